@@ -9,6 +9,9 @@
 #include "tinywxuni.h"
 #include "tinyxml.h"
 
+// The buffer is only needed while parsing: the nodes own their strings (entities are
+// decoded and callers modify values in place), and they're freed one by one, since
+// documents like ConfigManager's are edited for the whole session.
 bool TinyXML::LoadDocument(const wxString& filename, TiXmlDocument *doc)
 {
 
@@ -211,6 +211,16 @@ void TiXmlParsingData::Stamp( const char* now, TiXmlEncoding encoding )
 
 	while ( p < now )
 	{
+		// Plain printable ASCII just moves the column; this covers
+		// nearly all of a typical file, so skip it in a tight loop.
+		while ( p < now && (unsigned char) *p >= 0x20 && (unsigned char) *p < 0x80 )
+		{
+			++p;
+			++col;
+		}
+		if ( p >= now )
+			break;
+
 		// Treat p as unsigned, so we have a happy compiler.
 		const unsigned char* pU = (const unsigned char*)p;
 
@@ -579,14 +589,39 @@ const char* TiXmlBase::ReadText(	const char* p,
 									TiXmlEncoding encoding )
 {
     *text = "";
+
+	// Plain ASCII characters are copied in runs, instead of one append
+	// per character. Only entities, multi-byte characters and whatever
+	// may start the end tag go through GetChar() and StringEqual().
+	char endLower = *endTag;
+	char endUpper = *endTag;
+	if ( caseInsensitive )
+	{
+		endLower = (char) tolower( (unsigned char) *endTag );
+		endUpper = (char) toupper( (unsigned char) *endTag );
+	}
+
 	if (    !trimWhiteSpace			// certain tags always keep whitespace
 		 || !condenseWhiteSpace )	// if true, whitespace is always kept
 	{
 		// Keep all the white space.
-		while (	   p && *p
-				&& !StringEqual( p, endTag, caseInsensitive, encoding )
-			  )
+		while ( p && *p )
 		{
+			const char* run = p;
+			while (    *p
+					&& (unsigned char) *p < 0x80
+					&& *p != '&'
+					&& *p != endLower
+					&& *p != endUpper )
+			{
+				++p;
+			}
+			if ( p > run )
+				text->append( run, p - run );
+
+			if ( !*p || StringEqual( p, endTag, caseInsensitive, encoding ) )
+				break;
+
 			int len;
 			char cArr[4] = { 0, 0, 0, 0 };
 			p = GetChar( p, cArr, &len, encoding );
@@ -621,6 +656,23 @@ const char* TiXmlBase::ReadText(	const char* p,
 					(*text) += ' ';
 					whitespace = false;
 				}
+
+				const char* run = p;
+				while (    *p
+						&& (unsigned char) *p < 0x80
+						&& *p != '&'
+						&& *p != endLower
+						&& *p != endUpper
+						&& !IsWhiteSpace( *p ) )
+				{
+					++p;
+				}
+				if ( p > run )
+				{
+					text->append( run, p - run );
+					continue;
+				}
+
 				int len;
 				char cArr[4] = { 0, 0, 0, 0 };
 				p = GetChar( p, cArr, &len, encoding );
@@ -21,6 +21,8 @@ class ProjectFile;
 class FilesGroupsAndMasks;
 class TiXmlNode;
 class TiXmlElement;
+class TiXmlDocument;
+struct ProjectFileState;
 
 // hashmap for fast searches in cbProject::GetFileByFilename()
 WX_DECLARE_STRING_HASH_MAP(ProjectFile*, ProjectFiles);
@@ -89,8 +91,11 @@ enum PCHMode
 class DLLIMPORT cbProject : public CompileTargetBase
 {
      public:
-        /// Constructor
-        cbProject(const wxString& filename = wxEmptyString);
+        /** Constructor.
+          * @param filename The project file.
+          * @param doc The already parsed project file, if available (it remains owned by the caller).
+          */
+        cbProject(const wxString& filename = wxEmptyString, TiXmlDocument* doc = 0);
         /// Destructor
         ~cbProject();
 
@@ -396,6 +401,14 @@ class DLLIMPORT cbProject : public CompileTargetBase
           */
         ProjectFile* AddFile(int targetIndex, const wxString& filename, bool compile = true, bool link = true, unsigned short int weight = 50);
 
+        /** Add a file to the project, like AddFile(-1, ...) did before.
+          * Used when loading the project, with the state cached from a previous
+          * load (see ProjectSnapshot), so it isn't worked out again.
+          * @param state What AddFile() worked out for the file (which generates no other files).
+          * @return The newly added file or NULL if something went wrong.
+          */
+        ProjectFile* AddFile(const ProjectFileState& state);
+
         /** Remove a file from the project.
           * @param index The index of the file.
           * @return True if @c index was valid, false if not.
@@ -664,7 +677,7 @@ class DLLIMPORT cbProject : public CompileTargetBase
         virtual FilesList& GetFilesList(){ return m_Files; }
 
     private:
-        void Open();
+        void Open(TiXmlDocument* doc = 0);
         void ExpandVirtualBuildTargetGroup(const wxString& alias, wxArrayString& result) const;
         wxTreeItemId AddTreeNode(wxTreeCtrl* tree, const wxString& text, const wxTreeItemId& parent, bool useFolders, FileTreeData::FileTreeDataKind folders_kind, bool compiles, int image, FileTreeData* data = 0L);
         wxTreeItemId FindNodeToInsertAfter(wxTreeCtrl* tree, const wxString& text, const wxTreeItemId& parent, bool in_folders); // alphabetical sorting
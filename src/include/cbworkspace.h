@@ -3,6 +3,7 @@
 
 #include <wx/string.h>
 #include <wx/filename.h>
+#include <wx/datetime.h>
 
 #include "globals.h"
 
@@ -102,12 +103,25 @@ class cbWorkspace
           * false, the workspace will be marked as unmodified.
           */
         virtual void SetModified(bool modified);
+
+        /** @brief Get the workspace file's modification time when it was last loaded or saved
+          *
+          * Used to detect modifications outside the IDE.
+          */
+        wxDateTime GetLastModificationTime() const { return m_LastModified; }
+
+        /** @brief Set the last modification time to 'now'
+          *
+          * Used when the user chose not to reload a workspace modified outside the IDE.
+          */
+        void Touch() { m_LastModified = wxDateTime::Now(); }
     private:
         bool m_IsOK; // succeeded loading?
         bool m_IsDefault; // is this the Code::Blocks default workspace?
         bool m_Modified; // is it modified?
         wxFileName m_Filename; // filename
         wxString m_Title; // title
+        wxDateTime m_LastModified; // the file's time when loaded or saved
 
         void Load(); // utility function
 };
@@ -11,6 +11,7 @@
 #include "compileroptions.h"
 
 class CompilerCommandGenerator;
+class wxRegEx;
 class cbProject;
 class ProjectBuildTarget;
 class ProjectFile;
@@ -358,6 +359,21 @@ class DLLIMPORT Compiler : public CompileOptionsBase
         bool m_Valid; // 'valid' flag
         bool m_NeedValidityCheck; // flag to re-check validity (raised when changing compiler paths)
 
+        // compiled form of m_RegExes, so that CheckForWarningsAndErrors() doesn't
+        // have to build a wxRegEx for each regex on each output line.
+        // it is re-synced with m_RegExes (by comparing the patterns) on each call,
+        // because derived compilers modify m_RegExes directly.
+        struct CompiledRegEx
+        {
+            wxString pattern; // the pattern this was compiled from
+            wxString literal; // a literal that any matching line must contain (may be empty)
+            wxRegEx* regex;
+        };
+        typedef std::vector<CompiledRegEx> CompiledRegExes;
+        CompiledRegExes m_CompiledRegExes;
+        void SyncCompiledRegExes();
+        void ClearCompiledRegExes();
+
         // "mirror" default settings for comparing when saving (to save only those that differ from defaults)
         struct MirrorSettings
         {
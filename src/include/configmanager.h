@@ -3,6 +3,7 @@
 
 #include <wx/hashmap.h>
 #include <wx/hashset.h>
+#include <wx/thread.h>
 
 #include "settings.h"
 #include "globals.h"
@@ -94,8 +95,19 @@ class DLLIMPORT ConfigManager
     TiXmlElement* root;
     TiXmlElement* pathNode;
 
+    struct KeyIndexEntry
+    {
+        TiXmlElement* base; // pathNode the key was resolved in
+        TiXmlElement* leaf; // null if the key doesn't exist
+    };
+    WX_DECLARE_STRING_HASH_MAP(KeyIndexEntry, KeyIndexMap);
+    KeyIndexMap keyIndex;
+    mutable wxMutex indexMutex; // guards the index and the document, recursive
+
     ConfigManager(TiXmlElement* r);
     TiXmlElement* AssertPath(wxString& path);
+    TiXmlElement* FindLeaf(const wxString& name);
+    TiXmlElement* AssertLeaf(const wxString& name);
     TiXmlElement* GetUniqElement(TiXmlElement* p, const wxString& q);
     void SetNodeText(TiXmlElement *n, const TiXmlText& t);
     inline void Collapse(wxString& str) const;
@@ -276,10 +288,10 @@ public:
 
     template <typename T> void Read(const wxString& name, std::map<wxString, T*> *map)
     {
-        wxString key(name);
-        TiXmlHandle ph(AssertPath(key));
+        wxMutexLocker lock(indexMutex);
+        TiXmlHandle ph(FindLeaf(name));
         TiXmlElement* e = 0;
-        if(TiXmlNode *n = ph.FirstChild(key.mb_str(wxConvUTF8)).FirstChild("objmap").Node())
+        if(TiXmlNode *n = ph.FirstChild("objmap").Node())
             while(n->IterateChildren(e) && (e = n->IterateChildren(e)->ToElement()))
             {
                 T *obj = new T;
@@ -42,6 +42,7 @@ struct cbFindReplaceData;
 class DLLIMPORT EditorManager : public Mgr<EditorManager>, public wxEvtHandler
 {
         friend class Mgr<EditorManager>;
+        friend class EditorBase; // keeps the file name index up to date
         static bool s_CanShutdown;
     public:
         friend class Manager; // give Manager access to our private members
@@ -60,6 +61,15 @@ class DLLIMPORT EditorManager : public Mgr<EditorManager>, public wxEvtHandler
         EditorBase* IsOpen(const wxString& filename);
         cbEditor* Open(const wxString& filename, int pos = 0,ProjectFile* data = 0);
         cbEditor* Open(LoaderBase* fileLdr, const wxString& filename, int pos = 0,ProjectFile* data = 0);
+        /** Open @c filename in a tab which loads the file only when it's used, i.e. when
+          * the tab is activated or the file is opened again with Open(). Until then, it's
+          * a plain EditorBase: GetBuiltinEditor() and IsBuiltinOpen() return NULL for it,
+          * so loops over the open editors don't load it.
+          * Used to restore project layouts.
+          * @return The (maybe not loaded) editor, or NULL if the file doesn't exist. */
+        EditorBase* OpenDeferred(const wxString& filename, ProjectFile* data = 0);
+        /** Is @c eb a tab opened by OpenDeferred() and not loaded yet? Its file is unmodified. */
+        bool IsDeferred(EditorBase* eb) const;
         EditorBase* GetEditor(int index);
         EditorBase* GetEditor(const wxString& filename){ return IsOpen(filename); } // synonym of IsOpen()
         EditorBase* GetActiveEditor();
@@ -112,7 +122,8 @@ class DLLIMPORT EditorManager : public Mgr<EditorManager>, public wxEvtHandler
         void HideNotebook();
         /** Shows the previously hidden editor notebook */
         void ShowNotebook();
-        /** Check if one of the open files has been modified outside the IDE. If so, ask to reload it. */
+        /** Check if one of the open files has been modified outside the IDE. If so, ask to reload it.
+          * Only the files reported by the file watcher (see FileWatcher) are checked. */
         void CheckForExternallyModifiedFiles();
 
         void OnGenericContextMenuHandler(wxCommandEvent& event);
@@ -136,11 +147,16 @@ class DLLIMPORT EditorManager : public Mgr<EditorManager>, public wxEvtHandler
         void OnTreeItemRightClick(wxTreeEvent &event);
         void SetZoom(int zoom);
         int GetZoom()const;
+        /** @brief Stop the running "Find in files" search (the matches found so far are kept). */
+        void CancelFindInFiles();
 
     protected:
         // m_EditorsList access
         void AddEditorBase(EditorBase* eb);
         void RemoveEditorBase(EditorBase* eb, bool deleteObject = true);
+        // file name index access
+        void IndexEditor(EditorBase* eb);
+        void UnindexEditor(EditorBase* eb);
         cbEditor* InternalGetBuiltinEditor(int page);
         EditorBase* InternalGetEditorBase(int page);
 
@@ -156,8 +172,14 @@ class DLLIMPORT EditorManager : public Mgr<EditorManager>, public wxEvtHandler
         ~EditorManager();
         void CalculateFindReplaceStartEnd(cbStyledTextCtrl* control, cbFindReplaceData* data, bool replace = false);
         void OnCheckForModifiedFiles(wxCommandEvent& event);
+        void OnFilesChanged(wxCommandEvent& event);
+        cbEditor* LoadDeferredEditor(EditorBase* eb, LoaderBase* fileLdr = 0);
+        void OnLoadDeferredEditor(wxCommandEvent& event);
         int Find(cbStyledTextCtrl* control, cbFindReplaceData* data);
         int FindInFiles(cbFindReplaceData* data);
+        void OnFindInFilesResults(wxCommandEvent& event);
+        void LogFindInFilesResults();
+        void EndFindInFiles();
         int Replace(cbStyledTextCtrl* control, cbFindReplaceData* data);
         int ReplaceInFiles(cbFindReplaceData* data);
 
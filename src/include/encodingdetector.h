@@ -12,8 +12,9 @@ class DLLIMPORT EncodingDetector
 {
 	public:
 		EncodingDetector(const wxString& filename);
-		EncodingDetector(LoaderBase* fileLdr);
-		EncodingDetector(const wxByte* buffer, size_t size);
+		/** If @c ConvertToWxString is false, only the encoding is detected and GetWxStr() returns an empty string. */
+		EncodingDetector(LoaderBase* fileLdr, bool ConvertToWxString = true);
+		EncodingDetector(const wxByte* buffer, size_t size, bool ConvertToWxString = true);
 		EncodingDetector(const EncodingDetector& rhs);
 		~EncodingDetector();
 
@@ -0,0 +1,86 @@
+#ifndef FILEWATCHER_H
+#define FILEWATCHER_H
+
+#include <map>
+#include <set>
+
+#include <wx/arrstr.h>
+#include <wx/string.h>
+#include <wx/thread.h>
+
+#include "settings.h"
+
+class wxEvtHandler;
+
+/**
+  * @brief Tells which files may have been modified outside the IDE.
+  *
+  * Checking for external modifications used to mean stat()'ing every open
+  * file, each time the application or an editor was activated. With the
+  * files on a slow (network) drive, that blocks the UI for a long time.
+  *
+  * On Linux, the directories of the watched files are watched with inotify
+  * by a dedicated thread. When a watched file changes, the owner gets a
+  * wxEVT_COMMAND_MENU_SELECTED event with the given id. Further changes
+  * don't send more events until the pending ones are taken with
+  * GetChanges().
+  *
+  * Some files can't be watched this way, and these are polled instead:
+  * GetChanges() always returns them, and the caller checks them like it
+  * always did. This covers all files on other platforms and files on
+  * network file systems, where inotify doesn't see changes made by other
+  * hosts. It also covers files added when the system's watch limit is
+  * reached.
+  */
+class DLLIMPORT FileWatcher : public wxThread
+{
+    public:
+        FileWatcher(wxEvtHandler* owner, int id);
+        virtual ~FileWatcher();
+
+        /** @brief Start watching @c filename (watches are reference-counted).
+          * A newly added file is returned once by the next GetChanges(). */
+        void Add(const wxString& filename);
+        /** @brief Stop watching @c filename. */
+        void Remove(const wxString& filename);
+        /** @brief Get the files which may have changed since the last call, plus the polled ones. */
+        void GetChanges(wxArrayString& changed);
+        /** @brief Return @c filenames again by the next GetChanges(), without notifying the owner.
+          * Useful when the caller couldn't check them all (e.g. the user cancelled). */
+        void Requeue(const wxArrayString& filenames);
+
+        /** @brief Should the owner check the reported changes now?
+          * Not while another application has the focus (the check is done when the IDE
+          * is activated again), nor when the "check modified files" option is off. */
+        static bool ShouldCheckChanges();
+    protected:
+        virtual ExitCode Entry();
+    private:
+        bool WatchNatively(const wxString& filename);
+        void UnwatchNatively(const wxString& filename);
+        void DirectoryChanged(const wxString& dir);
+        void Notify();
+
+        wxEvtHandler* m_pOwner;
+        int m_ID;
+        int m_Fd; // inotify instance, -1 when not available
+        bool m_Running;
+
+        wxMutex m_Mutex; // protects the members below
+        bool m_Stop;
+        bool m_NotifyPending;
+        typedef std::map<wxString, int> FileRefs;
+        FileRefs m_Files; // all watched files, with their reference count
+        std::set<wxString> m_Polled; // watched files not seen by inotify
+        struct WatchedDir
+        {
+            int wd;
+            int count; // files watched in the directory
+        };
+        typedef std::map<wxString, WatchedDir> WatchedDirs;
+        WatchedDirs m_Dirs;
+        std::map<int, wxString> m_DirsByWatch;
+        std::set<wxString> m_Changed;
+};
+
+#endif // FILEWATCHER_H
@@ -13,7 +13,11 @@
 #include <wx/ffile.h>
 #include <wx/textctrl.h>
 
+#include <vector>
+
 class wxListCtrl;
+class wxListItemAttr;
+class wxTimer;
 
 // this file contains some kinds of loggers, they can save/record messages to different kind of devices
 // all these specific logger classes are derived from Logger class defined in logger.h
@@ -116,6 +120,34 @@ public:
     virtual void Append(const wxString& msg, Logger::level lv = info);
 };
 
+/** a TextCtrlLogger which collects messages and adds them to the control a few times per second,
+  * so loggers getting lots of lines (like the build log) don't redraw the control for every one of them */
+class DLLIMPORT BufferedTextCtrlLogger : public TextCtrlLogger
+{
+protected:
+
+    struct Run
+    {
+        Logger::level lv;
+        wxString      text;
+    };
+    std::vector<Run> pending; // consecutive messages of the same level are merged
+    wxTimer*         flushTimer;
+
+    void AddRun(Logger::level lv, const wxString& text);
+
+public:
+    BufferedTextCtrlLogger(bool fixedPitchFont = false);
+    ~BufferedTextCtrlLogger();
+
+    /** add the pending messages to the control now */
+    virtual void      Flush();
+
+    virtual void      CopyContentsToClipboard(bool selectionOnly = false);
+    virtual void      Append(const wxString& msg, Logger::level lv = info);
+    virtual void      Clear();
+};
+
 /** a logger which prints messages to a wxListCtrl */
 class DLLIMPORT ListCtrlLogger : public Logger
 {
@@ -150,4 +182,39 @@ public:
     virtual void      AutoFitColumns(int column);
 };
 
+/** a ListCtrlLogger using a virtual list control: the rows are kept here, column by column,
+  * and the control only asks for the rows it shows. New rows are added to the control a few
+  * times per second, so it stays responsive when getting many thousands of rows.
+  * Call Flush() before accessing the control's items after appending. */
+class DLLIMPORT VirtualListCtrlLogger : public ListCtrlLogger
+{
+protected:
+
+    std::vector<wxArrayString> columns;  // one entry per row in each column
+    std::vector<unsigned char> levels;   // Logger::level of each row
+    wxListItemAttr*            attrs;    // one per level
+    wxTimer*                   flushTimer;
+    wxArrayInt                 autoSizeColumns;
+
+public:
+
+    VirtualListCtrlLogger(const wxArrayString& titles, const wxArrayInt& widths, bool fixedPitchFont = false);
+    ~VirtualListCtrlLogger();
+
+    /** tell the control about the rows appended since the last call */
+    virtual void      Flush();
+
+    wxString          GetItemText(long item, long column) const;
+    wxListItemAttr*   GetItemAttr(long item) const;
+
+    virtual void      CopyContentsToClipboard(bool selectionOnly = false);
+    virtual void      UpdateSettings();
+    virtual void      Append(const wxString& msg, Logger::level lv = info);
+    virtual void      Append(const wxArrayString& colValues, Logger::level lv = info, int autoSize = -1);
+    virtual size_t    GetItemsCount() const;
+    virtual void      Clear();
+    virtual wxWindow* CreateControl(wxWindow* parent);
+    virtual void      AutoFitColumns(int column);
+};
+
 #endif // LOGGERS_H
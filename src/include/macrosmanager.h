@@ -5,6 +5,7 @@
 #include "manager.h"
 #include <wx/regex.h>
 #include <wx/filename.h>
+#include <vector>
 
 // forward decls;
 class wxMenuBar;
@@ -15,6 +16,16 @@ class UserVariableManager;
 
 WX_DECLARE_STRING_HASH_MAP( wxString, MacrosMap );
 
+// A piece of a tokenised macro string: either literal text or a variable reference.
+struct MacroToken
+{
+    bool isVar;
+    wxString text;  // literal text, or the upper-cased variable name
+    wxChar trail;   // separator eaten after a $VAR reference, appended to its value
+};
+typedef std::vector<MacroToken> MacroTemplate;
+WX_DECLARE_STRING_HASH_MAP( MacroTemplate, MacroTemplateMap );
+
 class DLLIMPORT MacrosManager : public Mgr<MacrosManager>
 {
 public:
@@ -37,18 +48,21 @@ protected:
     m_ProjectFiles, m_Makefile, m_TargetOutputDir, m_TargetName,
     m_TargetOutputBaseName, m_TargetFilename;
 	MacrosMap macros;
-    wxRegEx m_re_unx;
-    wxRegEx m_re_dos;
     wxRegEx m_re_if;
     wxRegEx m_re_ifsp;
     wxRegEx m_re_script;
+    MacroTemplateMap m_templates;   // tokenised input strings
+    MacrosMap m_expanded;           // expansions valid until the next RecalcVars()
     UserVariableManager *m_uVarMan;
 public:
     void Reset();
 private:
     MacrosManager();
     ~MacrosManager();
-    wxString EvalCondition(const wxString& cond, const wxString& true_clause, const wxString& false_clause, ProjectBuildTarget* target);
+    bool DoReplaceMacros(wxString& buffer, ProjectBuildTarget* target, bool subrequest);
+    wxString EvalCondition(const wxString& cond, const wxString& true_clause, const wxString& false_clause, ProjectBuildTarget* target, bool& constant);
+    const MacroTemplate& GetTemplate(const wxString& str);
+    bool ExpandTemplate(const MacroTemplate& tpl, wxString& out, int depth);
 };
 
 #endif // MACROSMANAGER_H
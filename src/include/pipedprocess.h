@@ -21,6 +21,9 @@ class DLLIMPORT PipedProcess : public wxProcess
         virtual bool HasInput();
 		virtual int GetPid(){ return m_Pid; }
 		void ForfeitStreams();
+		/** Enable/disable reading the redirected streams in HasInput().
+		  * Disable it when someone else (e.g. a reader thread) consumes the output. */
+		void SetPollInput(bool poll){ m_PollInput = poll; }
     protected:
          virtual void OnTerminate(int pid, int status);
 		virtual void OnTimer(wxTimerEvent& event);
@@ -28,6 +31,7 @@ class DLLIMPORT PipedProcess : public wxProcess
         wxEvtHandler* m_Parent;
 		int m_Id;
 		int m_Pid;
+		bool m_PollInput;
 		wxTimer m_timerPollProcess;
 	private:
 		void** m_pvThis;
@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <map>
+#include <string>
 
 #include <wx/dynarray.h>
 #include "globals.h" // PluginType
@@ -135,6 +136,11 @@ class DLLIMPORT PluginManager : public Mgr<PluginManager>, public wxEvtHandler
                                 PluginInfo* infoOut = 0);
 		void ReadExtraFilesFromManifestFile(const wxString& pluginFilename,
 											wxArrayString& extraFiles);
+        /// Read the manifests of the given plugins: from the cache when their resources
+        /// haven't changed, else in parallel. Manifests which can't be read are left empty.
+        void ReadManifests(const wxArrayString& pluginFilenames, std::vector<std::string>& manifests);
+        void LoadManifestCache();
+        void SaveManifestCache();
         bool ExtractFile(const wxString& bundlename,
                         const wxString& src_filename,
                         const wxString& dst_filename,
@@ -145,6 +151,17 @@ class DLLIMPORT PluginManager : public Mgr<PluginManager>, public wxEvtHandler
         wxDynamicLibrary* m_pCurrentlyLoadingLib;
         TiXmlDocument* m_pCurrentlyLoadingManifestDoc;
 
+        // manifests read at previous startups, by resource file
+        struct CachedManifest
+        {
+            long modified;
+            long size;
+            std::string contents;
+        };
+        typedef std::map<wxString, CachedManifest> ManifestCache;
+        ManifestCache m_ManifestCache;
+        bool m_ManifestCacheLoaded;
+
         // this struct fills the following vector each time
         // RegisterPlugin() is called.
         // this vector is then used in LoadPlugin() (which triggered
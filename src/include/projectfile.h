@@ -2,12 +2,14 @@
 #define PROJECTFILE_H
 
 #include <vector>
+#include <algorithm>
 
 #include "settings.h"
 #include "globals.h"
 #include <wx/dynarray.h>
 #include <wx/filename.h>
 #include <wx/list.h>
+#include <wx/hashset.h>
 #include <wx/treectrl.h>
 
 #include "blockallocated.h"
@@ -174,7 +176,70 @@ class ProjectFile  : public BlockAllocated<ProjectFile, 1000>
         wxString m_ObjName;
         PFDMap m_PFDMap;
 };
-WX_DECLARE_LIST(ProjectFile, FilesList);
+WX_DECLARE_HASH_SET(ProjectFile*, wxPointerHash, wxPointerEqual, ProjectFilesSet);
+
+/** The files of a project or build target, in project order.
+  *
+  * Files are kept in a vector, so GetFile(index) doesn't walk a list.
+  * ProjectFile objects come from their block allocator and are only
+  * referenced here, so the pointers stay valid when the list grows or
+  * is sorted. A hash set makes Find() constant time.
+  *
+  * Iterate with begin()/end() or by index:
+  * @code
+  * for (FilesList::iterator it = prj->GetFilesList().begin(); it != prj->GetFilesList().end(); ++it)
+  *     DoSomething(*it);
+  * @endcode
+  */
+class FilesList
+{
+    public:
+        typedef ProjectFilesVector::iterator iterator;
+        typedef ProjectFilesVector::const_iterator const_iterator;
+
+        iterator begin(){ return m_Files.begin(); }
+        iterator end(){ return m_Files.end(); }
+        const_iterator begin() const { return m_Files.begin(); }
+        const_iterator end() const { return m_Files.end(); }
+
+        size_t GetCount() const { return m_Files.size(); }
+        bool IsEmpty() const { return m_Files.empty(); }
+        ProjectFile* Item(size_t index) const { return m_Files[index]; }
+        ProjectFile* operator[](size_t index) const { return m_Files[index]; }
+
+        /** @return True if @c file is in the list. */
+        bool Find(ProjectFile* file) const { return m_Set.find(file) != m_Set.end(); }
+
+        /** Add @c file at the end of the list (if it's not there already). */
+        void Append(ProjectFile* file)
+        {
+            if (m_Set.insert(file).second)
+                m_Files.push_back(file);
+        }
+
+        /** Remove @c file from the list. Does not delete it.
+          * @return True if the file was in the list. */
+        bool DeleteObject(ProjectFile* file)
+        {
+            if (!m_Set.erase(file))
+                return false;
+            m_Files.erase(std::find(m_Files.begin(), m_Files.end(), file));
+            return true;
+        }
+
+        /** Remove all files from the list. Does not delete them. */
+        void Clear()
+        {
+            m_Files.clear();
+            m_Set.clear();
+        }
+
+        /** Sort the list using @c less to compare files. */
+        template<class Compare> void Sort(Compare less){ std::sort(m_Files.begin(), m_Files.end(), less); }
+    private:
+        ProjectFilesVector m_Files;
+        ProjectFilesSet m_Set;
+};
 
 /** This is a helper class that caches various filenames for one ProjectFile.
   * These include the source filename, the generated object filename,
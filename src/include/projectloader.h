@@ -10,6 +10,7 @@
 class cbProject;
 class ProjectBuildTarget;
 class ProjectFile;
+class TiXmlDocument;
 
 WX_DECLARE_STRING_HASH_MAP(wxString, CompilerSubstitutes);
 
@@ -41,6 +42,14 @@ class DLLIMPORT ProjectLoader : public IBaseLoader
           * @return True on success, false on failure. */
         bool Open(const wxString& filename, TiXmlElement** ppExtensions);
 
+        /** Open a file that has already been read and parsed.
+          * Used when project files are parsed in background threads (e.g. by the workspace loader).
+          * @param filename The file's name.
+          * @param doc The parsed file. It remains owned by the caller.
+          * @param ppExtensions Receives a copy of the \<Extensions\> element (if not NULL).
+          * @return True on success, false on failure. */
+        bool Open(const wxString& filename, TiXmlDocument* doc, TiXmlElement** ppExtensions);
+
         /** Save a file.
           * This version of Save, can override the \<Extensions\> element.
           * @param filename The file to save.
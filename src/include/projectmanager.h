@@ -5,6 +5,7 @@
 #include "globals.h" // DEFAULT_WORKSPACE
 
 #include <wx/event.h>
+#include <wx/arrstr.h>
 #include <wx/dynarray.h>
 #include <wx/hashmap.h>
 #include <wx/treectrl.h>
@@ -23,6 +24,8 @@ class FilesGroupsAndMasks;
 class cbWorkspace;
 class wxFlatNotebook;
 class wxFlatNotebookEvent;
+class TiXmlDocument;
+class FileWatcher;
 
 DLLIMPORT extern int ID_ProjectManager; /* Used by both Project and Editor Managers */
 WX_DEFINE_ARRAY(cbProject*, ProjectsArray);
@@ -97,10 +100,11 @@ class DLLIMPORT ProjectManager : public Mgr<ProjectManager>, public wxEvtHandler
           * so that the same project can't be loaded twice.
           * @param filename The project file's filename.
           * @param activateIt Active the project after loading.
+          * @param doc The already parsed project file, if available (it remains owned by the caller).
           * @return If the function succeeds, a pointer to the newly opened project
           * is returned. Else the return value is NULL.
           */
-        cbProject* LoadProject(const wxString& filename, bool activateIt = true);
+        cbProject* LoadProject(const wxString& filename, bool activateIt = true, TiXmlDocument* doc = 0);
         /** Save a project to disk.
           * @param project A pointer to the project to save.
           * @return True if saving was succesful, false if not.
@@ -383,7 +387,8 @@ class DLLIMPORT ProjectManager : public Mgr<ProjectManager>, public wxEvtHandler
         /** @return The virtual folder icon index in the image list. */
         int VirtualFolderIconIndex();
 
-        /** Check if one of the open projects has been modified outside the IDE. If so, ask to reload it. */
+        /** Check if the workspace or one of the open projects has been modified outside the IDE.
+          * If so, ask to reload it. Only the files reported by the file watcher (see FileWatcher) are checked. */
         void CheckForExternallyModifiedProjects();
 
         /** Sends message to the plugins that the workspace has been changed */
@@ -462,11 +467,14 @@ class DLLIMPORT ProjectManager : public Mgr<ProjectManager>, public wxEvtHandler
         void OnUpdateUI(wxUpdateUIEvent& event);
         void OnIdle(wxIdleEvent& event);
         void OnAppDoneStartup(CodeBlocksEvent& event);
+        void OnProjectFilesChanged(wxCommandEvent& event);
 
         void DoOpenSelectedFile();
         void DoOpenFile(ProjectFile* pf, const wxString& filename);
         int DoAddFileToProject(const wxString& filename, cbProject* project, wxArrayInt& targets);
         void RemoveFilesRecursively(wxTreeItemId& sel_id);
+        void UpdateWatchedProjects();
+        bool CheckForExternallyModifiedWorkspace(const wxArrayString& changedFiles);
 
         wxFlatNotebook* m_pNotebook;
         wxTreeCtrl* m_pTree;
@@ -488,6 +496,8 @@ class DLLIMPORT ProjectManager : public Mgr<ProjectManager>, public wxEvtHandler
         wxTreeItemId m_DraggingItem;
         bool m_isCheckingForExternallyModifiedProjects;
         bool m_CanSendWorkspaceChanged;
+        FileWatcher* m_pWatcher; // tells which project (and workspace) files must be checked for external modifications
+        wxArrayString m_WatchedProjects; // includes the workspace file
 
         DECLARE_EVENT_TABLE()
 };
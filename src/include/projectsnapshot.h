@@ -0,0 +1,62 @@
+#ifndef PROJECTSNAPSHOT_H
+#define PROJECTSNAPSHOT_H
+
+#include <wx/hashmap.h>
+#include <wx/string.h>
+
+class cbProject;
+class TiXmlDocument;
+
+/** What cbProject::AddFile() works out for a file which generates no other files. */
+struct ProjectFileState
+{
+    ProjectFileState() : compile(false), link(false) {}
+
+    wxString relativeFilename;
+    wxString fullFilename;
+    wxString compilerVar;
+    bool compile;
+    bool link;
+};
+/// Unit filename (as in the project file) -> its state
+WX_DECLARE_STRING_HASH_MAP(ProjectFileState, ProjectFileStates);
+
+/**
+  * @brief Caches what it takes to load a project file.
+  *
+  * Two caches are kept per project, in the "projects" folder of the
+  * user's config folder (never next to the project):
+  * - a compact binary snapshot of the parsed project file, used as long as
+  *   the project file's size and modification time haven't changed;
+  * - the state cbProject::AddFile() works out for each unit (file type,
+  *   compiler variable, generated files...), used as long as the compilers
+  *   set up and the compilers used by the project haven't changed.
+  * The project file always remains the source of truth: a missing, stale or
+  * damaged cache is ignored and everything is worked out again.
+  * The caches are only used if "/environment/project_snapshots" (in the "app"
+  * config namespace) is set, which is the default.
+  */
+namespace ProjectSnapshot
+{
+    /** @return The snapshot file of project file @c filename, or an empty string if
+      * snapshots are disabled. Call from the main thread. */
+    wxString GetSnapshotFilename(const wxString& filename);
+
+    /** Read the project file @c filename into @c doc, from @c snapshotFilename if possible.
+      * If the file had to be parsed, a new snapshot is saved (when possible).
+      * This uses plain C file I/O and doesn't log anything, so it's safe to use from
+      * worker threads.
+      * @param snapshotFilename As returned by GetSnapshotFilename(); if empty, the file is just parsed.
+      * @return False if the file can't be read. Parse errors are left in @c doc,
+      * like TinyXML::LoadDocument() does. */
+    bool LoadDocument(const wxString& filename, const wxString& snapshotFilename, TiXmlDocument* doc);
+
+    /** Read the cached unit states of @c project (its targets must be loaded already).
+      * @return False if there are none, or they aren't valid anymore. */
+    bool LoadFileStates(cbProject* project, ProjectFileStates& states);
+
+    /** Save the unit states of @c project, for LoadFileStates(). */
+    void SaveFileStates(cbProject* project, const ProjectFileStates& states);
+}
+
+#endif // PROJECTSNAPSHOT_H
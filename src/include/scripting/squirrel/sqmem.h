@@ -6,4 +6,20 @@ void *sq_vm_malloc (SQUnsignedInteger size);
 void *sq_vm_realloc(void *p,SQUnsignedInteger oldsize,SQUnsignedInteger size);
 void  sq_vm_free   (void *p,SQUnsignedInteger size);
 
+// C::B patch: Memory statistics of the pool allocator (see sqmem.cpp)
+#define SQ_MEM_GRANULARITY 8
+#define SQ_MEM_NUM_CLASSES 32 // blocks up to 256 bytes are pooled
+
+struct SQMemStats
+{
+	SQUnsignedInteger live_bytes;   // requested by the VM and not freed yet
+	SQUnsignedInteger peak_bytes;   // highest live_bytes so far
+	SQUnsignedInteger pool_bytes;   // taken from libc for the pools
+	SQUnsignedInteger live_blocks;  // pooled blocks in use
+	SQUnsignedInteger large_allocs; // blocks too big for the pools
+	SQUnsignedInteger class_hits[SQ_MEM_NUM_CLASSES]; // blocks served by each size class
+};
+
+void  sq_vm_getmemstats(SQMemStats *stats);
+
 #endif //_SQMEM_H_
@@ -12,6 +12,7 @@
 #include <wx/intl.h>
 
 class SquirrelError;
+class SquirrelObject;
 
 /** @brief Provides scripting in Code::Blocks.
   *
@@ -60,6 +61,9 @@ class DLLIMPORT ScriptingManager : public Mgr<ScriptingManager>, public wxEvtHan
         void operator=(const ScriptingManager& rhs){ cbThrow(_T("Can't assign an ScriptingManager* !!!")); }
 
         /** @brief Loads a script.
+          *
+          * The compiled script is kept, it's only compiled again when the
+          * file's modification time or size changes.
           *
           * @param filename The filename of the script to run.
           * @return True if the script loaded and compiled, false if not.
@@ -67,6 +71,9 @@ class DLLIMPORT ScriptingManager : public Mgr<ScriptingManager>, public wxEvtHan
         bool LoadScript(const wxString& filename);
 
         /** @brief Loads a string buffer.
+          *
+          * Recently compiled buffers are kept, running the same buffer
+          * again doesn't compile it again.
           *
           * @param buffer The script buffer to compile and run.
           * @param debugName A debug name. This will appear in any errors displayed.
@@ -214,6 +221,8 @@ class DLLIMPORT ScriptingManager : public Mgr<ScriptingManager>, public wxEvtHan
         void OnScriptMenu(wxCommandEvent& event);
         void OnScriptPluginMenu(wxCommandEvent& event);
         void RegisterScriptFunctions();
+        bool CompileBuffer(const wxString& buffer, const wxString& debugName, SquirrelObject& script);
+        bool RunScript(SquirrelObject& script, const wxString& debugName);
 
         ScriptingManager();
         ~ScriptingManager();
@@ -0,0 +1,101 @@
+#ifndef SEARCHINFILES_H
+#define SEARCHINFILES_H
+
+#include <vector>
+
+#include <wx/font.h>
+#include <wx/string.h>
+#include <wx/thread.h>
+
+#include "settings.h"
+
+class wxEvtHandler;
+class cbThreadPool;
+
+/** What to search for, and how (see cbFindReplaceData). */
+struct SearchInFilesOptions
+{
+    SearchInFilesOptions();
+
+    wxString text;
+    bool matchCase;
+    bool matchWord; ///< the match must start and end at word boundaries
+    bool startWord; ///< the match must start at a word boundary
+    bool regEx; ///< @c text is a regular expression (the word options are ignored)
+    int regExFlags; ///< wxRE_BASIC, wxRE_EXTENDED or wxRE_ADVANCED
+    wxFontEncoding encoding; ///< used for files that are neither unicode nor valid UTF-8
+};
+
+/** A line matching the searched text. */
+struct SearchInFilesHit
+{
+    int line; ///< 1-based
+    wxString text;
+};
+typedef std::vector<SearchInFilesHit> SearchInFilesHits;
+
+/**
+  * @brief Searches text in a list of files, in the background.
+  *
+  * The files are read in one go (no editor control is involved) and
+  * searched by a pool of worker threads. Whenever a worker finished a
+  * chunk of files, the owner receives a cbEVT_THREADTASK_ENDED event
+  * with the given id and can fetch the results with GetNextResults(),
+  * which returns them in the order the files were added.
+  *
+  * Files open in an editor should be added with AddBuffer(), so their
+  * unsaved contents are searched.
+  *
+  * Only the first match of each line is reported.
+  */
+class DLLIMPORT SearchInFiles
+{
+    public:
+        SearchInFiles(wxEvtHandler* owner, int id, const SearchInFilesOptions& options);
+        /** Cancels the search, if still running. */
+        ~SearchInFiles();
+
+        /** @brief Add a file to be read from disk. */
+        void AddFile(const wxString& filename);
+        /** @brief Add a file whose contents are already in memory (e.g. an open editor). */
+        void AddBuffer(const wxString& filename, const wxString& contents);
+
+        /** @brief Start searching the files added so far. */
+        void Start();
+        /** @brief Stop searching and wait for the workers to let go.
+          * The results of files already searched can still be fetched. */
+        void Cancel();
+        bool IsCancelled() const { return m_Cancelled; }
+
+        /** @brief Get the results of the next file, if it was searched already.
+          * @return false if the next file isn't searched yet (or there are no more files). */
+        bool GetNextResults(wxString& filename, SearchInFilesHits& hits);
+        /** @brief Have all the results been fetched (or the search cancelled)? */
+        bool IsDone() const;
+
+        size_t GetFilesCount() const { return m_Files.size(); }
+        /** @brief The number of files whose results have been fetched. */
+        size_t GetFilesFetched() const { return m_NextResult; }
+    private:
+        friend class SearchInFilesTask;
+
+        struct File
+        {
+            wxString filename;
+            wxString contents;
+            bool inMemory;
+            bool searched;
+            SearchInFilesHits hits;
+        };
+
+        void SetResults(size_t index, SearchInFilesHits& hits);
+
+        SearchInFilesOptions m_Options;
+        cbThreadPool* m_pPool;
+        std::vector<File> m_Files;
+        size_t m_NextResult;
+        volatile bool m_Cancelled;
+        wxMutex m_Mutex; // protects File::searched and File::hits
+};
+
+#endif // SEARCHINFILES_H
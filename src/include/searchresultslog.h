@@ -6,8 +6,9 @@
 
 class wxArrayString;
 class wxCommandEvent;
+class wxListEvent;
 
-class SearchResultsLog : public ListCtrlLogger, public wxEvtHandler
+class SearchResultsLog : public VirtualListCtrlLogger, public wxEvtHandler
 {
 	public:
 		SearchResultsLog(const wxArrayString& titles, wxArrayInt& widths);
@@ -18,6 +19,7 @@ class SearchResultsLog : public ListCtrlLogger, public wxEvtHandler
 		virtual wxWindow* CreateControl(wxWindow* parent);
 	protected:
         void OnDoubleClick(wxCommandEvent& event);
+        void OnKeyDown(wxListEvent& event);
         void SyncEditor(int selIndex);
 
         wxString m_Base;
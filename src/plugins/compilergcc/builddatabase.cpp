@@ -0,0 +1,221 @@
+/*
+* This file is part of Code::Blocks Studio, an open-source cross-platform IDE
+* Copyright (C) 2003  Yiannis An. Mandravellos
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*
+* $Revision$
+* $Id$
+* $HeadURL$
+*/
+#include "sdk.h"
+#ifndef CB_PRECOMP
+    #include <wx/filefn.h>
+    #include <wx/intl.h>
+#endif
+#include <wx/file.h>
+#include <wx/ffile.h>
+#include "builddatabase.h"
+
+namespace
+{
+    const wxString g_Magic = _T("# build database v2");
+
+    // FNV-1a, 64 bits
+    wxString HashFile(const wxString& filename, bool& ok)
+    {
+        ok = false;
+        wxFile file(filename);
+        if (!file.IsOpened())
+            return wxEmptyString;
+
+        wxUint64 hash = wxULL(14695981039346656037);
+        unsigned char buf[65536];
+        ssize_t len;
+        while ((len = file.Read(buf, sizeof(buf))) > 0)
+        {
+            for (ssize_t i = 0; i < len; ++i)
+            {
+                hash ^= buf[i];
+                hash *= wxULL(1099511628211);
+            }
+        }
+        if (len == wxInvalidOffset)
+            return wxEmptyString;
+
+        ok = true;
+        return wxString::Format(_T("%08x%08x"), (unsigned int)(hash >> 32), (unsigned int)(hash & 0xffffffff));
+    }
+}
+
+BuildDatabase::BuildDatabase()
+    : m_Modified(false)
+{
+    //ctor
+}
+
+BuildDatabase::~BuildDatabase()
+{
+    //dtor
+}
+
+bool BuildDatabase::Load(const wxString& filename)
+{
+    m_Files.clear();
+    m_Objects.clear();
+    m_Modified = false;
+
+    if (!wxFileExists(filename))
+        return true;
+
+    wxFFile file(filename, _T("rb"));
+    wxString contents;
+    if (!file.IsOpened() || !file.ReadAll(&contents, wxConvUTF8))
+        return false;
+    if (!contents.StartsWith(g_Magic))
+        return false; // unknown version: start over
+
+    // F <mtime> <hash> <file>     hashed file
+    // O <old mtime> <object>      object file, followed by:
+    // C <command>                   its command line(s)
+    // I <hash> <file>               its inputs
+    ObjectInfo* object = 0;
+    size_t pos = 0;
+    while (pos < contents.Length())
+    {
+        size_t eol = contents.find(_T('\n'), pos);
+        if (eol == wxString::npos)
+            eol = contents.Length();
+        wxString line = contents.Mid(pos, eol - pos);
+        pos = eol + 1;
+        if (line.Length() < 2 || line[1] != _T(' '))
+            continue;
+
+        wxChar type = line[0];
+        line.Remove(0, 2);
+        long time = 0;
+        if (type == _T('F'))
+        {
+            FileHash& fh = m_Files[line.AfterFirst(_T(' ')).AfterFirst(_T(' '))];
+            line.BeforeFirst(_T(' ')).ToLong(&time);
+            fh.mtime = time;
+            fh.hash = line.AfterFirst(_T(' ')).BeforeFirst(_T(' '));
+        }
+        else if (type == _T('O'))
+        {
+            object = &m_Objects[line.AfterFirst(_T(' '))];
+            line.BeforeFirst(_T(' ')).ToLong(&time);
+            object->oldObjectTime = time;
+        }
+        else if (type == _T('C') && object)
+        {
+            if (!object->command.IsEmpty())
+                object->command << _T('\n');
+            object->command << line;
+        }
+        else if (type == _T('I') && object)
+            object->inputs[line.AfterFirst(_T(' '))] = line.BeforeFirst(_T(' '));
+    }
+    return true;
+}
+
+bool BuildDatabase::Save(const wxString& filename)
+{
+    if (!m_Modified)
+        return true;
+
+    wxString contents;
+    contents << g_Magic << _T('\n');
+    for (FileHashes::const_iterator it = m_Files.begin(); it != m_Files.end(); ++it)
+        contents << _T("F ") << (long)it->second.mtime << _T(' ') << it->second.hash << _T(' ') << it->first << _T('\n');
+    for (ObjectInfos::const_iterator it = m_Objects.begin(); it != m_Objects.end(); ++it)
+    {
+        const ObjectInfo& info = it->second;
+        contents << _T("O ") << (long)info.oldObjectTime << _T(' ') << it->first << _T('\n');
+        wxString command = info.command;
+        command.Replace(_T("\n"), _T("\nC "));
+        contents << _T("C ") << command << _T('\n');
+        for (BuildInputs::const_iterator inp = info.inputs.begin(); inp != info.inputs.end(); ++inp)
+            contents << _T("I ") << inp->second << _T(' ') << inp->first << _T('\n');
+    }
+
+    wxFFile file(filename, _T("wb"));
+    if (!file.IsOpened() || !file.Write(contents, wxConvUTF8))
+        return false;
+    m_Modified = false;
+    return true;
+}
+
+bool BuildDatabase::GetFileHash(const wxString& filename, time_t mtime, wxString& hash)
+{
+    FileHashes::iterator it = m_Files.find(filename);
+    if (it != m_Files.end() && it->second.mtime == mtime)
+    {
+        hash = it->second.hash;
+        return true;
+    }
+
+    bool ok;
+    hash = HashFile(filename, ok);
+    if (!ok)
+        return false;
+    FileHash& fh = m_Files[filename];
+    fh.mtime = mtime;
+    fh.hash = hash;
+    m_Modified = true;
+    return true;
+}
+
+bool BuildDatabase::HasObject(const wxString& object) const
+{
+    return m_Objects.find(object) != m_Objects.end();
+}
+
+wxString BuildDatabase::GetRebuildReason(const wxString& object, time_t objectTime, const wxString& command, const BuildInputs& inputs) const
+{
+    ObjectInfos::const_iterator it = m_Objects.find(object);
+    if (it == m_Objects.end())
+        return _("no build information");
+    const ObjectInfo& info = it->second;
+
+    if (info.oldObjectTime && objectTime <= info.oldObjectTime)
+        return _("the last build failed or was aborted");
+    if (info.command != command)
+        return _("the command line changed");
+
+    for (BuildInputs::const_iterator inp = inputs.begin(); inp != inputs.end(); ++inp)
+    {
+        BuildInputs::const_iterator old = info.inputs.find(inp->first);
+        if (old == info.inputs.end())
+            return _("new dependency: ") + inp->first;
+        if (old->second != inp->second)
+            return _("changed: ") + inp->first;
+    }
+    for (BuildInputs::const_iterator old = info.inputs.begin(); old != info.inputs.end(); ++old)
+    {
+        if (inputs.find(old->first) == inputs.end())
+            return _("removed dependency: ") + old->first;
+    }
+    return wxEmptyString;
+}
+
+void BuildDatabase::SetObject(const wxString& object, time_t oldObjectTime, const wxString& command, const BuildInputs& inputs)
+{
+    ObjectInfo& info = m_Objects[object];
+    info.oldObjectTime = oldObjectTime;
+    info.command = command;
+    info.inputs = inputs;
+    m_Modified = true;
+}
@@ -0,0 +1,82 @@
+#ifndef BUILDDATABASE_H
+#define BUILDDATABASE_H
+
+#include <map>
+#include <time.h>
+
+#include <wx/string.h>
+
+/** The inputs an object file is built from: file name -> content hash. */
+typedef std::map<wxString, wxString> BuildInputs;
+
+/**
+  * @brief Remembers what each object file was built from.
+  *
+  * For every object file, the database keeps the expanded command line
+  * and a content hash of the source and all headers it was compiled from.
+  * Comparing these with the current ones tells if the object really needs
+  * to be rebuilt, no matter what the files' modification times say
+  * (think "touch" or switching branches in the VCS), and notices changed
+  * build options too.
+  *
+  * The hashes of the files are cached by modification time, so each file
+  * is only read when it was modified since it was last hashed.
+  *
+  * The database is saved in a text file next to the project's depslib
+  * cache (".depend") file.
+  */
+class BuildDatabase
+{
+    public:
+        BuildDatabase();
+        ~BuildDatabase();
+
+        /** @brief Load the database from @c filename (a missing file gives an empty database). */
+        bool Load(const wxString& filename);
+        /** @brief Save the database to @c filename, if it was modified since loaded. */
+        bool Save(const wxString& filename);
+
+        /** @brief Get the content hash of a file, last modified at @c mtime.
+          * @return false if the file can't be read. */
+        bool GetFileHash(const wxString& filename, time_t mtime, wxString& hash);
+
+        /** @brief Is there any information about this object file? */
+        bool HasObject(const wxString& object) const;
+
+        /** @brief Why does this object file need to be rebuilt?
+          * @param object The object file.
+          * @param objectTime The object file's modification time.
+          * @param command The command line that would build it now.
+          * @param inputs The files it would be built from now.
+          * @return The reason, or an empty string if the object is up-to-date. */
+        wxString GetRebuildReason(const wxString& object, time_t objectTime, const wxString& command, const BuildInputs& inputs) const;
+
+        /** @brief Remember the command line and inputs of an object file.
+          * @param oldObjectTime The object file's modification time before it is
+          * rebuilt (0 if it is up-to-date or doesn't exist). If the object file
+          * isn't newer than that later on, its build failed and it's out-of-date.
+          * Only file times are compared: the local clock may not match the one of
+          * the (network) drive the object file is on. */
+        void SetObject(const wxString& object, time_t oldObjectTime, const wxString& command, const BuildInputs& inputs);
+    private:
+        struct FileHash
+        {
+            time_t mtime;
+            wxString hash;
+        };
+        typedef std::map<wxString, FileHash> FileHashes;
+
+        struct ObjectInfo
+        {
+            time_t oldObjectTime;
+            wxString command;
+            BuildInputs inputs;
+        };
+        typedef std::map<wxString, ObjectInfo> ObjectInfos;
+
+        FileHashes m_Files;
+        ObjectInfos m_Objects;
+        bool m_Modified;
+};
+
+#endif // BUILDDATABASE_H
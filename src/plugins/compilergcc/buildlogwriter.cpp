@@ -0,0 +1,177 @@
+/*
+* This file is part of Code::Blocks Studio, an open-source cross-platform IDE
+* Copyright (C) 2003  Yiannis An. Mandravellos
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*
+* $Revision$
+* $Id$
+* $HeadURL$
+*/
+#include "sdk.h"
+#ifndef CB_PRECOMP
+    #include <wx/event.h>
+    #include <wx/filefn.h>
+#endif
+#include <wx/filename.h>
+#include <vector>
+#include "buildlogwriter.h"
+
+namespace
+{
+    // stdio buffer size of the log files
+    const size_t bufferSize = 256 * 1024;
+    // the writer is woken up early when this many characters are pending
+    const size_t batchSize = 64 * 1024;
+    // ...and at least this often (in milliseconds) while the build runs
+    const unsigned long flushInterval = 1000;
+}
+
+BuildLogWriter::BuildLogWriter(wxEvtHandler* owner, int id)
+    : wxThread(wxTHREAD_JOINABLE),
+    m_pOwner(owner),
+    m_ID(id),
+    m_pBody(0),
+    m_Running(false),
+    m_Condition(m_Mutex),
+    m_Finish(false)
+{
+    //ctor
+}
+
+BuildLogWriter::~BuildLogWriter()
+{
+    //dtor
+    if (m_Running)
+    {
+        {
+            wxMutexLocker lock(m_Mutex);
+            m_Finish = true; // without a file name: just stop
+            m_Condition.Signal();
+        }
+        Wait();
+        m_Running = false;
+    }
+    if (m_pBody)
+        fclose(m_pBody);
+    if (!m_BodyFilename.IsEmpty() && wxFileExists(m_BodyFilename))
+        wxRemoveFile(m_BodyFilename);
+}
+
+bool BuildLogWriter::Start()
+{
+    if (m_Running)
+        return true;
+
+    m_BodyFilename = wxFileName::CreateTempFileName(_T("cb_build_log"));
+    if (m_BodyFilename.IsEmpty())
+        return false;
+    m_pBody = wxFopen(m_BodyFilename, _T("w+b"));
+    if (!m_pBody)
+        return false;
+    setvbuf(m_pBody, 0, _IOFBF, bufferSize);
+
+    if (Create() != wxTHREAD_NO_ERROR || Run() != wxTHREAD_NO_ERROR)
+        return false;
+    m_Running = true;
+    return true;
+}
+
+void BuildLogWriter::Add(const wxString& text)
+{
+    wxMutexLocker lock(m_Mutex);
+    if (m_Finish)
+        return;
+    m_Pending.append(text.c_str()); // copies the characters: wxString isn't thread-safe
+    if (m_Pending.length() >= batchSize)
+        m_Condition.Signal();
+}
+
+void BuildLogWriter::Finish(const wxString& filename, const wxString& header, const wxString& footer)
+{
+    wxMutexLocker lock(m_Mutex);
+    if (m_Finish)
+        return;
+    m_Filename = filename.c_str();
+    m_Header = header.c_str();
+    m_Footer = footer.c_str();
+    m_Finish = true;
+    m_Condition.Signal();
+}
+
+wxThread::ExitCode BuildLogWriter::Entry()
+{
+    while (true)
+    {
+        wxString batch;
+        bool finish;
+        {
+            wxMutexLocker lock(m_Mutex);
+            if (m_Pending.IsEmpty() && !m_Finish)
+                m_Condition.WaitTimeout(flushInterval);
+            batch.swap(m_Pending);
+            finish = m_Finish;
+        }
+
+        if (!batch.IsEmpty())
+            WriteText(m_pBody, batch);
+        if (finish)
+            break;
+    }
+
+    wxCommandEvent event(wxEVT_COMMAND_MENU_SELECTED, m_ID);
+    event.SetInt(WriteLog() ? 1 : 0);
+    event.SetClientData(this);
+    wxPostEvent(m_pOwner, event);
+    return 0;
+}
+
+bool BuildLogWriter::WriteText(FILE* fp, const wxString& text)
+{
+    // a single conversion for the whole batch
+    const wxCharBuffer buf = text.mb_str(wxConvUTF8);
+    if (!buf)
+        return false;
+    size_t len = strlen(buf);
+    return fwrite((const char*)buf, 1, len, fp) == len;
+}
+
+bool BuildLogWriter::WriteLog()
+{
+    wxString filename;
+    wxString header;
+    wxString footer;
+    {
+        wxMutexLocker lock(m_Mutex);
+        filename = m_Filename;
+        header = m_Header;
+        footer = m_Footer;
+    }
+    if (filename.IsEmpty() || fflush(m_pBody) != 0 || fseek(m_pBody, 0, SEEK_SET) != 0)
+        return false;
+
+    FILE* fp = wxFopen(filename, _T("wb"));
+    if (!fp)
+        return false;
+    setvbuf(fp, 0, _IOFBF, bufferSize);
+
+    bool ok = WriteText(fp, header);
+    std::vector<char> buf(bufferSize);
+    size_t len;
+    while (ok && (len = fread(&buf[0], 1, buf.size(), m_pBody)) > 0)
+        ok = fwrite(&buf[0], 1, len, fp) == len;
+    ok = ok && !ferror(m_pBody) && WriteText(fp, footer);
+    return fclose(fp) == 0 && ok;
+}
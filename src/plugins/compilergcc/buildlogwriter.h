@@ -0,0 +1,65 @@
+#ifndef BUILDLOGWRITER_H
+#define BUILDLOGWRITER_H
+
+#include <stdio.h>
+
+#include <wx/string.h>
+#include <wx/thread.h>
+
+class wxEvtHandler;
+
+/**
+  * @brief Writes the HTML build log in a dedicated thread.
+  *
+  * The build log's body is queued with Add() while the build runs. The
+  * writer thread picks it up in batches, converts each batch to UTF-8 once
+  * and appends it to a temporary file. Finish() hands over the header and
+  * footer (the header contains the build's end time, so it can only be
+  * known at the end): the thread then writes the log file, copying the
+  * body from the temporary file, and exits.
+  *
+  * This way the thread running the build never waits for the disk, which
+  * matters when the project lives on a slow (network) drive.
+  *
+  * When the thread is done, the owner gets a wxEVT_COMMAND_MENU_SELECTED
+  * event with the given id, the writer as client data and, as int, whether
+  * the log file was written. The writer can then be deleted without waiting.
+  */
+class BuildLogWriter : public wxThread
+{
+    public:
+        BuildLogWriter(wxEvtHandler* owner, int id);
+        virtual ~BuildLogWriter();
+
+        /** @brief Create the temporary file and run the writer thread. */
+        bool Start();
+        /** @brief Queue a part of the log's body. */
+        void Add(const wxString& text);
+        /** @brief Write the log to @c filename, between @c header and @c footer.
+          * Returns immediately, the file is written by the thread.
+          * An empty @c filename drops the log. */
+        void Finish(const wxString& filename, const wxString& header, const wxString& footer);
+        /** @brief The file name given to Finish() (only read it once the thread is done). */
+        const wxString& GetFilename() const { return m_Filename; }
+    protected:
+        virtual ExitCode Entry();
+    private:
+        bool WriteText(FILE* fp, const wxString& text);
+        bool WriteLog();
+
+        wxEvtHandler* m_pOwner;
+        int m_ID;
+        FILE* m_pBody; // the temporary file, only touched by the thread once running
+        wxString m_BodyFilename;
+        bool m_Running;
+
+        wxMutex m_Mutex; // protects the members below
+        wxCondition m_Condition;
+        wxString m_Pending;
+        bool m_Finish;
+        wxString m_Filename;
+        wxString m_Header;
+        wxString m_Footer;
+};
+
+#endif // BUILDLOGWRITER_H
@@ -3,17 +3,25 @@
 #include <cbproject.h>
 #include <projectbuildtarget.h>
 
+#include <wx/stopwatch.h>
+#include <wx/utils.h>
 #include <wx/listimpl.cpp>
 WX_DEFINE_LIST(CompilerCommands);
 
 CompilerQueue::CompilerQueue()
-    : m_LastWasRun(false)
+    : m_LastWasRun(false),
+    m_Slots(1),
+    m_BusyTime(0),
+    m_CriticalPath(0)
 {
 }
 
 CompilerQueue::~CompilerQueue()
 {
     Clear();
+    for (RunningCommands::iterator it = m_Running.begin(); it != m_Running.end(); ++it)
+        delete it->first;
+    m_Running.clear();
 }
 
 void CompilerQueue::Clear()
@@ -39,6 +47,10 @@ void CompilerQueue::Add(CompilerCommand* cmd)
     {
         if (cmd->dir.IsEmpty() && cmd->project)
             cmd->dir = cmd->project->GetBasePath();
+        // the compiler's environment is set up before its commands are queued, but the
+        // commands may run after the next project (maybe using another compiler) is set up
+        if (cmd->envPath.IsEmpty())
+            wxGetEnv(_T("PATH"), &cmd->envPath);
         m_Commands.Append(cmd);
     }
 }
@@ -64,11 +76,167 @@ CompilerCommand* CompilerQueue::Peek()
 
 CompilerCommand* CompilerQueue::Next()
 {
-    wxCompilerCommandsNode* node = m_Commands.GetFirst();
-    if (!node)
-        return 0;
-    CompilerCommand* cmd = node->GetData();
-    m_Commands.Erase(node);
-    m_LastWasRun = cmd ? cmd->isRun : false;
-    return cmd;
+    // what the commands before the one examined are doing
+    bool earlierAny = false;
+    std::set<TargetKey> earlierTargets;
+    std::set<TargetKey> earlierBarriers;
+
+    for (wxCompilerCommandsNode* node = m_Commands.GetFirst(); node; node = node->GetNext())
+    {
+        CompilerCommand* cmd = node->GetData();
+        bool canRun = true;
+
+        // queued before it
+        if (cmd->isRun && earlierAny)
+            canRun = false;
+        else
+        {
+            for (std::set<TargetKey>::iterator it = earlierBarriers.begin(); canRun && it != earlierBarriers.end(); ++it)
+                canRun = !MustWaitFor(cmd, *it, true);
+            for (std::set<TargetKey>::iterator it = earlierTargets.begin(); canRun && it != earlierTargets.end(); ++it)
+                canRun = !MustWaitFor(cmd, *it, false);
+        }
+
+        // running
+        for (RunningCommands::iterator it = m_Running.begin(); canRun && it != m_Running.end(); ++it)
+            canRun = !MustWaitFor(cmd, it->first);
+
+        if (canRun)
+        {
+            m_Commands.Erase(node);
+            m_LastWasRun = cmd->isRun;
+            return cmd;
+        }
+
+        // nothing runs past a "run" command
+        if (cmd->isRun)
+            break;
+        earlierAny = true;
+        if (IsBarrier(cmd))
+            earlierBarriers.insert(TargetKey(cmd->project, cmd->target));
+        else
+            earlierTargets.insert(TargetKey(cmd->project, cmd->target));
+    }
+    return 0;
+}
+
+void CompilerQueue::SetProjectDependencies(const ProjectDependencies& deps)
+{
+    m_ProjectDeps = deps;
+}
+
+bool CompilerQueue::HasPendingWork(cbProject* project, ProjectBuildTarget* target) const
+{
+    for (wxCompilerCommandsNode* node = m_Commands.GetFirst(); node; node = node->GetNext())
+    {
+        if (IsPendingFor(node->GetData(), project, target))
+            return true;
+    }
+    for (RunningCommands::const_iterator it = m_Running.begin(); it != m_Running.end(); ++it)
+    {
+        if (IsPendingFor(it->first, project, target))
+            return true;
+    }
+    return false;
+}
+
+bool CompilerQueue::IsPendingFor(const CompilerCommand* other, cbProject* project, ProjectBuildTarget* target) const
+{
+    if (other->project != project)
+        return DependsOn(project, other->project);
+    return !target || !other->target || other->target == target;
+}
+
+bool CompilerQueue::IsBarrier(const CompilerCommand* cmd) const
+{
+    return cmd->mustWait || cmd->isLink;
+}
+
+bool CompilerQueue::DependsOn(cbProject* project, cbProject* dependency) const
+{
+    ProjectDependencies::const_iterator it = m_ProjectDeps.find(project);
+    return it != m_ProjectDeps.end() && it->second.find(dependency) != it->second.end();
+}
+
+bool CompilerQueue::MustWaitFor(const CompilerCommand* cmd, const CompilerCommand* other) const
+{
+    if (cmd->isRun || other->isRun)
+        return true;
+    return MustWaitFor(cmd, TargetKey(other->project, other->target), IsBarrier(other));
+}
+
+bool CompilerQueue::MustWaitFor(const CompilerCommand* cmd, const TargetKey& other, bool otherIsBarrier) const
+{
+    if (cmd->project != other.first)
+        return DependsOn(cmd->project, other.first);
+    // the same target, or the project's own pre/post-build steps
+    if (cmd->target == other.second || !cmd->target || !other.second)
+        return IsBarrier(cmd) || otherIsBarrier;
+    // another target of the project: it may link (or copy) what this one links
+    return IsBarrier(cmd) && otherIsBarrier;
+}
+
+void CompilerQueue::CommandStarted(CompilerCommand* cmd)
+{
+    if (cmd)
+        m_Running[cmd] = wxGetLocalTimeMillis();
+}
+
+void CompilerQueue::CommandFinished(CompilerCommand* cmd)
+{
+    RunningCommands::iterator it = m_Running.find(cmd);
+    if (it == m_Running.end())
+        return;
+
+    long duration = (wxGetLocalTimeMillis() - it->second).ToLong();
+    m_Running.erase(it);
+
+    if (!cmd->isRun)
+    {
+        m_BusyTime += duration;
+
+        // the longest chain of commands this one had to wait for
+        // (the values used here cannot change while the command runs)
+        long before = 0;
+        for (PathLengths::iterator p = m_TargetPath.begin(); p != m_TargetPath.end(); ++p)
+        {
+            if (p->second > before && MustWaitFor(cmd, p->first, false))
+                before = p->second;
+        }
+        for (PathLengths::iterator p = m_BarrierPath.begin(); p != m_BarrierPath.end(); ++p)
+        {
+            if (p->second > before && MustWaitFor(cmd, p->first, true))
+                before = p->second;
+        }
+
+        TargetKey key(cmd->project, cmd->target);
+        long path = before + duration;
+        if (IsBarrier(cmd))
+            m_BarrierPath[key] = path;
+        if (path > m_TargetPath[key])
+            m_TargetPath[key] = path;
+        if (path > m_CriticalPath)
+            m_CriticalPath = path;
+    }
+
+    delete cmd;
+}
+
+void CompilerQueue::ResetStatistics(size_t slots)
+{
+    m_Slots = slots ? slots : 1;
+    m_StatsStart = wxGetLocalTimeMillis();
+    m_BusyTime = 0;
+    m_CriticalPath = 0;
+    m_TargetPath.clear();
+    m_BarrierPath.clear();
+}
+
+void CompilerQueue::GetStatistics(long& criticalPath, float& utilization) const
+{
+    criticalPath = m_CriticalPath;
+    wxLongLong available = (wxGetLocalTimeMillis() - m_StatsStart) * (long)m_Slots;
+    utilization = available > 0 ? (float)m_BusyTime.ToDouble() / (float)available.ToDouble() : 0.0f;
+    if (utilization > 1.0f)
+        utilization = 1.0f;
 }
@@ -1,8 +1,13 @@
 #ifndef COMPILER_DEFS_H
 #define COMPILER_DEFS_H
 
+#include <map>
+#include <set>
+#include <utility>
+
 #include <wx/string.h>
 #include <wx/list.h>    // WX_DECLARE_LIST
+#include <wx/longlong.h>
 
 class cbProject;
 class ProjectBuildTarget;
@@ -13,11 +18,12 @@ struct CompilerCommand
         : command(cmd), message(msg), project(prj), target(tgt), isRun(is_run), mustWait(false), isLink(false)
     {}
     CompilerCommand(const CompilerCommand& rhs)
-        : command(rhs.command), message(rhs.message), project(rhs.project), target(rhs.target), isRun(rhs.isRun), mustWait(rhs.mustWait), isLink(rhs.isLink)
+        : command(rhs.command), message(rhs.message), envPath(rhs.envPath), project(rhs.project), target(rhs.target), isRun(rhs.isRun), mustWait(rhs.mustWait), isLink(rhs.isLink)
     {}
     wxString command;
     wxString message;
     wxString dir;
+    wxString envPath; ///< the PATH to run it with (the one of its compiler, set when it was queued).
     cbProject* project;
     ProjectBuildTarget* target;
     bool isRun; ///< if it's a command to run the target.
@@ -26,33 +32,88 @@ struct CompilerCommand
 };
 WX_DECLARE_LIST(CompilerCommand, CompilerCommands);
 
+/** The build commands queue.
+  *
+  * Commands are not run in strict order: Next() returns the first queued command
+  * whose dependencies are satisfied, so that all process slots can be kept busy.
+  * A command depends on the queued (before it) and running commands that:
+  * - belong to a project its own project depends on,
+  * - belong to the same target, if either of them is a "wait" or link command,
+  * - are the project's own pre/post-build steps (which have no target), or are
+  *   of the same project if it is one of these steps itself,
+  * - belong to another target of the same project, if both of them are "wait"
+  *   or link commands (so that the targets still link in order),
+  * - are "run" commands, or any command if it is a "run" command itself.
+  */
 class CompilerQueue
 {
     public:
+        /// Project -> all projects it depends on (directly or not)
+        typedef std::map<cbProject*, std::set<cbProject*> > ProjectDependencies;
+        /// The target commands belong to (no target for the project's pre/post-build steps)
+        typedef std::pair<cbProject*, ProjectBuildTarget*> TargetKey;
+
         CompilerQueue();
         ~CompilerQueue();
 
-        /// Clear the queue.
+        /// Clear the queue (running commands are still tracked, until CommandFinished()).
         void Clear();
-        /// Get the commands count.
+        /// Get the (queued) commands count.
         size_t GetCount() const;
         bool LastCommandWasRun() const;
         /// Queue a command.
         void Add(CompilerCommand* cmd);
         /// Queue all commands from another CompilerQueue.
         void Add(CompilerQueue* queue);
-        /** Get the next command in queue.
-          * If @c from is NULL, returns the top command.
-          * If @c from is not NULL, the command following @c from is
-          * returned.
-          * if @c remove is true (default), the command is removed from the list.
-          * This means that the caller must delete it.
+        /** Get the next command that can run now and remove it from the queue.
+          * Returns NULL if the queue is empty or all queued commands wait for others to finish.
+          * If the command is started, pass it to CommandStarted(), else the caller must delete it.
           */
         CompilerCommand* Next();
         CompilerCommand* Peek();
+
+        /// Set the project dependencies used to order commands of different projects.
+        void SetProjectDependencies(const ProjectDependencies& deps);
+        /** Are there queued or running commands of @c target, of the pre/post-build steps
+          * of @c project or of a project it depends on?
+          * If @c target is NULL, the commands of all the project's targets are included.
+          */
+        bool HasPendingWork(cbProject* project, ProjectBuildTarget* target) const;
+
+        /// A command returned by Next() has been started; the queue takes ownership of it.
+        void CommandStarted(CompilerCommand* cmd);
+        /// A started command has finished: update the statistics and delete it.
+        void CommandFinished(CompilerCommand* cmd);
+
+        /// Reset the build statistics (at the start of a build), for @c slots parallel processes.
+        void ResetStatistics(size_t slots);
+        /** Get the build statistics since ResetStatistics().
+          * @param criticalPath The longest chain of dependent commands (in milliseconds).
+          * @param utilization The fraction of the available process slot time spent running commands.
+          */
+        void GetStatistics(long& criticalPath, float& utilization) const;
     protected:
+        bool IsBarrier(const CompilerCommand* cmd) const;
+        bool DependsOn(cbProject* project, cbProject* dependency) const;
+        bool IsPendingFor(const CompilerCommand* other, cbProject* project, ProjectBuildTarget* target) const;
+        bool MustWaitFor(const CompilerCommand* cmd, const CompilerCommand* other) const;
+        bool MustWaitFor(const CompilerCommand* cmd, const TargetKey& other, bool otherIsBarrier) const;
+
         CompilerCommands m_Commands;
         bool m_LastWasRun;
+        ProjectDependencies m_ProjectDeps;
+
+        typedef std::map<CompilerCommand*, wxLongLong> RunningCommands; // command -> start time
+        RunningCommands m_Running;
+
+        // statistics
+        size_t m_Slots;
+        wxLongLong m_StatsStart;
+        wxLongLong m_BusyTime; // sum of all commands durations
+        long m_CriticalPath;
+        typedef std::map<TargetKey, long> PathLengths;
+        PathLengths m_TargetPath; // longest path ending in each target
+        PathLengths m_BarrierPath; // longest path ending at each target's last barrier
 };
 
 #endif // COMPILER_DEFS_H
@@ -60,6 +60,8 @@
 #include "makefilegenerator.h"
 #include "compileroptionsdlg.h"
 #include "directcommands.h"
+#include "compileroutputreader.h"
+#include "buildlogwriter.h"
 #include "globals.h"
 #include "cbworkspace.h"
 
@@ -120,18 +122,18 @@ namespace ScriptBindings
 
 const int idBuildLog = wxNewId();
 
-class BuildLogger : public TextCtrlLogger
+class BuildLogger : public BufferedTextCtrlLogger
 {
     wxPanel* panel;
     wxBoxSizer* sizer;
 public:
     wxGauge* progress;
 
-    BuildLogger() : TextCtrlLogger(true), panel(0), sizer(0), progress(0) {}
+    BuildLogger() : BufferedTextCtrlLogger(true), panel(0), sizer(0), progress(0) {}
 
     void UpdateSettings()
     {
-        TextCtrlLogger::UpdateSettings();
+        BufferedTextCtrlLogger::UpdateSettings();
 
         style[caption].SetAlignment(wxTEXT_ALIGNMENT_DEFAULT);
         style[caption].SetFont(style[error].GetFont());
@@ -143,7 +145,7 @@ public:
     {
         panel = new wxPanel(parent);
 
-        TextCtrlLogger::CreateControl(panel);
+        BufferedTextCtrlLogger::CreateControl(panel);
         control->SetId(idBuildLog);
 
         sizer = new wxBoxSizer(wxVERTICAL);
@@ -253,6 +255,8 @@ int idGCCProcess13 = wxNewId();
 int idGCCProcess14 = wxNewId();
 int idGCCProcess15 = wxNewId();
 int idGCCProcess16 = wxNewId();
+int idGCCOutputReader = wxNewId();
+int idGCCBuildLogWriter = wxNewId();
 
 BEGIN_EVENT_TABLE(CompilerGCC, cbCompilerPlugin)
     EVT_UPDATE_UI(idMenuCompile, CompilerGCC::OnUpdateUI)
@@ -317,6 +321,8 @@ BEGIN_EVENT_TABLE(CompilerGCC, cbCompilerPlugin)
     EVT_PIPEDPROCESS_STDOUT_RANGE(idGCCProcess1, idGCCProcess16, CompilerGCC::OnGCCOutput)
     EVT_PIPEDPROCESS_STDERR_RANGE(idGCCProcess1, idGCCProcess16, CompilerGCC::OnGCCError)
     EVT_PIPEDPROCESS_TERMINATED_RANGE(idGCCProcess1, idGCCProcess16, CompilerGCC::OnGCCTerminated)
+    EVT_PIPEDPROCESS_STDOUT(idGCCOutputReader,      CompilerGCC::OnGCCOutputLines)
+    EVT_MENU(idGCCBuildLogWriter,                   CompilerGCC::OnBuildLogWritten)
 END_EVENT_TABLE()
 
 CompilerGCC::CompilerGCC()
@@ -334,6 +340,10 @@ CompilerGCC::CompilerGCC()
     m_pTbar(0L),
     m_Pid(0),
     m_ProcessOutputFiles(0),
+    m_ProcessCommands(0),
+    m_pOutputReader(0),
+    m_ProcessGeneration(0),
+    m_pBuildLogWriter(0),
     m_Log(0L),
     m_pListLog(0L),
     m_ToolTarget(0L),
@@ -378,6 +388,7 @@ void CompilerGCC::OnAttach()
     m_pTbar = 0L;
     m_Pid = 0;
     m_ProcessOutputFiles = 0;
+    m_ProcessCommands = 0;
     m_Log = 0L;
     m_pListLog = 0L;
     m_ToolTarget = 0L;
@@ -396,6 +407,19 @@ void CompilerGCC::OnAttach()
 
     m_timerIdleWakeUp.SetOwner(this, idTimerPollCompiler);
 
+    // build processes' output is read in a separate thread, where supported (else it's polled)
+    m_pOutputReader = 0;
+    if (CompilerOutputReader::IsSupported())
+    {
+        m_pOutputReader = new CompilerOutputReader(this, idGCCOutputReader);
+        if (!m_pOutputReader->Start())
+        {
+            Manager::Get()->GetLogManager()->DebugLog(_T("Could not start the compiler output reader; polling build processes instead."));
+            delete m_pOutputReader;
+            m_pOutputReader = 0;
+        }
+    }
+
     for (int i = 0; i < MAX_TARGETS; ++i)
         idMenuSelectTargetOther[i] = wxNewId();
     // register built-in compilers
@@ -534,6 +558,16 @@ void CompilerGCC::OnRelease(bool appShutDown)
 
     m_timerIdleWakeUp.Stop();
 
+    delete m_pOutputReader;
+    m_pOutputReader = 0;
+
+    // these wait until the last logs are written
+    delete m_pBuildLogWriter;
+    m_pBuildLogWriter = 0;
+    for (std::set<BuildLogWriter*>::iterator it = m_FinishingBuildLogs.begin(); it != m_FinishingBuildLogs.end(); ++it)
+        delete *it;
+    m_FinishingBuildLogs.clear();
+
     FreeProcesses();
 
     DoDeleteTempMakefile();
@@ -1026,10 +1060,14 @@ void CompilerGCC::AddToCommandQueue(const wxArrayString& commands)
 //    wxString myWaitEnd = wxString(COMPILER_WAIT_END);
 //    ProjectBuildTarget* lastTarget = 0;
     ProjectBuildTarget* bt = m_pBuildingProject ? m_pBuildingProject->GetBuildTarget(GetTargetIndexFromName(m_pBuildingProject, m_BuildingTargetName)) : 0;
+    // the project's own pre/post-build steps don't belong to any of its targets
+    if (m_BuildState == bsProjectPreBuild || m_BuildState == bsProjectPostBuild)
+        bt = 0;
     m_CurrentProgress = 0;
     m_MaxProgress = 0;
     bool isLink = false;
     bool mustWait = false;
+    std::vector<CompilerCommand*> logCommands; // log-only commands since the last compiler command
     size_t count = commands.GetCount();
     for (size_t i = 0; i < count; ++i)
     {
@@ -1039,7 +1077,9 @@ void CompilerGCC::AddToCommandQueue(const wxArrayString& commands)
         if (cmd.StartsWith(mySimpleLog))
         {
             cmd.Remove(0, mySimpleLog.Length());
-            m_CommandQueue.Add(new CompilerCommand(wxEmptyString, cmd, m_pBuildingProject, bt));
+            CompilerCommand* p = new CompilerCommand(wxEmptyString, cmd, m_pBuildingProject, bt);
+            m_CommandQueue.Add(p);
+            logCommands.push_back(p);
         }
         // compiler change
         else if (cmd.StartsWith(myTargetChange))
@@ -1060,6 +1100,13 @@ void CompilerGCC::AddToCommandQueue(const wxArrayString& commands)
             p->mustWait = mustWait;
             p->isLink = isLink;
             m_CommandQueue.Add(p);
+            // the messages describing this command must be scheduled like it
+            for (size_t n = 0; n < logCommands.size(); ++n)
+            {
+                logCommands[n]->mustWait = mustWait;
+                logCommands[n]->isLink = isLink;
+            }
+            logCommands.clear();
             isLink = false;
             mustWait = false;
             ++m_MaxProgress;
@@ -1080,11 +1127,17 @@ void CompilerGCC::AllocProcesses()
     m_Processes = new wxProcess*[m_ParallelProcessCount];
     m_Pid = new long int[m_ParallelProcessCount];
     m_ProcessOutputFiles = new wxString[m_ParallelProcessCount];
+    m_ProcessCommands = new CompilerCommand*[m_ParallelProcessCount];
     for (size_t i = 0; i < m_ParallelProcessCount; ++i)
     {
         m_Processes[i] = 0;
         m_Pid[i] = 0;
+        m_ProcessCommands[i] = 0;
     }
+    // the reader may still deliver output of the previous slots: OnGCCOutputLines() drops it
+    ++m_ProcessGeneration;
+    m_ReaderProcesses.clear();
+    m_PendingJobEnds.clear();
 }
 
 void CompilerGCC::FreeProcesses()
@@ -1097,6 +1150,7 @@ void CompilerGCC::FreeProcesses()
     DeleteArray(m_Processes);
     DeleteArray(m_Pid);
     DeleteArray(m_ProcessOutputFiles);
+    DeleteArray(m_ProcessCommands);
 }
 
 bool CompilerGCC::ReAllocProcesses()
@@ -1111,13 +1165,15 @@ bool CompilerGCC::IsProcessRunning(int idx) const
     // invalid process index
     if (!m_Processes || idx >= (int)m_ParallelProcessCount)
         return false;
+    // a slot is busy until OnJobEnd() is called for it, even if its
+    // process has already terminated (m_Pid is only reset there)
     // specific process
     if (idx >= 0)
-        return m_Processes[idx] != 0;
+        return m_Processes[idx] != 0 || m_Pid[idx] != 0;
     // any process (-1)
     for (size_t i = 0; i < m_ParallelProcessCount; ++i)
     {
-        if (m_Processes[i] != 0)
+        if (m_Processes[i] != 0 || m_Pid[i] != 0)
             return true;
     }
     return false;
@@ -1138,7 +1194,7 @@ int CompilerGCC::GetActiveProcessCount() const
     size_t count = 0;
     for (size_t i = 0; i < m_ParallelProcessCount; ++i)
     {
-        if (m_Processes[i] != 0)
+        if (m_Processes[i] != 0 || m_Pid[i] != 0)
             ++count;
     }
     return count;
@@ -1157,32 +1213,30 @@ int CompilerGCC::DoRunQueue()
         return -2;
     }
 
-    // if next command is linking and compilation is still in progress, abort
-    if (IsProcessRunning())
-    {
-        CompilerCommand* cmd = m_CommandQueue.Peek();
-        if (cmd && (cmd->mustWait || cmd->isLink))
-        {
-//            msgMan->Log(m_PageIndex, _("Waiting for compile to finish before linking..."));
-            return -3;
-        }
-    }
-
+    // get the next command that doesn't have to wait for others
+    // (e.g. linking waits for the target's compilation to finish)
     CompilerCommand* cmd = m_CommandQueue.Next();
     if (!cmd)
     {
-        if (IsProcessRunning())
+        if (m_CommandQueue.GetCount())
         {
-            return 0;
+//            msgMan->Log(m_PageIndex, _("Waiting for running commands to finish..."));
+            return -3;
         }
 
         while (1)
         {
             // keep switching build states until we have commands to run or reach end of states
+            // (this may go on to the next project while the current one is still linking)
+            if (!CanAdvanceBuildState())
+                return 0;
             BuildStateManagement();
             cmd = m_CommandQueue.Next();
             if (!cmd && m_BuildState == bsNone && m_NextBuildState == bsNone)
             {
+                // let the last commands finish first
+                if (IsProcessRunning() || m_CommandQueue.GetCount())
+                    return 0;
                 NotifyJobDone(true);
                 ResetBuildState();
                 if (m_RunAfterCompile)
@@ -1196,6 +1250,8 @@ int CompilerGCC::DoRunQueue()
 
             if (cmd)
                 break;
+            if (m_CommandQueue.GetCount())
+                return -3; // queued commands wait for running ones
         }
     }
 
@@ -1248,6 +1304,12 @@ int CompilerGCC::DoRunQueue()
         return DoRunQueue(); // move on
     }
 
+    // run with the PATH of the command's compiler, which may not be the current one anymore
+    wxString oldPath;
+    wxGetEnv(_T("PATH"), &oldPath);
+    if (!cmd->envPath.IsEmpty())
+        wxSetEnv(_T("PATH"), cmd->envPath);
+
     wxString oldLibPath; // keep old PATH/LD_LIBRARY_PATH contents
     wxGetEnv(LIBRARY_ENVVAR, &oldLibPath);
 
@@ -1300,14 +1362,28 @@ int CompilerGCC::DoRunQueue()
         m_Processes[procIndex] = 0;
         m_CommandQueue.Clear();
         ResetBuildState();
+        delete cmd;
+        cmd = 0;
+    }
+    else if (pipe && m_pOutputReader && m_pOutputReader->AddProcess(procIndex, m_ProcessGeneration, m_Processes[procIndex]))
+    {
+        // the reader thread takes care of the output, no need to poll
+        ((PipedProcess*)m_Processes[procIndex])->SetPollInput(false);
+        m_ReaderProcesses.insert(procIndex);
     }
     else
         m_timerIdleWakeUp.Start(100);
 
     // restore dynamic linker path
     wxSetEnv(LIBRARY_ENVVAR, oldLibPath);
+    wxSetEnv(_T("PATH"), oldPath);
 
-    delete cmd;
+    if (cmd)
+    {
+        // the queue needs to know what's running, to schedule the rest
+        m_ProcessCommands[procIndex] = cmd;
+        m_CommandQueue.CommandStarted(cmd);
+    }
     return DoRunQueue();
 }
 
@@ -1480,6 +1556,7 @@ void CompilerGCC::DoPrepareQueue()
         DoClearErrors();
         // wxStartTimer();
         m_StartTimer = wxGetLocalTimeMillis();
+        m_CommandQueue.ResetStatistics(m_ParallelProcessCount);
     }
     Manager::Yield();
 }
@@ -2156,7 +2233,7 @@ BuildState CompilerGCC::GetNextStateBasedOnJob()
 void CompilerGCC::BuildStateManagement()
 {
 //    Manager::Get()->GetMessageManager()->Log(m_PageIndex, _T("BuildStateManagement")));
-    if (IsProcessRunning())
+    if (!CanAdvanceBuildState())
     {
         return;
     }
@@ -2285,6 +2362,31 @@ void CompilerGCC::BuildStateManagement()
     Manager::Yield();
 }
 
+bool CompilerGCC::CanAdvanceBuildState()
+{
+    if (!IsProcessRunning() && m_CommandQueue.GetCount() == 0)
+        return true;
+
+    // nothing left to advance to: just wait for the running commands
+    if (m_BuildState == bsNone && m_NextBuildState == bsNone)
+        return false;
+
+    // pre/post-build steps are simply queued; the queue orders them after
+    // whatever they depend on. But the target build step decides which files
+    // are out-of-date, so everything the target depends on must be finished
+    // by then: the projects it depends on, the project's pre-build steps and
+    // its own pre-build steps. The project's previous targets too, if the
+    // target has external dependencies (they may be outputs of those).
+    if (m_NextBuildState == bsTargetBuild && m_pBuildingProject)
+    {
+        ProjectBuildTarget* bt = m_pBuildingProject->GetBuildTarget(GetTargetIndexFromName(m_pBuildingProject, m_BuildingTargetName));
+        if (bt && !bt->GetExternalDeps().IsEmpty())
+            bt = 0;
+        return !m_CommandQueue.HasPendingWork(m_pBuildingProject, bt);
+    }
+    return true;
+}
+
 int CompilerGCC::GetTargetIndexFromName(cbProject* prj, const wxString& name)
 {
     if (!prj || name.IsEmpty())
@@ -2331,6 +2433,16 @@ void CompilerGCC::PreprocessJob(cbProject* project, const wxString& targetName)
     else
         CalculateProjectDependencies(project, deps);
 
+    // let the queue know which projects' commands must wait for which
+    CompilerQueue::ProjectDependencies queueDeps;
+    ProjectsArray* projects = Manager::Get()->GetProjectManager()->GetProjects();
+    for (size_t i = 0; i < deps.GetCount(); ++i)
+    {
+        cbProject* prj = projects->Item(deps[i]);
+        CollectProjectDependencies(prj, queueDeps[prj]);
+    }
+    m_CommandQueue.SetProjectDependencies(queueDeps);
+
     // loop all projects in the dependencies list
 //    Manager::Get()->GetMessageManager()->Log(m_PageIndex, _T("** Creating deps")));
     for (size_t i = 0; i < deps.GetCount(); ++i)
@@ -2507,6 +2619,20 @@ void CompilerGCC::CalculateProjectDependencies(cbProject* prj, wxArrayInt& deps)
     }
 }
 
+void CompilerGCC::CollectProjectDependencies(cbProject* prj, std::set<cbProject*>& deps)
+{
+    const ProjectsArray* arr = Manager::Get()->GetProjectManager()->GetDependenciesForProject(prj);
+    if (!arr)
+        return;
+    for (size_t i = 0; i < arr->GetCount(); ++i)
+    {
+        cbProject* thisprj = arr->Item(i);
+        // the set also protects against circular dependencies
+        if (thisprj != prj && deps.insert(thisprj).second)
+            CollectProjectDependencies(thisprj, deps);
+    }
+}
+
 int CompilerGCC::Build(const wxString& target)
 {
     wxString realTarget = target;
@@ -3241,7 +3367,8 @@ void CompilerGCC::OnGCCOutput(CodeBlocksEvent& event)
                                 // turn it off), I put this condition here to avoid
                                 // displaying it...
     {
-        AddOutputLine(msg);
+        size_t procIndex = event.GetId() - idGCCProcess1;
+        AddOutputLine(msg, false, procIndex < m_ParallelProcessCount ? m_ProcessCommands[procIndex] : 0);
     }
 }
 
@@ -3249,12 +3376,58 @@ void CompilerGCC::OnGCCError(CodeBlocksEvent& event)
 {
     wxString msg = event.GetString();
     if (!msg.IsEmpty())
-        AddOutputLine(msg);
+    {
+        size_t procIndex = event.GetId() - idGCCProcess1;
+        AddOutputLine(msg, false, procIndex < m_ParallelProcessCount ? m_ProcessCommands[procIndex] : 0);
+    }
+}
+
+void CompilerGCC::OnGCCOutputLines(CodeBlocksEvent& event)
+{
+    if (!m_pOutputReader)
+        return;
+
+    CompilerOutputLines lines;
+    m_pOutputReader->GetLines(lines);
+    for (size_t i = 0; i < lines.size(); ++i)
+    {
+        const CompilerOutputLine& line = lines[i];
+        if (line.generation != m_ProcessGeneration)
+            continue; // from a process slot which has been reallocated since
+        if (line.eof)
+        {
+            // all output of this process has been read (or drained, once it terminated):
+            // if it already terminated, we 're done with it
+            m_ReaderProcesses.erase(line.procIndex);
+            std::map<size_t, int>::iterator it = m_PendingJobEnds.find(line.procIndex);
+            if (it != m_PendingJobEnds.end())
+            {
+                int exitCode = it->second;
+                m_PendingJobEnds.erase(it);
+                OnJobEnd(line.procIndex, exitCode);
+            }
+            continue;
+        }
+
+        CodeBlocksEvent lineEvent(line.isError ? cbEVT_PIPEDPROCESS_STDERR : cbEVT_PIPEDPROCESS_STDOUT,
+                                  idGCCProcess1 + line.procIndex);
+        lineEvent.SetString(line.text);
+        if (line.isError)
+            OnGCCError(lineEvent);
+        else
+            OnGCCOutput(lineEvent);
+    }
 }
 
-void CompilerGCC::AddOutputLine(const wxString& output, bool forceErrorColour)
+void CompilerGCC::AddOutputLine(const wxString& output, bool forceErrorColour, const CompilerCommand* cmd)
 {
-    Compiler* compiler = CompilerFactory::GetCompiler(m_CompilerId);
+    // commands of different targets/projects may run at the same time:
+    // use the ones the output came from, if known
+    ProjectBuildTarget* bt = cmd && cmd->target ? cmd->target : m_pLastBuildingTarget;
+    cbProject* prj = cmd && cmd->project ? cmd->project : m_pBuildingProject;
+    Compiler* compiler = cmd && cmd->target ? CompilerFactory::GetCompiler(cmd->target->GetCompilerID()) : 0;
+    if (!compiler)
+        compiler = CompilerFactory::GetCompiler(m_CompilerId);
     CompilerLineType clt = compiler->CheckForWarningsAndErrors(output);
 
     // if max_errors reached, display a one-time message and do not log anymore
@@ -3280,9 +3453,9 @@ void CompilerGCC::AddOutputLine(const wxString& output, bool forceErrorColour)
     {
         // display current project/target "header" in build messages, if different since last warning/error
         static ProjectBuildTarget* last_bt = 0;
-        if (last_bt != m_pLastBuildingTarget)
+        if (last_bt != bt)
         {
-            last_bt = m_pLastBuildingTarget;
+            last_bt = bt;
             if (last_bt)
             {
                 wxString msg;
@@ -3293,7 +3466,7 @@ void CompilerGCC::AddOutputLine(const wxString& output, bool forceErrorColour)
             }
         }
         // actually log message
-        LogWarningOrError(clt, m_pBuildingProject, compiler->GetLastErrorFilename(), compiler->GetLastErrorLine(), compiler->GetLastError());
+        LogWarningOrError(clt, prj, compiler->GetLastErrorFilename(), compiler->GetLastErrorLine(), compiler->GetLastError());
     }
 
     // add to log
@@ -3324,39 +3497,41 @@ void CompilerGCC::LogWarningOrError(CompilerLineType lt, cbProject* prj, const w
 void CompilerGCC::LogMessage(const wxString& message, CompilerLineType lt, LogTarget log, bool forceErrorColour, bool isTitle, bool updateProgress)
 {
     // log file
-    if (log & ltFile)
+    if ((log & ltFile) && m_pBuildLogWriter)
     {
+        wxString line;
         if (forceErrorColour)
         {
-            m_BuildLogContents << _T("<font color=\"#a00000\">");
+            line << _T("<font color=\"#a00000\">");
         }
         else if (lt == cltError)
         {
-            m_BuildLogContents << _T("<font color=\"#ff0000\">");
+            line << _T("<font color=\"#ff0000\">");
         }
         else if (lt == cltWarning)
         {
-            m_BuildLogContents << _T("<font color=\"#0000ff\">");
+            line << _T("<font color=\"#0000ff\">");
         }
 
         if (isTitle)
         {
-            m_BuildLogContents << _T("<b>");
+            line << _T("<b>");
         }
 
-        m_BuildLogContents << message;
+        line << message;
 
         if (isTitle)
         {
-            m_BuildLogContents << _T("</b>");
+            line << _T("</b>");
         }
 
         if (lt == cltWarning || lt == cltError || forceErrorColour)
         {
-            m_BuildLogContents << _T("</font>");
+            line << _T("</font>");
         }
 
-        m_BuildLogContents << _T("<br />\n");
+        line << _T("<br />\n");
+        m_pBuildLogWriter->Add(line);
     }
 
     // log window
@@ -3418,60 +3593,105 @@ void CompilerGCC::InitBuildLog(bool workspaceBuild)
     m_BuildLogTitle = title + _(" build log");
     m_BuildLogFilename = basepath;
     m_BuildLogFilename << basename << _T("_build_log.html");
-    m_BuildLogContents.Clear();
+
+    // a previous build which didn't finish drops its log (without waiting for the thread)
+    if (m_pBuildLogWriter)
+    {
+        m_pBuildLogWriter->Finish(wxEmptyString, wxEmptyString, wxEmptyString);
+        m_FinishingBuildLogs.insert(m_pBuildLogWriter);
+        m_pBuildLogWriter = 0;
+    }
+    if (Manager::Get()->GetConfigManager(_T("compiler"))->ReadBool(_T("/save_html_build_log"), false))
+    {
+        m_pBuildLogWriter = new BuildLogWriter(this, idGCCBuildLogWriter);
+        if (!m_pBuildLogWriter->Start())
+        {
+            Manager::Get()->GetLogManager()->DebugLog(_T("Could not start the build log writer; the HTML build log won't be saved."));
+            delete m_pBuildLogWriter;
+            m_pBuildLogWriter = 0;
+        }
+    }
     m_MaxProgress = 0;
     m_CurrentProgress = 0;
 }
 
 void CompilerGCC::SaveBuildLog()
 {
-    // if not enabled in the configuration, leave
-    if (!Manager::Get()->GetConfigManager(_T("compiler"))->ReadBool(_T("/save_html_build_log"), false))
+    // if not enabled in the configuration (when the build started), leave
+    if (!m_pBuildLogWriter)
         return;
 
     // NOTE: if we want to add a CSS later on, we 'd have to edit:
     //       - this function and
     //       - LogMessage()
 
-    wxFile f(m_BuildLogFilename, wxFile::write);
-
     // first output the standard header blurb
-    f.Write(_T("<html>\n"));
-    f.Write(_T("<head>\n"));
-    f.Write(_T("<title>") + m_BuildLogTitle + _T("</title>\n"));
-    f.Write(_T("</head>\n"));
-    f.Write(_T("<body>\n"));
+    wxString header;
+    header << _T("<html>\n");
+    header << _T("<head>\n");
+    header << _T("<title>") << m_BuildLogTitle << _T("</title>\n");
+    header << _T("</head>\n");
+    header << _T("<body>\n");
 
     // use fixed-width font
-    f.Write(_T("<tt>\n"));
+    header << _T("<tt>\n");
 
     // write the start-end time of the build
-    f.Write(_("Build started on: "));
-    f.Write(_T("<u>"));
-    f.Write(m_BuildStartTime.Format(_T("%d-%m-%Y at %H:%M.%S")));
-    f.Write(_T("</u><br />\n"));
-    f.Write(_("Build ended on: "));
-    f.Write(_T("<u>"));
-    f.Write(wxDateTime::Now().Format(_T("%d-%m-%Y at %H:%M.%S")));
-    f.Write(_T("</u><p />\n"));
-
-    // output the main body
-    f.Write(m_BuildLogContents);
+    header << _("Build started on: ");
+    header << _T("<u>");
+    header << m_BuildStartTime.Format(_T("%d-%m-%Y at %H:%M.%S"));
+    header << _T("</u><br />\n");
+    header << _("Build ended on: ");
+    header << _T("<u>");
+    header << wxDateTime::Now().Format(_T("%d-%m-%Y at %H:%M.%S"));
+    header << _T("</u><p />\n");
+
+    // the main body has been written already
 
     // done with fixed-width font
-    f.Write(_T("</tt>\n"));
+    wxString footer;
+    footer << _T("</tt>\n");
 
     // finally output the footer
-    f.Write(_T("</body>\n"));
-    f.Write(_T("</html>\n"));
+    footer << _T("</body>\n");
+    footer << _T("</html>\n");
 
-    Manager::Get()->GetLogManager()->Log(_("Build log saved as: "), m_PageIndex);
-    Manager::Get()->GetLogManager()->Log(F(_T("file://%s"), m_BuildLogFilename.wx_str()), m_PageIndex, Logger::warning);
+    // the file is written in the background, OnBuildLogWritten() tells when it's done
+    m_pBuildLogWriter->Finish(m_BuildLogFilename, header, footer);
+    m_FinishingBuildLogs.insert(m_pBuildLogWriter);
+    m_pBuildLogWriter = 0;
+}
+
+void CompilerGCC::OnBuildLogWritten(wxCommandEvent& event)
+{
+    BuildLogWriter* writer = static_cast<BuildLogWriter*>(event.GetClientData());
+    if (m_FinishingBuildLogs.erase(writer) == 0)
+        return; // not finished through SaveBuildLog()/InitBuildLog()
+
+    if (event.GetInt())
+    {
+        Manager::Get()->GetLogManager()->Log(_("Build log saved as: "), m_PageIndex);
+        Manager::Get()->GetLogManager()->Log(F(_T("file://%s"), writer->GetFilename().wx_str()), m_PageIndex, Logger::warning);
+    }
+    else if (!writer->GetFilename().IsEmpty())
+        Manager::Get()->GetLogManager()->LogWarning(F(_("Could not save the build log as %s"), writer->GetFilename().wx_str()), m_PageIndex);
+    // the thread has returned (or is about to), this doesn't block
+    delete writer;
 }
 
 void CompilerGCC::OnGCCTerminated(CodeBlocksEvent& event)
 {
-    OnJobEnd(event.GetId() - idGCCProcess1, event.GetInt());
+    size_t procIndex = event.GetId() - idGCCProcess1;
+    if (m_ReaderProcesses.find(procIndex) != m_ReaderProcesses.end())
+    {
+        // the reader thread hasn't seen the end of its output yet: have it read
+        // what's left now, rather than wait for end-of-file (a process it started
+        // may keep the pipes open). OnGCCOutputLines() ends the job after that.
+        m_PendingJobEnds[procIndex] = event.GetInt();
+        m_pOutputReader->Drain(procIndex, m_ProcessGeneration);
+        return;
+    }
+    OnJobEnd(procIndex, event.GetInt());
 }
 
 void CompilerGCC::OnJobEnd(size_t procIndex, int exitCode)
@@ -3481,6 +3701,11 @@ void CompilerGCC::OnJobEnd(size_t procIndex, int exitCode)
     m_Pid[procIndex] = 0;
     m_Processes[procIndex] = 0;
     m_LastExitCode = exitCode;
+    if (m_ProcessCommands[procIndex])
+    {
+        m_CommandQueue.CommandFinished(m_ProcessCommands[procIndex]);
+        m_ProcessCommands[procIndex] = 0;
+    }
 
     if (exitCode == 0 && !m_ProcessOutputFiles[procIndex].IsEmpty())
     {
@@ -3560,6 +3785,12 @@ void CompilerGCC::OnJobEnd(size_t procIndex, int exitCode)
         {
             wxString msg = wxString::Format(_("%d errors, %d warnings"), m_Errors.GetCount(cltError), m_Errors.GetCount(cltWarning));
             LogMessage(msg, exitCode == 0 ? cltWarning : cltError, ltAll, exitCode != 0);
+
+            long criticalPath;
+            float utilization;
+            m_CommandQueue.GetStatistics(criticalPath, utilization);
+            LogMessage(wxString::Format(_("Critical path %.1f seconds, %d%% utilization of %d process slot(s)"),
+                                        (float)criticalPath / 1000.0f, (int)(utilization * 100.0f + 0.5f), (int)m_ParallelProcessCount));
             LogWarningOrError(cltNormal, 0, wxEmptyString, wxEmptyString, wxString::Format(_("=== Build finished: %s ==="), msg.c_str()));
             SaveBuildLog();
         }
@@ -2,6 +2,8 @@
 #define COMPILERGCC_H
 
 #include <queue>
+#include <map>
+#include <set>
 
 #include <settings.h> // SDK
 #include <sdk_events.h>
@@ -67,6 +69,8 @@ class wxComboBox;
 class wxStaticText;
 class wxGauge;
 class BuildLogger;
+class CompilerOutputReader;
+class BuildLogWriter;
 
 class CompilerGCC : public cbCompilerPlugin
 {
@@ -155,6 +159,8 @@ class CompilerGCC : public cbCompilerPlugin
         /*void OnProjectPopupMenu(wxNotifyEvent& event);*/
         void OnGCCOutput(CodeBlocksEvent& event);
         void OnGCCError(CodeBlocksEvent& event);
+        void OnGCCOutputLines(CodeBlocksEvent& event);
+        void OnBuildLogWritten(wxCommandEvent& event);
         void OnGCCTerminated(CodeBlocksEvent& event);
         void OnJobEnd(size_t procIndex, int exitCode);
 
@@ -177,7 +183,7 @@ class CompilerGCC : public cbCompilerPlugin
         void DoGotoPreviousError();
         void DoClearErrors();
         wxString ProjectMakefile();
-        void AddOutputLine(const wxString& output, bool forceErrorColour = false);
+        void AddOutputLine(const wxString& output, bool forceErrorColour = false, const CompilerCommand* cmd = 0);
         void LogWarningOrError(CompilerLineType lt, cbProject* prj, const wxString& filename, const wxString& line, const wxString& msg);
         void LogMessage(const wxString& message, CompilerLineType lt = cltNormal, LogTarget log = ltAll, bool forceErrorColour = false, bool isTitle = false, bool updateProgress = false);
         void SaveBuildLog();
@@ -191,6 +197,8 @@ class CompilerGCC : public cbCompilerPlugin
         int DoBuild();
         void CalculateWorkspaceDependencies(wxArrayInt& deps);
         void CalculateProjectDependencies(cbProject* prj, wxArrayInt& deps);
+        void CollectProjectDependencies(cbProject* prj, std::set<cbProject*>& deps);
+        bool CanAdvanceBuildState();
         void InitBuildState(BuildJob job, const wxString& target);
         void ResetBuildState();
         void BuildStateManagement(); ///< This uses m_BuildJob.
@@ -247,7 +255,12 @@ class CompilerGCC : public cbCompilerPlugin
         wxToolBar* m_pTbar;
         long int* m_Pid;
         wxString* m_ProcessOutputFiles;
+        CompilerCommand** m_ProcessCommands; // the command running in each process slot (owned by m_CommandQueue)
         wxTimer m_timerIdleWakeUp;
+        CompilerOutputReader* m_pOutputReader; // reads the build processes' output (if supported)
+        size_t m_ProcessGeneration; // bumped when the process slots are (re)allocated: tells stale reader output apart
+        std::set<size_t> m_ReaderProcesses; // process slots whose output is read by m_pOutputReader
+        std::map<size_t, int> m_PendingJobEnds; // exit codes of terminated processes, waiting for the rest of their output
         BuildLogger* m_Log;
         CompilerMessages* m_pListLog;
         wxChoice* m_ToolTarget;
@@ -280,7 +293,8 @@ class CompilerGCC : public cbCompilerPlugin
 
         wxString m_BuildLogFilename;
         wxString m_BuildLogTitle;
-        wxString m_BuildLogContents;
+        BuildLogWriter* m_pBuildLogWriter; // 0 if the HTML build log isn't saved
+        std::set<BuildLogWriter*> m_FinishingBuildLogs; // finished, still writing the file
         wxDateTime m_BuildStartTime;
 
         // build progress
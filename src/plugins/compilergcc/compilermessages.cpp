@@ -23,7 +23,7 @@ BEGIN_EVENT_TABLE(CompilerMessages, wxEvtHandler)
 END_EVENT_TABLE()
 
 CompilerMessages::CompilerMessages(const wxArrayString& titles, const wxArrayInt& widths)
-    : ListCtrlLogger(titles, widths, true)
+    : VirtualListCtrlLogger(titles, widths, true)
 {
     //ctor
 }
@@ -37,7 +37,7 @@ CompilerMessages::~CompilerMessages()
 
 wxWindow* CompilerMessages::CreateControl(wxWindow* parent)
 {
-    ListCtrlLogger::CreateControl(parent);
+    VirtualListCtrlLogger::CreateControl(parent);
     control->SetId(idList);
     Connect(idList, -1, wxEVT_COMMAND_LIST_ITEM_SELECTED,
             (wxObjectEventFunction) (wxEventFunction) (wxCommandEventFunction)
@@ -51,6 +51,7 @@ wxWindow* CompilerMessages::CreateControl(wxWindow* parent)
 
 void CompilerMessages::FocusError(int nr)
 {
+    Flush();
     control->SetItemState(nr, wxLIST_STATE_SELECTED | wxLIST_STATE_FOCUSED, wxLIST_STATE_SELECTED | wxLIST_STATE_FOCUSED);
     control->EnsureVisible(nr);
 }
@@ -7,7 +7,7 @@ class CompilerErrors;
 class wxArrayString;
 class wxCommandEvent;
 
-class CompilerMessages : public ListCtrlLogger, public wxEvtHandler
+class CompilerMessages : public VirtualListCtrlLogger, public wxEvtHandler
 {
     public:
         CompilerMessages(const wxArrayString& titles, const wxArrayInt& widths);
@@ -0,0 +1,484 @@
+/*
+* This file is part of Code::Blocks Studio, an open-source cross-platform IDE
+* Copyright (C) 2003  Yiannis An. Mandravellos
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*
+* $Revision$
+* $Id$
+* $HeadURL$
+*/
+#include "sdk.h"
+#ifndef CB_PRECOMP
+    #include <wx/event.h>
+    #include <wx/process.h>
+    #include "sdk_events.h"
+#endif
+#include <wx/txtstrm.h> // wxEOT
+#include <wx/wfstream.h>
+#include "compileroutputreader.h"
+
+#ifdef __linux__
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <poll.h>
+    #include <unistd.h>
+    #include <sys/epoll.h>
+    #include <sys/eventfd.h>
+#endif
+
+namespace
+{
+    // Converts the bytes the same way as cbTextInputStream::NextChar() in pipedprocess.cpp,
+    // so the text is the same as when the process' streams are polled: each character is
+    // converted on its own with wxConvLocal, from at most nine bytes.
+    wxString DecodeLine(const std::string& text)
+    {
+#if wxUSE_UNICODE
+        wxString line;
+        line.Alloc(text.length());
+        char bytes[10];
+        wchar_t wbuf[2];
+        size_t pos = 0;
+        while (pos < text.length())
+        {
+            const unsigned char first = (unsigned char)text[pos];
+            if (first < 0x80 && first != 0)
+            {
+                // ASCII is the same in all the locales' encodings we care about
+                line += (wxChar)first;
+                ++pos;
+                continue;
+            }
+
+            memset(bytes, 0, sizeof(bytes));
+            wxChar c = wxEOT;
+            size_t inlen = 0;
+            for ( ; inlen < 9; ++inlen)
+            {
+                if (pos == text.length())
+                    return line; // incomplete character at the end of the line: dropped
+                bytes[inlen] = text[pos++];
+                int retlen = (int)wxConvLocal.MB2WC(wbuf, bytes, 2); // returns -1 for failure
+                if (retlen >= 0) // res == 0 could happen for '\0' char
+                {
+                    c = wbuf[0];
+                    break;
+                }
+            }
+            line += c;
+        }
+        return line;
+#else
+        return wxString(text.c_str(), text.length());
+#endif
+    }
+
+#ifdef __linux__
+    // wxFileInputStream only exposes its wxFile since wx2.9
+    class FileInputStreamAccess : public wxFileInputStream
+    {
+        public:
+            static int GetFd(wxInputStream* stream)
+            {
+                wxFileInputStream* fileStream = dynamic_cast<wxFileInputStream*>(stream);
+                if (!fileStream)
+                    return -1;
+#if wxCHECK_VERSION(2, 9, 0)
+                wxFile* file = fileStream->GetFile();
+#else
+                wxFile* file = static_cast<FileInputStreamAccess*>(fileStream)->m_file;
+#endif
+                return file ? file->fd() : -1;
+            }
+    };
+}
+#endif
+
+CompilerOutputReader::CompilerOutputReader(wxEvtHandler* owner, int id)
+    : wxThread(wxTHREAD_JOINABLE),
+    m_pOwner(owner),
+    m_ID(id),
+    m_EpollFd(-1),
+    m_WakeFd(-1),
+    m_Running(false),
+    m_NotifyPending(false),
+    m_Stop(false)
+{
+    //ctor
+}
+
+CompilerOutputReader::~CompilerOutputReader()
+{
+    //dtor
+    Stop();
+}
+
+bool CompilerOutputReader::IsSupported()
+{
+#ifdef __linux__
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool CompilerOutputReader::Start()
+{
+#ifdef __linux__
+    if (m_Running)
+        return true;
+
+    m_EpollFd = epoll_create1(EPOLL_CLOEXEC);
+    m_WakeFd = eventfd(0, EFD_CLOEXEC);
+    if (m_EpollFd == -1 || m_WakeFd == -1)
+    {
+        Stop();
+        return false;
+    }
+
+    epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.fd = m_WakeFd;
+    if (epoll_ctl(m_EpollFd, EPOLL_CTL_ADD, m_WakeFd, &ev) == -1 ||
+        Create() != wxTHREAD_NO_ERROR ||
+        Run() != wxTHREAD_NO_ERROR)
+    {
+        Stop();
+        return false;
+    }
+    m_Running = true;
+    return true;
+#else
+    return false;
+#endif
+}
+
+void CompilerOutputReader::Stop()
+{
+#ifdef __linux__
+    if (m_Running)
+    {
+        {
+            wxMutexLocker lock(m_Mutex);
+            m_Stop = true;
+        }
+        Wake();
+        Wait();
+        m_Running = false;
+    }
+
+    // streams not yet picked up by the thread
+    for (size_t i = 0; i < m_NewFds.size(); ++i)
+        close(m_NewFds[i]);
+    m_NewFds.clear();
+    m_NewStreams.clear();
+    m_Drains.clear();
+    m_Lines.clear();
+
+    if (m_WakeFd != -1)
+        close(m_WakeFd);
+    if (m_EpollFd != -1)
+        close(m_EpollFd);
+    m_WakeFd = -1;
+    m_EpollFd = -1;
+#endif
+}
+
+bool CompilerOutputReader::AddProcess(size_t procIndex, size_t generation, wxProcess* process)
+{
+#ifdef __linux__
+    if (!m_Running || !process || !process->IsRedirected())
+        return false;
+
+    int outFd = FileInputStreamAccess::GetFd(process->GetInputStream());
+    int errFd = FileInputStreamAccess::GetFd(process->GetErrorStream());
+    if (outFd == -1 || errFd == -1)
+        return false;
+
+    // use our own copies of the descriptors: the process deletes its streams
+    // (and closes theirs) when it terminates, maybe before we 've read everything
+    outFd = fcntl(outFd, F_DUPFD_CLOEXEC, 0);
+    errFd = fcntl(errFd, F_DUPFD_CLOEXEC, 0);
+    if (outFd == -1 || errFd == -1)
+    {
+        if (outFd != -1)
+            close(outFd);
+        if (errFd != -1)
+            close(errFd);
+        return false;
+    }
+
+    Stream out;
+    out.procIndex = procIndex;
+    out.generation = generation;
+    out.isError = false;
+    Stream err;
+    err.procIndex = procIndex;
+    err.generation = generation;
+    err.isError = true;
+    {
+        wxMutexLocker lock(m_Mutex);
+        m_NewFds.push_back(outFd);
+        m_NewStreams.push_back(out);
+        m_NewFds.push_back(errFd);
+        m_NewStreams.push_back(err);
+    }
+    Wake();
+    return true;
+#else
+    return false;
+#endif
+}
+
+void CompilerOutputReader::Drain(size_t procIndex, size_t generation)
+{
+#ifdef __linux__
+    if (!m_Running)
+        return;
+    {
+        wxMutexLocker lock(m_Mutex);
+        m_Drains.push_back(SlotKey(procIndex, generation));
+    }
+    Wake();
+#endif
+}
+
+void CompilerOutputReader::GetLines(CompilerOutputLines& lines)
+{
+    wxMutexLocker lock(m_Mutex);
+    if (lines.empty())
+        lines.swap(m_Lines);
+    else
+        lines.insert(lines.end(), m_Lines.begin(), m_Lines.end());
+    m_Lines.clear();
+    m_NotifyPending = false;
+}
+
+void CompilerOutputReader::Wake()
+{
+#ifdef __linux__
+    if (m_WakeFd != -1)
+    {
+        uint64_t one = 1;
+        if (write(m_WakeFd, &one, sizeof(one)) == -1)
+            return; // counter overflow: the thread has a wake-up pending anyway
+    }
+#endif
+}
+
+wxThread::ExitCode CompilerOutputReader::Entry()
+{
+#ifdef __linux__
+    const int maxEvents = 32;
+    epoll_event events[maxEvents];
+
+    while (true)
+    {
+        int count = epoll_wait(m_EpollFd, events, maxEvents, -1);
+        if (count == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        for (int i = 0; i < count; ++i)
+        {
+            int fd = events[i].data.fd;
+            if (fd == m_WakeFd)
+            {
+                uint64_t value;
+                if (read(m_WakeFd, &value, sizeof(value)) != sizeof(value))
+                    continue; // spurious wake-up
+
+                std::vector<int> fds;
+                std::vector<Stream> streams;
+                std::vector<SlotKey> drains;
+                {
+                    wxMutexLocker lock(m_Mutex);
+                    if (m_Stop)
+                        break;
+                    fds.swap(m_NewFds);
+                    streams.swap(m_NewStreams);
+                    drains.swap(m_Drains);
+                }
+                for (size_t n = 0; n < fds.size(); ++n)
+                    AddStream(fds[n], streams[n]);
+                for (size_t n = 0; n < drains.size(); ++n)
+                    DrainSlot(drains[n]);
+            }
+            else
+                ReadStream(fd);
+        }
+
+        bool notify = false;
+        {
+            wxMutexLocker lock(m_Mutex);
+            if (m_Stop)
+                break;
+            if (!m_Lines.empty() && !m_NotifyPending)
+            {
+                m_NotifyPending = true;
+                notify = true;
+            }
+        }
+        if (notify)
+        {
+            // one event per batch: the owner fetches everything queued so far with GetLines()
+            CodeBlocksEvent event(cbEVT_PIPEDPROCESS_STDOUT, m_ID);
+            wxPostEvent(m_pOwner, event);
+        }
+    }
+
+    for (StreamsMap::iterator it = m_Streams.begin(); it != m_Streams.end(); ++it)
+        close(it->first);
+    m_Streams.clear();
+    m_OpenStreams.clear();
+#endif
+    return 0;
+}
+
+void CompilerOutputReader::AddStream(int fd, const Stream& newStream)
+{
+#ifdef __linux__
+    Stream& stream = m_Streams[fd];
+    stream = newStream;
+    stream.partial.clear();
+    ++m_OpenStreams[SlotKey(stream.procIndex, stream.generation)];
+
+    epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    if (epoll_ctl(m_EpollFd, EPOLL_CTL_ADD, fd, &ev) == -1)
+        CloseStream(fd);
+#endif
+}
+
+void CompilerOutputReader::ReadStream(int fd)
+{
+#ifdef __linux__
+    StreamsMap::iterator it = m_Streams.find(fd);
+    if (it == m_Streams.end())
+        return;
+    Stream& stream = it->second;
+
+    // level-triggered: a single read() per wake-up never blocks
+    char buf[65536];
+    ssize_t len = read(fd, buf, sizeof(buf));
+    if (len == -1 && (errno == EINTR || errno == EAGAIN))
+        return;
+    if (len <= 0)
+    {
+        if (!stream.partial.empty())
+            QueueLine(stream, stream.partial);
+        CloseStream(fd);
+        return;
+    }
+
+    // split in lines; "\r\n", "\n" and "\r" are all end-of-line
+    // (empty lines are dropped anyway, so "\r\n" split between reads is fine)
+    const char* start = buf;
+    const char* end = buf + len;
+    for (const char* p = buf; p < end; ++p)
+    {
+        if (*p != '\n' && *p != '\r')
+            continue;
+        if (stream.partial.empty())
+            QueueLine(stream, std::string(start, p));
+        else
+        {
+            stream.partial.append(start, p);
+            QueueLine(stream, stream.partial);
+            stream.partial.clear();
+        }
+        start = p + 1;
+    }
+    stream.partial.append(start, end);
+#endif
+}
+
+void CompilerOutputReader::CloseStream(int fd)
+{
+#ifdef __linux__
+    StreamsMap::iterator it = m_Streams.find(fd);
+    if (it == m_Streams.end())
+        return;
+    const SlotKey slot(it->second.procIndex, it->second.generation);
+    m_Streams.erase(it);
+    epoll_ctl(m_EpollFd, EPOLL_CTL_DEL, fd, 0);
+    close(fd);
+
+    if (--m_OpenStreams[slot] > 0)
+        return;
+    m_OpenStreams.erase(slot);
+
+    CompilerOutputLine line;
+    line.procIndex = slot.first;
+    line.generation = slot.second;
+    line.isError = false;
+    line.eof = true;
+    wxMutexLocker lock(m_Mutex);
+    m_Lines.push_back(line);
+#endif
+}
+
+void CompilerOutputReader::DrainSlot(const SlotKey& slot)
+{
+#ifdef __linux__
+    std::vector<int> fds;
+    for (StreamsMap::iterator it = m_Streams.begin(); it != m_Streams.end(); ++it)
+    {
+        if (SlotKey(it->second.procIndex, it->second.generation) == slot)
+            fds.push_back(it->first);
+    }
+
+    for (size_t i = 0; i < fds.size(); ++i)
+    {
+        // read while there's something to read right now (ReadStream() closes it at end-of-file)
+        pollfd pfd;
+        pfd.fd = fds[i];
+        pfd.events = POLLIN;
+        while (m_Streams.find(fds[i]) != m_Streams.end() && poll(&pfd, 1, 0) > 0)
+            ReadStream(fds[i]);
+
+        StreamsMap::iterator it = m_Streams.find(fds[i]);
+        if (it != m_Streams.end())
+        {
+            if (!it->second.partial.empty())
+                QueueLine(it->second, it->second.partial);
+            CloseStream(fds[i]);
+        }
+    }
+#endif
+}
+
+void CompilerOutputReader::QueueLine(const Stream& stream, const std::string& text)
+{
+    if (text.empty())
+        return;
+
+    CompilerOutputLine line;
+    line.procIndex = stream.procIndex;
+    line.generation = stream.generation;
+    line.isError = stream.isError;
+    line.eof = false;
+    wxString decoded = DecodeLine(text);
+
+    wxMutexLocker lock(m_Mutex);
+    m_Lines.push_back(line);
+    // hand the text over without keeping a reference to it: wxString isn't thread-safe
+    m_Lines.back().text.swap(decoded);
+}
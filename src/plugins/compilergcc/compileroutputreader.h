@@ -0,0 +1,104 @@
+#ifndef COMPILEROUTPUTREADER_H
+#define COMPILEROUTPUTREADER_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <wx/string.h>
+#include <wx/thread.h>
+
+class wxEvtHandler;
+class wxProcess;
+
+/** One line (or end-of-output marker) read from a build process' pipes. */
+struct CompilerOutputLine
+{
+    size_t procIndex; ///< the process slot the line came from
+    size_t generation; ///< the slot's generation, as given to AddProcess()
+    bool isError; ///< read from stderr?
+    bool eof; ///< no more output for this process slot (text is empty)
+    wxString text;
+};
+typedef std::vector<CompilerOutputLine> CompilerOutputLines;
+
+/**
+  * @brief Reads the output of all running build processes in a dedicated thread.
+  *
+  * Instead of polling each process' streams from the idle handler, the pipes
+  * of all build processes are multiplexed with epoll. Complete lines are
+  * queued and the owner is notified with a single cbEVT_PIPEDPROCESS_STDOUT
+  * event (with the reader's id) per batch; it then fetches the batch with GetLines().
+  * When both pipes of a process slot reached end-of-file, or the slot has been
+  * drained with Drain(), an @c eof line is queued.
+  *
+  * This is only supported on Linux. Elsewhere IsSupported() returns false
+  * and the processes' output should be polled as before.
+  */
+class CompilerOutputReader : public wxThread
+{
+    public:
+        CompilerOutputReader(wxEvtHandler* owner, int id);
+        virtual ~CompilerOutputReader();
+
+        /** @brief Is multiplexed reading available on this platform? */
+        static bool IsSupported();
+
+        /** @brief Create and run the reader thread. */
+        bool Start();
+        /** @brief Stop the reader thread and wait for it (pending output is dropped). */
+        void Stop();
+
+        /** @brief Start reading the redirected output of @c process, running in slot @c procIndex.
+          * Its lines are tagged with @c generation, so the owner can tell apart the output
+          * of slots it has reallocated in the meantime.
+          * @return false if the process' pipes couldn't be taken over (keep polling it then). */
+        bool AddProcess(size_t procIndex, size_t generation, wxProcess* process);
+
+        /** @brief The process in slot @c procIndex has terminated: read the output it has
+          * written and stop reading its pipes (an @c eof line is queued then), without waiting
+          * for their end-of-file. A process it started may still hold them open. */
+        void Drain(size_t procIndex, size_t generation);
+
+        /** @brief Move all the queued lines into @c lines (call from the main thread). */
+        void GetLines(CompilerOutputLines& lines);
+    protected:
+        virtual ExitCode Entry();
+    private:
+        struct Stream
+        {
+            size_t procIndex;
+            size_t generation;
+            bool isError;
+            std::string partial; // incomplete last line
+        };
+        typedef std::map<int, Stream> StreamsMap;
+        typedef std::pair<size_t, size_t> SlotKey; // process slot and generation
+
+        void AddStream(int fd, const Stream& newStream);
+        void ReadStream(int fd);
+        void CloseStream(int fd);
+        void DrainSlot(const SlotKey& slot);
+        void QueueLine(const Stream& stream, const std::string& text);
+        void Wake();
+
+        wxEvtHandler* m_pOwner;
+        int m_ID;
+        int m_EpollFd;
+        int m_WakeFd;
+        bool m_Running;
+
+        // only touched by the reader thread
+        StreamsMap m_Streams;
+        std::map<SlotKey, int> m_OpenStreams; // open streams count per process slot
+
+        wxMutex m_Mutex; // protects the members below
+        std::vector<Stream> m_NewStreams; // keyed by fd in m_NewFds
+        std::vector<int> m_NewFds;
+        std::vector<SlotKey> m_Drains; // slots to drain, after the new streams are added
+        CompilerOutputLines m_Lines;
+        bool m_NotifyPending;
+        bool m_Stop;
+};
+
+#endif // COMPILEROUTPUTREADER_H
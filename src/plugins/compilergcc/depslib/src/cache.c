@@ -186,6 +186,22 @@ g_stats.cache_used++;
 	return 0;
 }
 
+/* Like cache_check(), but doesn't add an entry nor count it as used */
+int cache_peek(const char *path, time_t time, LIST **includes)
+{
+	HDR hdr, *h = &hdr;
+
+	if (!hdrhash)
+		return 0;
+	h->file = path;
+	if (hashcheck(hdrhash, (HASHDATA **)&h) && h->time && (h->time == time))
+	{
+		*includes = h->includes;
+		return 1;
+	}
+	return 0;
+}
+
 void cache_enter(const char *path, time_t time, LIST *includes)
 {
 	HDR *h;
@@ -127,6 +127,11 @@ const char *depsGetNewest(depsRef ref, time_t *time)
 	return h->newest->key;
 }
 
+void depsForEachHeader(depsRef ref, depsHeaderFunc func, void *userData)
+{
+	headerforeach((HEADER *)ref, func, userData);
+}
+
 void depsTimeStamp(const char *path, time_t *time)
 {
 	PATHSPLIT f;
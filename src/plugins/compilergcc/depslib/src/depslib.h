@@ -93,6 +93,30 @@ extern void depsAddSearchDir(const char *path);
  */
 extern depsRef depsScanForHeaders(const char *path);
 
+/*
+ * -- depsParallelFunc --
+ * A function that calls job(data, index) for every index in [0, count),
+ * possibly from several threads at once, and returns when all calls are
+ * done. The jobs don't touch any of depslib's state.
+ */
+typedef void (*depsJobFunc)(void *data, int index);
+typedef void (*depsParallelFunc)(depsJobFunc job, void *data, int count, void *userData);
+
+/*
+ * -- depsPrescanForHeaders --
+ * Call this after depsSearchStart() with the files that will be passed to
+ * depsScanForHeaders(), to scan them and their (recursively) included files
+ * for #include statements in parallel. depsScanForHeaders() uses the results
+ * later on, instead of scanning these files again. Files with up-to-date
+ * entries in the cache are not scanned.
+ *
+ * arg paths (in) -> the relative (or absolute) file paths
+ * arg count (in) -> the number of paths
+ * arg parallel (in) -> runs the scan jobs; NULL scans the files serially
+ * arg userData (in) -> passed on to 'parallel'
+ */
+extern void depsPrescanForHeaders(const char **paths, int count, depsParallelFunc parallel, void *userData);
+
 /*
  * -- depsGetNewest --
  * Call this to get the absolute path and file modification time of the file
@@ -106,6 +130,19 @@ extern depsRef depsScanForHeaders(const char *path);
  */
 extern const char *depsGetNewest(depsRef ref, time_t *time);
 
+/*
+ * -- depsForEachHeader --
+ * Call this to enumerate the files a file passed to depsScanForHeaders()
+ * includes, directly or not. Each file is reported once.
+ *
+ * arg ref (in) -> the result of depsScanForHeaders()
+ * arg func (in) -> called with the absolute path and file modification time
+ *   of each included file
+ * arg userData (in) -> passed on to 'func'
+ */
+typedef void (*depsHeaderFunc)(const char *path, time_t time, void *userData);
+extern void depsForEachHeader(depsRef ref, depsHeaderFunc func, void *userData);
+
 /*
  * -- depsTimeStamp --
  * Return the timestamp for a file.
@@ -14,6 +14,8 @@
  * - Depth level counting (needed for D support)
  * - Simple optimization by avoiding regexec most of the time
  * - Special cache keys for source files (needed for D support)
+ * - Hand-written #include scanner over the (memory-mapped) file contents
+ * - Parallel pre-scanning of files (see depsPrescanForHeaders)
  */
 #include "jam.h"
 #include "alloc.h"
@@ -25,22 +27,243 @@
 #ifdef USE_CACHE
 #include "cache.h"
 #endif
+#include "pathsys.h"
+#include "pathsplit.h"
+#include "timestamp.h"
+
+#ifdef DEPSLIB_UNIX
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #include "depslib.h" /* for struct depsStats */
 extern struct depsStats g_stats;
 
 struct hash *headerhash = 0;
-static regexp *hdrre = 0;
 //D support
 static regexp *dimpre = 0;
 
-LIST *headers1(const char *file, int depth)
+/* Results of depsPrescanForHeaders(), used by headers1() instead of
+ * scanning the file again */
+typedef struct _prescan PRESCAN;
+
+struct _prescan
+{
+	const char *key;
+	LIST *includes;
+	int found; /* could the file be opened? */
+};
+
+static struct hash *prescanhash = 0;
+
+/* The contents of a file, memory-mapped if possible */
+typedef struct _filebuf FILEBUF;
+
+struct _filebuf
+{
+	char *data;
+	size_t size;
+	int mapped;
+};
+
+static int filebuf_open(const char *file, FILEBUF *fb)
 {
 	FILE *f;
-	regexp *re;
+	size_t alloced = 0;
+
+	fb->data = 0;
+	fb->size = 0;
+	fb->mapped = 0;
+
+#ifdef DEPSLIB_UNIX
+	{
+		struct stat st;
+		int fd = open(file, O_RDONLY);
+		if (fd == -1)
+			return 0;
+		if (fstat(fd, &st) == 0 && st.st_size > 0)
+		{
+			void *p = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (p != MAP_FAILED)
+			{
+				fb->data = p;
+				fb->size = st.st_size;
+				fb->mapped = 1;
+				close(fd);
+				return 1;
+			}
+		}
+		close(fd);
+	}
+#endif
+
+	/* Read the whole file. Text mode translation (Windows) is done by
+	 * next_line() */
+	if (!(f = fopen(file, "rb")))
+		return 0;
+	for (;;)
+	{
+		size_t n;
+		if (fb->size == alloced)
+		{
+			char *p = realloc(fb->data, alloced ? alloced * 2 : 16384);
+			if (!p)
+				break;
+			fb->data = p;
+			alloced = alloced ? alloced * 2 : 16384;
+		}
+		n = fread(fb->data + fb->size, 1, alloced - fb->size, f);
+		if (!n)
+			break;
+		fb->size += n;
+	}
+	fclose(f);
+#ifdef DEPSLIB_WINDOWS
+	/* Ctrl-Z is end-of-file in text mode */
+	if (fb->size)
+	{
+		char *eof = memchr(fb->data, 0x1a, fb->size);
+		if (eof)
+			fb->size = eof - fb->data;
+	}
+#endif
+	return 1;
+}
+
+static void filebuf_close(FILEBUF *fb)
+{
+#ifdef DEPSLIB_UNIX
+	if (fb->mapped)
+	{
+		munmap(fb->data, fb->size);
+		return;
+	}
+#endif
+	free(fb->data);
+}
+
+/* Returns the end of the line starting at p. Lines are split exactly like
+ * fgets() with a 1024 char buffer did, so long lines are handled the same */
+static const char *next_line(const char *p, const char *end)
+{
+	int n = 0;
+
+	while (p < end && n < 1023)
+	{
+#ifdef DEPSLIB_WINDOWS
+		/* text mode: "\r\n" is read as "\n" */
+		if (*p == '\r' && p + 1 < end && p[1] == '\n')
+			++p;
+#endif
+		++n;
+		if (*p++ == '\n')
+			break;
+	}
+	return p;
+}
+
+static int is_blank(char c)
+{
+	return c == ' ' || c == '\t';
+}
+
+/* Matches a line against "^[ \t]*#[ \t]*include[ \t]*([<\"])([^\">]*)([\">]).*$"
+ * On success, returns the length of the '<foo.h>' part starting at *name. */
+static int match_include(const char *p, const char *end, const char **name)
+{
+	const char *q;
+	/* strings end at the first NUL */
+	const char *nul = memchr(p, '\0', end - p);
+	if (nul)
+		end = nul;
+
+	while (p < end && is_blank(*p))
+		++p;
+	if (p == end || *p != '#')
+		return 0;
+	++p;
+	while (p < end && is_blank(*p))
+		++p;
+	if (end - p < 7 || memcmp(p, "include", 7) != 0)
+		return 0;
+	p += 7;
+	while (p < end && is_blank(*p))
+		++p;
+	if (p == end || (*p != '<' && *p != '"'))
+		return 0;
+	for (q = p + 1; q < end && *q != '"' && *q != '>'; ++q)
+		;
+	if (q == end)
+		return 0;
+	*name = p;
+	return q - p + 1;
+}
+
+/* Scan a C/C++ file for #include statements. This doesn't touch any global
+ * state, so it can run in any thread. The result is a malloc'ed array of
+ * malloc'ed strings. Returns zero if the file can't be opened. */
+static int headers_scan(const char *file, char ***includes, int *count)
+{
+	FILEBUF fb;
+	const char *p, *end;
+	int alloced = 0;
+
+	*includes = 0;
+	*count = 0;
+	if (!filebuf_open(file, &fb))
+		return 0;
+
+	end = fb.data + fb.size;
+	for (p = fb.data; p < end; )
+	{
+		const char *eol = next_line(p, end);
+		const char *name;
+		int l = match_include(p, eol, &name);
+		if (l)
+		{
+			char *s;
+			if (*count == alloced)
+			{
+				char **n = realloc(*includes, (alloced ? alloced * 2 : 16) * sizeof(char *));
+				if (!n)
+					break;
+				*includes = n;
+				alloced = alloced ? alloced * 2 : 16;
+			}
+			s = malloc(l + 1);
+			memcpy(s, name, l);
+			s[l] = '\0';
+			(*includes)[(*count)++] = s;
+		}
+		p = eol;
+	}
+
+	filebuf_close(&fb);
+	return 1;
+}
+
+static void headers_free(char **includes, int count)
+{
+	int i;
+	for (i = 0; i < count; ++i)
+		free(includes[i]);
+	free(includes);
+}
+
+static int is_dfile(const char *file)
+{
+	int fnlen = strlen(file);
+	return fnlen >= 2 && file[fnlen-2] == '.' && file[fnlen-1] == 'd';
+}
+
+LIST *headers1(const char *file, int depth)
+{
 	LIST *result = 0;
 	char buf[1024];
 	int fnlen=strlen(file);
+	FILEBUF fb;
+	const char *p, *end;
 	
 	//D support
 	int dMode=0;
@@ -52,27 +275,70 @@ LIST *headers1(const char *file, int depth)
 			printf("D file detected\n");
 	}
 
-	if (!(f = fopen(file, "r")))
+	if (!dMode && prescanhash)
+	{
+		PRESCAN ps, *s = &ps;
+		s->key = file;
+		if (hashcheck(prescanhash, (HASHDATA **)&s))
+		{
+			if (s->found)
+				g_stats.scanned++;
+			return s->includes;
+		}
+	}
+
+	if (!dMode)
+	{
+		char **includes;
+		int i, count;
+
+		if (!headers_scan(file, &includes, &count))
+			return result;
+
+		if( DEBUG_HEADER )
+			printf("header scan %s\n", file);
+
+		for (i = 0; i < count; ++i)
+		{
+			result = list_new(result, includes[i], 0);
+			if (DEBUG_HEADER)
+				printf("header found: %s\n", includes[i]);
+		}
+		headers_free(includes, count);
+
+		g_stats.scanned++;
+		return result;
+	}
+
+	//D support
+	if (!filebuf_open(file, &fb))
 		return result;
 
 	if( DEBUG_HEADER )
 	    printf("header scan %s\n", file);
 
-	if (!hdrre)
-		hdrre = my_regcomp("^[ 	]*#[ 	]*include[ 	]*([<\"])([^\">]*)([\">]).*$");
-	re = hdrre;
-	
-	//D support
-	if(dMode)
-	{
-		if(!dimpre)
-			dimpre = my_regcomp(
-				"^.*import[ \t]*([[A-Za-z_ \t]+=[ \t]*)?([A-Za-z_\\.]+)(\\:.+)?;.*$");
-		re = dimpre;
-	}
+	if(!dimpre)
+		dimpre = my_regcomp(
+			"^.*import[ \t]*([[A-Za-z_ \t]+=[ \t]*)?([A-Za-z_\\.]+)(\\:.+)?;.*$");
 	
-	while (fgets(buf, sizeof(buf), f))
+	end = fb.data + fb.size;
+	for (p = fb.data; p < end; )
 	{
+		regexp *re = dimpre;
+		const char *eol = next_line(p, end);
+		char *b = buf;
+
+		/* the line, like fgets() would have read it */
+		for (; p < eol; ++p)
+		{
+#ifdef DEPSLIB_WINDOWS
+			if (*p == '\r' && p + 1 < eol && p[1] == '\n')
+				continue;
+#endif
+			*b++ = *p;
+		}
+		*b = '\0';
+
 		//D support
 		if(dMode)
 		{
@@ -91,20 +357,14 @@ LIST *headers1(const char *file, int depth)
 		}
 		
 		//Simple reduction of regex overhead
-		if(strstr(buf, dMode ? "import" : "include"))
+		if(strstr(buf, "import"))
 			if (my_regexec(re, buf))
 			{
 				char buf2[MAXSYM];
 
 				//FIXME: don't add duplicate headers
-				if(!dMode && re->startp[3])
-				{
-					int l = re->endp[3] - re->startp[1];
-					memcpy(buf2, re->startp[1], l);
-					buf2[l] = '\0';
-				}
 				//D support
-				else if(re->startp[2])
+				if(re->startp[2])
 				{
 					if(depth > 0)
 					{
@@ -149,7 +409,7 @@ LIST *headers1(const char *file, int depth)
 		}
 	}
 
-	fclose(f);
+	filebuf_close(&fb);
 
 	g_stats.scanned++;
 
@@ -250,15 +510,221 @@ void headernewest(HEADER *h)
 	}
 }
 
+static void headerforeach1(HEADER *h, struct hash *visited, void (*func)(const char *path, time_t time, void *userData), void *userData)
+{
+	HEADERS *hs;
+
+	for (hs = h->headers; hs; hs = hs->next)
+	{
+		PRESCAN ps, *s = &ps;
+		s->key = hs->header->key;
+		if (!hashenter(visited, (HASHDATA **)&s))
+			continue;
+		func(hs->header->key, hs->header->time, userData);
+		headerforeach1(hs->header, visited, func, userData);
+	}
+}
+
+void headerforeach(HEADER *h, void (*func)(const char *path, time_t time, void *userData), void *userData)
+{
+	struct hash *visited = hashinit(sizeof(PRESCAN), "foreach");
+	headerforeach1(h, visited, func, userData);
+	hashdone(visited);
+}
+
+/* One file to scan in depsPrescanForHeaders() */
+typedef struct _prescanjob PRESCANJOB;
+
+struct _prescanjob
+{
+	const char *file;
+	time_t time;
+	int depth;
+	int scan; /* not in the cache: scan it */
+	int found;
+	char **includes;
+	int count;
+};
+
+static void prescan_job(void *data, int index)
+{
+	PRESCANJOB *job = (PRESCANJOB *)data + index;
+	job->found = headers_scan(job->file, &job->includes, &job->count);
+}
+
+/* Was this file handled already (or will be by headersDepth() without
+ * scanning it)? Otherwise set *includes if its includes are cached. */
+static int prescan_known(const char *file, time_t time, int depth, LIST **includes)
+{
+	char key[MAXJPATH + sizeof("source:")];
+	const char *cachekey = file;
+	HEADER hdr, *h = &hdr;
+	PRESCAN ps, *s = &ps;
+
+	*includes = 0;
+	s->key = file;
+	if (prescanhash && hashcheck(prescanhash, (HASHDATA **)&s))
+		return 1;
+
+	//D support (see headersDepth())
+	if (depth == 0)
+	{
+		strcpy(key, "source:");
+		strcat(key, file);
+		cachekey = key;
+	}
+	h->key = cachekey;
+	if (headerhash && hashcheck(headerhash, (HASHDATA **)&h))
+		return 1;
+#ifdef USE_CACHE
+	(void) cache_peek(cachekey, time, includes);
+#endif
+	return 0;
+}
+
+void depsPrescanForHeaders(const char **paths, int count, depsParallelFunc parallel, void *userData)
+{
+	PRESCANJOB *jobs = 0;
+	int njobs = 0, alloced = 0;
+	struct hash *visited;
+	int i;
+
+	if (!prescanhash)
+		prescanhash = hashinit(sizeof(PRESCAN), "prescan");
+	visited = hashinit(sizeof(PRESCAN), "visited");
+
+	for (i = 0; i < count; ++i)
+	{
+		PATHSPLIT f;
+		char buf[MAXJPATH];
+		time_t time;
+
+		/* same as depsScanForHeaders() */
+		path_split(paths[i], &f);
+		path_normalize(&f, NULL);
+		path_tostring(&f, buf);
+		timestamp(buf, &time);
+		if (!time)
+			continue;
+
+		if (njobs == alloced)
+		{
+			alloced = alloced ? alloced * 2 : 64;
+			jobs = realloc(jobs, alloced * sizeof(PRESCANJOB));
+		}
+		jobs[njobs].file = newstr(buf);
+		jobs[njobs].time = time;
+		jobs[njobs].depth = 0;
+		++njobs;
+	}
+
+	/* Scan the files in waves: the files of a wave are scanned in parallel,
+	 * then their #includes are looked up, which gives the next wave.
+	 * The results are used by headers1() later on. All the shared state
+	 * (hashes, strings, the cache) is only touched in this thread. */
+	while (njobs)
+	{
+		PRESCANJOB *next = 0;
+		int nnext = 0, nalloced = 0;
+		PRESCANJOB *scan = malloc(njobs * sizeof(PRESCANJOB));
+		int nscan = 0;
+		LIST **cached = malloc(njobs * sizeof(LIST *));
+
+		for (i = 0; i < njobs; ++i)
+		{
+			PRESCAN ps, *s = &ps;
+
+			cached[i] = 0;
+			jobs[i].scan = 0;
+			s->key = jobs[i].file;
+			if (!hashenter(visited, (HASHDATA **)&s))
+				continue;
+			//D support: D files are scanned depending on the depth, leave them alone
+			if (is_dfile(jobs[i].file))
+				continue;
+			if (prescan_known(jobs[i].file, jobs[i].time, jobs[i].depth, &cached[i]))
+				continue;
+			if (cached[i])
+			{
+				jobs[i].scan = -1; /* only follow the cached includes */
+				continue;
+			}
+			jobs[i].scan = 1;
+			jobs[i].found = 0;
+			jobs[i].includes = 0;
+			jobs[i].count = 0;
+			scan[nscan++] = jobs[i];
+		}
+
+		if (parallel && nscan > 1)
+			parallel(prescan_job, scan, nscan, userData);
+		else
+		{
+			for (i = 0; i < nscan; ++i)
+				prescan_job(scan, i);
+		}
+
+		for (i = 0, nscan = 0; i < njobs; ++i)
+		{
+			PRESCANJOB *job = jobs + i;
+			LIST *l = cached[i];
+
+			if (job->scan == 0)
+				continue;
+			if (job->scan == 1)
+			{
+				PRESCAN ps, *s = &ps;
+				int n;
+
+				job = scan + nscan++;
+				s->key = job->file;
+				s->includes = 0;
+				s->found = job->found;
+				(void) hashenter(prescanhash, (HASHDATA **)&s);
+				for (n = 0; n < job->count; ++n)
+					s->includes = list_new(s->includes, job->includes[n], 0);
+				headers_free(job->includes, job->count);
+				l = s->includes;
+			}
+
+			/* the next wave: the included files (see headersDepth()) */
+			for (; l; l = list_next(l))
+			{
+				time_t time;
+				const char *t2 = search(job->file, l->string, &time);
+				if (!time)
+					continue;
+				if (nnext == nalloced)
+				{
+					nalloced = nalloced ? nalloced * 2 : 64;
+					next = realloc(next, nalloced * sizeof(PRESCANJOB));
+				}
+				next[nnext].file = t2;
+				next[nnext].time = time;
+				next[nnext].depth = job->depth + 1;
+				++nnext;
+			}
+		}
+
+		free(cached);
+		free(scan);
+		free(jobs);
+		jobs = next;
+		njobs = nnext;
+	}
+	free(jobs);
+	hashdone(visited);
+}
+
 void donehdrs(void)
 {
-	my_redone(hdrre);
-	hdrre = 0;
 	//D support
 	my_redone(dimpre);
 	dimpre = 0;
 	hashdone(headerhash);
 	headerhash = 0;
+	hashdone(prescanhash);
+	prescanhash = 0;
 	alloc_free(hdralloc);
 	hdralloc = 0;
 }
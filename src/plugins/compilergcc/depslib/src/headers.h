@@ -30,4 +30,5 @@ struct _header
 
 extern HEADER *headers(const char *t, time_t time);
 extern void headernewest(HEADER *h);
+extern void headerforeach(HEADER *h, void (*func)(const char *path, time_t time, void *userData), void *userData);
 extern void donehdrs(void);
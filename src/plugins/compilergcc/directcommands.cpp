@@ -1,4 +1,6 @@
 #include <sdk.h>
+#include <algorithm>
+#include <vector>
 #include <wx/intl.h>
 #include <wx/filename.h>
 #include <wx/msgdlg.h>
@@ -18,8 +20,73 @@
 #include "compilergcc.h"
 #include "cbexception.h"
 #include "filefilters.h"
+#include "cbthreadpool.h"
+#include "builddatabase.h"
 #include <depslib.h>
 
+namespace
+{
+    // runs a range of depsPrescanForHeaders()'s jobs in the thread pool
+    class DepsScanTask : public cbThreadedTask
+    {
+        public:
+            DepsScanTask(depsJobFunc job, void* data, int first, int last, wxSemaphore& done)
+                : m_Job(job), m_pData(data), m_First(first), m_Last(last), m_Done(done)
+            {}
+            int Execute()
+            {
+                for (int i = m_First; i < m_Last; ++i)
+                    m_Job(m_pData, i);
+                m_Done.Post();
+                return 0;
+            }
+        private:
+            depsJobFunc m_Job;
+            void* m_pData;
+            int m_First;
+            int m_Last;
+            wxSemaphore& m_Done;
+    };
+
+    // depsParallelFunc: run the jobs in the thread pool passed as userData and wait for them
+    void DepsParallelFor(depsJobFunc job, void* data, int count, void* userData)
+    {
+        cbThreadPool* pool = static_cast<cbThreadPool*>(userData);
+        // a few files per task, there may be thousands of them
+        const int chunk = 8;
+        wxSemaphore done;
+        int tasks = 0;
+        pool->BatchBegin();
+        for (int i = 0; i < count; i += chunk)
+        {
+            pool->AddTask(new DepsScanTask(job, data, i, std::min(i + chunk, count), done), true);
+            ++tasks;
+        }
+        pool->BatchEnd();
+        while (tasks--)
+            done.Wait();
+    }
+
+    // depsHeaderFunc: add the header's content hash to the BuildInputs
+    struct HashHeadersData
+    {
+        BuildDatabase* db;
+        BuildInputs* inputs;
+        bool ok;
+    };
+
+    void HashHeader(const char* path, time_t time, void* userData)
+    {
+        HashHeadersData* data = static_cast<HashHeadersData*>(userData);
+        wxString filename(path, wxConvLibc);
+        wxString hash;
+        if (data->db->GetFileHash(filename, time, hash))
+            (*data->inputs)[filename] = hash;
+        else
+            data->ok = false;
+    }
+}
+
 DirectCommands::DirectCommands(CompilerGCC* compilerPlugin,
                                 Compiler* compiler,
                                 cbProject* project,
@@ -30,7 +97,9 @@ DirectCommands::DirectCommands(CompilerGCC* compilerPlugin,
 //    m_pGenerator(generator),
     m_pCompiler(compiler),
     m_pProject(project),
-    m_pCurrTarget(0)
+    m_pCurrTarget(0),
+    m_pDepsPool(0),
+    m_pBuildDb(0)
 {
     //ctor
     if (!m_pProject)
@@ -44,6 +113,14 @@ DirectCommands::DirectCommands(CompilerGCC* compilerPlugin,
     wxFileName fname(m_pProject->GetFilename());
     fname.SetExt(_T("depend"));
     depsCacheRead(fname.GetFullPath().mb_str());
+
+    // content hashes and command lines of the object files
+    if (Manager::Get()->GetConfigManager(_T("compiler"))->ReadBool(_T("/build_database"), true))
+    {
+        m_pBuildDb = new BuildDatabase;
+        fname.SetExt(_T("builddb"));
+        m_pBuildDb->Load(fname.GetFullPath());
+    }
 }
 
 DirectCommands::~DirectCommands()
@@ -60,10 +137,18 @@ DirectCommands::~DirectCommands()
         fname.SetExt(_T("depend"));
         depsCacheWrite(fname.GetFullPath().mb_str());
     }
+    if (m_pBuildDb)
+    {
+        wxFileName fname(m_pProject->GetFilename());
+        fname.SetExt(_T("builddb"));
+        m_pBuildDb->Save(fname.GetFullPath());
+        delete m_pBuildDb;
+    }
     Manager::Get()->GetLogManager()->DebugLog(
         F(_("Scanned %d files for #includes, cache used %d, cache updated %d"),
         stats.scanned, stats.cache_used, stats.cache_updated));
 
+    delete m_pDepsPool;
     depsDone();
 }
 
@@ -132,22 +217,62 @@ wxArrayString DirectCommands::CompileFile(ProjectBuildTarget* target, ProjectFil
     {
         DepsSearchStart(target);
 
-        const pfDetails& pfd = pf->GetFileDetails(target);
+        wxArrayString filecmd = GetCompileFileCommand(target, pf);
         wxString err;
-        if (!IsObjectOutdated(target, pfd, &err))
+        if (!IsObjectOutdated(target, pf, filecmd, &err))
         {
             if (!err.IsEmpty())
                 ret.Add(wxString(COMPILER_SIMPLE_LOG) + err);
             return ret;
         }
+        PrepareCompileFile(target, pf);
+        if (target)
+            ret.Add(wxString(COMPILER_TARGET_CHANGE) + target->GetTitle());
+        AppendArray(filecmd, ret);
+        return ret;
     }
 
+    PrepareCompileFile(target, pf);
     if (target)
         ret.Add(wxString(COMPILER_TARGET_CHANGE) + target->GetTitle());
     AppendArray(GetCompileFileCommand(target, pf), ret);
     return ret;
 }
 
+void DirectCommands::PrepareCompileFile(ProjectBuildTarget* target, ProjectFile* pf)
+{
+    // is it compilable?
+    if (!pf->compile || pf->compilerVar.IsEmpty())
+        return;
+
+    const pfDetails& pfd = pf->GetFileDetails(target);
+    Compiler* compiler = target ? CompilerFactory::GetCompiler(target->GetCompilerID()) : m_pCompiler;
+
+    // create output dir
+    if (!pfd.object_dir_native.IsEmpty() && !CreateDirRecursively(pfd.object_dir_native, 0755))
+    {
+        cbMessageBox(_("Can't create object output directory ") + pfd.object_dir_native);
+    }
+
+    // its generated files are compiled with it
+    for (size_t i = 0; i < pf->generatedFiles.size(); ++i)
+        PrepareCompileFile(target, pf->generatedFiles[i]);
+
+    // if it's a PCH, delete the previously generated PCH to avoid problems
+    // (it 'll be recreated anyway)
+    if (FileTypeOf(pf->relativeFilename) == ftHeader && compiler->GetSwitches().supportsPCH)
+    {
+        const CompilerTool& tool = compiler->GetCompilerTool(ctCompileObjectCmd, pf->file.GetExt());
+        pfCustomBuild& pcfb = pf->customBuild[compiler->GetID()];
+        bool hasCommand = pcfb.useCustomBuildCommand ? !pcfb.buildCommand.IsEmpty() : !tool.command.IsEmpty();
+        if (hasCommand)
+        {
+            wxString ObjectAbs = (compiler->GetSwitches().UseFlatObjects)?pfd.object_file_flat_absolute_native:pfd.object_file_absolute_native;
+            wxRemoveFile(ObjectAbs);
+        }
+    }
+}
+
 wxArrayString DirectCommands::GetCompileFileCommand(ProjectBuildTarget* target, ProjectFile* pf)
 {
     wxArrayString ret;
@@ -164,11 +289,8 @@ wxArrayString DirectCommands::GetCompileFileCommand(ProjectBuildTarget* target,
     // lookup file's type
     FileType ft = FileTypeOf(pf->relativeFilename);
 
-    // create output dir
-    if (!pfd.object_dir_native.IsEmpty() && !CreateDirRecursively(pfd.object_dir_native, 0755))
-    {
-        cbMessageBox(_("Can't create object output directory ") + pfd.object_dir_native);
-    }
+    // the output dir is created (and an old PCH deleted) by PrepareCompileFile(),
+    // once the file is known to need compiling: this only builds the command
 
     bool isResource = ft == ftResource;
     bool isHeader = ft == ftHeader;
@@ -248,14 +370,6 @@ wxArrayString DirectCommands::GetCompileFileCommand(ProjectBuildTarget* target,
 				ret.Add(wxString(COMPILER_WAIT));
 			AppendArray(retGenerated, ret);
 		}
-
-        // if it's a PCH, delete the previously generated PCH to avoid problems
-        // (it 'll be recreated anyway)
-        if (FileTypeOf(pf->relativeFilename) == ftHeader && pf->compile)
-        {
-            wxString ObjectAbs = (compiler->GetSwitches().UseFlatObjects)?pfd.object_file_flat_absolute_native:pfd.object_file_absolute_native;
-            wxRemoveFile(ObjectAbs);
-        }
     }
     else
         ret.Add(wxString(COMPILER_SIMPLE_LOG) + _("Skipping file (no compiler program set): ") + pfd.source_file_native);
@@ -409,18 +523,20 @@ wxArrayString DirectCommands::GetTargetCompileCommands(ProjectBuildTarget* targe
     size_t counter = ret.GetCount();
     MyFilesArray files = GetProjectFilesSortedByWeight(target, true, false);
     size_t fcount = files.GetCount();
+    if (!force)
+        PrescanHeaders(target, files);
     for (unsigned int i = 0; i < fcount; ++i)
     {
         ProjectFile* pf = files[i];
         // auto-generated files are handled automatically in GetCompileFileCommand()
         if (pf->autoGeneratedBy)
 			continue;
-        const pfDetails& pfd = pf->GetFileDetails(target);
         wxString err;
-        if (force || IsObjectOutdated(target, pfd, &err))
+        wxArrayString filecmd = GetCompileFileCommand(target, pf);
+        if (force || IsObjectOutdated(target, pf, filecmd, &err))
         {
             // compile file
-            wxArrayString filecmd = GetCompileFileCommand(target, pf);
+            PrepareCompileFile(target, pf);
             AppendArray(filecmd, ret);
         }
         else
@@ -850,52 +966,183 @@ bool DirectCommands::AreExternalDepsOutdated(const wxString& buildOutput, const
     return false; // no force relink
 }
 
-bool DirectCommands::IsObjectOutdated(ProjectBuildTarget* target, const pfDetails& pfd, wxString* errorStr)
+DirectCommands::ObjectState DirectCommands::GetObjectState(ProjectBuildTarget* target, const pfDetails& pfd, time_t* timeSrc, time_t* timeObj, wxString* errorStr)
 {
+    *timeObj = 0;
+
     // If the source file does not exist, then do not compile.
-    time_t timeSrc;
-    depsTimeStamp(pfd.source_file_absolute_native.mb_str(), &timeSrc);
-    if (!timeSrc)
+    depsTimeStamp(pfd.source_file_absolute_native.mb_str(), timeSrc);
+    if (!*timeSrc)
     {
         if (errorStr)
             *errorStr = _("WARNING: Can't read file's timestamp: ") + pfd.source_file_absolute_native;
 
         if (wxFileExists(pfd.source_file_absolute_native))
         {
-            return true;
+            return osOutdated;
         }
 
-        return false;
+        return osUpToDate;
     }
 
     // If the object file does not exist, then it must be built. In this case
     // there is no need to scan the source file for headers.
-    time_t timeObj;
-    Compiler* compiler = target ? CompilerFactory::GetCompiler(target->GetCompilerID()) : m_pCompiler;
-    wxString ObjectAbs = (compiler->GetSwitches().UseFlatObjects)?pfd.object_file_flat_absolute_native:pfd.object_file_absolute_native;
-    depsTimeStamp(ObjectAbs.mb_str(), &timeObj);
-    if (!timeObj)
-        return true;
+    depsTimeStamp(GetObjectFile(target, pfd).mb_str(), timeObj);
+    if (!*timeObj)
+        return osOutdated;
 
     // If the source file is newer than the object file, then the object file
     // must be built. In this case there is no need to scan the source file
     // for headers.
-    if (timeSrc > timeObj)
-        return true;
+    if (*timeSrc > *timeObj)
+        return osOutdated;
+
+    return osScanHeaders;
+}
+
+wxString DirectCommands::GetObjectFile(ProjectBuildTarget* target, const pfDetails& pfd)
+{
+    Compiler* compiler = target ? CompilerFactory::GetCompiler(target->GetCompilerID()) : m_pCompiler;
+    return (compiler->GetSwitches().UseFlatObjects)?pfd.object_file_flat_absolute_native:pfd.object_file_absolute_native;
+}
+
+void DirectCommands::PrescanHeaders(ProjectBuildTarget* target, const MyFilesArray& files)
+{
+    // find the files IsObjectOutdated() will scan for headers...
+    std::vector<wxCharBuffer> paths;
+    for (size_t i = 0; i < files.GetCount(); ++i)
+    {
+        ProjectFile* pf = files[i];
+        if (pf->autoGeneratedBy)
+            continue;
+        const pfDetails& pfd = pf->GetFileDetails(target);
+        time_t timeSrc;
+        time_t timeObj;
+        ObjectState state = GetObjectState(target, pfd, &timeSrc, &timeObj);
+        // the build database needs the headers of all existing objects
+        if (state == osScanHeaders || (m_pBuildDb && timeSrc && timeObj))
+            paths.push_back(pfd.source_file_absolute_native.mb_str());
+    }
+    if (paths.size() < 2)
+        return;
+
+    // ...and scan them (and their headers) in parallel
+    std::vector<const char*> ptrs(paths.size());
+    for (size_t i = 0; i < paths.size(); ++i)
+        ptrs[i] = paths[i].data();
+    if (!m_pDepsPool)
+        m_pDepsPool = new cbThreadPool(m_pCompilerPlugin);
+    depsPrescanForHeaders(&ptrs[0], ptrs.size(), DepsParallelFor, m_pDepsPool);
+}
+
+bool DirectCommands::IsObjectOutdated(ProjectBuildTarget* target, ProjectFile* pf, const wxArrayString& commands, wxString* errorStr)
+{
+    const pfDetails& pfd = pf->GetFileDetails(target);
+    time_t timeSrc;
+    time_t timeObj;
+    ObjectState state = GetObjectState(target, pfd, &timeSrc, &timeObj, errorStr);
+    if (state == osUpToDate)
+        return false;
+
+    wxString reason;
+    bool outdated = state == osOutdated;
+    if (!timeSrc)
+        reason = _("can't read the source file's timestamp");
+    else if (!timeObj)
+        reason = _("the object file doesn't exist");
+    else if (outdated)
+        reason = _("the source file is newer than the object file");
 
     // Scan the source file for headers. Result is NULL if the file does
     // not exist. If one of the descendent header files is newer than the
     // object file, then the object file must be built.
-    depsRef ref = depsScanForHeaders(pfd.source_file_absolute_native.mb_str());
-    if (ref)
+    // The build database needs the headers anyway (except for new objects).
+    depsRef ref = 0;
+    if (!outdated || (m_pBuildDb && timeSrc))
+        ref = depsScanForHeaders(pfd.source_file_absolute_native.mb_str());
+    if (ref && !outdated)
     {
         time_t timeNewest;
-        (void) depsGetNewest(ref, &timeNewest);
-        return (timeNewest > timeObj);
+        const char* newest = depsGetNewest(ref, &timeNewest);
+        outdated = timeNewest > timeObj;
+        if (outdated)
+            reason = _("newer than the object file: ") + wxString(newest, wxConvLibc);
+    }
+
+    if (!m_pBuildDb || !timeSrc)
+    {
+        if (outdated)
+            LogRebuildReason(pfd, reason);
+        return outdated;
+    }
+
+    // Now compare the object's actual inputs with those it was built from.
+    // If a file can't be hashed, its contents are unknown: use the timestamps.
+    wxString command = GetCommandLine(commands);
+    BuildInputs inputs;
+    HashHeadersData data;
+    data.db = m_pBuildDb;
+    data.inputs = &inputs;
+    data.ok = true;
+    HashHeader(pfd.source_file_absolute_native.mb_str(), timeSrc, &data);
+    if (ref)
+        depsForEachHeader(ref, HashHeader, &data);
+    if (!data.ok)
+    {
+        if (outdated)
+            LogRebuildReason(pfd, reason);
+        return outdated;
+    }
+
+    if (timeObj)
+    {
+        if (!m_pBuildDb->HasObject(GetObjectFile(target, pfd)))
+        {
+            // no information yet (e.g. the database was just turned on): trust the timestamps
+            if (!outdated)
+                m_pBuildDb->SetObject(GetObjectFile(target, pfd), 0, command, inputs);
+        }
+        else
+        {
+            reason = m_pBuildDb->GetRebuildReason(GetObjectFile(target, pfd), timeObj, command, inputs);
+            outdated = !reason.IsEmpty();
+        }
+    }
+
+    if (outdated)
+    {
+        // the object is built from the current inputs from now on; if it still has
+        // the same modification time when checked the next time, its build failed
+        m_pBuildDb->SetObject(GetObjectFile(target, pfd), timeObj, command, inputs);
+        LogRebuildReason(pfd, reason);
     }
+    return outdated;
+}
 
-    // object file is up to date with source file
-    return false;
+wxString DirectCommands::GetCommandLine(const wxArrayString& commands)
+{
+    // only the commands themselves, not the messages/markers for the compiler plugin
+    wxString ret;
+    for (size_t i = 0; i < commands.GetCount(); ++i)
+    {
+        const wxString& cmd = commands[i];
+        if (cmd.StartsWith(COMPILER_SIMPLE_LOG) ||
+            cmd.StartsWith(COMPILER_TARGET_CHANGE) ||
+            cmd == COMPILER_WAIT ||
+            cmd == COMPILER_WAIT_LINK)
+        {
+            continue;
+        }
+        if (!ret.IsEmpty())
+            ret << _T('\n');
+        ret << cmd;
+    }
+    return ret;
+}
+
+void DirectCommands::LogRebuildReason(const pfDetails& pfd, const wxString& reason)
+{
+    Manager::Get()->GetLogManager()->DebugLog(F(_("Rebuilding %s: %s"), pfd.source_file_native.c_str(), reason.c_str()));
 }
 
 void DirectCommands::DepsSearchStart(ProjectBuildTarget* target)
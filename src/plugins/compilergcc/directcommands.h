@@ -1,6 +1,7 @@
 #ifndef DIRECTCOMMANDS_H
 #define DIRECTCOMMANDS_H
 
+#include <time.h>
 #include <wx/string.h>
 #include <wx/hashmap.h>
 
@@ -16,6 +17,8 @@ class cbProject;
 class ProjectBuildTarget;
 class ProjectFile;
 class pfDetails;
+class cbThreadPool;
+class BuildDatabase;
 
 WX_DEFINE_ARRAY(ProjectFile*, MyFilesArray); // keep our own copy, to sort it by file weight (priority)
 
@@ -43,7 +46,20 @@ class DirectCommands
         bool m_doYield;
     protected:
         bool AreExternalDepsOutdated(const wxString& buildOutput, const wxString& additionalFiles, const wxString& externalDeps);
-        bool IsObjectOutdated(ProjectBuildTarget* target, const pfDetails& pfd, wxString* errorStr = 0);
+        // how an object file compares to its source file
+        enum ObjectState
+        {
+            osOutdated,     // needs to be compiled
+            osUpToDate,     // doesn't need to be compiled
+            osScanHeaders   // depends on the source file's headers
+        };
+        ObjectState GetObjectState(ProjectBuildTarget* target, const pfDetails& pfd, time_t* timeSrc, time_t* timeObj, wxString* errorStr = 0);
+        wxString GetObjectFile(ProjectBuildTarget* target, const pfDetails& pfd);
+        void PrepareCompileFile(ProjectBuildTarget* target, ProjectFile* pf);
+        void PrescanHeaders(ProjectBuildTarget* target, const MyFilesArray& files);
+        bool IsObjectOutdated(ProjectBuildTarget* target, ProjectFile* pf, const wxArrayString& commands, wxString* errorStr = 0);
+        wxString GetCommandLine(const wxArrayString& commands);
+        void LogRebuildReason(const pfDetails& pfd, const wxString& reason);
         void DepsSearchStart(ProjectBuildTarget* target);
         MyFilesArray GetProjectFilesSortedByWeight(ProjectBuildTarget* target, bool compile, bool link);
         void AddCommandsToArray(const wxString& cmds, wxArrayString& array, bool isWaitCmd = false, bool isLinkCmd = false);
@@ -53,6 +69,8 @@ class DirectCommands
         Compiler* m_pCompiler;
         cbProject* m_pProject;
         ProjectBuildTarget* m_pCurrTarget; // temp
+        cbThreadPool* m_pDepsPool; // scans for #includes in parallel
+        BuildDatabase* m_pBuildDb; // what the objects were built from (0 if disabled)
     private:
 };
 
@@ -98,7 +98,7 @@ int CodeStat::Execute()
     LanguageDef languages[NB_FILETYPES_MAX];
     int nb_languages = LoadSettings(languages);
     int dlgReturnCode = 0;
-    if(dlg->Execute(languages,nb_languages) != 0)
+    if(dlg->Execute(languages,nb_languages,cache) != 0)
     {
         dlgReturnCode = -1;
     }
@@ -11,9 +11,9 @@
 #define CODESTAT_H
 
 #include "cbplugin.h" // the base class we 're inheriting
+#include "codestatexec.h"
 
 class cbConfigurationPanel;
-class CodeStatExecDlg;
 class wxWindow;
 
 /** Main class for the Code Statistics plugin.
@@ -31,6 +31,7 @@ class CodeStat : public cbToolPlugin
 		void OnRelease(bool appShutDown); // fires when the plugin is released from the application
 	private:
       CodeStatExecDlg* dlg;
+      CodeStatCache cache; /**< Counts of the files analysed so far. */
 };
 
 #endif // CODESTAT_H
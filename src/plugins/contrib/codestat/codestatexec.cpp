@@ -21,60 +21,296 @@
 #include "projectfile.h"
 #include "projectmanager.h"
 #endif
+#include <wx/choicdlg.h>
+#include <wx/filefn.h>
 #include <wx/gauge.h>
+#include <wx/hashset.h>
 #include <wx/progdlg.h>
-#include <wx/textfile.h>
+#include <wx/thread.h>
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+#include "cbthreadpool.h"
 #include "codestatexec.h"
 
-/** Count the lines on all project's files and display the results.
+namespace
+{
+   const size_t g_FilesPerTask = 16;
+
+   WX_DECLARE_HASH_SET(wxString, wxStringHash, wxStringEqual, CodeStatFileSet);
+
+   /** The comment signs of a language, as UTF-8 bytes. */
+   struct CommentSigns
+   {
+      std::string single_line;
+      std::string multi_line_begin;
+      std::string multi_line_end;
+   };
+
+   /** A file to be counted by the worker threads. */
+   struct CodeStatJob
+   {
+      wxString filename;
+      time_t modified;
+      wxFileOffset size;
+      int language;
+      CodeStatCounts counts;
+   };
+
+   std::string ToUtf8(const wxString& str)
+   {
+      return std::string((const char*)str.mb_str(wxConvUTF8));
+   }
+
+   /** The first occurrence of sign in [begin, end), 0 if none (or if sign is empty). */
+   const char* FindSign(const char* begin, const char* end, const std::string& sign)
+   {
+      if (sign.empty())
+         return 0;
+      const char* found = std::search(begin, end, sign.begin(), sign.end());
+      return found == end ? 0 : found;
+   }
+
+   inline bool IsBlank(char c)
+   {
+      return c == ' ' || c == '\t' || c == '\v' || c == '\f';
+   }
+
+   /** Counts a file's lines ("\r\n", "\n" and "\r" all end a line, as in wxTextFile).
+    *  Each line is classified in place: the part after a comment sign is looked at
+    *  again, as long as something is left of it.
+    */
+   void CountLines(const char* data, size_t len, const CommentSigns& signs, CodeStatCounts& counts)
+   {
+      const char* end = data + len;
+      bool multi_line_comment = false;
+      for (const char* line = data; line < end; )
+      {
+         const char* eol = line;
+         while (eol < end && *eol != '\r' && *eol != '\n')
+            ++eol;
+
+         ++counts.total_lines;
+         bool comment = false;
+         bool code = false;
+         bool empty = true;
+         const char* p = line;
+         const char* e = eol;
+         for (;;)
+         {
+            // delete first and trailing spaces
+            while (p < e && IsBlank(*p))
+               ++p;
+            while (e > p && IsBlank(e[-1]))
+               --e;
+            if (p == e)
+               break;
+            empty = false;
+
+            // we are in a multiple line comment => finding the "end of multiple line comment" sign
+            if (multi_line_comment)
+            {
+               comment = true;
+               const char* comment_end = FindSign(p, e, signs.multi_line_end);
+               if (!comment_end)
+                  break;
+               multi_line_comment = false;
+               p = comment_end + signs.multi_line_end.length();
+               continue;
+            }
+
+            const char* single = FindSign(p, e, signs.single_line);
+            const char* begin = FindSign(p, e, signs.multi_line_begin);
+            // first comment sign found is a single line comment sign
+            if (single && (!begin || single < begin))
+            {
+               comment = true;
+               if (single > p)
+                  code = true;
+               break;
+            }
+            // first comment sign found is a multi-line comment begin sign
+            if (begin)
+            {
+               multi_line_comment = true;
+               comment = true;
+               if (begin > p)
+                  code = true;
+               p = begin + signs.multi_line_begin.length();
+               continue;
+            }
+            code = true;
+            break;
+         }
+
+         if (empty)
+            ++counts.empty_lines;
+         else if (comment && code)
+            ++counts.codecomments_lines;
+         else if (comment)
+            ++counts.comment_lines;
+         else if (code)
+            ++counts.code_lines;
+
+         if (eol == end)
+            break;
+         line = eol + 1;
+         if (*eol == '\r' && line < end && *line == '\n')
+            ++line;
+      }
+   }
+}
+
+/** Counts the lines of a chunk of the files. */
+class CodeStatTask : public cbThreadedTask
+{
+   public:
+      CodeStatTask(std::vector<CodeStatJob>& jobs, size_t first, size_t last,
+                   const std::vector<CommentSigns>& signs, wxMutex& mutex, size_t& done)
+         : jobs(jobs), first(first), last(last), signs(signs), mutex(mutex), done(done) {}
+      int Execute();
+   private:
+      bool ReadFile(const wxString& filename, std::vector<char>& buffer);
+
+      std::vector<CodeStatJob>& jobs;
+      size_t first;
+      size_t last;
+      const std::vector<CommentSigns>& signs;
+      wxMutex& mutex;
+      size_t& done;
+};
+
+int CodeStatTask::Execute()
+{
+   std::vector<char> buffer;
+   for (size_t i = first; i < last; ++i)
+   {
+      CodeStatJob& job = jobs[i];
+      if (!TestDestroy() && ReadFile(job.filename, buffer) && !buffer.empty())
+         CountLines(&buffer[0], buffer.size(), signs[job.language], job.counts);
+
+      wxMutexLocker lock(mutex);
+      ++done;
+   }
+   return 0;
+}
+
+bool CodeStatTask::ReadFile(const wxString& filename, std::vector<char>& buffer)
+{
+   // not wxFile: it would log failures from the worker thread
+   FILE* fp = wxFopen(filename, _T("rb"));
+   if (!fp)
+      return false;
+
+   // the whole file in one read
+   buffer.clear();
+   bool ok = fseek(fp, 0, SEEK_END) == 0;
+   long size = ok ? ftell(fp) : -1;
+   if (size >= 0 && fseek(fp, 0, SEEK_SET) == 0)
+   {
+      buffer.resize(size);
+      size_t len = size ? fread(&buffer[0], 1, size, fp) : 0;
+      buffer.resize(len);
+      ok = !ferror(fp);
+   }
+   else
+      ok = false;
+   fclose(fp);
+   return ok;
+}
+
+/** Count the lines on all project's (or workspace's) files and display the results.
+ *  Files whose modification time and size didn't change since the last run are
+ *  taken from the cache, the others are read and counted by a pool of threads.
  *  @param languages Languages definitions
  *  @param nb_languages Number of languages defined in the 'languages' array
+ *  @param cache Counts of the files analysed before
  */
-int CodeStatExecDlg::Execute(LanguageDef languages[NB_FILETYPES_MAX], int nb_languages)
+int CodeStatExecDlg::Execute(LanguageDef languages[NB_FILETYPES_MAX], int nb_languages, CodeStatCache& cache)
 {
-   cbProject* project = Manager::Get()->GetProjectManager()->GetActiveProject();
-   long nb_files = project->GetFilesCount();
-   //wxMessageBox(wxString::Format(_T("Nb files: %ld"), nb_files), _("Error"), wxOK);
+   ProjectManager* prjMan = Manager::Get()->GetProjectManager();
+   std::vector<cbProject*> projects;
+   projects.push_back(prjMan->GetActiveProject());
+
+   // With several projects opened, the whole workspace can be counted
+   bool workspace = false;
+   if (prjMan->GetProjects()->GetCount() > 1)
+   {
+      wxArrayString choices;
+      choices.Add(_("Active project"));
+      choices.Add(_("Whole workspace"));
+      wxSingleChoiceDialog dlg(parent, _("Count the lines of:"), _("Code Statistics plugin"), choices);
+      PlaceWindow(&dlg);
+      if (dlg.ShowModal() != wxID_OK)
+         return 0;
+      workspace = dlg.GetSelection() == 1;
+   }
+   if (workspace)
+   {
+      projects.clear();
+      for (size_t p = 0; p < prjMan->GetProjects()->GetCount(); ++p)
+         projects.push_back(prjMan->GetProjects()->Item(p));
+   }
 
    // Check if all files have been saved
    bool all_files_saved = true;
-   for (int i=0; i<nb_files; ++i)
-      if (project->GetFile(i)->GetFileState() == fvsModified)
-         all_files_saved = false;
+   for (size_t p = 0; p < projects.size(); ++p)
+      for (int i=0; i<projects[p]->GetFilesCount(); ++i)
+         if (projects[p]->GetFile(i)->GetFileState() == fvsModified)
+            all_files_saved = false;
    // If not, ask user if we can save them
    if (!all_files_saved)
    {
        if (cbMessageBox(_T("Some files are not saved.\nDo you want to save them before running the plugin?"), _("Warning"), wxICON_EXCLAMATION | wxYES_NO, Manager::Get()->GetAppWindow()) == wxID_YES)
        {
-           for (int i=0; i<nb_files; ++i)
+           for (size_t p = 0; p < projects.size(); ++p)
            {
-              if (project->GetFile(i)->GetFileState() == fvsModified)
-                 Manager::Get()->GetEditorManager()->Save(project->GetFile(i)->file.GetFullPath());
+              for (int i=0; i<projects[p]->GetFilesCount(); ++i)
+              {
+                 if (projects[p]->GetFile(i)->GetFileState() == fvsModified)
+                    Manager::Get()->GetEditorManager()->Save(projects[p]->GetFile(i)->file.GetFullPath());
+              }
            }
        }
    }
 
-	// Count code statistics on each file
+   // The comment signs of each language, for the worker threads
+   std::vector<CommentSigns> signs(nb_languages);
+   std::vector<std::string> signatures(nb_languages);
+   for (int l = 0; l<nb_languages; ++l)
+   {
+      signs[l].single_line = ToUtf8(languages[l].single_line_comment);
+      signs[l].multi_line_begin = ToUtf8(languages[l].multiple_line_comment[0]);
+      signs[l].multi_line_end = ToUtf8(languages[l].multiple_line_comment[1]);
+      signatures[l] = signs[l].single_line + '\n' + signs[l].multi_line_begin + '\n' + signs[l].multi_line_end;
+   }
+
+	// Count code statistics on each file (once, even if it belongs to several projects)
+	long nb_files = 0;
 	long nb_files_not_found = 0;
 	long nb_skipped_files = 0;
-	long total_lines = 0;
-	long code_lines = 0;
-	long empty_lines = 0;
-	long comment_lines = 0;
-	long codecomments_lines = 0;
-
-	wxProgressDialog progress(_("Code Statistics plugin"),_("Parsing project files. Please wait..."));
-	for (int i=0; i<nb_files; ++i)
+	CodeStatCounts total = { 0, 0, 0, 0, 0 };
+	std::vector<CodeStatJob> jobs;
+	CodeStatFileSet seen;
+
+	for (size_t p = 0; p < projects.size(); ++p)
 	{
-		ProjectFile* pf = project->GetFile(i);
-		wxFileName filename(pf->file.GetFullPath(), wxPATH_DOS);
-		if (!filename.FileExists())
-		{
-			++nb_files_not_found;
-			//Manager::Get()->GetLogManager()->DebugLog(_T("Code Statistics: Ignoring file '%s' (file not found)"), filename.GetName());
-		}
-		else
+		for (int i=0; i<projects[p]->GetFilesCount(); ++i)
 		{
+			ProjectFile* pf = projects[p]->GetFile(i);
+			wxString fullpath = pf->file.GetFullPath();
+			if (!seen.insert(fullpath).second)
+				continue;
+			++nb_files;
+
+			wxFileName filename(fullpath, wxPATH_DOS);
+			wxStructStat st;
+			if (!filename.FileExists() || wxStat(filename.GetFullPath(), &st) != 0)
+			{
+				++nb_files_not_found;
+				continue;
+			}
+
 			// Find the language associated to the file extension
 			int num_language = -1;
 			for (int l = 0; l<nb_languages; ++l)
@@ -85,16 +321,89 @@ int CodeStatExecDlg::Execute(LanguageDef languages[NB_FILETYPES_MAX], int nb_lan
 					 num_language = l;
 				}
 			}
+			if (num_language == -1)
+			{
+				++nb_skipped_files;
+				continue;
+			}
+
+			// Unchanged since last time?
+			CodeStatCache::const_iterator it = cache.find(fullpath);
+			if (it != cache.end() && it->second.modified == st.st_mtime &&
+				it->second.size == (wxFileOffset)st.st_size && it->second.comment_signs == signatures[num_language])
+			{
+				const CodeStatCounts& counts = it->second.counts;
+				total.code_lines += counts.code_lines;
+				total.codecomments_lines += counts.codecomments_lines;
+				total.comment_lines += counts.comment_lines;
+				total.empty_lines += counts.empty_lines;
+				total.total_lines += counts.total_lines;
+				continue;
+			}
 
-			// If the language is found, analyse the source file
-			if (num_language > -1)
-			  CountLines(filename, languages[num_language], code_lines, codecomments_lines, comment_lines, empty_lines, total_lines);
-			else ++nb_skipped_files;
+			CodeStatJob job;
+			job.filename = wxString(filename.GetFullPath().c_str()); // own copy, for the worker thread
+			job.modified = st.st_mtime;
+			job.size = st.st_size;
+			job.language = num_language;
+			job.counts = CodeStatCounts();
+			jobs.push_back(job);
 		}
-		if (nb_files > 1)
-			progress.Update((100*i)/(nb_files-1));
-   }
-   progress.Update(100);
+	}
+
+	if (!jobs.empty())
+	{
+		wxProgressDialog progress(_("Code Statistics plugin"),_("Parsing project files. Please wait..."));
+		wxMutex mutex;
+		size_t done = 0;
+		cbThreadPool pool(this);
+		pool.BatchBegin();
+		for (size_t first = 0; first < jobs.size(); first += g_FilesPerTask)
+		{
+			size_t last = std::min(first + g_FilesPerTask, jobs.size());
+			pool.AddTask(new CodeStatTask(jobs, first, last, signs, mutex, done), true);
+		}
+		pool.BatchEnd();
+
+		for (;;)
+		{
+			size_t files_done;
+			{
+				wxMutexLocker lock(mutex);
+				files_done = done;
+			}
+			if (files_done == jobs.size())
+				break;
+			progress.Update((100*files_done)/jobs.size());
+			wxMilliSleep(20);
+		}
+		// let the workers finish their task before the pool goes away
+		while (!pool.Done())
+			wxMilliSleep(1);
+		progress.Update(100);
+	}
+
+	for (size_t i = 0; i < jobs.size(); ++i)
+	{
+		const CodeStatJob& job = jobs[i];
+		total.code_lines += job.counts.code_lines;
+		total.codecomments_lines += job.counts.codecomments_lines;
+		total.comment_lines += job.counts.comment_lines;
+		total.empty_lines += job.counts.empty_lines;
+		total.total_lines += job.counts.total_lines;
+
+		CodeStatCacheEntry& entry = cache[job.filename];
+		entry.modified = job.modified;
+		entry.size = job.size;
+		entry.comment_signs = signatures[job.language];
+		entry.counts = job.counts;
+	}
+
+	long total_lines = total.total_lines;
+	long code_lines = total.code_lines;
+	long empty_lines = total.empty_lines;
+	long comment_lines = total.comment_lines;
+	long codecomments_lines = total.codecomments_lines;
 
    // Setting-up the statistics dialog box
    wxXmlResource::Get()->LoadDialog(this, parent, _T("dlgCodeStatExec"));
@@ -146,7 +455,7 @@ int CodeStatExecDlg::Execute(LanguageDef languages[NB_FILETYPES_MAX], int nb_lan
 
         ShowModal();
    }
-   else cbMessageBox(_("The project is empty!"), _("Warning"), wxICON_EXCLAMATION | wxOK, Manager::Get()->GetAppWindow());
+   else cbMessageBox(workspace ? _("The workspace is empty!") : _("The project is empty!"), _("Warning"), wxICON_EXCLAMATION | wxOK, Manager::Get()->GetAppWindow());
 
    return 0;
 }
@@ -156,102 +465,6 @@ void CodeStatExecDlg::EndModal(int retCode)
     wxDialog::EndModal(retCode);
 }
 
-/** This function analyses a given source file and count the lines of code, comments etc...
- */
-void CodeStatExecDlg::CountLines(wxFileName filename, LanguageDef &language,
-                                 long int &code_lines, long int &codecomments_lines,
-                                 long int &comment_lines, long int &empty_lines, long int &total_lines)
-{
-	wxTextFile file;
-	if (file.Open(filename.GetFullPath(),wxConvFile))
-	{
-		bool multi_line_comment = false;
-		total_lines += file.GetLineCount();
-		for (unsigned int i=0; i<file.GetLineCount(); ++i)
-		{
-		   wxString line(file[i]);
-		   line = line.Trim(true);
-           line = line.Trim(false);
-		   bool comment = false;
-		   bool code = false;
-		   if (line.IsEmpty())
-	         ++empty_lines;
-		   else
-		   {
-		   	  AnalyseLine(language, line, comment, code, multi_line_comment);
-		      if (comment&&code) ++codecomments_lines;
-		      else if (comment) ++comment_lines;
-		      else if (code) ++code_lines;
-		   }
-		}
-	}
-}
-
-/** This function determines the caracteristics of a given line (code line, comment line etc...).
- *  It is called by the "CountLines" function.
- *  @see CountLines
- */
-void CodeStatExecDlg::AnalyseLine(LanguageDef &language, wxString line, bool &comment, bool &code, bool &multi_line_comment)
-{
-   int first_single_line_comment, first_multi_line_comment_begin, first_multi_line_comment_end;
-
-   // Delete first and trailing spaces
-   line = line.Trim(true);
-   line = line.Trim(false);
-
-	if (line.IsEmpty())
-	   return;
-
-	// Searching for single and multi-lines comment signs
-	if (language.single_line_comment.Length() > 0)
-      first_single_line_comment = line.Find(language.single_line_comment);
-   else first_single_line_comment = -1;
-   if (language.multiple_line_comment[0].Length() > 0)
-      first_multi_line_comment_begin = line.Find(language.multiple_line_comment[0]);
-   else first_multi_line_comment_begin = -1;
-   if (language.multiple_line_comment[1].Length() > 0)
-      first_multi_line_comment_end = line.Find(language.multiple_line_comment[1]);
-   else first_multi_line_comment_end = -1;
-
-   // We are in a multiple line comment => finding the "end of multiple line comment" sign
-   if (multi_line_comment)
-   {
-      comment = true;
-   	if (first_multi_line_comment_end > -1)
-   	{
-   		multi_line_comment = false;
-   		if (first_multi_line_comment_end+language.multiple_line_comment[1].Length() < line.Length())
-   		   AnalyseLine(language, line.Mid(first_multi_line_comment_end+language.multiple_line_comment[1].Length()), comment, code, multi_line_comment);
-   	}
-   }
-   // We are not in a multiple line comment
-   else if (!multi_line_comment)
-   {
-   	// First comment sign found is a single line comment sign
-      if ( (first_single_line_comment>-1)
-         &&((first_multi_line_comment_begin==-1)||((first_multi_line_comment_begin>-1)&&(first_single_line_comment<first_multi_line_comment_begin))) )
-      {
-      	comment = true;
-         if (first_single_line_comment > 0)
-            code = true;
-      }
-      // First comment sign found is a multi-line comment begin sign
-      else if (first_multi_line_comment_begin>-1)
-      {
-         multi_line_comment = true;
-         comment = true;
-         if (first_multi_line_comment_begin > 0)
-            code = true;
-         if (first_multi_line_comment_begin+language.multiple_line_comment[0].Length() < line.Length())
-   		   AnalyseLine(language, line.Mid(first_multi_line_comment_begin+language.multiple_line_comment[0].Length()), comment, code, multi_line_comment);
-      }
-      else
-      {
-      	code = true;
-      }
-   }
-}
-
 CodeStatExecDlg::~CodeStatExecDlg()
 {
 }
@@ -12,10 +12,35 @@
 
 #include <wx/dialog.h>
 #include <wx/filename.h>
+#include <map>
+#include <string>
 #include "language_def.h"
 
 class wxWindow;
 
+/** Line counts of one or more source files. */
+struct CodeStatCounts
+{
+   long code_lines;
+   long codecomments_lines;
+   long comment_lines;
+   long empty_lines;
+   long total_lines;
+};
+
+/** The counts of a file, valid as long as the file keeps its modification time and size.
+ *  @see CodeStatExecDlg
+ */
+struct CodeStatCacheEntry
+{
+   time_t modified;
+   wxFileOffset size;
+   std::string comment_signs; /**< The comment signs the file was analysed with. */
+   CodeStatCounts counts;
+};
+
+typedef std::map<wxString, CodeStatCacheEntry> CodeStatCache;
+
 /** This class computes the statistics of the project's files and display them.
  *  @see CodeStat, CodeStatConfigDlg, CodeStatExecDlg, LanguageDef
  */
@@ -24,13 +49,9 @@ class CodeStatExecDlg : public wxDialog
 	public:
 		CodeStatExecDlg(wxWindow* parent) : parent(parent){}
 		virtual ~CodeStatExecDlg();
-		int Execute(LanguageDef languages[NB_FILETYPES_MAX], int nb_languages);
+		int Execute(LanguageDef languages[NB_FILETYPES_MAX], int nb_languages, CodeStatCache& cache);
 	private:
       void EndModal(int retCode);
-      void CountLines(wxFileName filename, LanguageDef &language,
-                      long int &code_lines, long int &codecomments_lines,
-                      long int &comment_lines, long int &empty_lines, long int &total_lines);
-      void AnalyseLine(LanguageDef &language, wxString line, bool &comment, bool &code, bool &multi_line_comment);
       wxWindow* parent;
 };
 
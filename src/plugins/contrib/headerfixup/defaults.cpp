@@ -35,6 +35,7 @@ void Bindings::SetDefaultsCodeBlocks()
     "BlkAllc;blockallocated.h|"
     "BlockAllocated;blockallocated.h|"
     "BlockAllocator;blockallocated.h|"
+    "BufferedTextCtrlLogger;loggers.h|"
     "cbAssert;cbexception.h|"
     "cbC2U;globals.h|"
     "cbCodeCompletionPlugin;cbplugin.h|"
@@ -133,6 +134,7 @@ void Bindings::SetDefaultsCodeBlocks()
     "FilesGroupsAndMasks;filegroupsandmasks.h|"
     "FileTreeData;cbproject.h|"
     "FileType;globals.h|"
+    "FileWatcher;filewatcher.h|"
     "FileTypeOf;globals.h|"
     "FindDlg;finddlg.h|"
     "FindReplaceBase;findreplacebase.h|"
@@ -291,6 +293,7 @@ void Bindings::SetDefaultsCodeBlocks()
     "UsesCommonControls6;globals.h|"
     "UserVariableManager;uservarmanager.h|"
     "VirtualBuildTargetsDlg;virtualbuildtargetsdlg.h|"
+    "VirtualListCtrlLogger;loggers.h|"
     "WorkspaceLoader;workspaceloader.h|"
     "wxToolBarAddOnXmlHandler;xtra_res.h|"
     "wxBase64;base64.h|"
@@ -0,0 +1,502 @@
+/*
+* This file is part of lib_finder plugin for Code::Blocks Studio
+* Copyright (C) 2006-2007  Bartlomiej Swiecki
+*
+* wxSmith is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* wxSmith is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with wxSmith; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*
+* $Revision$
+* $Id$
+* $HeadURL$
+*/
+
+#include "dirindex.h"
+
+#include <wx/ffile.h>
+#include <wx/filefn.h>
+#include <wx/filename.h>
+#include <wx/utils.h>
+#include <cbthreadpool.h>
+
+#include <algorithm>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef __WXMSW__
+    #include <wx/msw/wrapwin.h>
+#else
+    #include <dirent.h>
+#endif
+
+namespace
+{
+    const wxString IndexMagic = _T("lib_finder dir index 1");
+
+    /** \brief Listing entries of a directory
+     *
+     * Not using wxDir since it logs errors and this runs in worker threads.
+     * Links to directories are followed (like wxDir does), except for
+     * junctions on windows.
+     */
+    void ListDir(const wxString& Path,wxArrayString& Files,wxArrayString& SubDirs)
+    {
+        #ifdef __WXMSW__
+
+            WIN32_FIND_DATA Data;
+            HANDLE Find = ::FindFirstFile((Path + _T("\\*")).c_str(),&Data);
+            if ( Find == INVALID_HANDLE_VALUE ) return;
+            do
+            {
+                wxString Name(Data.cFileName);
+                if ( Name == _T(".") || Name == _T("..") ) continue;
+                if ( Data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY )
+                {
+                    if ( !(Data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) )
+                    {
+                        SubDirs.Add(Name);
+                    }
+                }
+                else
+                {
+                    Files.Add(Name);
+                }
+            }
+            while ( ::FindNextFile(Find,&Data) );
+            ::FindClose(Find);
+
+        #else
+
+            std::string DirName((const char*)Path.fn_str());
+            DIR* Dir = opendir(DirName.c_str());
+            if ( !Dir ) return;
+            DirName += '/';
+            while ( dirent* Entry = readdir(Dir) )
+            {
+                if ( !strcmp(Entry->d_name,".") || !strcmp(Entry->d_name,"..") ) continue;
+
+                bool IsDir;
+                #ifdef DT_DIR
+                if ( Entry->d_type == DT_DIR )
+                    IsDir = true;
+                else if ( Entry->d_type == DT_REG )
+                    IsDir = false;
+                else
+                #endif
+                {
+                    struct stat St;
+                    IsDir = stat((DirName + Entry->d_name).c_str(),&St) == 0 && S_ISDIR(St.st_mode);
+                }
+
+                wxString Name(Entry->d_name,*wxConvFileName);
+                if ( IsDir )
+                    SubDirs.Add(Name);
+                else
+                    Files.Add(Name);
+            }
+            closedir(Dir);
+
+        #endif
+    }
+
+    /** \brief Making copy of strings not sharing any data with the original ones */
+    void CopyArray(const wxArrayString& Source,wxArrayString& Dest)
+    {
+        Dest.Alloc(Source.Count());
+        for ( size_t i=0; i<Source.Count(); i++ )
+        {
+            Dest.Add(wxString(Source[i].c_str()));
+        }
+    }
+
+    bool IsInside(const wxString& Path,const wxArrayString& Roots)
+    {
+        for ( size_t i=0; i<Roots.Count(); i++ )
+        {
+            if ( Path == Roots[i] ) return true;
+            if ( Path.StartsWith(Roots[i]) && Path[Roots[i].Len()] == wxFileName::GetPathSeparator() ) return true;
+        }
+        return false;
+    }
+}
+
+/** \brief Task reading one directory */
+class DirIndexTask: public cbThreadedTask
+{
+    public:
+
+        DirIndexTask(DirIndex* Index,const wxString& Path):
+            m_Index(Index),
+            m_Path(Path.c_str())    // Own copy, wxString is not thread-safe
+        {}
+
+        int Execute();
+
+    private:
+
+        DirIndex* m_Index;
+        wxString m_Path;
+};
+
+int DirIndexTask::Execute()
+{
+    DirIndex::DirEntry* Entry = 0;
+    wxString VisitKey;
+
+    wxStructStat St;
+    if ( !TestDestroy() && wxStat(m_Path,&St) == 0 && (St.st_mode & S_IFMT) == S_IFDIR )
+    {
+        #ifdef __WXMSW__
+            VisitKey = m_Path.Lower();
+        #else
+            VisitKey = wxString::Format(_T("%lu:%lu"),(unsigned long)St.st_dev,(unsigned long)St.st_ino);
+        #endif
+
+        Entry = new DirIndex::DirEntry;
+        Entry->Modified = St.st_mtime;
+
+        // The index may be read without locking, it's not modified while scanning
+        DirIndex::DirMap::const_iterator Old = m_Index->m_Dirs.find(m_Path);
+        if ( Old != m_Index->m_Dirs.end() && Old->second->Modified == Entry->Modified )
+        {
+            CopyArray(Old->second->Files,Entry->Files);
+            CopyArray(Old->second->SubDirs,Entry->SubDirs);
+        }
+        else
+        {
+            ListDir(m_Path,Entry->Files,Entry->SubDirs);
+        }
+    }
+
+    m_Index->DirScanned(m_Path,Entry,VisitKey);
+    return 0;
+}
+
+DirIndex::DirIndex():
+    m_Pool(0),
+    m_Pending(0),
+    m_ScannedCount(0),
+    m_Stop(false),
+    m_ScanStart(0)
+{
+}
+
+DirIndex::~DirIndex()
+{
+    StopScan();
+    ClearDirs(m_Dirs);
+}
+
+void DirIndex::ClearDirs(DirMap& Dirs)
+{
+    for ( DirMap::iterator it = Dirs.begin(); it != Dirs.end(); ++it )
+    {
+        delete it->second;
+    }
+    Dirs.clear();
+}
+
+bool DirIndex::Load(const wxString& FileName)
+{
+    ClearDirs(m_Dirs);
+    m_DirPaths.Clear();
+    m_Names.clear();
+
+    if ( !wxFileExists(FileName) ) return true;
+
+    wxFFile File(FileName,_T("rb"));
+    wxString Contents;
+    if ( !File.IsOpened() || !File.ReadAll(&Contents,wxConvUTF8) ) return false;
+    if ( !Contents.StartsWith(IndexMagic) ) return false;   // Unknown version, start over
+
+    // D <mtime> <path>     directory, followed by:
+    // F <name>               its files
+    // S <name>               its subdirectories
+    DirEntry* Entry = 0;
+    size_t Pos = 0;
+    while ( Pos < Contents.Length() )
+    {
+        size_t Eol = Contents.find(_T('\n'),Pos);
+        if ( Eol == wxString::npos ) Eol = Contents.Length();
+        size_t Start = Pos;
+        Pos = Eol + 1;
+        if ( Eol - Start < 3 || Contents[Start+1] != _T(' ') ) continue;
+
+        wxChar Type = Contents[Start];
+        wxString Value = Contents.Mid(Start+2,Eol-Start-2);
+        if ( Type == _T('D') )
+        {
+            long Modified = 0;
+            Value.BeforeFirst(_T(' ')).ToLong(&Modified);
+            wxString Path = Value.AfterFirst(_T(' '));
+            DirEntry*& Slot = m_Dirs[Path];
+            delete Slot;
+            Slot = Entry = new DirEntry;
+            Entry->Modified = Modified;
+        }
+        else if ( Type == _T('F') && Entry )
+        {
+            Entry->Files.Add(Value);
+        }
+        else if ( Type == _T('S') && Entry )
+        {
+            Entry->SubDirs.Add(Value);
+        }
+    }
+    return true;
+}
+
+bool DirIndex::Save(const wxString& FileName)
+{
+    wxString Contents;
+    Contents << IndexMagic << _T('\n');
+    for ( DirMap::const_iterator it = m_Dirs.begin(); it != m_Dirs.end(); ++it )
+    {
+        const DirEntry* Entry = it->second;
+        Contents << _T("D ") << (long)Entry->Modified << _T(' ') << it->first << _T('\n');
+        for ( size_t i=0; i<Entry->Files.Count(); i++ )
+        {
+            Contents << _T("F ") << Entry->Files[i] << _T('\n');
+        }
+        for ( size_t i=0; i<Entry->SubDirs.Count(); i++ )
+        {
+            Contents << _T("S ") << Entry->SubDirs[i] << _T('\n');
+        }
+    }
+
+    wxFFile File(FileName,_T("wb"));
+    return File.IsOpened() && File.Write(Contents,wxConvUTF8);
+}
+
+void DirIndex::StartScan(wxEvtHandler* Owner,const wxArrayString& Dirs)
+{
+    StopScan();
+
+    m_Roots.Clear();
+    for ( size_t i=0; i<Dirs.Count(); i++ )
+    {
+        wxString DirName = Dirs[i];
+        if ( DirName.empty() ) continue;
+
+        // Cutting off last character if it is path separator
+        wxChar LastChar = DirName[DirName.Len()-1];
+        if ( wxFileName::GetPathSeparators().Find(LastChar) != -1 )
+        {
+            DirName.RemoveLast();
+        }
+        m_Roots.Add(DirName);
+    }
+
+    m_Pool = new cbThreadPool(Owner);
+    m_ScanStart = time(0);
+    m_Stop = false;
+    m_ScannedCount = 0;
+
+    wxMutexLocker Lock(m_Mutex);
+    m_Pool->BatchBegin();
+    for ( size_t i=0; i<m_Roots.Count(); i++ )
+    {
+        QueueDir(m_Roots[i]);
+    }
+    m_Pool->BatchEnd();
+}
+
+void DirIndex::QueueDir(const wxString& Path)
+{
+    // Called with m_Mutex locked
+    if ( m_Stop ) return;
+    ++m_Pending;
+    m_Pool->AddTask(new DirIndexTask(this,Path),true);
+}
+
+void DirIndex::DirScanned(const wxString& Path,DirEntry* Entry,const wxString& VisitKey)
+{
+    wxMutexLocker Lock(m_Mutex);
+
+    // Subdirectory of an alias dropped in the meantime
+    if ( Entry && IsInside(Path,m_Dropped) )
+    {
+        delete Entry;
+        Entry = 0;
+    }
+
+    // Same directory reached through a link: don't loop, and index it
+    // under the smallest path so the result doesn't depend on threads' timing
+    if ( Entry )
+    {
+        VisitedMap::iterator it = m_Visited.find(VisitKey);
+        if ( it != m_Visited.end() && !IsInside(it->second,m_Dropped) )
+        {
+            if ( it->second.Cmp(Path) <= 0 )
+            {
+                delete Entry;
+                Entry = 0;
+            }
+            else
+            {
+                DropAlias(it->second);
+            }
+        }
+    }
+
+    if ( Entry )
+    {
+        m_Visited[wxString(VisitKey.c_str())] = wxString(Path.c_str());
+        m_Scanned[wxString(Path.c_str())] = Entry;
+        ++m_ScannedCount;
+        for ( size_t i=0; i<Entry->SubDirs.Count(); i++ )
+        {
+            QueueDir(Path + wxFileName::GetPathSeparator() + Entry->SubDirs[i]);
+        }
+    }
+    --m_Pending;
+}
+
+void DirIndex::DropAlias(const wxString& Path)
+{
+    // Called with m_Mutex locked
+    wxArrayString Alias;
+    Alias.Add(Path);
+    m_Dropped.Add(Path);
+
+    // Subdirectories still queued are dropped when they're scanned
+    wxArrayString Drop;
+    for ( DirMap::iterator it = m_Scanned.begin(); it != m_Scanned.end(); ++it )
+    {
+        if ( IsInside(it->first,Alias) )
+        {
+            Drop.Add(it->first);
+        }
+    }
+    for ( size_t i=0; i<Drop.Count(); i++ )
+    {
+        delete m_Scanned[Drop[i]];
+        m_Scanned.erase(Drop[i]);
+        --m_ScannedCount;
+    }
+}
+
+bool DirIndex::IsScanning()
+{
+    if ( !m_Pool ) return false;
+    {
+        wxMutexLocker Lock(m_Mutex);
+        if ( m_Pending > 0 ) return true;
+    }
+    FinishScan();
+    return false;
+}
+
+int DirIndex::GetScannedCount()
+{
+    wxMutexLocker Lock(m_Mutex);
+    return m_ScannedCount;
+}
+
+void DirIndex::StopScan()
+{
+    if ( !m_Pool ) return;
+    {
+        wxMutexLocker Lock(m_Mutex);
+        m_Stop = true;
+        m_Pool->AbortAllTasks();
+    }
+    while ( !m_Pool->Done() ) wxMilliSleep(1);
+    delete m_Pool;
+    m_Pool = 0;
+
+    ClearDirs(m_Scanned);
+    m_Visited.clear();
+    m_Dropped.Clear();
+    m_Pending = 0;
+}
+
+void DirIndex::FinishScan()
+{
+    // Let the workers finish their last task before the pool goes away
+    while ( !m_Pool->Done() ) wxMilliSleep(1);
+    delete m_Pool;
+    m_Pool = 0;
+
+    // Directories inside scanned ones which were not reached any more are gone
+    wxArrayString Gone;
+    for ( DirMap::iterator it = m_Dirs.begin(); it != m_Dirs.end(); ++it )
+    {
+        if ( IsInside(it->first,m_Roots) && m_Scanned.find(it->first) == m_Scanned.end() )
+        {
+            Gone.Add(it->first);
+        }
+    }
+    for ( size_t i=0; i<Gone.Count(); i++ )
+    {
+        delete m_Dirs[Gone[i]];
+        m_Dirs.erase(Gone[i]);
+    }
+
+    for ( DirMap::iterator it = m_Scanned.begin(); it != m_Scanned.end(); ++it )
+    {
+        // Directory modified while scanning could be modified again
+        // within the same second, its time can't be trusted next time
+        if ( it->second->Modified >= m_ScanStart - 1 )
+        {
+            it->second->Modified = (time_t)-1;
+        }
+
+        DirEntry*& Slot = m_Dirs[it->first];
+        delete Slot;
+        Slot = it->second;
+    }
+    m_Scanned.clear();
+    m_Visited.clear();
+    m_Dropped.Clear();
+
+    BuildNames();
+}
+
+void DirIndex::BuildNames()
+{
+    m_DirPaths.Clear();
+    m_Names.clear();
+
+    // Only directories from current scan are searched,
+    // sorted so the results always come in the same order
+    for ( DirMap::const_iterator it = m_Dirs.begin(); it != m_Dirs.end(); ++it )
+    {
+        if ( IsInside(it->first,m_Roots) )
+        {
+            m_DirPaths.Add(it->first);
+        }
+    }
+    m_DirPaths.Sort();
+
+    for ( size_t i=0; i<m_DirPaths.Count(); i++ )
+    {
+        const DirEntry* Entry = m_Dirs[m_DirPaths[i]];
+        for ( size_t j=0; j<Entry->Files.Count(); j++ )
+        {
+            m_Names[Entry->Files[j]].push_back((int)i);
+        }
+        for ( size_t j=0; j<Entry->SubDirs.Count(); j++ )
+        {
+            m_Names[Entry->SubDirs[j]].push_back((int)i);
+        }
+    }
+}
+
+const std::vector<int>* DirIndex::FindName(const wxString& Name) const
+{
+    NameMap::const_iterator it = m_Names.find(Name);
+    if ( it == m_Names.end() ) return 0;
+    return &it->second;
+}
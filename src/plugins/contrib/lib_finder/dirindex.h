@@ -0,0 +1,125 @@
+/*
+* This file is part of lib_finder plugin for Code::Blocks Studio
+* Copyright (C) 2006-2007  Bartlomiej Swiecki
+*
+* wxSmith is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* wxSmith is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with wxSmith; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*
+* $Revision$
+* $Id$
+* $HeadURL$
+*/
+
+#ifndef DIRINDEX_H
+#define DIRINDEX_H
+
+#include <wx/string.h>
+#include <wx/arrstr.h>
+#include <wx/hashmap.h>
+#include <wx/hashset.h>
+#include <wx/thread.h>
+#include <time.h>
+#include <vector>
+
+class cbThreadPool;
+class wxEvtHandler;
+
+/** \brief Index of file and directory names found in the search directories
+ *
+ * Each directory is stored once, together with its modification time and
+ * the names of its entries. The index maps each name to the directories
+ * containing it, so it's much smaller than a list of full paths.
+ *
+ * Directories are read by a pool of threads. The index is saved to disk
+ * after the scan, so the next scan only lists directories whose
+ * modification time changed. Unchanged directories are just walked through.
+ */
+class DirIndex
+{
+    public:
+
+        DirIndex();
+        ~DirIndex();
+
+        /** \brief Loading index saved by previous scan (missing file gives empty index) */
+        bool Load(const wxString& FileName);
+
+        /** \brief Saving index */
+        bool Save(const wxString& FileName);
+
+        /** \brief Starting the scan of given directories and their subdirectories
+         *
+         * The scan runs in the background, poll IsScanning() until it's finished.
+         * \param Owner handler receiving thread pool's events (may ignore them)
+         */
+        void StartScan(wxEvtHandler* Owner,const wxArrayString& Dirs);
+
+        /** \brief Checking if the scan is still running, the index is updated when it's finished */
+        bool IsScanning();
+
+        /** \brief Stopping the scan, the index is left as it was before */
+        void StopScan();
+
+        /** \brief Getting number of directories scanned so far */
+        int GetScannedCount();
+
+        /** \brief Getting indexes of directories containing entry with given name (or 0 if there's none) */
+        const std::vector<int>* FindName(const wxString& Name) const;
+
+        /** \brief Getting path of directory with given index
+         *
+         * Returns a deep copy, so it may be called from many threads at once
+         * (copying wxString only bumps a reference count which is not thread-safe)
+         */
+        wxString GetDir(int Index) const { return wxString(m_DirPaths[Index].c_str()); }
+
+    private:
+
+        friend class DirIndexTask;
+
+        struct DirEntry
+        {
+            time_t Modified;
+            wxArrayString Files;
+            wxArrayString SubDirs;
+        };
+
+        WX_DECLARE_STRING_HASH_MAP(DirEntry*,DirMap);
+        WX_DECLARE_STRING_HASH_MAP(std::vector<int>,NameMap);
+        WX_DECLARE_STRING_HASH_MAP(wxString,VisitedMap);
+
+        void ClearDirs(DirMap& Dirs);
+        void BuildNames();
+        void QueueDir(const wxString& Path);
+        void DirScanned(const wxString& Path,DirEntry* Entry,const wxString& VisitKey);
+        void DropAlias(const wxString& Path);
+        void FinishScan();
+
+        DirMap m_Dirs;              ///< \brief Directories indexed so far
+        wxArrayString m_DirPaths;   ///< \brief Paths of directories, by index
+        NameMap m_Names;            ///< \brief Entry name -> indexes of directories containing it
+
+        cbThreadPool* m_Pool;
+        wxArrayString m_Roots;      ///< \brief Directories being scanned
+        DirMap m_Scanned;           ///< \brief Directories read by current scan
+        VisitedMap m_Visited;       ///< \brief Directory identity -> path it's indexed under (prevents link loops)
+        wxArrayString m_Dropped;    ///< \brief Aliases replaced by a smaller path, their subdirectories are dropped too
+        int m_Pending;              ///< \brief Directories queued but not read yet
+        int m_ScannedCount;
+        bool m_Stop;                ///< \brief No more directories are queued
+        wxMutex m_Mutex;
+        time_t m_ScanStart;
+};
+
+#endif
@@ -28,7 +28,12 @@
 #include <wx/filename.h>
 #include <wx/tokenzr.h>
 #include <wx/filename.h>
+#include <wx/utils.h>
 #include <prep.h>
+#include <cbthreadpool.h>
+#include <configmanager.h>
+#include <algorithm>
+#include <vector>
 
 //(*InternalHeaders(ProcessingDlg)
 #include <wx/intl.h>
@@ -85,83 +90,126 @@ void ProcessingDlg::OnButton1Click(wxCommandEvent& event)
     StopFlag = true;
 }
 
-bool ProcessingDlg::ReadDirs(const wxArrayString& Dirs)
+wxString ProcessingDlg::GetIndexFileName()
 {
-    Gauge1->SetRange(Dirs.Count());
-    for ( size_t i = 0; i<Dirs.Count(); i++ )
-    {
-        if ( StopFlag ) return false;
-        Gauge1->SetValue(i);
+    return ConfigManager::GetFolder(sdConfig) + wxFileName::GetPathSeparator() + _T("lib_finder.index");
+}
 
-        wxString DirName = Dirs[i];
-        if ( DirName.empty() ) continue;
+bool ProcessingDlg::ReadDirs(const wxArrayString& Dirs)
+{
+    Status->SetLabel(_("Loading directory index"));
+    ::wxYield();
+    wxString IndexFile = GetIndexFileName();
+    Index.Load(IndexFile);
 
-        // Cutting off last character if it is path separator
-        wxChar LastChar = DirName[DirName.Len()-1];
-        if ( wxFileName::GetPathSeparators().Find(LastChar) != -1 )
+    // Only directories changed since the index was saved are read again
+    Index.StartScan(this,Dirs);
+    while ( Index.IsScanning() )
+    {
+        if ( StopFlag )
         {
-            DirName.RemoveLast();
+            Index.StopScan();
+            return false;
         }
-
-        // Reading dir content
-        ReadDir(DirName);
+        Status->SetLabel(wxString::Format(_("Reading dirs: %d"),Index.GetScannedCount()));
+        Gauge1->Pulse();
+        ::wxYield();
+        ::wxMilliSleep(20);
     }
+
+    Index.Save(IndexFile);
     return !StopFlag;
 }
 
-void ProcessingDlg::ReadDir(const wxString& DirName)
+/** \brief Task searching for one library */
+class ProcessLibraryTask: public cbThreadedTask
 {
-    wxDir Dir(DirName);
+    public:
 
-    if ( !Dir.IsOpened() ) return;
+        ProcessLibraryTask(ProcessingDlg* Dlg,const LibraryConfig* Config,ResultArray& Found,wxMutex& Mutex,int& Done):
+            m_Dlg(Dlg),
+            m_Config(Config),
+            m_Found(Found),
+            m_Mutex(Mutex),
+            m_Done(Done)
+        {}
 
-    Status->SetLabel(_T("Reading dir: ") + DirName);
-    ::wxYield();
-    if ( StopFlag ) return;
+        int Execute()
+        {
+            if ( !TestDestroy() )
+            {
+                m_Dlg->ProcessLibrary(m_Config,m_Found);
+            }
+            wxMutexLocker Lock(m_Mutex);
+            m_Done++;
+            return 0;
+        }
+
+    private:
 
-    wxString Name;
+        ProcessingDlg* m_Dlg;
+        const LibraryConfig* m_Config;
+        ResultArray& m_Found;
+        wxMutex& m_Mutex;
+        int& m_Done;
+};
 
-    if ( Dir.GetFirst(&Name,wxEmptyString,wxDIR_FILES|wxDIR_HIDDEN) )
+bool ProcessingDlg::ProcessLibs()
+{
+    int Count = m_Manager.GetLibraryCount();
+    Gauge1->SetRange(Count);
+
+    // Each library is searched for by a separate task, the results
+    // are added in the order of library configurations later
+    std::vector<ResultArray> Found(Count);
+    wxMutex Mutex;
+    int Done = 0;
+    cbThreadPool Pool(this);
+    Pool.BatchBegin();
+    for ( int i=0; i<Count; ++i )
     {
-        do
-        {
-            Map[Name].Add(DirName + wxFileName::GetPathSeparator() + Name);
-        }
-        while ( Dir.GetNext(&Name) );
+        Pool.AddTask(new ProcessLibraryTask(this,m_Manager.GetLibrary(i),Found[i],Mutex,Done),true);
     }
+    Pool.BatchEnd();
 
-    if ( Dir.GetFirst(&Name,wxEmptyString,wxDIR_DIRS|wxDIR_HIDDEN) )
+    for ( ;; )
     {
-        do
+        int DoneNow;
         {
-            Map[Name].Add(DirName + wxFileName::GetPathSeparator() + Name);
-            ReadDir(DirName + wxFileName::GetPathSeparator() + Name);
+            wxMutexLocker Lock(Mutex);
+            DoneNow = Done;
         }
-        while ( Dir.GetNext(&Name) );
+        if ( DoneNow == Count || StopFlag ) break;
+        Status->SetLabel(wxString::Format(_("Searching libraries: %d of %d"),DoneNow,Count));
+        Gauge1->SetValue(DoneNow);
+        ::wxYield();
+        ::wxMilliSleep(20);
     }
-}
 
-bool ProcessingDlg::ProcessLibs()
-{
-    Gauge1->SetRange(m_Manager.GetLibraryCount());
+    if ( StopFlag ) Pool.AbortAllTasks();
+    while ( !Pool.Done() ) ::wxMilliSleep(1);
 
-    for ( int i=0; i<m_Manager.GetLibraryCount(); ++i )
+    for ( int i=0; i<Count; ++i )
     {
-        if ( StopFlag ) return false;
-        ProcessLibrary(m_Manager.GetLibrary(i));
+        for ( size_t j=0; j<Found[i].Count(); ++j )
+        {
+            if ( StopFlag )
+            {
+                delete Found[i][j];
+            }
+            else
+            {
+                m_FoundResults.GetShortCode(Found[i][j]->ShortCode).Add(Found[i][j]);
+            }
+        }
     }
 
     return !StopFlag;
 }
 
-void ProcessingDlg::ProcessLibrary(const LibraryConfig* Config)
+void ProcessingDlg::ProcessLibrary(const LibraryConfig* Config,ResultArray& Found)
 {
-    Status->SetLabel(
-        wxString::Format(
-            _("Searching library \"%s\""),
-            Config->ShortCode.c_str()));
-
-    CheckFilter(_T(""),wxStringStringMap(),wxArrayString(),Config,0);
+    CheckFilter(_T(""),wxStringStringMap(),wxArrayString(),Config,0,Found);
 }
 
 void ProcessingDlg::CheckFilter(
@@ -169,11 +217,12 @@ void ProcessingDlg::CheckFilter(
     const wxStringStringMap& OldVars,
     const wxArrayString& OldCompilers,
     const LibraryConfig* Config,
-    int WhichFilter)
+    int WhichFilter,
+    ResultArray& Found)
 {
     if ( (int)Config->Filters.size() <= WhichFilter )
     {
-        FoundLibrary(OldBasePath,OldVars,OldCompilers,Config);
+        FoundLibrary(OldBasePath,OldVars,OldCompilers,Config,Found);
         return;
     }
 
@@ -187,16 +236,18 @@ void ProcessingDlg::CheckFilter(
             wxArrayString Pattern;
             SplitPath(Filter.Value,Pattern);
 
-            // Fetch list of files with filename matching last pattern's element
-            const wxArrayString& PathArray = Map[Pattern[Pattern.Count()-1]];
-            if ( PathArray.empty() ) return;
+            // Fetch list of dirs containing file with name matching last pattern's element
+            const wxString& FileName = Pattern[Pattern.Count()-1];
+            const std::vector<int>* DirArray = Index.FindName(FileName);
+            if ( !DirArray ) return;
 
             // Process those files
-            for ( size_t i=0; i<PathArray.Count(); i++ )
+            for ( size_t i=0; i<DirArray->size(); i++ )
             {
                 wxArrayString Path;
                 wxStringStringMap Vars = OldVars;
-                SplitPath(PathArray[i],Path);
+                SplitPath(Index.GetDir((*DirArray)[i]),Path);
+                Path.Add(FileName);
 
                 int path_index = (int)Path.Count() - 1;
                 int pattern_index = (int)Pattern.Count() - 1;
@@ -242,7 +293,7 @@ void ProcessingDlg::CheckFilter(
                 }
 
                 // Ok, this filter matches, let's advance to next filet
-                CheckFilter(BasePath,Vars,OldCompilers,Config,WhichFilter+1);
+                CheckFilter(BasePath,Vars,OldCompilers,Config,WhichFilter+1,Found);
             }
             break;
         }
@@ -339,7 +390,7 @@ void ProcessingDlg::CheckFilter(
 
             if ( IsPlatform )
             {
-                CheckFilter(OldBasePath,OldVars,OldCompilers,Config,WhichFilter+1);
+                CheckFilter(OldBasePath,OldVars,OldCompilers,Config,WhichFilter+1,Found);
             }
             break;
         }
@@ -380,7 +431,7 @@ void ProcessingDlg::CheckFilter(
 
             if ( IsExec )
             {
-                CheckFilter(OldBasePath,OldVars,OldCompilers,Config,WhichFilter+1);
+                CheckFilter(OldBasePath,OldVars,OldCompilers,Config,WhichFilter+1,Found);
             }
             break;
         }
@@ -389,7 +440,7 @@ void ProcessingDlg::CheckFilter(
         {
             if ( m_KnownResults[rtPkgConfig].IsShortCode(Filter.Value) )
             {
-                CheckFilter(OldBasePath,OldVars,OldCompilers,Config,WhichFilter+1);
+                CheckFilter(OldBasePath,OldVars,OldCompilers,Config,WhichFilter+1,Found);
             }
             break;
         }
@@ -399,7 +450,7 @@ void ProcessingDlg::CheckFilter(
             if ( OldCompilers.IsEmpty() )
             {
                 // If this is the first compiler filter, let's build new list and continue
-                CheckFilter(OldBasePath,OldVars,wxStringTokenize(Filter.Value,_T("| \t")),Config,WhichFilter+1);
+                CheckFilter(OldBasePath,OldVars,wxStringTokenize(Filter.Value,_T("| \t")),Config,WhichFilter+1,Found);
             }
             else
             {
@@ -418,7 +469,7 @@ void ProcessingDlg::CheckFilter(
 
                 if ( !Compilers.IsEmpty() )
                 {
-                    CheckFilter(OldBasePath,OldVars,Compilers,Config,WhichFilter+1);
+                    CheckFilter(OldBasePath,OldVars,Compilers,Config,WhichFilter+1,Found);
                 }
             }
             break;
@@ -426,7 +477,7 @@ void ProcessingDlg::CheckFilter(
 
         case LibraryFilter::None:
         {
-            CheckFilter(OldBasePath,OldVars,OldCompilers,Config,WhichFilter+1);
+            CheckFilter(OldBasePath,OldVars,OldCompilers,Config,WhichFilter+1,Found);
             break;
         }
     }
@@ -448,7 +499,7 @@ bool ProcessingDlg::IsVariable(const wxString& NamePart) const
     return true;
 }
 
-void ProcessingDlg::FoundLibrary(const wxString& OldBasePath,const wxStringStringMap& OldVars,const wxArrayString& Compilers,const LibraryConfig* Config)
+void ProcessingDlg::FoundLibrary(const wxString& OldBasePath,const wxStringStringMap& OldVars,const wxArrayString& Compilers,const LibraryConfig* Config,ResultArray& Found)
 {
     wxStringStringMap Vars = OldVars;
     wxString BasePath = OldBasePath;
@@ -502,8 +553,7 @@ void ProcessingDlg::FoundLibrary(const wxString& OldBasePath,const wxStringStrin
         Result->LFlags.Add(FixVars(Config->LFlags[i],Vars));
     }
 
-    ResultArray& Array = m_FoundResults.GetShortCode(Config->ShortCode);
-    Array.Add(Result);
+    Found.Add(Result);
 }
 
 wxString ProcessingDlg::FixVars(wxString Original,const wxStringStringMap& Vars)
@@ -40,6 +40,7 @@
 #include "libraryconfigmanager.h"
 #include "resultmap.h"
 #include "pkgconfigmanager.h"
+#include "dirindex.h"
 
 WX_DECLARE_STRING_HASH_MAP(wxArrayString,FileNamesMap);
 WX_DECLARE_STRING_HASH_MAP(wxString,wxStringStringMap);
@@ -77,17 +78,19 @@ class ProcessingDlg: public wxDialog
 
 	private:
 
-        void ReadDir(const wxString& DirName);
-        void ProcessLibrary(const LibraryConfig* Config);
+        friend class ProcessLibraryTask;
+
+        void ProcessLibrary(const LibraryConfig* Config,ResultArray& Found);
         void SplitPath(const wxString& FileName,wxArrayString& Split);
         bool IsVariable(const wxString& NamePart) const;
-        void CheckFilter(const wxString& BasePath,const wxStringStringMap& Vars,const wxArrayString& CompilerList,const LibraryConfig *Config,int WhichFilter);
-        void FoundLibrary(const wxString& BasePath,const wxStringStringMap& Vars,const wxArrayString& CompilerList,const LibraryConfig *Config);
+        void CheckFilter(const wxString& BasePath,const wxStringStringMap& Vars,const wxArrayString& CompilerList,const LibraryConfig *Config,int WhichFilter,ResultArray& Found);
+        void FoundLibrary(const wxString& BasePath,const wxStringStringMap& Vars,const wxArrayString& CompilerList,const LibraryConfig *Config,ResultArray& Found);
         wxString FixVars(wxString Original,const wxStringStringMap& Vars);
         wxString FixPath(wxString Original);
+        wxString GetIndexFileName();
 
         bool StopFlag;
-        FileNamesMap Map;
+        DirIndex Index;
         LibraryConfigManager& m_Manager;
         TypedResults& m_KnownResults;
         ResultMap& m_FoundResults;
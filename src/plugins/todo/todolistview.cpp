@@ -4,11 +4,12 @@
   #include <wx/button.h>
   #include <wx/combobox.h>
   #include <wx/event.h>
-  #include <wx/file.h>
+  #include <wx/filefn.h>
   #include <wx/intl.h>
   #include <wx/listctrl.h>
   #include <wx/sizer.h>
   #include <wx/stattext.h>
+  #include <wx/strconv.h>
   #include <wx/utils.h>
 
   #include "cbeditor.h"
@@ -20,7 +21,12 @@
   #include "projectmanager.h"
   //#include "logmanager.h"
 #endif
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
 #include "cbstyledtextctrl.h"
+#include "cbthreadpool.h"
 
 #include "todolistview.h"
 
@@ -30,12 +36,300 @@ namespace
     int idSource = wxNewId();
     int idUser = wxNewId();
     int idButtonRefresh = wxNewId();
+    int idParse = wxNewId();
+
+    const size_t g_FilesPerTask = 16;
+
+    bool LongerType(const wxString& a, const wxString& b)
+    {
+        return a.Length() > b.Length();
+    }
+
+    // The todo types, indexed by their first character, so that the buffer
+    // can be scanned once for all of them. Longer types are tried first.
+    class ToDoTypeMatcher
+    {
+        public:
+            ToDoTypeMatcher(const wxArrayString& types)
+            {
+                for (size_t i = 0; i < types.GetCount(); ++i)
+                {
+                    if (!types[i].IsEmpty())
+                        m_Types.push_back(types[i]);
+                }
+                std::stable_sort(m_Types.begin(), m_Types.end(), LongerType);
+                for (size_t i = 0; i < m_Types.size(); ++i)
+                {
+                    if (m_FirstChars.Find(m_Types[i][0]) == wxNOT_FOUND)
+                        m_FirstChars << m_Types[i][0];
+                }
+            }
+
+            // the type found at text, if any
+            const wxString* Match(const wxChar* text) const
+            {
+                if (m_FirstChars.Find(*text) == wxNOT_FOUND)
+                    return 0;
+                for (size_t i = 0; i < m_Types.size(); ++i)
+                {
+                    const wxString& type = m_Types[i];
+                    if (type[0] == *text && wxStrncmp(text, type.c_str(), type.Length()) == 0)
+                        return &type;
+                }
+                return 0;
+            }
+        private:
+            vector<wxString> m_Types;
+            wxString m_FirstChars;
+    };
+
+    // is the todo starting at pos in a C or C++ comment?
+    bool InComment(const wxChar* buf, int pos, bool& isC)
+    {
+        wxChar lastChar = _T('\0');
+        for (int idx = pos - 1; idx >= 0; --idx)
+        {
+            wxChar c = buf[idx];
+            if (c != _T(' ') && c != _T('\t') && c != _T('/') && c != _T('*'))
+                break;
+            if (c == _T('/') && (lastChar == _T('/') || lastChar == _T('*')))
+            {
+                isC = lastChar == _T('*');
+                return true;
+            }
+            lastChar = c;
+        }
+        return false;
+    }
+
+    // Parses the todo item whose type ends at idx, i.e. the optional
+    // "(user#priority#)" and the text up to the end of the line or comment.
+    // Returns the position the item ends at.
+    int ParseItem(const wxChar* buf, int len, int idx, bool isC, ToDoItem& item)
+    {
+        wxChar c = _T('\0');
+
+        // skip to next non-blank char
+        while (idx < len)
+        {
+            c = buf[idx];
+            if (c != _T(' ') && c != _T('\t'))
+                break;
+            ++idx;
+        }
+        // is it ours or generic todo?
+        if (c == _T('('))
+        {
+            // it's ours, find user and/or priority
+            ++idx; // skip (
+            while (idx < len)
+            {
+                wxChar c1 = buf[idx];
+                if (c1 != _T('#') && c1 != _T(')'))
+                {
+                    // a little logic doesn't hurt ;)
+
+                    if (c1 == _T(' ') || c1 == _T('\t') || c1 == _T('\r') || c1 == _T('\n'))
+                    {
+                        // allow one consecutive space
+                        if (item.user.IsEmpty() || item.user.Last() != _T(' '))
+                            item.user << _T(' ');
+                    }
+                    else
+                        item.user << c1;
+                }
+                else if (c1 == _T('#'))
+                {
+                    // look for priority
+                    c1 = buf[++idx];
+                    if (c1 >= _T('0') && c1 <= _T('9'))
+                        item.priorityStr << c1;
+                    // skip to start of text
+                    while (idx < len)
+                    {
+                        wxChar c2 = buf[idx++];
+                        if (c2 == _T(')') || c2 == _T('\r') || c2 == _T('\n'))
+                            break;
+                    }
+                    break;
+                }
+                else
+                    break;
+                ++idx;
+            }
+        }
+        // ok, we 've reached the actual todo text :)
+        // take everything up to the end of line or end of comment (if isC)
+        wxChar lastChar = _T('\0');
+        if (idx < len && buf[idx] == _T(':'))
+            ++idx;
+        while (idx < len)
+        {
+            wxChar c1 = buf[idx++];
+            if (c1 == _T('\r') || c1 == _T('\n'))
+                break;
+            if (isC && c1 == _T('/') && lastChar == _T('*'))
+            {
+                // remove last char '*'
+                item.text.RemoveLast();
+                break;
+            }
+            if (c1 == _T(' ') || c1 == _T('\t'))
+            {
+                // allow one consecutive space
+                if (item.text.IsEmpty() || item.text.Last() != _T(' '))
+                    item.text << _T(' ');
+            }
+            else
+                item.text << c1;
+            lastChar = c1;
+        }
+        // do some clean-up
+        item.text.Trim();
+        item.text.Trim(false);
+        item.user.Trim();
+        item.user.Trim(false);
+        return idx;
+    }
+
+    // Finds the todo items of a buffer in a single pass, counting lines on the way.
+    // We look for two basic kinds of todo entries in the text;
+    // our version...
+    // TODO (mandrav#0#): Implement code to do this and the other...
+    // and a generic version...
+    // TODO: Implement code to do this and the other...
+    // The strings put in items are not shared with the buffer or the types,
+    // so they can be handed to another thread.
+    void ParseBuffer(const wxString& buffer, const wxString& filename, const ToDoTypeMatcher& matcher, vector<ToDoItem>& items)
+    {
+        const wxChar* buf = buffer.c_str();
+        const int len = (int)buffer.Length();
+        int line = 0;
+        int counted = 0;
+
+        int pos = 0;
+        while (pos < len)
+        {
+            const wxString* type = matcher.Match(buf + pos);
+            bool isC = false; // C or C++ style comment?
+            if (!type || !InComment(buf, pos, isC))
+            {
+                ++pos;
+                continue;
+            }
+
+            // count the lines up to the item ("\r\n", "\n" and "\r" all end a line)
+            for (; counted < pos; ++counted)
+            {
+                if (buf[counted] == _T('\n') || (buf[counted] == _T('\r') && buf[counted + 1] != _T('\n')))
+                    ++line;
+            }
+
+            ToDoItem item;
+            item.type = wxString(type->c_str());
+            item.filename = wxString(filename.c_str());
+            pos = ParseItem(buf, len, pos + type->Length(), isC, item);
+            item.line = line;
+            item.lineStr << wxString::Format(_T("%d"), item.line + 1); // 1-based line number for list
+            items.push_back(item);
+        }
+    }
+
+    bool ReadFile(const wxString& filename, std::vector<char>& buffer)
+    {
+        // not wxFile: it would log failures from the worker thread
+        FILE* fp = wxFopen(filename, _T("rb"));
+        if (!fp)
+            return false;
+
+        // the whole file in one read; the padding zero-terminates even UTF-16
+        buffer.clear();
+        bool ok = fseek(fp, 0, SEEK_END) == 0;
+        long size = ok ? ftell(fp) : -1;
+        if (size >= 0 && fseek(fp, 0, SEEK_SET) == 0)
+        {
+            buffer.resize(size + 2, 0);
+            size_t len = size ? fread(&buffer[0], 1, size, fp) : 0;
+            buffer.resize(len);
+            ok = !ferror(fp);
+        }
+        else
+            ok = false;
+        fclose(fp);
+        buffer.insert(buffer.end(), 2, '\0');
+        return ok;
+    }
 };
 
+/** Parses a chunk of the project files that are not open in an editor. */
+class ToDoParseTask : public cbThreadedTask
+{
+    public:
+        ToDoParseTask(ToDoListView* view, int generation, const wxArrayString& filenames, size_t first, size_t last, const wxArrayString& types)
+            : m_pView(view),
+            m_Generation(generation),
+            m_Conv(wxFONTENCODING_SYSTEM)
+        {
+            // own copies, for the worker thread (wxString isn't thread-safe)
+            for (size_t i = first; i < last; ++i)
+                m_Filenames.Add(wxString(filenames[i].c_str()));
+            for (size_t i = 0; i < types.GetCount(); ++i)
+                m_Types.Add(wxString(types[i].c_str()));
+            // create the converter here, as it may need the (global) font mapper
+            m_Conv.IsOk();
+        }
+
+        int Execute();
+    private:
+        wxString Decode(const char* data, size_t len);
+
+        ToDoListView* m_pView;
+        int m_Generation;
+        wxArrayString m_Filenames;
+        wxArrayString m_Types;
+        wxCSConv m_Conv;
+};
+
+int ToDoParseTask::Execute()
+{
+    ToDoTypeMatcher matcher(m_Types);
+    std::vector<char> buffer;
+    for (size_t i = 0; i < m_Filenames.GetCount(); ++i)
+    {
+        if (TestDestroy())
+            break;
+
+        wxStructStat st;
+        if (wxStat(m_Filenames[i], &st) != 0 || !ReadFile(m_Filenames[i], buffer))
+            continue;
+
+        vector<ToDoItem> items;
+        ParseBuffer(Decode(&buffer[0], buffer.size() - 2), m_Filenames[i], matcher, items);
+        m_pView->AddParsedFile(m_Generation, m_Filenames[i], st.st_mtime, items);
+    }
+    return 0;
+}
+
+wxString ToDoParseTask::Decode(const char* data, size_t len)
+{
+    if (len >= 2 && !memcmp(data, "\xFF\xFE", 2))
+        return wxString(data + 2, wxMBConvUTF16LE(), len - 2);
+    if (len >= 2 && !memcmp(data, "\xFE\xFF", 2))
+        return wxString(data + 2, wxMBConvUTF16BE(), len - 2);
+    if (len >= 3 && !memcmp(data, "\xEF\xBB\xBF", 3))
+        return wxString(data + 3, wxConvUTF8, len - 3);
+    wxString text(data, wxConvUTF8, len);
+    if (text.IsEmpty() && len)
+        text = wxString(data, m_Conv, len);
+    return text;
+}
+
 BEGIN_EVENT_TABLE(ToDoListView, wxEvtHandler)
     EVT_COMBOBOX(idSource, ToDoListView::OnComboChange)
     EVT_COMBOBOX(idUser, ToDoListView::OnComboChange)
     EVT_BUTTON(idButtonRefresh, ToDoListView::OnButtonRefresh)
+    EVT_THREADTASK_ENDED(idParse, ToDoListView::OnParseResults)
+    EVT_THREADTASK_ALLDONE(idParse, ToDoListView::OnParseResults)
 END_EVENT_TABLE()
 
 ToDoListView::ToDoListView(const wxArrayString& titles, const wxArrayInt& widths, const wxArrayString& m_Types)
@@ -45,7 +339,9 @@ ToDoListView::ToDoListView(const wxArrayString& titles, const wxArrayInt& widths
     m_pUser(0L),
     m_Types(m_Types),
     m_LastFile(wxEmptyString),
-    m_ignore(false)
+    m_ignore(false),
+    m_pPool(new cbThreadPool(this, idParse)),
+    m_Generation(0)
 {
     //ctor
 }
@@ -53,6 +349,10 @@ ToDoListView::ToDoListView(const wxArrayString& titles, const wxArrayInt& widths
 ToDoListView::~ToDoListView()
 {
     //dtor
+    CancelParsing();
+    while (!m_pPool->Done())
+        wxMilliSleep(1);
+    delete m_pPool;
     Manager::Get()->GetAppWindow()->RemoveEventHandler(this);
 }
 
@@ -193,6 +493,14 @@ void ToDoListView::ParseCurrent(bool forced)
             m_LastFile = filename;
             m_Items.Clear();
             ParseEditor(ed);
+
+            // just saved: the file on disk won't need parsing again
+            if (!ed->GetModified() && m_Cache.find(filename) != m_Cache.end() && wxFileExists(filename))
+            {
+                ToDoFileItems& cached = m_Cache[filename];
+                cached.modified = wxFileModificationTime(filename);
+                cached.items = m_itemsmap[filename];
+            }
         }
     }
     FillList();
@@ -204,6 +512,7 @@ void ToDoListView::Parse()
     // based on user prefs, parse files for todo items
     if(m_ignore)
         return; // Reentrancy
+    CancelParsing();
     Clear();
     m_itemsmap.clear();
     m_Items.Clear();
@@ -220,11 +529,18 @@ void ToDoListView::Parse()
         case 1: // open files
         {
             // easy too; parse all open editor files...
-            for (int i = 0; i < Manager::Get()->GetEditorManager()->GetEditorsCount(); ++i)
+            // (the tabs not loaded yet are the same as on disk)
+            EditorManager* em = Manager::Get()->GetEditorManager();
+            wxArrayString toParse;
+            for (int i = 0; i < em->GetEditorsCount(); ++i)
             {
-                cbEditor* ed = Manager::Get()->GetEditorManager()->GetBuiltinEditor(Manager::Get()->GetEditorManager()->GetEditor(i));
-                ParseEditor(ed);
+                EditorBase* eb = em->GetEditor(i);
+                if (em->IsDeferred(eb))
+                    toParse.Add(eb->GetFilename());
+                else
+                    ParseEditor(em->GetBuiltinEditor(eb));
             }
+            ParseFiles(toParse);
             break;
         }
         case 2: // all project files
@@ -235,208 +551,119 @@ void ToDoListView::Parse()
             cbProject* prj = Manager::Get()->GetProjectManager()->GetActiveProject();
             if (!prj)
                 return;
+
+            wxArrayString toParse;
             for (int i = 0; i < prj->GetFilesCount(); ++i)
             {
                 ProjectFile* pf = prj->GetFile(i);
                 wxString filename = pf->file.GetFullPath();
                 cbEditor* ed = Manager::Get()->GetEditorManager()->IsBuiltinOpen(filename);
                 if (ed)
+                {
                     ParseEditor(ed);
-                else
-                    ParseFile(filename);
+                    continue;
+                }
+                toParse.Add(filename);
             }
+            ParseFiles(toParse);
             break;
         }
     }
     FillList();
 }
 
-int ToDoListView::CalculateLineNumber(const wxString& buffer, int upTo)
+void ToDoListView::ParseFiles(const wxArrayString& filenames)
 {
-    int line = 0;
-    for (int i = 0; i < upTo; ++i)
+    if (TypesChanged())
+        m_Cache.clear();
+
+    // files unchanged since they were last parsed come from the cache,
+    // the others are read and parsed in the background
+    wxArrayString toParse;
+    for (size_t i = 0; i < filenames.GetCount(); ++i)
+    {
+        const wxString& filename = filenames[i];
+        if (!wxFileExists(filename))
+            continue;
+        TodoFileCache::iterator it = m_Cache.find(filename);
+        if (it != m_Cache.end() && it->second.modified == wxFileModificationTime(filename))
+            m_itemsmap[filename] = it->second.items;
+        else
+            toParse.Add(filename);
+    }
+
+    m_pPool->BatchBegin();
+    for (size_t first = 0; first < toParse.GetCount(); first += g_FilesPerTask)
     {
-        if (buffer.GetChar(i) == _T('\r') && buffer.GetChar(i + 1) == _T('\n')) // CR+LF
-            continue; // we 'll count on \n (next loop)
-        else if (buffer.GetChar(i) == _T('\r') || // CR only
-                buffer.GetChar(i) == _T('\n')) // lf only
-            ++line;
+        size_t last = std::min(first + g_FilesPerTask, toParse.GetCount());
+        m_pPool->AddTask(new ToDoParseTask(this, m_Generation, toParse, first, last, m_Types), true);
     }
-    return line;
+    m_pPool->BatchEnd();
 }
 
-void ToDoListView::ParseEditor(cbEditor* pEditor)
+void ToDoListView::CancelParsing()
 {
-    if (pEditor)
-        ParseBuffer(pEditor->GetControl()->GetText(), pEditor->GetFilename());
+    // running tasks stop after their current file; whatever they still report is dropped
+    m_pPool->AbortAllTasks();
+    wxMutexLocker lock(m_ParsedMutex);
+    ++m_Generation;
+    m_Parsed.clear();
 }
 
-void ToDoListView::ParseFile(const wxString& filename)
+bool ToDoListView::TypesChanged()
 {
-    if (!wxFileExists(filename))
-        return;
+    wxString types;
+    for (size_t i = 0; i < m_Types.GetCount(); ++i)
+        types << m_Types[i] << _T('\n');
+    if (types == m_CachedTypes)
+        return false;
+    m_CachedTypes = types;
+    return true;
+}
 
-    // open file
-    wxString st;
-    wxFile file(filename);
-    if(!cbRead(file,st))
+void ToDoListView::AddParsedFile(int generation, const wxString& filename, time_t modified, vector<ToDoItem>& items)
+{
+    // called from the worker threads
+    wxMutexLocker lock(m_ParsedMutex);
+    if (generation != m_Generation)
         return;
-    ParseBuffer(st, filename);
+    ToDoFileItems& parsed = m_Parsed[wxString(filename.c_str())];
+    parsed.modified = modified;
+    parsed.items.swap(items);
 }
 
-void ToDoListView::ParseBuffer(const wxString& buffer, const wxString& filename)
+void ToDoListView::OnParseResults(wxCommandEvent& event)
 {
-    // this is the actual workhorse...
-
-    // ok, we look for two basic kinds of todo entries in the text
-    // our version...
-    // TODO (mandrav#0#): Implement code to do this and the other...
-    // and a generic version...
-    // TODO: Implement code to do this and the other...
-
-    m_itemsmap[filename].clear();
-
-    for (unsigned int i = 0; i < m_Types.GetCount(); ++i)
+    TodoFileCache parsed;
     {
-//Manager::Get()->GetLogManager()->DebugLog("Looking for %s", m_Types[i].c_str());
-        int pos = buffer.find(m_Types[i], 0);
+        wxMutexLocker lock(m_ParsedMutex);
+        parsed.swap(m_Parsed);
+    }
+    if (parsed.empty())
+        return;
 
-        while (pos > 0)
+    bool changed = false;
+    for (TodoFileCache::iterator it = parsed.begin(); it != parsed.end(); ++it)
+    {
+        m_Cache[it->first] = it->second;
+        // opened in an editor meanwhile? then the editor's contents count
+        if (!Manager::Get()->GetEditorManager()->IsBuiltinOpen(it->first))
         {
-            // ok, start parsing now...
-            // keep a temp copy of pos to work with
-            int idx = pos;
-            bool isValid = false; // found it in a comment?
-            bool isC = false; // C or C++ style comment?
-
-//#warning TODO (mandrav#1#): Make viewtododlg understand and display todo notes that are compiler warnings/errors...
-
-            // first check what type of comment we have
-            wxString allowedChars = _T(" \t/*");
-            wxChar lastChar = _T('\0');
-            while (idx >= 0)
-            {
-                wxChar c = buffer.GetChar(--idx);
-                if ((int)allowedChars.Index(c) != wxNOT_FOUND)
-                {
-                    if (c == _T('/') && (lastChar == _T('/') || lastChar == _T('*')))
-                    {
-                        isValid = true;
-                        isC = lastChar == _T('*');
-                        break;
-                    }
-                }
-                else
-                    break;
-                lastChar = c;
-            }
-
-//Manager::Get()->GetLogManager()->DebugLog("Found %s %s style %s at %d", isValid ? "valid" : "invalid", isC ? "C" : "C++", m_Types[i].c_str(), pos);
-            if (isValid)
-            {
-                ToDoItem item;
-                item.type = m_Types[i];
-                item.filename = filename;
-
-                idx = pos + m_Types[i].Length();
-                wxChar c = _T('\0');
-
-//Manager::Get()->GetLogManager()->DebugLog("1");
-                // skip to next non-blank char
-                while (idx < (int)buffer.Length())
-                {
-                    c = buffer.GetChar(idx);
-                    if (c != _T(' ') && c != _T('\t'))
-                        break;
-                    ++idx;
-                }
-//Manager::Get()->GetLogManager()->DebugLog("2");
-                // is it ours or generic todo?
-                if (c == _T('('))
-                {
-                    // it's ours, find user and/or priority
-                    ++idx; // skip (
-                    while (idx < (int)buffer.Length())
-                    {
-                        wxChar c1 = buffer.GetChar(idx);
-                        if (c1 != _T('#') && c1 != _T(')'))
-                        {
-                            // a little logic doesn't hurt ;)
-
-                            if (c1 == _T(' ') || c1 == _T('\t') || c1 == _T('\r') || c1 == _T('\n'))
-                            {
-                                // allow one consecutive space
-                                if (item.user.Last() != _T(' '))
-                                    item.user << _T(' ');
-                            }
-                            else
-                                item.user << c1;
-                        }
-                        else if (c1 == _T('#'))
-                        {
-                            // look for priority
-                            c1 = buffer.GetChar(++idx);
-                            allowedChars = _T("0123456789");
-                            if ((int)allowedChars.Index(c1) != wxNOT_FOUND)
-                                item.priorityStr << c1;
-                            // skip to start of text
-                            while (idx < (int)buffer.Length())
-                            {
-                                wxChar c2 = buffer.GetChar(idx++);
-                                if (c2 == _T(')') || c2 == _T('\r') || c2 == _T('\n'))
-                                    break;
-                            }
-                            break;
-                        }
-                        else
-                            break;
-                        ++idx;
-                    }
-                }
-//Manager::Get()->GetLogManager()->DebugLog("3");
-                // ok, we 've reached the actual todo text :)
-                // take everything up to the end of line or end of comment (if isC)
-                wxChar lastChar = _T('\0');
-                if (buffer.GetChar(idx) == _T(':'))
-                    ++idx;
-                while (idx < (int)buffer.Length())
-                {
-                    wxChar c1 = buffer.GetChar(idx++);
-                    if (c1 == _T('\r') || c1 == _T('\n'))
-                        break;
-                    if (isC && c1 == _T('/') && lastChar == _T('*'))
-                    {
-                        // remove last char '*'
-                        item.text.RemoveLast();
-                        break;
-                    }
-                    if (c1 == _T(' ') || c1 == _T('\t'))
-                    {
-                        // allow one consecutive space
-                        if (item.text.IsEmpty() || item.text.Last() != _T(' '))
-                            item.text << _T(' ');
-                    }
-                    else
-                        item.text << c1;
-                    lastChar = c1;
-                }
-//Manager::Get()->GetLogManager()->DebugLog("4");
-                // do some clean-up
-                item.text.Trim();
-                item.text.Trim(false);
-                item.user.Trim();
-                item.user.Trim(false);
-                item.line = CalculateLineNumber(buffer, pos);
-                item.lineStr << wxString::Format(_T("%d"), item.line + 1); // 1-based line number for list
-                m_itemsmap[filename].push_back(item);
-                // m_Items.Add(item);
-            }
-            else
-                break; // invalid style...
-
-            pos = buffer.find(m_Types[i], idx);
+            m_itemsmap[it->first] = it->second.items;
+            changed = changed || !it->second.items.empty();
         }
-//        Manager::Get()->GetLogManager()->DebugLog("Found it at %d", pos);
+    }
+    if (changed && m_pSource->GetSelection() != 0)
+        FillList();
+}
+
+void ToDoListView::ParseEditor(cbEditor* pEditor)
+{
+    if (pEditor)
+    {
+        vector<ToDoItem>& items = m_itemsmap[pEditor->GetFilename()];
+        items.clear();
+        ParseBuffer(pEditor->GetControl()->GetText(), pEditor->GetFilename(), ToDoTypeMatcher(m_Types), items);
     }
 }
 
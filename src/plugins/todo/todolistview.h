@@ -2,6 +2,7 @@
 #define TODOLISTVIEW_H
 
 #include <wx/string.h>
+#include <wx/thread.h>
 #include "loggers.h"
 #include <vector>
 #include <map>
@@ -14,6 +15,7 @@ class wxListEvent;
 class wxComboBox;
 class wxButton;
 class wxPanel;
+class cbThreadPool;
 
 struct ToDoItem
 {
@@ -29,6 +31,15 @@ struct ToDoItem
 
 typedef map<wxString,vector<ToDoItem> > TodoItemsMap;
 
+// the items of a file on disk, as of its last modification time
+struct ToDoFileItems
+{
+    time_t modified;
+    vector<ToDoItem> items;
+};
+
+typedef map<wxString,ToDoFileItems> TodoFileCache;
+
 WX_DECLARE_OBJARRAY(ToDoItem, ToDoItems);
 
 class ToDoListView : public ListCtrlLogger, public wxEvtHandler
@@ -41,13 +52,17 @@ class ToDoListView : public ListCtrlLogger, public wxEvtHandler
         virtual wxWindow* CreateControl(wxWindow* parent);
         wxWindow* GetWindow(){ return panel; }
     private:
+        friend class ToDoParseTask;
+
         void LoadUsers();
         void FillList();
         void ParseEditor(cbEditor* pEditor);
-        void ParseFile(const wxString& filename);
-        void ParseBuffer(const wxString& buffer, const wxString& filename);
-        int CalculateLineNumber(const wxString& buffer, int upTo);
+        void ParseFiles(const wxArrayString& filenames);
+        void CancelParsing();
+        bool TypesChanged();
+        void AddParsedFile(int generation, const wxString& filename, time_t modified, vector<ToDoItem>& items);
 
+        void OnParseResults(wxCommandEvent& event);
         void OnComboChange(wxCommandEvent& event);
         void OnListItemSelected(wxCommandEvent& event);
         void OnButtonRefresh(wxCommandEvent& event);
@@ -64,6 +79,13 @@ class ToDoListView : public ListCtrlLogger, public wxEvtHandler
         wxString m_LastFile;
         bool m_ignore;
 
+        TodoFileCache m_Cache; // project files, parsed by the workers
+        wxString m_CachedTypes; // the types m_Cache was parsed for
+        cbThreadPool* m_pPool;
+        int m_Generation; // results of an older Parse() are dropped
+        TodoFileCache m_Parsed; // parsed by the workers, not yet merged
+        wxMutex m_ParsedMutex;
+
         DECLARE_EVENT_TABLE()
 };
 
@@ -79,6 +79,106 @@ const wxString g_EditorModified = _T("*");
 #define DEBUG_MARKER        4
 #define DEBUG_STYLE         wxSCI_MARK_ARROW
 
+namespace
+{
+    // files are converted to UTF-8 in pieces of this size (in bytes)
+    const size_t loadChunkSize = 1024 * 1024;
+
+    bool IsASCII(const wxByte* data, size_t len)
+    {
+        for (size_t i = 0; i < len; ++i)
+        {
+            if (data[i] & 0x80)
+                return false;
+        }
+        return true;
+    }
+
+    // EncodingDetector stops at the first multi-byte sequence: this checks them all,
+    // rejecting what wxConvUTF8 wouldn't convert back (overlong forms, surrogates)
+    bool IsValidUTF8(const wxByte* data, size_t len)
+    {
+        size_t i = 0;
+        while (i < len)
+        {
+            const wxByte b = data[i];
+            if (b < 0x80)
+            {
+                ++i;
+                continue;
+            }
+
+            size_t tail;
+            wxByte min = 0x80;
+            wxByte max = 0xBF;
+            if (b >= 0xC2 && b <= 0xDF)
+                tail = 1;
+            else if (b >= 0xE0 && b <= 0xEF)
+            {
+                tail = 2;
+                if (b == 0xE0)
+                    min = 0xA0;
+                else if (b == 0xED)
+                    max = 0x9F;
+            }
+            else if (b >= 0xF0 && b <= 0xF4)
+            {
+                tail = 3;
+                if (b == 0xF0)
+                    min = 0x90;
+                else if (b == 0xF4)
+                    max = 0x8F;
+            }
+            else
+                return false;
+
+            if (i + tail >= len || data[i + 1] < min || data[i + 1] > max)
+                return false;
+            for (size_t j = 2; j <= tail; ++j)
+            {
+                if ((data[i + j] & 0xC0) != 0x80)
+                    return false;
+            }
+            i += tail + 1;
+        }
+        return true;
+    }
+
+    // one byte per character, ASCII included
+    bool IsSingleByteEncoding(wxFontEncoding encoding)
+    {
+        return (encoding >= wxFONTENCODING_ISO8859_1 && encoding <= wxFONTENCODING_ISO8859_15) ||
+               (encoding >= wxFONTENCODING_CP1250 && encoding <= wxFONTENCODING_CP1257) ||
+               encoding == wxFONTENCODING_KOI8 || encoding == wxFONTENCODING_KOI8_U ||
+               encoding == wxFONTENCODING_CP437 || encoding == wxFONTENCODING_CP850 ||
+               encoding == wxFONTENCODING_CP852 || encoding == wxFONTENCODING_CP855 ||
+               encoding == wxFONTENCODING_CP866;
+    }
+
+    bool IsUnicodeEncoding(wxFontEncoding encoding)
+    {
+        return encoding == wxFONTENCODING_UTF16LE || encoding == wxFONTENCODING_UTF16BE ||
+               encoding == wxFONTENCODING_UTF32LE || encoding == wxFONTENCODING_UTF32BE;
+    }
+
+    // the length of the next piece to convert, not splitting a character in two
+    size_t GetChunkLength(const wxByte* data, size_t len, wxFontEncoding encoding)
+    {
+        if (len <= loadChunkSize)
+            return len;
+
+        size_t chunk = loadChunkSize; // a multiple of 4, fine for UTF-32 too
+        if (encoding == wxFONTENCODING_UTF16LE || encoding == wxFONTENCODING_UTF16BE)
+        {
+            // don't split a surrogate pair
+            const wxByte high = data[encoding == wxFONTENCODING_UTF16LE ? chunk - 1 : chunk - 2];
+            if (high >= 0xD8 && high <= 0xDB)
+                chunk -= 2;
+        }
+        return chunk;
+    }
+}
+
 
 
 /* This struct holds private data for the cbEditor class.
@@ -115,13 +215,14 @@ struct cbEditorInternalData
         m_useByteOrderMark(false),
         m_byteOrderMarkLength(0),
         m_lineNumbersWidth(0),
-        m_pFileLoader(fileLoader)
+        m_pFileLoader(fileLoader),
+        m_LargeFile(false)
     {
         m_encoding = wxLocale::GetSystemEncoding();
 
         if (m_pFileLoader)
         {
-            EncodingDetector enc(fileLoader);
+            EncodingDetector enc(fileLoader, false);
             if (enc.IsOK())
             {
                 m_byteOrderMarkLength = enc.GetBOMSizeInBytes();
@@ -315,6 +416,69 @@ struct cbEditorInternalData
 #endif // #if !defined(CA_BUILD_WITHOUT_WXSCINTILLA) 
     }
 
+    /** Files bigger than /large_file_size MB (zero for no limit) are opened
+      * without folding, line wrapping and syntax highlighting, which would all
+      * go through the whole document. */
+    static bool IsLargeFile(size_t length)
+    {
+        int limit = Manager::Get()->GetConfigManager(_T("editor"))->ReadInt(_T("/large_file_size"), 16);
+        return limit > 0 && length > (size_t)limit * 1024 * 1024;
+    }
+
+#if !defined(CA_BUILD_WITHOUT_WXSCINTILLA) 
+    void ApplyLargeFileMode(cbStyledTextCtrl* control)
+    {
+        if (!control)
+            return;
+        control->SetWrapMode(wxSCI_WRAP_NONE);
+        control->SetProperty(_T("fold"), _T("0"));
+        control->SetMarginWidth(2, 0);
+    }
+
+    /** Put the file's contents (without BOM) in the empty editor.
+      * UTF-8 and plain ASCII go in as they are, since Scintilla stores UTF-8 too.
+      * Single-byte and UTF-16/32 encodings are converted to UTF-8 piece by piece.
+      * @return False if the contents are left for the caller to convert,
+      * i.e. other encodings or if the conversion failed. */
+    bool LoadText(const wxByte* data, size_t len, wxFontEncoding encoding)
+    {
+        cbStyledTextCtrl* control = m_pOwner->m_pControl;
+        if (!data || len == 0)
+            return true;
+
+        control->Allocate(len);
+        if (encoding == wxFONTENCODING_UTF8 ? IsValidUTF8(data, len)
+                                            : IsSingleByteEncoding(encoding) && IsASCII(data, len))
+        {
+            control->AppendTextRaw((const char*)data, len);
+            return true;
+        }
+        if (!IsSingleByteEncoding(encoding) && !IsUnicodeEncoding(encoding))
+            return false;
+
+        wxCSConv conv(encoding);
+        while (len > 0)
+        {
+            size_t chunk = GetChunkLength(data, len, encoding);
+            size_t wideLen = 0;
+            wxWCharBuffer wideBuff = conv.cMB2WC((const char*)data, chunk, &wideLen);
+            size_t utf8Len = 0;
+            wxCharBuffer utf8Buff;
+            if (wideBuff && wideLen > 0)
+                utf8Buff = wxConvUTF8.cWC2MB(wideBuff, wideLen, &utf8Len);
+            if (!utf8Buff)
+            {
+                control->ClearAll();
+                return false;
+            }
+            control->AppendTextRaw(utf8Buff, utf8Len);
+            data += chunk;
+            len -= chunk;
+        }
+        return true;
+    }
+#endif // #if !defined(CA_BUILD_WITHOUT_WXSCINTILLA) 
+
     //vars
     bool m_strip_trailing_spaces;
     bool m_ensure_final_line_end;
@@ -334,6 +498,7 @@ struct cbEditorInternalData
 
     LoaderBase* m_pFileLoader;
 
+    bool m_LargeFile;
 };
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -944,6 +1109,12 @@ void cbEditor::SetEditorStyleBeforeFileOpen()
 #if !defined(CA_BUILD_WITHOUT_WXSCINTILLA) 
     if (m_pControl2)
         InternalSetEditorStyleBeforeFileOpen(m_pControl2);
+
+    if (m_pData->m_LargeFile)
+    {
+        m_pData->ApplyLargeFileMode(m_pControl);
+        m_pData->ApplyLargeFileMode(m_pControl2);
+    }
 #endif // #if !defined(CA_BUILD_WITHOUT_WXSCINTILLA) 
 
     SetLanguage( HL_AUTO );
@@ -1239,7 +1410,15 @@ void cbEditor::DetectEncoding( )
 void cbEditor::SetLanguage( HighlightLanguage lang )
 {
 #if !defined(CA_BUILD_WITHOUT_WXSCINTILLA) 
-    if (m_pTheme)
+    if (m_pTheme && m_pData && m_pData->m_LargeFile && lang == HL_AUTO)
+    {
+        // no lexer: it would style the whole file (choosing a language still works)
+        m_lang = m_pTheme->Apply(this, HL_NONE);
+        m_pControl->SetLexer(wxSCI_LEX_NULL);
+        if (m_pControl2)
+            m_pControl2->SetLexer(wxSCI_LEX_NULL);
+    }
+    else if (m_pTheme)
     {
         m_lang = m_pTheme->Apply(this, lang);
     }
@@ -1266,7 +1445,6 @@ bool cbEditor::Open(bool detectEncoding)
 
     // open file
     m_pControl->SetReadOnly(false);
-    wxString st;
 
     m_pControl->ClearAll();
     m_pControl->SetModEventMask(0);
@@ -1279,17 +1457,39 @@ bool cbEditor::Open(bool detectEncoding)
         m_pData->m_pFileLoader = Manager::Get()->GetFileManager()->Load(m_Filename);
     }
 
-    EncodingDetector enc((wxByte*)m_pData->m_pFileLoader->GetData(), m_pData->m_pFileLoader->GetLength());
-    st = enc.GetWxStr();
+    const wxByte* data = (const wxByte*)m_pData->m_pFileLoader->GetData();
+    size_t length = m_pData->m_pFileLoader->GetLength();
+
+    bool largeFile = cbEditorInternalData::IsLargeFile(length);
+    if (largeFile != m_pData->m_LargeFile)
+    {
+        m_pData->m_LargeFile = largeFile;
+        SetEditorStyleBeforeFileOpen(); // (un)do the large file mode before the text goes in
+    }
+
+    EncodingDetector enc(data, length, false);
+    wxFontEncoding encoding = enc.GetFontEncoding();
+    int bomLength = enc.GetBOMSizeInBytes();
+
+    // the undo history would be one more copy of the file
+    m_pControl->SetUndoCollection(false);
+    if (!m_pData->LoadText(data + bomLength, length - bomLength, encoding))
+    {
+        // convert it at once, the detector falls back to another encoding if needed
+        EncodingDetector conv(data, length);
+        encoding = conv.GetFontEncoding();
+        m_pControl->InsertText(0, conv.GetWxStr());
+    }
+    m_pControl->SetUndoCollection(true);
+    m_pControl->EmptyUndoBuffer();
+
     if (detectEncoding)
     {
-        SetEncoding(enc.GetFontEncoding());
-        m_pData->m_byteOrderMarkLength = enc.GetBOMSizeInBytes();
+        SetEncoding(encoding);
+        m_pData->m_byteOrderMarkLength = bomLength;
         SetUseBom(m_pData->m_byteOrderMarkLength > 0);
     }
 
-    m_pControl->InsertText(0, st);
-    m_pControl->EmptyUndoBuffer();
     m_pControl->SetModEventMask(wxSCI_MODEVENTMASKALL);
 
     // mark the file read-only, if applicable
@@ -1297,7 +1497,7 @@ bool cbEditor::Open(bool detectEncoding)
     m_pControl->SetReadOnly(read_only);
     SetLanguage(HL_AUTO);
 
-    if (Manager::Get()->GetConfigManager(_T("editor"))->ReadBool(_T("/folding/fold_all_on_open"), false))
+    if (!m_pData->m_LargeFile && Manager::Get()->GetConfigManager(_T("editor"))->ReadBool(_T("/folding/fold_all_on_open"), false))
         FoldAll();
 
     wxFileName fname(m_Filename);
@@ -57,6 +57,7 @@
 #include "infowindow.h"
 
 #include "projectoptionsdlg.h"
+#include "projectsnapshot.h"
 #include "projectloader.h"
 #include "projectlayoutloader.h"
 #include "selecttargetdlg.h"
@@ -70,7 +71,7 @@ namespace compatibility { typedef TernaryCondTypedef<wxMinimumVersion<2,5>::eval
 
 
 // class constructor
-cbProject::cbProject(const wxString& filename)
+cbProject::cbProject(const wxString& filename, TiXmlDocument* doc)
     : m_CustomMakefile(false),
     m_Loaded(false),
     m_CurrentlyLoading(false),
@@ -89,7 +90,7 @@ cbProject::cbProject(const wxString& filename)
         // existing project
         m_Filename = filename;
         m_BasePath = GetBasePath();
-        Open();
+        Open(doc);
     }
     else
     {
@@ -250,9 +251,9 @@ void cbProject::ClearAllProperties()
 {
     Delete(m_pExtensionsElement);
 
-    m_Files.DeleteContents(true);
+    for (FilesList::iterator it = m_Files.begin(); it != m_Files.end(); ++it)
+        delete *it;
     m_Files.Clear();
-    m_Files.DeleteContents(false);
     m_CompilerOptions.Clear();
     m_LinkerOptions.Clear();
     m_IncludeDirs.Clear();
@@ -269,7 +270,7 @@ void cbProject::ClearAllProperties()
     NotifyPlugins(cbEVT_BUILDTARGET_SELECTED);
 }
 
-void cbProject::Open()
+void cbProject::Open(TiXmlDocument* doc)
 {
     m_Loaded = false;
     m_ProjectFilesMap.clear();
@@ -292,7 +293,10 @@ void cbProject::Open()
         Manager::Get()->GetLogManager()->Log(_("Opening ") + m_Filename);
         m_CurrentlyLoading = true;
         ProjectLoader loader(this);
-        m_Loaded = loader.Open(m_Filename, &m_pExtensionsElement);
+        if (doc)
+            m_Loaded = loader.Open(m_Filename, doc, &m_pExtensionsElement);
+        else
+            m_Loaded = loader.Open(m_Filename, &m_pExtensionsElement);
         fileUpgraded = loader.FileUpgraded();
         fileModified = loader.FileModified();
         m_CurrentlyLoading = false;
@@ -337,9 +341,9 @@ void cbProject::CalculateCommonTopLevelPath()
     // this loop takes ~30ms for 1000 project files
     // it's as fast as it can get, considered that it used to take ~1200ms ;)
     // don't even bother making it faster - you can't :)
-    for (FilesList::Node* node = m_Files.GetFirst(); node; node = node->GetNext())
+    for (FilesList::iterator it = m_Files.begin(); it != m_Files.end(); ++it)
     {
-        ProjectFile* f = node->GetData();
+        ProjectFile* f = *it;
         wxString tmp = f->relativeFilename;
         wxString tmpbase = m_BasePath;
 
@@ -466,12 +470,11 @@ bool cbProject::LoadLayout()
         Manager::Get()->GetEditorManager()->HideNotebook();
         if(openmode == 0) // Open all files
         {
-            FilesList::Node* node = m_Files.GetFirst();
-            while(node)
+            // the files are loaded when their tabs are used
+            for (FilesList::iterator it = m_Files.begin(); it != m_Files.end(); ++it)
             {
-                ProjectFile* f = node->GetData();
-                Manager::Get()->GetEditorManager()->Open(f->file.GetFullPath(),0,f);
-                node = node->GetNext();
+                ProjectFile* f = *it;
+                Manager::Get()->GetEditorManager()->OpenDeferred(f->file.GetFullPath(), f);
             }
             result = true;
         }
@@ -486,29 +489,17 @@ bool cbProject::LoadLayout()
                 open_files_map open_files;
 
                 // Get all files to open and sort them according to their tab-position:
-                FilesList::Node* node = m_Files.GetFirst();
-                while(node)
+                for (FilesList::iterator it = m_Files.begin(); it != m_Files.end(); ++it)
                 {
-                    ProjectFile* f = node->GetData();
+                    ProjectFile* f = *it;
                     if (f->editorOpen)
                         open_files[f->editorTabPos] = f;
-                    node = node->GetNext();
                 }
 
-                // Load all requested files
-                std::vector<LoaderBase*> filesInMemory;
-                for (open_files_map::iterator it = open_files.begin(); it != open_files.end(); ++it)
-                {
-                    filesInMemory.push_back(Manager::Get()->GetFileManager()->Load((*it).second->file.GetFullPath()));
-                }
-                // Open all requested files:
-                size_t i = 0;
+                // Open all requested files: only the tabs the user looks at are loaded
                 for (open_files_map::iterator it = open_files.begin(); it != open_files.end(); ++it)
                 {
-                    cbEditor* ed = Manager::Get()->GetEditorManager()->Open(filesInMemory[i], (*it).second->file.GetFullPath(),0,(*it).second);
-                    if (ed)
-                        ed->SetProjectFile((*it).second);
-                    ++i;
+                    Manager::Get()->GetEditorManager()->OpenDeferred((*it).second->file.GetFullPath(), (*it).second);
                 }
 
                 ProjectFile* f = loader.GetTopProjectFile();
@@ -792,6 +783,54 @@ ProjectFile* cbProject::AddFile(int targetIndex, const wxString& filename, bool
     return f;
 }
 
+ProjectFile* cbProject::AddFile(const ProjectFileState& state)
+{
+    // quick test
+    ProjectFile* f = m_ProjectFilesMap[state.relativeFilename];
+    if (f)
+        return f;
+
+    if (!m_Targets.GetCount())
+    {
+        // no targets in project; add default
+        AddDefaultBuildTarget();
+        if (!m_Targets.GetCount())
+            return 0L; // if that failed, fail addition of file...
+    }
+
+    // what AddFile(-1, ...) works out from the file's name, the compilers and the base path
+    f = new ProjectFile(this);
+    f->compilerVar = state.compilerVar;
+    f->compile = state.compile;
+    f->link = state.link;
+    f->file.Assign(state.fullFilename);
+    f->relativeFilename = state.relativeFilename;
+
+    wxString fullFilename = state.fullFilename;
+    m_Files.Append(f);
+    if (!m_CurrentlyLoading)
+    {
+        // check if we really need to recalculate the common top-level path for the project
+        if (!fullFilename.StartsWith(m_CommonTopLevelPath))
+            CalculateCommonTopLevelPath();
+        else
+        {
+            // set f->relativeToCommonTopLevelPath
+            f->relativeToCommonTopLevelPath = fullFilename.Right(fullFilename.Length() - m_CommonTopLevelPath.Length());
+        }
+    }
+    SetModified(true);
+    m_ProjectFilesMap[UnixFilename(f->relativeFilename)] = f; // add to hashmap
+
+    // whether the file exists isn't cached
+    if (!wxFileExists(fullFilename))
+        f->SetFileState(fvsMissing);
+    else if (!wxFile::Access(fullFilename.c_str(), wxFile::write)) // readonly
+        f->SetFileState(fvsReadOnly);
+
+    return f;
+}
+
 bool cbProject::RemoveFile(ProjectFile* pf)
 {
     if (!pf)
@@ -799,15 +838,8 @@ bool cbProject::RemoveFile(ProjectFile* pf)
     m_ProjectFilesMap.erase(UnixFilename(pf->relativeFilename)); // remove from hashmap
     Manager::Get()->GetEditorManager()->Close(pf->file.GetFullPath());
 
-    FilesList::Node* node = m_Files.Find(pf);
-    if (!node)
-    {
+    if (!m_Files.DeleteObject(pf))
         Manager::Get()->GetLogManager()->DebugLog(_T("Can't locate node for ProjectFile* !"));
-    }
-    else
-    {
-        m_Files.DeleteNode(node);
-    }
 
     // remove this file from all targets too
     for (unsigned int i = 0; i < m_Targets.GetCount(); ++i)
@@ -847,9 +879,9 @@ bool cbProject::RemoveFile(int index)
     return RemoveFile(f);
 }
 
-int filesSort(const ProjectFile** arg1, const ProjectFile** arg2)
+static bool filesSort(const ProjectFile* arg1, const ProjectFile* arg2)
 {
-    return (*arg1)->file.GetFullPath().CompareTo((*arg2)->file.GetFullPath());
+    return arg1->file.GetFullPath().CompareTo(arg2->file.GetFullPath()) < 0;
 }
 
 void cbProject::BuildTree(wxTreeCtrl* tree, const wxTreeItemId& root, bool categorize, bool useFolders, FilesGroupsAndMasks* fgam)
@@ -899,9 +931,9 @@ void cbProject::BuildTree(wxTreeCtrl* tree, const wxTreeItemId& root, bool categ
 
     // iterate all project files and add them to the tree
     int count = 0;
-    for (FilesList::Node* node = m_Files.GetFirst(); node; node = node->GetNext())
+    for (FilesList::iterator it = m_Files.begin(); it != m_Files.end(); ++it)
     {
-        ProjectFile* f = node->GetData();
+        ProjectFile* f = *it;
         ftd = new FileTreeData(this, FileTreeData::ftdkFile);
         ftd->SetFileIndex(count++);
         ftd->SetProjectFile(f);
@@ -1299,9 +1331,9 @@ void cbProject::VirtualFolderDeleted(wxTreeCtrl* tree, wxTreeItemId node)
     wxString parent_foldername = GetRelativeFolderPath(tree, tree->GetItemParent(node));
 
     // now loop all project files and remove them from this virtual folder
-    for (FilesList::Node* node = m_Files.GetFirst(); node; node = node->GetNext())
+    for (FilesList::iterator it = m_Files.begin(); it != m_Files.end(); ++it)
     {
-        ProjectFile* f = node->GetData();
+        ProjectFile* f = *it;
         if (f && !f->virtual_path.IsEmpty())
         {
             if (f->virtual_path.StartsWith(foldername)) // need 2 checks because of last separator
@@ -1371,9 +1403,9 @@ bool cbProject::VirtualFolderRenamed(wxTreeCtrl* tree, wxTreeItemId node, const
         m_VirtualFolders.Add(new_foldername);
 
     // now loop all project files and rename this virtual folder
-    for (FilesList::Node* node = m_Files.GetFirst(); node; node = node->GetNext())
+    for (FilesList::iterator it = m_Files.begin(); it != m_Files.end(); ++it)
     {
-        ProjectFile* f = node->GetData();
+        ProjectFile* f = *it;
         if (f && !f->virtual_path.IsEmpty())
         {
             if (f->virtual_path.StartsWith(old_foldername))
@@ -1423,11 +1455,9 @@ const wxString& cbProject::GetMakefile()
 
 ProjectFile* cbProject::GetFile(int index)
 {
-    FilesList::Node* node = m_Files.Item(index);
-    if (node)
-        return node->GetData();
-
-    return NULL;
+    if (index < 0 || index >= (int)m_Files.GetCount())
+        return NULL;
+    return m_Files[index];
 }
 
 ProjectFile* cbProject::GetFileByFilename(const wxString& filename, bool isRelative, bool isUnixFilename)
@@ -1460,18 +1490,15 @@ ProjectFile* cbProject::GetFileByFilename(const wxString& filename, bool isRelat
 
 bool cbProject::QueryCloseAllFiles()
 {
-    FilesList::Node* node;
-    node = m_Files.GetFirst();
-    while(node)
+    for (FilesList::iterator it = m_Files.begin(); it != m_Files.end(); ++it)
     {
-        ProjectFile* f = node->GetData();
+        ProjectFile* f = *it;
         cbEditor* ed = Manager::Get()->GetEditorManager()->IsBuiltinOpen(f->file.GetFullPath());
         if (ed && ed->GetModified())
         {
             if (!Manager::Get()->GetEditorManager()->QueryClose(ed))
                 return false;
         }
-        node = node->GetNext();
     }
     return true;
 }
@@ -1486,15 +1513,13 @@ bool cbProject::CloseAllFiles(bool dontsave)
 
     // now free the rest of the project files
     Manager::Get()->GetEditorManager()->HideNotebook();
-    FilesList::Node* node = m_Files.GetFirst();
-    while(node)
+    for (FilesList::iterator it = m_Files.begin(); it != m_Files.end(); ++it)
     {
-        ProjectFile* f = node->GetData();
+        ProjectFile* f = *it;
         Manager::Get()->GetEditorManager()->Close(f->file.GetFullPath(),true);
         delete f;
-        delete node;
-        node = m_Files.GetFirst();
     }
+    m_Files.Clear();
     Manager::Get()->GetEditorManager()->ShowNotebook();
     return true;
 }
@@ -1502,13 +1527,11 @@ bool cbProject::CloseAllFiles(bool dontsave)
 bool cbProject::SaveAllFiles()
 {
     int count = m_Files.GetCount();
-    FilesList::Node* node = m_Files.GetFirst();
-    while(node)
+    for (FilesList::iterator it = m_Files.begin(); it != m_Files.end(); ++it)
     {
-        ProjectFile* f = node->GetData();
+        ProjectFile* f = *it;
         if (Manager::Get()->GetEditorManager()->Save(f->file.GetFullPath()))
             --count;
-        node = node->GetNext();
     }
     return count == 0;
 }
@@ -1520,13 +1543,8 @@ bool cbProject::ShowOptions()
     if (dlg.ShowModal() == wxID_OK)
     {
         // update file details
-        FilesList::Node* node = m_Files.GetFirst();
-        while(node)
-        {
-            ProjectFile* f = node->GetData();
-            f->UpdateFileDetails();
-            node = node->GetNext();
-        }
+        for (FilesList::iterator it = m_Files.begin(); it != m_Files.end(); ++it)
+            (*it)->UpdateFileDetails();
         return true;
     }
     return false;
@@ -1630,11 +1648,9 @@ ProjectBuildTarget* cbProject::DuplicateBuildTarget(int index, const wxString& n
         wxString newTargetName = !newName.IsEmpty() ? newName : (_("Copy of ") + target->GetTitle());
         newTarget->SetTitle(newTargetName);
         // just notify the files of this target that they belong to the new target too
-        for (FilesList::Node* it = newTarget->GetFilesList().GetFirst(); it; it = it->GetNext())
-        {
-            ProjectFile* pf = it->GetData();
-            pf->AddBuildTarget(newTargetName);
-        }
+        FilesList& files = newTarget->GetFilesList();
+        for (FilesList::iterator it = files.begin(); it != files.end(); ++it)
+            (*it)->AddBuildTarget(newTargetName);
         SetModified(true);
         m_Targets.Add(newTarget);
         NotifyPlugins(cbEVT_BUILDTARGET_ADDED, newName);
@@ -2004,9 +2020,9 @@ void cbProject::SetExtendedObjectNamesGeneration(bool ext)
 
     if (changed)
     {
-        for (FilesList::Node* node = m_Files.GetFirst(); node; node = node->GetNext())
+        for (FilesList::iterator it = m_Files.begin(); it != m_Files.end(); ++it)
         {
-            ProjectFile* f = node->GetData();
+            ProjectFile* f = *it;
             f->SetObjName(f->relativeToCommonTopLevelPath);
             f->UpdateFileDetails();
         }
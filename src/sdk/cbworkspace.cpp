@@ -104,6 +104,8 @@ void cbWorkspace::Load()
     }
 
     m_Filename.SetExt(FileFilters::WORKSPACE_EXT);
+    if (m_Filename.FileExists())
+        m_LastModified = m_Filename.GetModificationTime();
     SetModified(false);
 }
 
@@ -118,6 +120,8 @@ bool cbWorkspace::Save(bool force)
     Manager::Get()->GetLogManager()->DebugLog(F(_T("Saving workspace \"%s\""), m_Filename.GetFullPath().wx_str()));
     WorkspaceLoader wsp;
     bool ret = wsp.Save(m_Title, m_Filename.GetFullPath());
+    if (ret)
+        m_LastModified = m_Filename.GetModificationTime();
     SetModified(!ret);
     if(!ret)
         cbMessageBox(_("Couldn't save workspace ") + m_Filename.GetFullPath() + _("\n(Maybe the file is write-protected?)"), _("Warning"), wxICON_WARNING);
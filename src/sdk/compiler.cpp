@@ -45,6 +45,152 @@ const wxString Compiler::FilePathWithSpaces = _T("[][{}() \t#%$~A-Za-z0-9_:+/\\.
 // use his own settings or the new defaults
 const wxString CompilerSettingsVersion = _T("0.0.2");
 
+namespace
+{
+    void FlushLiteralRun(wxString& run, wxArrayString& runs)
+    {
+        if (!run.IsEmpty())
+            runs.Add(run);
+        run.Clear();
+    }
+
+    // Returns the longest literal string that any line matched by 'pattern' must contain,
+    // or an empty string if none could be determined.
+    // It is used as a cheap prefilter before running the regex on a compiler output line,
+    // so it has to be conservative: anything not understood yields an empty string.
+    wxString GetRequiredLiteral(const wxString& pattern)
+    {
+        wxArrayString runs; // required literal runs found so far
+        std::vector<size_t> groups; // runs.GetCount() at each open '('
+        wxString run;
+        bool lastWasLiteral = false; // is the last char of 'run' a single (quantifiable) atom?
+
+        const size_t len = pattern.Length();
+        size_t i = 0;
+        while (i < len)
+        {
+            const wxChar ch = pattern[i];
+            if (ch == _T('|'))
+                return wxEmptyString; // alternation: nothing is really required
+            else if (ch == _T('('))
+            {
+                if (i + 1 < len && pattern[i + 1] == _T('?'))
+                    return wxEmptyString; // special (?...) constructs
+                FlushLiteralRun(run, runs);
+                groups.push_back(runs.GetCount());
+                lastWasLiteral = false;
+                ++i;
+            }
+            else if (ch == _T(')'))
+            {
+                if (groups.empty())
+                    return wxEmptyString;
+                FlushLiteralRun(run, runs);
+                size_t start = groups.back();
+                groups.pop_back();
+                ++i;
+                // an optional group doesn't contribute anything
+                if (i < len && (pattern[i] == _T('?') || pattern[i] == _T('*') || pattern[i] == _T('{')))
+                {
+                    while (runs.GetCount() > start)
+                        runs.RemoveAt(runs.GetCount() - 1);
+                }
+                lastWasLiteral = false;
+            }
+            else if (ch == _T('['))
+            {
+                // skip the bracket expression
+                size_t j = i + 1;
+                if (j < len && pattern[j] == _T('^'))
+                    ++j;
+                if (j < len && pattern[j] == _T(']'))
+                    ++j;
+                while (j < len && pattern[j] != _T(']'))
+                {
+                    if (pattern[j] == _T('[') && j + 1 < len &&
+                        (pattern[j + 1] == _T(':') || pattern[j + 1] == _T('.') || pattern[j + 1] == _T('=')))
+                    {
+                        // [:class:], [.coll.] or [=equiv=]
+                        int end = pattern.Mid(j + 2).Find(wxString(pattern[j + 1]) + _T("]"));
+                        if (end == wxNOT_FOUND)
+                            return wxEmptyString;
+                        j += 2 + end + 2;
+                    }
+                    else if (pattern[j] == _T('\\'))
+                    {
+                        if (j + 1 >= len || pattern[j + 1] == _T(']'))
+                            return wxEmptyString; // ambiguous between ERE and ARE
+                        j += 2;
+                    }
+                    else
+                        ++j;
+                }
+                if (j >= len)
+                    return wxEmptyString;
+                FlushLiteralRun(run, runs);
+                lastWasLiteral = false;
+                i = j + 1;
+            }
+            else if (ch == _T('?') || ch == _T('*') || ch == _T('{'))
+            {
+                // the previous atom is optional
+                if (lastWasLiteral && !run.IsEmpty())
+                    run.RemoveLast();
+                FlushLiteralRun(run, runs);
+                lastWasLiteral = false;
+                if (ch == _T('{'))
+                {
+                    int end = pattern.Mid(i).Find(_T('}'));
+                    if (end == wxNOT_FOUND)
+                        return wxEmptyString;
+                    i += end;
+                }
+                ++i;
+            }
+            else if (ch == _T('+') || ch == _T('.') || ch == _T('^') || ch == _T('$'))
+            {
+                FlushLiteralRun(run, runs);
+                lastWasLiteral = false;
+                ++i;
+            }
+            else if (ch == _T('\\'))
+            {
+                if (i + 1 >= len)
+                    return wxEmptyString;
+                if (wxIsalnum(pattern[i + 1]))
+                {
+                    // class shorthands, back-references, etc
+                    FlushLiteralRun(run, runs);
+                    lastWasLiteral = false;
+                }
+                else
+                {
+                    run << pattern[i + 1];
+                    lastWasLiteral = true;
+                }
+                i += 2;
+            }
+            else
+            {
+                run << ch;
+                lastWasLiteral = true;
+                ++i;
+            }
+        }
+        if (!groups.empty())
+            return wxEmptyString;
+        FlushLiteralRun(run, runs);
+
+        wxString longest;
+        for (size_t n = 0; n < runs.GetCount(); ++n)
+        {
+            if (runs[n].Length() > longest.Length())
+                longest = runs[n];
+        }
+        return longest;
+    }
+}
+
 CompilerSwitches::CompilerSwitches()
 {   // default based upon gnu
     includeDirs = _T("-I");
@@ -143,6 +289,7 @@ Compiler::~Compiler()
 {
     //dtor
     delete m_pGenerator;
+    ClearCompiledRegExes();
 }
 
 bool Compiler::IsValid()
@@ -702,18 +849,62 @@ void Compiler::LoadSettings(const wxString& baseKey)
     }
 }
 
+void Compiler::SyncCompiledRegExes()
+{
+    while (m_CompiledRegExes.size() > m_RegExes.GetCount())
+    {
+        delete m_CompiledRegExes.back().regex;
+        m_CompiledRegExes.pop_back();
+    }
+
+    for (size_t i = 0; i < m_RegExes.GetCount(); ++i)
+    {
+        if (i == m_CompiledRegExes.size())
+        {
+            CompiledRegEx cre;
+            cre.regex = 0;
+            m_CompiledRegExes.push_back(cre);
+        }
+
+        CompiledRegEx& cre = m_CompiledRegExes[i];
+        const wxString& pattern = m_RegExes[i].regex;
+        if (cre.pattern == pattern && (cre.regex || pattern.IsEmpty()))
+            continue; // up-to-date
+
+        delete cre.regex;
+        cre.regex = 0;
+        cre.pattern = pattern;
+        cre.literal = GetRequiredLiteral(pattern);
+        if (!pattern.IsEmpty())
+            cre.regex = new wxRegEx(pattern);
+    }
+}
+
+void Compiler::ClearCompiledRegExes()
+{
+    for (size_t i = 0; i < m_CompiledRegExes.size(); ++i)
+        delete m_CompiledRegExes[i].regex;
+    m_CompiledRegExes.clear();
+}
+
 CompilerLineType Compiler::CheckForWarningsAndErrors(const wxString& line)
 {
     m_ErrorFilename.Clear();
     m_ErrorLine.Clear();
     m_Error.Clear();
 
+    SyncCompiledRegExes();
+
     for (size_t i = 0; i < m_RegExes.Count(); ++i)
     {
         RegExStruct& rs = m_RegExes[i];
-        if (rs.regex.IsEmpty())
+        const CompiledRegEx& cre = m_CompiledRegExes[i];
+        if (!cre.regex || !cre.regex->IsValid())
+            continue;
+        // lines that don't contain the regex's required literal can't match it
+        if (!cre.literal.IsEmpty() && line.Find(cre.literal) == wxNOT_FOUND)
             continue;
-        wxRegEx regex(rs.regex);
+        wxRegEx& regex = *cre.regex;
         if (regex.Matches(line))
         {
             if (rs.filename > 0)
@@ -1,6 +1,7 @@
 #include "sdk_precomp.h"
 #include "compilercommandgenerator.h"
 #include <wx/intl.h>
+#include <wx/stopwatch.h>
 #include "cbexception.h"
 #include "cbproject.h"
 #include "compilerfactory.h"
@@ -380,6 +381,9 @@ void CompilerCommandGenerator::DoBuildScripts(cbProject* project, CompileTargetB
             continue;
         }
 
+        // scripts are compiled once (see ScriptingManager), so this is mostly running time
+        wxStopWatch sw;
+
         // clear previous script's context
         Manager::Get()->GetScriptingManager()->LoadBuffer(clearout_buildscripts);
 
@@ -400,6 +404,7 @@ void CompilerCommandGenerator::DoBuildScripts(cbProject* project, CompileTargetB
             Manager::Get()->GetScriptingManager()->DisplayErrors(&e);
             m_ScriptsWithErrors.Add(script_nomacro);
         }
+        Manager::Get()->GetLogManager()->DebugLog(F(_T("Build script %s: %s() took %ldms"), script_nomacro.wx_str(), funcName.wx_str(), sw.Time()));
     }
 }
 
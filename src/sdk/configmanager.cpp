@@ -556,7 +556,7 @@ wxString ConfigManager::LocateDataFile(const wxString& filename, int search_dirs
 *  ConfigManager
 */
 
-ConfigManager::ConfigManager(TiXmlElement* r) : doc(r->GetDocument()), root(r), pathNode(r)
+ConfigManager::ConfigManager(TiXmlElement* r) : doc(r->GetDocument()), root(r), pathNode(r), indexMutex(wxMUTEX_RECURSIVE)
 {
 }
 
@@ -573,6 +573,7 @@ ConfigManager::ConfigManager(TiXmlElement* r) : doc(r->GetDocument()), root(r),
 
 wxString ConfigManager::GetPath() const
 {
+    wxMutexLocker lock(indexMutex);
     TiXmlElement *e = pathNode;
     wxString ret;
     ret.Alloc(64);
@@ -590,6 +591,7 @@ wxString ConfigManager::GetPath() const
 void ConfigManager::SetPath(const wxString& path)
 {
     wxString p(path + _T('/'));
+    wxMutexLocker lock(indexMutex);
     pathNode = AssertPath(p);
 }
 
@@ -665,7 +667,9 @@ TiXmlElement* ConfigManager::AssertPath(wxString& path)
 
 void ConfigManager::Clear()
 {
+    wxMutexLocker lock(indexMutex);
     root->Clear();
+    keyIndex.clear();
 }
 
 void ConfigManager::Delete()
@@ -702,6 +706,50 @@ void ConfigManager::DeleteAll()
 }
 
 
+/* ------------------------------------------------------------------------------------------------------------------
+*  Key index
+*  Resolving a key means tokenizing its path and walking the tree, which is far too slow for settings that are read
+*  over and over (like on every build command or timer tick). Therefore, every key read or written is remembered
+*  in keyIndex together with its leaf element (or null if the key doesn't exist), so the next access is a hash lookup.
+*  Relative keys are only valid for the path they were resolved in, absolute keys always are.
+*  The index holds no values, the document stays the only storage, so the config file is saved exactly as before.
+*  Removing any element clears the index, as it may hold pointers to the removed nodes (or to their children).
+*/
+
+TiXmlElement* ConfigManager::FindLeaf(const wxString& name)
+{
+    KeyIndexMap::iterator it = keyIndex.find(name);
+    if(it != keyIndex.end() && (it->second.base == pathNode || name.StartsWith(_T("/"))))
+        return it->second.leaf;
+
+    wxString key(name);
+    TiXmlElement* e = AssertPath(key);
+    TiXmlElement* leaf = e->FirstChildElement(cbU2C(key));
+
+    // deep copy: the caller's string may be shared with another thread
+    KeyIndexEntry& entry = keyIndex[wxString(name.c_str())];
+    entry.base = pathNode;
+    entry.leaf = leaf;
+    return leaf;
+}
+
+TiXmlElement* ConfigManager::AssertLeaf(const wxString& name)
+{
+    if(TiXmlElement* leaf = FindLeaf(name))
+        return leaf;
+
+    wxString key(name);
+    TiXmlElement* e = AssertPath(key);
+    TiXmlElement* leaf = (TiXmlElement*)(e->InsertEndChild(TiXmlElement(cbU2C(key))));
+
+    // other spellings of the same key may be indexed as missing
+    keyIndex.clear();
+    KeyIndexEntry& entry = keyIndex[wxString(name.c_str())];
+    entry.base = pathNode;
+    entry.leaf = leaf;
+    return leaf;
+}
+
 /* ------------------------------------------------------------------------------------------------------------------
 *  Utility functions for writing nodes
 */
@@ -749,10 +797,8 @@ void ConfigManager::Write(const wxString& name,  const wxString& value, bool ign
         return;
     }
 
-    wxString key(name);
-    TiXmlElement* e = AssertPath(key);
-
-    TiXmlElement *str = GetUniqElement(e, key);
+    wxMutexLocker lock(indexMutex);
+    TiXmlElement *str = AssertLeaf(name);
 
     TiXmlElement *s = GetUniqElement(str, _T("str"));
 
@@ -796,11 +842,9 @@ bool ConfigManager::Read(const wxString& name, wxString* str)
         return true;
     }
 
-    wxString key(name);
-    TiXmlElement* e = AssertPath(key);
-
-    TiXmlHandle parentHandle(e);
-    TiXmlText *t = (TiXmlText *) parentHandle.FirstChild(cbU2C(key)).FirstChild("str").FirstChild().Node();
+    wxMutexLocker lock(indexMutex);
+    TiXmlHandle leafHandle(FindLeaf(name));
+    TiXmlText *t = (TiXmlText *) leafHandle.FirstChild("str").FirstChild().Node();
 
     if(t)
     {
@@ -812,10 +856,8 @@ bool ConfigManager::Read(const wxString& name, wxString* str)
 
 void ConfigManager::Write(const wxString& name,  const wxColour& c)
 {
-    wxString key(name);
-    TiXmlElement* e = AssertPath(key);
-
-    TiXmlElement *leaf = GetUniqElement(e, key);
+    wxMutexLocker lock(indexMutex);
+    TiXmlElement *leaf = AssertLeaf(name);
 
     TiXmlElement *s = GetUniqElement(leaf, _T("colour"));
     s->SetAttribute("r", c.Red());
@@ -835,11 +877,9 @@ wxColour ConfigManager::ReadColour(const wxString& name, const wxColour& default
 
 bool ConfigManager::Read(const wxString& name, wxColour* ret)
 {
-    wxString key(name);
-    TiXmlElement* e = AssertPath(key);
-
-    TiXmlHandle parentHandle(e);
-    TiXmlElement *c = (TiXmlElement *) parentHandle.FirstChild(cbU2C(key)).FirstChild("colour").Element();
+    wxMutexLocker lock(indexMutex);
+    TiXmlHandle leafHandle(FindLeaf(name));
+    TiXmlElement *c = (TiXmlElement *) leafHandle.FirstChild("colour").Element();
 
     if(c)
     {
@@ -855,9 +895,8 @@ bool ConfigManager::Read(const wxString& name, wxColour* ret)
 
 void ConfigManager::Write(const wxString& name,  int value)
 {
-    wxString key(name);
-    TiXmlElement* e = AssertPath(key);
-    TiXmlElement *leaf = GetUniqElement(e, key);
+    wxMutexLocker lock(indexMutex);
+    TiXmlElement *leaf = AssertLeaf(name);
 
     leaf->SetAttribute("int", value);
 }
@@ -874,11 +913,8 @@ int  ConfigManager::ReadInt(const wxString& name,  int defaultVal)
 
 bool ConfigManager::Read(const wxString& name,  int* value)
 {
-    wxString key(name);
-    TiXmlElement* e = AssertPath(key);
-
-    TiXmlHandle parentHandle(e);
-    TiXmlElement *leaf = parentHandle.FirstChild(cbU2C(key)).Element();
+    wxMutexLocker lock(indexMutex);
+    TiXmlElement *leaf = FindLeaf(name);
 
     if(leaf)
         return leaf->QueryIntAttribute("int", value) == TIXML_SUCCESS;
@@ -888,9 +924,8 @@ bool ConfigManager::Read(const wxString& name,  int* value)
 
 void ConfigManager::Write(const wxString& name,  bool value)
 {
-    wxString key(name);
-    TiXmlElement* e = AssertPath(key);
-    TiXmlElement *leaf = GetUniqElement(e, key);
+    wxMutexLocker lock(indexMutex);
+    TiXmlElement *leaf = AssertLeaf(name);
 
     leaf->SetAttribute("bool", value ? "1" : "0");
 }
@@ -907,11 +942,8 @@ bool  ConfigManager::ReadBool(const wxString& name,  bool defaultVal)
 
 bool ConfigManager::Read(const wxString& name,  bool* value)
 {
-    wxString key(name);
-    TiXmlElement* e = AssertPath(key);
-
-    TiXmlHandle parentHandle(e);
-    TiXmlElement *leaf = parentHandle.FirstChild(cbU2C(key)).Element();
+    wxMutexLocker lock(indexMutex);
+    TiXmlElement *leaf = FindLeaf(name);
 
     if(leaf && leaf->Attribute("bool"))
     {
@@ -924,9 +956,8 @@ bool ConfigManager::Read(const wxString& name,  bool* value)
 
 void ConfigManager::Write(const wxString& name,  double value)
 {
-    wxString key(name);
-    TiXmlElement* e = AssertPath(key);
-    TiXmlElement *leaf = GetUniqElement(e, key);
+    wxMutexLocker lock(indexMutex);
+    TiXmlElement *leaf = AssertLeaf(name);
 
     leaf->SetDoubleAttribute("double", value);
 }
@@ -943,11 +974,8 @@ double  ConfigManager::ReadDouble(const wxString& name,  double defaultVal)
 
 bool ConfigManager::Read(const wxString& name,  double* value)
 {
-    wxString key(name);
-    TiXmlElement* e = AssertPath(key);
-
-    TiXmlHandle parentHandle(e);
-    TiXmlElement *leaf = parentHandle.FirstChild(cbU2C(key)).Element();
+    wxMutexLocker lock(indexMutex);
+    TiXmlElement *leaf = FindLeaf(name);
 
     if(leaf)
         return leaf->QueryDoubleAttribute("double", value) == TIXML_SUCCESS;
@@ -957,27 +985,24 @@ bool ConfigManager::Read(const wxString& name,  double* value)
 
 void ConfigManager::Set(const wxString& name)
 {
-    wxString key(name);
-    TiXmlElement* e = AssertPath(key);
-    GetUniqElement(e, key);
+    wxMutexLocker lock(indexMutex);
+    AssertLeaf(name);
 }
 
 void ConfigManager::UnSet(const wxString& name)
 {
-    wxString key(name);
-    TiXmlElement* e = AssertPath(key);
-
-    TiXmlNode *leaf = GetUniqElement(e, key);
-    e->RemoveChild(leaf);
+    wxMutexLocker lock(indexMutex);
+    if(TiXmlElement *leaf = FindLeaf(name))
+    {
+        leaf->Parent()->RemoveChild(leaf);
+        keyIndex.clear();
+    }
 }
 
 bool ConfigManager::Exists(const wxString& name)
 {
-    wxString key(name);
-    TiXmlElement* e = AssertPath(key);
-
-    TiXmlHandle parentHandle(e);
-    TiXmlElement *leaf = parentHandle.FirstChild(cbU2C(key)).Element();
+    wxMutexLocker lock(indexMutex);
+    TiXmlElement *leaf = FindLeaf(name);
 
     return leaf;
 }
@@ -986,10 +1011,8 @@ bool ConfigManager::Exists(const wxString& name)
 
 void ConfigManager::Write(const wxString& name,  const wxArrayString& arrayString)
 {
-    wxString key(name);
-    TiXmlElement* e = AssertPath(key);
-
-    TiXmlElement *leaf = GetUniqElement(e, key);
+    wxMutexLocker lock(indexMutex);
+    TiXmlElement *leaf = AssertLeaf(name);
 
     TiXmlElement *as;
     as = GetUniqElement(leaf, _T("astr"));
@@ -1010,11 +1033,9 @@ void ConfigManager::Write(const wxString& name,  const wxArrayString& arrayStrin
 
 void ConfigManager::Read(const wxString& name, wxArrayString *arrayString)
 {
-    wxString key(name);
-    TiXmlElement* e = AssertPath(key);
-
-    TiXmlHandle parentHandle(e);
-    TiXmlNode *asNode = parentHandle.FirstChild(cbU2C(key)).FirstChild("astr").Node();
+    wxMutexLocker lock(indexMutex);
+    TiXmlHandle leafHandle(FindLeaf(name));
+    TiXmlNode *asNode = leafHandle.FirstChild("astr").Node();
 
     TiXmlNode *curr = 0;
     if(asNode)
@@ -1035,10 +1056,8 @@ wxArrayString ConfigManager::ReadArrayString(const wxString& name)
 
 void ConfigManager::WriteBinary(const wxString& name,  const wxString& source)
 {
-    wxString key(name);
-    TiXmlElement* e = AssertPath(key);
-
-    TiXmlElement *str = GetUniqElement(e, key);
+    wxMutexLocker lock(indexMutex);
+    TiXmlElement *str = AssertLeaf(name);
 
     TiXmlElement *s = GetUniqElement(str, _T("bin"));
     s->SetAttribute("crc", wxCrc32::FromString(source));
@@ -1054,12 +1073,11 @@ void ConfigManager::WriteBinary(const wxString& name,  void* ptr, size_t len)
 wxString ConfigManager::ReadBinary(const wxString& name)
 {
     wxString str;
-    wxString key(name);
-    TiXmlElement* e = AssertPath(key);
     unsigned int crc = 0;
 
-    TiXmlHandle parentHandle(e);
-    TiXmlElement* bin = parentHandle.FirstChild(cbU2C(key)).FirstChild("bin").Element();
+    wxMutexLocker lock(indexMutex);
+    TiXmlHandle leafHandle(FindLeaf(name));
+    TiXmlElement* bin = leafHandle.FirstChild("bin").Element();
 
     if(!bin)
         return wxEmptyString;
@@ -1081,6 +1099,7 @@ wxString ConfigManager::ReadBinary(const wxString& name)
 wxArrayString ConfigManager::EnumerateSubPaths(const wxString& path)
 {
     wxString key(path + _T('/')); // the trailing slash hack is required because AssertPath expects a key name
+    wxMutexLocker lock(indexMutex);
     TiXmlNode* e = AssertPath(key);
     wxArrayString ret;
 
@@ -1103,6 +1122,8 @@ wxArrayString ConfigManager::EnumerateSubPaths(const wxString& path)
 
 void ConfigManager::DeleteSubPath(const wxString& thePath)
 {
+    wxMutexLocker lock(indexMutex);
+
     if(doc->ErrorId())
     {
         cbMessageBox(wxString(_T("### TinyXML error:\n")) << cbC2U(doc->ErrorDesc()));
@@ -1159,6 +1180,7 @@ void ConfigManager::DeleteSubPath(const wxString& thePath)
         {
             toRemove->Clear();
             parent->RemoveChild(toRemove);
+            keyIndex.clear();
         }
     }
 }
@@ -1167,6 +1189,7 @@ void ConfigManager::DeleteSubPath(const wxString& thePath)
 wxArrayString ConfigManager::EnumerateKeys(const wxString& path)
 {
     wxString key(path + _T('/')); // the trailing slash hack is required because AssertPath expects a key name
+    wxMutexLocker lock(indexMutex);
     TiXmlNode* e = AssertPath(key);
     wxArrayString ret;
 
@@ -1189,10 +1212,8 @@ wxArrayString ConfigManager::EnumerateKeys(const wxString& path)
 
 void ConfigManager::Write(const wxString& name, const ISerializable& object)
 {
-    wxString key(name);
-    TiXmlElement* e = AssertPath(key);
-
-    TiXmlElement *obj = GetUniqElement(e, key);
+    wxMutexLocker lock(indexMutex);
+    TiXmlElement *obj = AssertLeaf(name);
 
     TiXmlElement *s = GetUniqElement(obj, _T("obj"));
     SetNodeText(s, TiXmlText(cbU2C(caBase64::Encode(object.SerializeOut()))));
@@ -1201,11 +1222,10 @@ void ConfigManager::Write(const wxString& name, const ISerializable& object)
 bool ConfigManager::Read(const wxString& name, ISerializable* object)
 {
     wxString str;
-    wxString key(name);
-    TiXmlElement* e = AssertPath(key);
 
-    TiXmlHandle parentHandle(e);
-    TiXmlText *t = (TiXmlText *) parentHandle.FirstChild(cbU2C(key)).FirstChild("obj").FirstChild().Node();
+    wxMutexLocker lock(indexMutex);
+    TiXmlHandle leafHandle(FindLeaf(name));
+    TiXmlText *t = (TiXmlText *) leafHandle.FirstChild("obj").FirstChild().Node();
 
     if(t)
     {
@@ -1217,10 +1237,8 @@ bool ConfigManager::Read(const wxString& name, ISerializable* object)
 
 void ConfigManager::Write(const wxString& name, const ConfigManagerContainer::StringToStringMap& map)
 {
-    wxString key(name);
-    TiXmlElement* e = AssertPath(key);
-
-    TiXmlElement *leaf = GetUniqElement(e, key);
+    wxMutexLocker lock(indexMutex);
+    TiXmlElement *leaf = AssertLeaf(name);
 
     TiXmlElement *mNode;
     mNode = GetUniqElement(leaf, _T("ssmap"));
@@ -1241,11 +1259,9 @@ void ConfigManager::Write(const wxString& name, const ConfigManagerContainer::St
 
 void ConfigManager::Read(const wxString& name, ConfigManagerContainer::StringToStringMap* map)
 {
-    wxString key(name);
-    TiXmlElement* e = AssertPath(key);
-
-    TiXmlHandle parentHandle(e);
-    TiXmlNode *mNode = parentHandle.FirstChild(cbU2C(key)).FirstChild("ssmap").Node();
+    wxMutexLocker lock(indexMutex);
+    TiXmlHandle leafHandle(FindLeaf(name));
+    TiXmlNode *mNode = leafHandle.FirstChild("ssmap").Node();
 
     TiXmlNode *curr = 0;
     if(mNode)
@@ -1264,10 +1280,8 @@ ConfigManagerContainer::StringToStringMap ConfigManager::ReadSSMap(const wxStrin
 
 void ConfigManager::Write(const wxString& name, const ConfigManagerContainer::IntToStringMap& map)
 {
-    wxString key(name);
-    TiXmlElement* e = AssertPath(key);
-
-    TiXmlElement *leaf = GetUniqElement(e, key);
+    wxMutexLocker lock(indexMutex);
+    TiXmlElement *leaf = AssertLeaf(name);
 
     TiXmlElement *mNode;
     mNode = GetUniqElement(leaf, _T("ismap"));
@@ -1290,11 +1304,9 @@ void ConfigManager::Write(const wxString& name, const ConfigManagerContainer::In
 
 void ConfigManager::Read(const wxString& name, ConfigManagerContainer::IntToStringMap* map)
 {
-    wxString key(name);
-    TiXmlElement* e = AssertPath(key);
-
-    TiXmlHandle parentHandle(e);
-    TiXmlNode *mNode = parentHandle.FirstChild(cbU2C(key)).FirstChild("ismap").Node();
+    wxMutexLocker lock(indexMutex);
+    TiXmlHandle leafHandle(FindLeaf(name));
+    TiXmlNode *mNode = leafHandle.FirstChild("ismap").Node();
 
     TiXmlNode *curr = 0;
     long tmp;
@@ -1322,10 +1334,8 @@ ConfigManagerContainer::IntToStringMap ConfigManager::ReadISMap(const wxString&
 
 void ConfigManager::Write(const wxString& name, const ConfigManagerContainer::StringSet& set)
 {
-    wxString key(name);
-    TiXmlElement* e = AssertPath(key);
-
-    TiXmlElement *leaf = GetUniqElement(e, key);
+    wxMutexLocker lock(indexMutex);
+    TiXmlElement *leaf = AssertLeaf(name);
 
     TiXmlElement *mNode;
     mNode = GetUniqElement(leaf, _T("sset"));
@@ -1347,11 +1357,9 @@ void ConfigManager::Write(const wxString& name, const ConfigManagerContainer::St
 
 void ConfigManager::Read(const wxString& name, ConfigManagerContainer::StringSet* set)
 {
-    wxString key(name);
-    TiXmlElement* e = AssertPath(key);
-
-    TiXmlHandle parentHandle(e);
-    TiXmlNode *mNode = parentHandle.FirstChild(cbU2C(key)).FirstChild("sset").Node();
+    wxMutexLocker lock(indexMutex);
+    TiXmlHandle leafHandle(FindLeaf(name));
+    TiXmlNode *mNode = leafHandle.FirstChild("sset").Node();
 
     TiXmlNode *curr = 0;
     if(mNode)
@@ -1371,10 +1379,8 @@ ConfigManagerContainer::StringSet ConfigManager::ReadSSet(const wxString& name)
 
 void ConfigManager::Write(const wxString& name, const ConfigManagerContainer::SerializableObjectMap* map)
 {
-    wxString key(name);
-    TiXmlElement* e = AssertPath(key);
-
-    TiXmlElement *leaf = GetUniqElement(e, key);
+    wxMutexLocker lock(indexMutex);
+    TiXmlElement *leaf = AssertLeaf(name);
 
     TiXmlElement *mNode;
     mNode = GetUniqElement(leaf, _T("objmap"));
@@ -150,7 +150,11 @@ void EditorBase::SetTitle(const wxString& newTitle)
     m_WinTitle = newTitle;
     int mypage = Manager::Get()->GetEditorManager()->FindPageFromEditor(this);
     if (mypage != -1)
+    {
         Manager::Get()->GetEditorManager()->GetNotebook()->SetPageText(mypage, newTitle);
+        // the file name usually changes with the title (e.g. "Save as")
+        Manager::Get()->GetEditorManager()->IndexEditor(this);
+    }
 }
 
 void EditorBase::Activate()
@@ -60,6 +60,8 @@
 #include <wx/bmpbuttn.h>
 #include <wx/progdlg.h>
 #include <wx/fontutil.h>
+#include <wx/fontmap.h>
+#include <wx/hashset.h>
 
 #if !defined(CA_BUILD_WITHOUT_WXSCINTILLA) 
 #include "editorcolourset.h" 
@@ -70,7 +72,9 @@
 #include "editorbase.h"
 #include "confirmreplacedlg.h"
 #include "filefilters.h"
+#include "filewatcher.h"
 #include "searchresultslog.h"
+#include "searchinfiles.h"
 #include "projectfileoptionsdlg.h"
 
 #include "wx/wxFlatNotebook/wxFlatNotebook.h"
@@ -81,6 +85,7 @@ template<> bool  Mgr<EditorManager>::isShutdown = false;
 int ID_NBEditorManager = wxNewId();
 int ID_EditorManager = wxNewId();
 int idEditorManagerCheckFiles = wxNewId();
+int idEditorManagerFilesChanged = wxNewId();
 
 // static
 bool EditorManager::s_CanShutdown = true;
@@ -125,6 +130,11 @@ static const int idNBTabTop = wxNewId();
 static const int idNBTabBottom = wxNewId();
 static const int idNBProperties = wxNewId();
 static const int idNB = wxNewId();
+static const int idFindInFiles = wxNewId();
+static const int idLoadDeferredEditor = wxNewId();
+
+WX_DECLARE_HASH_SET(wxString, wxStringHash, wxStringEqual, FindInFilesSet);
+WX_DECLARE_STRING_HASH_MAP(cbEditor*, FindInFilesEditors);
 
 /** *******************************************************
   * struct EditorManagerInternalData                      *
@@ -132,18 +142,70 @@ static const int idNB = wxNewId();
   * All data not relevant to other classes should go here *
   ********************************************************* */
 
+WX_DECLARE_STRING_HASH_MAP(EditorBase*, EditorPathIndex);
+
 struct EditorManagerInternalData
 {
     /* Methods */
 
     EditorManagerInternalData(EditorManager* owner)
-            : m_pOwner(owner)
+            : m_pOwner(owner),
+            m_pFindInFiles(0),
+            m_pWatcher(new FileWatcher(owner, idEditorManagerFilesChanged)),
+            m_pActivating(0)
     {}
 
+    ~EditorManagerInternalData()
+    {
+        delete m_pWatcher;
+    }
+
+    // the key of a file name in m_PathIndex
+    static wxString MakePathKey(const wxString& filename)
+    {
+        wxString key = filename;
+        // MSW must use case-insensitive comparison
+        if (platform::windows)
+            key.MakeLower();
+        return key;
+    }
+
     /* Static data */
 
     EditorManager* m_pOwner;
     bool m_SetFocusFlag;
+
+    // the running "Find in files" search
+    SearchInFiles* m_pFindInFiles;
+    wxString m_FindInFilesText;
+    wxString m_FindInFilesPath;
+    bool m_FindInFilesDelOld;
+    int m_FindInFilesOldCount;
+    int m_FindInFilesCount;
+
+    // the editors in the notebook by file name, for IsOpen()
+    EditorPathIndex m_PathIndex;
+    // what each editor is indexed (and its file is watched) with
+    struct IndexedEditor
+    {
+        wxString key;
+        wxString watched; // empty if not watched
+    };
+    typedef std::map<EditorBase*, IndexedEditor> IndexedEditors;
+    IndexedEditors m_IndexedEditors;
+    // tells which files must be checked for external modifications
+    FileWatcher* m_pWatcher;
+
+    // the tabs opened by OpenDeferred() and not loaded yet, with their project file (may be NULL)
+    typedef std::map<EditorBase*, ProjectFile*> DeferredEditors;
+    DeferredEditors m_DeferredEditors;
+    // the editor cbEVT_EDITOR_ACTIVATED is being sent for (a placeholder can't be replaced then)
+    EditorBase* m_pActivating;
+
+    bool IsDeferred(EditorBase* eb) const
+    {
+        return m_DeferredEditors.find(eb) != m_DeferredEditors.end();
+    }
 };
 
 // *********** End of EditorManagerInternalData **********
@@ -169,6 +231,10 @@ BEGIN_EVENT_TABLE(EditorManager, wxEvtHandler)
     EVT_MENU(idNBSwapHeaderSource, EditorManager::OnSwapHeaderSource)
     EVT_MENU(idNBProperties, EditorManager::OnProperties)
     EVT_MENU(idEditorManagerCheckFiles, EditorManager::OnCheckForModifiedFiles)
+    EVT_MENU(idEditorManagerFilesChanged, EditorManager::OnFilesChanged)
+    EVT_MENU(idLoadDeferredEditor, EditorManager::OnLoadDeferredEditor)
+    EVT_THREADTASK_ENDED(idFindInFiles, EditorManager::OnFindInFilesResults)
+    EVT_THREADTASK_ALLDONE(idFindInFiles, EditorManager::OnFindInFilesResults)
 END_EVENT_TABLE()
 
 // class constructor
@@ -210,6 +276,7 @@ EditorManager::~EditorManager()
     delete m_Theme;
 #endif // #if !defined(CA_BUILD_WITHOUT_WXSCINTILLA) 
     delete m_LastFindReplaceData;
+    delete m_pData->m_pFindInFiles; // stops the search
     delete m_pData;
     Manager::Get()->GetConfigManager(_T("editor"))->Write(_T("/zoom"), m_zoom);
 } // end of destructor
@@ -405,23 +472,35 @@ cbEditor* EditorManager::InternalGetBuiltinEditor(int page)
 
 cbEditor* EditorManager::GetBuiltinEditor(EditorBase* eb)
 {
-    return eb && eb->IsBuiltinEditor() ? (cbEditor*)eb : 0;
+    // a tab not loaded yet isn't a cbEditor: it's loaded by Open() or, once activated,
+    // from a pending event (loading replaces the tab, so it must not happen
+    // while an event about it is being dispatched)
+    if (!eb || m_pData->IsDeferred(eb))
+        return 0;
+    return eb->IsBuiltinEditor() ? (cbEditor*)eb : 0;
+}
+
+bool EditorManager::IsDeferred(EditorBase* eb) const
+{
+    return eb && m_pData->IsDeferred(eb);
 }
 
 EditorBase* EditorManager::IsOpen(const wxString& filename)
 {
 #if !defined(CA_BUILD_WITHOUT_WXSCINTILLA) 
     wxString uFilename = UnixFilename(filename);
-    for (int i = 0; i < m_pNotebook->GetPageCount(); ++i)
-    {
-        EditorBase* eb = InternalGetEditorBase(i);
-        if (!eb)
-            continue;
-        wxString fname = eb->GetFilename();
-
-        // MSW must use case-insensitive comparison
-        if (fname.IsSameAs(uFilename, platform::windows == false) || fname.IsSameAs(g_EditorModified + uFilename, platform::windows == false))
+    EditorPathIndex& index = m_pData->m_PathIndex;
+    EditorPathIndex::iterator it = index.find(EditorManagerInternalData::MakePathKey(uFilename));
+    if (it == index.end())
+        it = index.find(EditorManagerInternalData::MakePathKey(g_EditorModified + uFilename));
+    if (it != index.end())
+    {
+        // in case the editor was renamed without telling us
+        EditorBase* eb = it->second;
+        if (EditorManagerInternalData::MakePathKey(eb->GetFilename()) == it->first)
             return eb;
+        IndexEditor(eb);
+        return IsOpen(filename);
     }
 #endif // #if !defined(CA_BUILD_WITHOUT_WXSCINTILLA) 
 
@@ -477,7 +556,24 @@ cbEditor* EditorManager::Open(LoaderBase* fileLdr, const wxString& filename, int
 
     EditorBase* eb = IsOpen(fname);
     cbEditor* ed = 0;
-    if (eb)
+    if (eb && m_pData->IsDeferred(eb))
+    {
+        // loading replaces the tab: not while plugins are told it's activated,
+        // the pending event posted by OnPageChanged() loads it right after
+        if (eb == m_pData->m_pActivating)
+        {
+            delete fileLdr;
+            s_CanShutdown = true;
+            return 0;
+        }
+        ed = LoadDeferredEditor(eb, fileLdr);
+        if (!ed)
+        {
+            s_CanShutdown = true;
+            return 0;
+        }
+    }
+    else if (eb)
     {
         if (eb->IsBuiltinEditor())
             ed = (cbEditor*)eb;
@@ -542,6 +638,85 @@ cbEditor* EditorManager::Open(LoaderBase* fileLdr, const wxString& filename, int
     return ed;
 }
 
+EditorBase* EditorManager::OpenDeferred(const wxString& filename, ProjectFile* data)
+{
+    wxFileName fn(filename);
+    NormalizePath(fn, wxEmptyString);
+    wxString fname = UnixFilename(fn.GetFullPath());
+    if (!wxFileExists(fname))
+        return 0;
+
+    EditorBase* eb = IsOpen(fname);
+    if (eb)
+        return eb;
+
+    // a bare EditorBase is enough to show the tab (it adds itself to the notebook)
+    eb = new EditorBase(m_pNotebook, fname);
+    m_pData->m_DeferredEditors[eb] = data;
+    if (data)
+    {
+        // same as cbEditor::SetProjectFile()
+        data->editorOpen = true;
+        if (Manager::Get()->GetConfigManager(_T("editor"))->ReadBool(_T("/tab_text_relative"), true))
+            eb->SetTitle(data->relativeToCommonTopLevelPath);
+        else
+            eb->SetTitle(data->file.GetFullName());
+    }
+
+    // it was activated before we knew it's deferred
+    if (GetActiveEditor() == eb)
+    {
+        wxCommandEvent evt(wxEVT_COMMAND_MENU_SELECTED, idLoadDeferredEditor);
+        AddPendingEvent(evt);
+    }
+    return eb;
+}
+
+cbEditor* EditorManager::LoadDeferredEditor(EditorBase* eb, LoaderBase* fileLdr)
+{
+    EditorManagerInternalData::DeferredEditors::iterator it = m_pData->m_DeferredEditors.find(eb);
+    if (it == m_pData->m_DeferredEditors.end())
+    {
+        delete fileLdr;
+        return 0;
+    }
+    ProjectFile* pf = it->second;
+    // its tab is replaced, not closed: leave pf->editorOpen alone
+    m_pData->m_DeferredEditors.erase(it);
+
+    const wxString filename = eb->GetFilename();
+    const int page = FindPageFromEditor(eb);
+    EditorBase* active = GetActiveEditor();
+
+    m_pNotebook->Freeze();
+    // remove the placeholder first, so that Open() doesn't find it
+    m_pNotebook->DeletePage(page, false);
+    cbEditor* ed = 0;
+    if (fileLdr)
+        ed = Open(fileLdr, filename, 0, pf);
+    else
+        ed = Open(filename, 0, pf);
+
+    // move the editor to the placeholder's place, and keep the same tab active
+    int newPage = ed ? FindPageFromEditor(ed) : -1;
+    if (newPage != -1 && newPage != page)
+    {
+        m_pNotebook->RemovePage(newPage, false);
+        m_pNotebook->InsertPage(page, ed, ed->GetTitle(), false);
+    }
+    if (active == eb)
+        active = ed;
+    if (active)
+        SetActiveEditor(active);
+    m_pNotebook->Thaw();
+
+    // the tab is gone
+    if (!ed && pf)
+        pf->editorOpen = false;
+
+    return ed;
+}
+
 EditorBase* EditorManager::GetActiveEditor()
 {
     return InternalGetEditorBase(m_pNotebook->GetSelection());
@@ -627,11 +802,21 @@ void EditorManager::AddEditorBase(EditorBase* eb)
         //        LOGSTREAM << wxString::Format(_T("AddEditorBase(): ed=%p, title=%s\n"), eb, eb ? eb->GetTitle().c_str() : _T(""));
         m_pNotebook->AddPage(eb, eb->GetTitle(), true);
     }
+    IndexEditor(eb);
 }
 
 void EditorManager::RemoveEditorBase(EditorBase* eb, bool deleteObject)
 {
     //    LOGSTREAM << wxString::Format(_T("RemoveEditorBase(): ed=%p, title=%s\n"), eb, eb ? eb->GetFilename().c_str() : _T(""));
+    UnindexEditor(eb);
+    EditorManagerInternalData::DeferredEditors::iterator it = m_pData->m_DeferredEditors.find(eb);
+    if (it != m_pData->m_DeferredEditors.end())
+    {
+        // closed without being loaded (same as ~cbEditor())
+        if (it->second)
+            it->second->editorOpen = false;
+        m_pData->m_DeferredEditors.erase(it);
+    }
     int page = FindPageFromEditor(eb);
    if (page != -1 && !Manager::isappShuttingDown())
         m_pNotebook->RemovePage(page, false);
@@ -640,10 +825,70 @@ void EditorManager::RemoveEditorBase(EditorBase* eb, bool deleteObject)
     //        eb->Destroy();
 }
 
+void EditorManager::IndexEditor(EditorBase* eb)
+{
+    wxString key = EditorManagerInternalData::MakePathKey(eb->GetFilename());
+    // watch the files of builtin editors, the others can't be reloaded
+    wxString watched = eb->IsBuiltinEditor() ? eb->GetFilename() : wxString();
+
+    EditorManagerInternalData::IndexedEditors::iterator it = m_pData->m_IndexedEditors.find(eb);
+    if (it != m_pData->m_IndexedEditors.end())
+    {
+        if (it->second.key == key && it->second.watched == watched)
+            return; // nothing changed
+        UnindexEditor(eb);
+    }
+
+    m_pData->m_PathIndex[key] = eb;
+    EditorManagerInternalData::IndexedEditor& indexed = m_pData->m_IndexedEditors[eb];
+    indexed.key = key;
+    indexed.watched = watched;
+    if (!watched.IsEmpty())
+        m_pData->m_pWatcher->Add(watched);
+}
+
+void EditorManager::UnindexEditor(EditorBase* eb)
+{
+    EditorManagerInternalData::IndexedEditors::iterator it = m_pData->m_IndexedEditors.find(eb);
+    if (it == m_pData->m_IndexedEditors.end())
+        return;
+
+    EditorPathIndex::iterator pathIt = m_pData->m_PathIndex.find(it->second.key);
+    if (pathIt != m_pData->m_PathIndex.end() && pathIt->second == eb)
+    {
+        m_pData->m_PathIndex.erase(pathIt);
+        // another editor with the same name (not a file, e.g. a custom editor) takes over
+        for (EditorManagerInternalData::IndexedEditors::iterator other = m_pData->m_IndexedEditors.begin(); other != m_pData->m_IndexedEditors.end(); ++other)
+        {
+            if (other->first != eb && other->second.key == it->second.key)
+            {
+                m_pData->m_PathIndex[other->second.key] = other->first;
+                break;
+            }
+        }
+    }
+    if (!it->second.watched.IsEmpty())
+        m_pData->m_pWatcher->Remove(it->second.watched);
+    m_pData->m_IndexedEditors.erase(it);
+}
+
 bool EditorManager::UpdateProjectFiles(cbProject* project)
 {
     for (int i = 0; i < m_pNotebook->GetPageCount(); ++i)
     {
+        // tabs not loaded yet keep the position they were restored with
+        EditorManagerInternalData::DeferredEditors::iterator it = m_pData->m_DeferredEditors.find(InternalGetEditorBase(i));
+        if (it != m_pData->m_DeferredEditors.end())
+        {
+            ProjectFile* pf = it->second;
+            if (pf && pf->GetParentProject() == project)
+            {
+                pf->editorTabPos = i + 1;
+                pf->editorOpen = true;
+            }
+            continue;
+        }
+
         cbEditor* ed = InternalGetBuiltinEditor(i);
         if (!ed)
             continue;
@@ -860,7 +1105,7 @@ void EditorManager::Print(PrintScope ps, PrintColourMode pcm, bool line_numbers)
         {
             for (int i = 0; i < m_pNotebook->GetPageCount(); ++i)
             {
-                cbEditor* ed = InternalGetBuiltinEditor(i);
+                cbEditor* ed = GetBuiltinEditor(InternalGetEditorBase(i));
                 if (ed)
                     ed->Print(false, pcm, line_numbers);
             }
@@ -885,9 +1130,12 @@ void EditorManager::CheckForExternallyModifiedFiles()
 #if !defined(CA_BUILD_WITHOUT_WXSCINTILLA) 
     bool reloadAll = false; // flag to stop bugging the user
     wxArrayString failedFiles; // list of files failed to reload
-    for (int i = 0; i < m_pNotebook->GetPageCount(); ++i)
+    // only the files which may have changed need to be checked
+    wxArrayString changedFiles;
+    m_pData->m_pWatcher->GetChanges(changedFiles);
+    for (size_t i = 0; i < changedFiles.GetCount(); ++i)
     {
-        cbEditor* ed = InternalGetBuiltinEditor(i);
+        cbEditor* ed = GetBuiltinEditor(IsOpen(changedFiles[i]));
         bool b_modified = false;
 
         // no builtin editor or new file not yet saved
@@ -961,7 +1209,14 @@ void EditorManager::CheckForExternallyModifiedFiles()
                     failedFiles.Add(ed->GetFilename());
             }
             else if (ret == crCancel)
+            {
+                // check this one and the rest next time
+                wxArrayString unchecked;
+                for (size_t j = i; j < changedFiles.GetCount(); ++j)
+                    unchecked.Add(changedFiles[j]);
+                m_pData->m_pWatcher->Requeue(unchecked);
                 break;
+            }
             else if (ret == crNo)
                 ed->Touch();
         }
@@ -1621,12 +1876,12 @@ int EditorManager::ReplaceInFiles(cbFindReplaceData* data)
     }
     else if (data->scope == 1) // find in open files
     {
-        // fill the search list with the open files
+        // fill the search list with the open files (the tabs not loaded yet too: their files are searched on disk)
         for (int i = 0; i < m_pNotebook->GetPageCount(); ++i)
         {
-            cbEditor* ed = InternalGetBuiltinEditor(i);
-            if (ed)
-                filesList.Add(ed->GetFilename());
+            EditorBase* eb = InternalGetEditorBase(i);
+            if (eb && (eb->IsBuiltinEditor() || m_pData->IsDeferred(eb)))
+                filesList.Add(eb->GetFilename());
         }
     }
     else if (data->scope == 2) // find in workspace
@@ -2131,15 +2386,12 @@ int EditorManager::FindInFiles(cbFindReplaceData* data)
         return 0;
 
 #if !defined(CA_BUILD_WITHOUT_WXSCINTILLA) 
-    // clear old search results
-    if ( data->delOldSearches )
-    {
-        m_pSearchLog->Clear();
-    }
-    int oldcount = m_pSearchLog->GetItemsCount();
+    // a new search replaces the running one
+    CancelFindInFiles();
 
     // let's make a list of all the files to search in
     wxArrayString filesList;
+    FindInFilesSet filesSet; // avoids adding duplicates
 
     if (data->scope == 0) // find in project files
     {
@@ -2158,7 +2410,7 @@ int EditorManager::FindInFiles(cbFindReplaceData* data)
             if (pf)
             {
                 fullpath = pf->file.GetFullPath();
-                if (filesList.Index(fullpath) == -1) // avoid adding duplicates
+                if (filesSet.insert(fullpath).second) // avoid adding duplicates
                 {
                     if(wxFileExists(fullpath))  // Does the file exist?
                         filesList.Add(fullpath);
@@ -2168,12 +2420,12 @@ int EditorManager::FindInFiles(cbFindReplaceData* data)
     }
     else if (data->scope == 1) // find in open files
     {
-        // fill the search list with the open files
+        // fill the search list with the open files (the tabs not loaded yet too: their files are searched on disk)
         for (int i = 0; i < m_pNotebook->GetPageCount(); ++i)
         {
-            cbEditor* ed = InternalGetBuiltinEditor(i);
-            if (ed)
-                filesList.Add(ed->GetFilename());
+            EditorBase* eb = InternalGetEditorBase(i);
+            if (eb && (eb->IsBuiltinEditor() || m_pData->IsDeferred(eb)))
+                filesList.Add(eb->GetFilename());
         }
     }
     else if (data->scope == 2) // find in custom search path and mask
@@ -2187,10 +2439,17 @@ int EditorManager::FindInFiles(cbFindReplaceData* data)
             masks.Add(_T("*"));
         unsigned int count = masks.GetCount();
 
+        wxArrayString found;
         for (unsigned int i = 0; i < count; ++i)
         {
             // wxDir::GetAllFiles() does *not* clear the array, so it suits us just fine ;)
-            wxDir::GetAllFiles(data->searchPath, &filesList, masks[i], flags);
+            wxDir::GetAllFiles(data->searchPath, &found, masks[i], flags);
+        }
+        // overlapping masks find the same files more than once
+        for (size_t i = 0; i < found.GetCount(); ++i)
+        {
+            if (filesSet.insert(found[i]).second)
+                filesList.Add(found[i]);
         }
     }
     else if (data->scope == 3) // find in workspace
@@ -2217,7 +2476,7 @@ int EditorManager::FindInFiles(cbFindReplaceData* data)
                     if (pf)
                     {
                         fullpath = pf->file.GetFullPath();
-                        if (filesList.Index(fullpath) == -1) // avoid adding duplicates
+                        if (filesSet.insert(fullpath).second) // avoid adding duplicates
                         {
                             if(wxFileExists(fullpath))  // Does the file exist?
                                 filesList.Add(fullpath);
@@ -2235,24 +2494,35 @@ int EditorManager::FindInFiles(cbFindReplaceData* data)
         return 0;
     }
 
-    // now that list is filled, we'll search
-    // but first we'll create a hidden cbStyledTextCtrl to do the search for us ;)
-    cbStyledTextCtrl* control = new cbStyledTextCtrl(m_pNotebook, -1, wxDefaultPosition, wxSize(0, 0));
-    control->Show(false); //hidden
+    SearchInFilesOptions options;
+    options.text = data->findText;
+    options.matchWord = data->matchWord;
+    options.startWord = data->startWord;
+    options.matchCase = data->matchCase;
+    options.regEx = data->regEx;
+    if (data->regEx)
+    {
+        if (Manager::Get()->GetConfigManager(_T("editor"))->ReadBool(_T("/use_posix_style_regexes"), false))
+            options.regExFlags = wxRE_EXTENDED;
+        #ifdef wxHAS_REGEX_ADVANCED
+        if (Manager::Get()->GetConfigManager(_T("editor"))->ReadBool(_T("/use_advanced_regexes"), false))
+            options.regExFlags = wxRE_ADVANCED;
+        #endif
 
-#if wxUSE_PROGRESSDLG
-    // let's create a progress dialog because it might take some time depending on the files count
-    wxProgressDialog* progress = new wxProgressDialog(_("Find in files"),
-                                 _("Please wait while searching inside the files..."),
-                                 filesList.GetCount(),
-                                 Manager::Get()->GetAppWindow(),
-                                 wxPD_AUTO_HIDE | wxPD_APP_MODAL | wxPD_CAN_ABORT);
-
-    PlaceWindow(progress);
-#endif // wxUSE_PROGRESSDLG
+        // the search threads can't complain about a bad expression: do it here
+        wxRegEx re;
+        if (!re.Compile(options.text, options.regExFlags))
+            return 0;
+    }
+    wxString enc_name = Manager::Get()->GetConfigManager(_T("editor"))->Read(_T("/default_encoding"), wxLocale::GetSystemEncodingName());
+    options.encoding = wxFontMapper::GetEncodingFromName(enc_name);
 
-    // keep a copy of the find struct
-    cbFindReplaceData localData = *data;
+    // clear old search results
+    if ( data->delOldSearches )
+    {
+        m_pSearchLog->Clear();
+    }
+    int oldcount = m_pSearchLog->GetItemsCount();
 
     if ( !data->delOldSearches )
     {
@@ -2260,89 +2530,149 @@ int EditorManager::FindInFiles(cbFindReplaceData* data)
         oldcount++;
     }
 
-    int lastline = -1;
-    int count = 0;
-    for (size_t i = 0; i < filesList.GetCount(); ++i)
+    // files open in an editor are searched in the editor's (maybe modified) text
+    FindInFilesEditors editors;
+    for (int i = 0; i < m_pNotebook->GetPageCount(); ++i)
     {
-#if wxUSE_PROGRESSDLG
-        // update the progress bar
-        if (!progress->Update(i))
-            break; // user pressed "Cancel"
-#endif // wxUSE_PROGRESSDLG
-
-        // re-initialize the find struct for every file searched
-        *data = localData;
-
-        // check if the file is already opened in built-in editor and do search in it
-        cbEditor* ed = IsBuiltinOpen(filesList[i]);
+        cbEditor* ed = InternalGetBuiltinEditor(i);
         if (ed)
-            control->SetText(ed->GetControl()->GetText());
-        else if (!control->LoadFile(filesList[i])) // else load the file in the control
         {
-            //            LOGSTREAM << _("Failed opening ") << filesList[i] << wxT('\n');
-            continue; // failed
+            wxString fname = UnixFilename(ed->GetFilename());
+            if (platform::windows)
+                fname.MakeLower();
+            editors[fname] = ed;
         }
+    }
 
-        // now search for first occurence
-        if (Find(control, data) == -1)
-        {
-            lastline = -1;
-            continue;
-        }
+    SearchInFiles* search = new SearchInFiles(this, idFindInFiles, options);
+    for (size_t i = 0; i < filesList.GetCount(); ++i)
+    {
+        wxString fname = UnixFilename(filesList[i]);
+        if (platform::windows)
+            fname.MakeLower();
+        FindInFilesEditors::iterator it = editors.find(fname);
+        if (it != editors.end())
+            search->AddBuffer(filesList[i], it->second->GetControl()->GetText());
+        else
+            search->AddFile(filesList[i]);
+    }
+
+    m_pData->m_pFindInFiles = search;
+    m_pData->m_FindInFilesText = data->findText;
+    m_pData->m_FindInFilesPath = data->searchPath;
+    m_pData->m_FindInFilesDelOld = data->delOldSearches;
+    m_pData->m_FindInFilesOldCount = oldcount;
+    m_pData->m_FindInFilesCount = 0;
+
+    // the matches are logged as they come in (OnFindInFilesResults())
+    search->Start();
+    LogFindInFilesResults();
+
+    return filesList.GetCount();
+#else
+    return 0;
+#endif // #if !defined(CA_BUILD_WITHOUT_WXSCINTILLA) 
+}
+
+void EditorManager::CancelFindInFiles()
+{
+    if (!m_pData->m_pFindInFiles)
+        return;
+
+    m_pData->m_pFindInFiles->Cancel();
+    LogFindInFilesResults(); // the files searched until now
+}
+
+void EditorManager::OnFindInFilesResults(wxCommandEvent& /*event*/)
+{
+    LogFindInFilesResults();
+}
 
-        int line = control->LineFromPosition(control->GetSelectionStart());
-        lastline = line;
+void EditorManager::LogFindInFilesResults()
+{
+    SearchInFiles* search = m_pData->m_pFindInFiles;
+    if (!search)
+        return; // late event of a finished search
+
+    wxString filename;
+    SearchInFilesHits hits;
+    while (search->GetNextResults(filename, hits))
+    {
+        if (hits.empty())
+            continue;
 
         // make the filename relative
-        wxString filename = filesList[i];
-        if (filename.StartsWith(data->searchPath))
+        if (filename.StartsWith(m_pData->m_FindInFilesPath))
         {
             wxFileName fname(filename);
-            fname.MakeRelativeTo(data->searchPath);
+            fname.MakeRelativeTo(m_pData->m_FindInFilesPath);
             filename = fname.GetFullPath();
         }
 
-        // log it
-        LogSearch(filename, line + 1, control->GetLine(line));
-        ++count;
-
-        // now loop finding the next occurence
-        while (FindNext(true, control, data) != -1)
+        // show the log with the first match, so the rest can be watched coming in
+        if (m_pData->m_FindInFilesCount == 0 &&
+            Manager::Get()->GetConfigManager(_T("message_manager"))->ReadBool(_T("/auto_show_search"), true))
         {
-            // log it
-            line = control->LineFromPosition(control->GetSelectionStart());
-            if(line == lastline)  // avoid multiple hits on the same line (try search for "manager")
-                continue;
+            CodeBlocksLogEvent evtSwitch(cbEVT_SWITCH_TO_LOG_WINDOW, m_pSearchLog);
+            CodeBlocksLogEvent evtShow(cbEVT_SHOW_LOG_MANAGER);
 
-            lastline = line;
-            LogSearch(filename, line + 1, control->GetLine(line));
-            ++count;
+            Manager::Get()->ProcessEvent(evtSwitch);
+            Manager::Get()->ProcessEvent(evtShow);
         }
+
+        for (size_t i = 0; i < hits.size(); ++i)
+            LogSearch(filename, hits[i].line, hits[i].text);
+        m_pData->m_FindInFilesCount += (int)hits.size();
+        hits.clear();
     }
-    delete control; // done with it
-#if wxUSE_PROGRESSDLG
-    delete progress; // done here too
-#endif // wxUSE_PROGRESSDLG
 
-    if (count > 0)
+    if (search->IsDone())
     {
-        static_cast<SearchResultsLog*>(m_pSearchLog)->SetBasePath(data->searchPath);
-        if (Manager::Get()->GetConfigManager(_T("message_manager"))->ReadBool(_T("/auto_show_search"), true))
-        {
-        	CodeBlocksLogEvent evtSwitch(cbEVT_SWITCH_TO_LOG_WINDOW, m_pSearchLog);
-        	CodeBlocksLogEvent evtShow(cbEVT_SHOW_LOG_MANAGER);
+        EndFindInFiles();
+        return;
+    }
 
-			Manager::Get()->ProcessEvent(evtSwitch);
-			Manager::Get()->ProcessEvent(evtShow);
-        }
+    wxFrame* frame = Manager::Get()->GetAppFrame();
+    if (frame && frame->GetStatusBar())
+    {
+        frame->SetStatusText(wxString::Format(_("Searching in files: %d of %d (press Escape in the search results to stop)"),
+                                              (int)search->GetFilesFetched(), (int)search->GetFilesCount()));
+    }
+}
+
+void EditorManager::EndFindInFiles()
+{
+    SearchInFiles* search = m_pData->m_pFindInFiles;
+    m_pData->m_pFindInFiles = 0;
+    bool cancelled = search->IsCancelled();
+    size_t filesSearched = search->GetFilesFetched();
+    size_t filesCount = search->GetFilesCount();
+    delete search;
+
+    wxFrame* frame = Manager::Get()->GetAppFrame();
+    if (frame && frame->GetStatusBar())
+        frame->SetStatusText(wxEmptyString);
+
+    int oldcount = m_pData->m_FindInFilesOldCount;
+    int count = m_pData->m_FindInFilesCount;
+    if (cancelled)
+    {
+        wxString msg;
+        msg.Printf(_("stopped after searching %d of %d files"), (int)filesSearched, (int)filesCount);
+        LogSearch(_T(""), -1, msg);
+    }
+
+    if (count > 0)
+    {
+        static_cast<SearchResultsLog*>(m_pSearchLog)->SetBasePath(m_pData->m_FindInFilesPath);
         static_cast<SearchResultsLog*>(m_pSearchLog)->FocusEntry(oldcount);
     }
-    else
+    else if (!cancelled)
     {
         wxString msg;
-        if ( data->delOldSearches )
+        if ( m_pData->m_FindInFilesDelOld )
         {
-            msg.Printf(_("Not found: %s"), data->findText.c_str());
+            msg.Printf(_("Not found: %s"), m_pData->m_FindInFilesText.c_str());
             cbMessageBox(msg, _("Result"), wxICON_INFORMATION);
             cbEditor* ed = Manager::Get()->GetEditorManager()->GetBuiltinActiveEditor();
 #if !defined(CA_BUILD_WITHOUT_WXSCINTILLA) 
@@ -2352,16 +2682,11 @@ int EditorManager::FindInFiles(cbFindReplaceData* data)
         }
         else
         {
-            msg.Printf(_("not found in %d files"), filesList.GetCount());
+            msg.Printf(_("not found in %d files"), (int)filesCount);
             LogSearch(_T(""), -1, msg );
             static_cast<SearchResultsLog*>(m_pSearchLog)->FocusEntry(oldcount);
         }
     }
-
-    return count;
-#else
-    return 0;
-#endif // #if !defined(CA_BUILD_WITHOUT_WXSCINTILLA) 
 }
 
 int EditorManager::FindNext(bool goingDown, cbStyledTextCtrl* control, cbFindReplaceData* data)
@@ -2432,9 +2757,18 @@ void EditorManager::OnGenericContextMenuHandler(wxCommandEvent& event)
 void EditorManager::OnPageChanged(wxFlatNotebookEvent& event)
 {
     EditorBase* eb = static_cast<EditorBase*>(m_pNotebook->GetPage(event.GetSelection()));
+    if (eb && m_pData->IsDeferred(eb))
+    {
+        // load it once the notebook is done changing pages
+        wxCommandEvent evt(wxEVT_COMMAND_MENU_SELECTED, idLoadDeferredEditor);
+        AddPendingEvent(evt);
+    }
     //    LOGSTREAM << wxString::Format(_T("OnPageChanged(): ed=%p, title=%s\n"), eb, eb ? eb->GetTitle().c_str() : _T(""));
     CodeBlocksEvent evt(cbEVT_EDITOR_ACTIVATED, -1, 0, eb);
+    EditorBase* wasActivating = m_pData->m_pActivating;
+    m_pData->m_pActivating = eb;
     Manager::Get()->GetPluginManager()->NotifyPlugins(evt);
+    m_pData->m_pActivating = wasActivating;
 
     // focus editor on next update event
     m_pData->m_SetFocusFlag = true;
@@ -2592,6 +2926,22 @@ void EditorManager::OnCheckForModifiedFiles(wxCommandEvent& event)
     CheckForExternallyModifiedFiles();
 }
 
+void EditorManager::OnFilesChanged(wxCommandEvent& event)
+{
+    if (FileWatcher::ShouldCheckChanges())
+        CheckForExternallyModifiedFiles();
+}
+
+void EditorManager::OnLoadDeferredEditor(wxCommandEvent& event)
+{
+    if (Manager::isappShuttingDown())
+        return;
+    // the active tab may have changed again meanwhile
+    EditorBase* eb = GetActiveEditor();
+    if (eb && m_pData->IsDeferred(eb))
+        LoadDeferredEditor(eb);
+}
+
 void EditorManager::HideNotebook()
 {
     //    if(!this)
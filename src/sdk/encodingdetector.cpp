@@ -22,24 +22,24 @@ EncodingDetector::EncodingDetector(const wxString& filename)
     m_IsOK = DetectEncoding(filename);
 }
 
-EncodingDetector::EncodingDetector(LoaderBase* fileLdr)
+EncodingDetector::EncodingDetector(LoaderBase* fileLdr, bool ConvertToWxString)
     : m_IsOK(false),
     m_UseBOM(false),
     m_BOMSizeInBytes(0),
     m_ConvStr(wxEmptyString)
 {
     m_Encoding = wxLocale::GetSystemEncoding();
-    m_IsOK = DetectEncoding((wxByte*)fileLdr->GetData(), fileLdr->GetLength());
+    m_IsOK = DetectEncoding((wxByte*)fileLdr->GetData(), fileLdr->GetLength(), ConvertToWxString);
 }
 
-EncodingDetector::EncodingDetector(const wxByte* buffer, size_t size)
+EncodingDetector::EncodingDetector(const wxByte* buffer, size_t size, bool ConvertToWxString)
     : m_IsOK(false),
     m_UseBOM(false),
     m_BOMSizeInBytes(0),
     m_ConvStr(wxEmptyString)
 {
     m_Encoding = wxLocale::GetSystemEncoding();
-    m_IsOK = DetectEncoding(buffer, size);
+    m_IsOK = DetectEncoding(buffer, size, ConvertToWxString);
 }
 
 EncodingDetector::EncodingDetector(const EncodingDetector& rhs)
@@ -0,0 +1,328 @@
+/*
+* This file is part of Code::Blocks Studio, an open-source cross-platform IDE
+* Copyright (C) 2003  Yiannis An. Mandravellos
+*
+* This program is distributed under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or (at your option) any later version.
+*
+* $Revision$
+* $Id$
+* $HeadURL$
+*/
+
+#include "sdk_precomp.h"
+
+#ifndef CB_PRECOMP
+    #include <wx/event.h>
+    #include <wx/filename.h>
+    #include <wx/string.h>
+    #include <wx/toplevel.h>
+
+    #include "manager.h"
+    #include "configmanager.h"
+#endif
+
+#include "filewatcher.h"
+
+#ifdef __linux__
+    #include <errno.h>
+    #include <poll.h>
+    #include <unistd.h>
+    #include <sys/inotify.h>
+    #include <sys/vfs.h>
+#endif
+
+namespace
+{
+#ifdef __linux__
+    // what makes a watched file "changed"; the directory is watched, not the
+    // file itself, so that files saved by renaming a new one over them are seen
+    const unsigned int watchMask = IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_CREATE | IN_DELETE |
+                                   IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+    // how often (in milliseconds) the thread checks if it should stop
+    const int stopCheckInterval = 250;
+
+    // inotify only sees the changes made by this host on these
+    bool IsNetworkFileSystem(const wxString& dir)
+    {
+        struct statfs st;
+        if (statfs(dir.fn_str(), &st) != 0)
+            return true; // can't tell, play safe
+        switch ((unsigned long)st.f_type)
+        {
+            case 0x6969UL:     // NFS
+            case 0x517BUL:     // SMB
+            case 0xFF534D42UL: // CIFS
+            case 0xFE534D42UL: // SMB2
+            case 0x564CUL:     // NCP
+            case 0x5346414FUL: // AFS
+            case 0x73757245UL: // Coda
+            case 0x01021997UL: // 9P
+            case 0x65735546UL: // FUSE (sshfs and the like)
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    wxString GetDirectory(const wxString& filename)
+    {
+        return wxFileName(filename).GetPath(wxPATH_GET_VOLUME | wxPATH_GET_SEPARATOR);
+    }
+#endif
+
+    bool IsInDirectory(const wxString& filename, const wxString& dir)
+    {
+        return filename.length() > dir.length() &&
+               filename.StartsWith(dir) &&
+               filename.find(_T('/'), dir.length()) == wxString::npos;
+    }
+}
+
+FileWatcher::FileWatcher(wxEvtHandler* owner, int id)
+    : wxThread(wxTHREAD_JOINABLE),
+    m_pOwner(owner),
+    m_ID(id),
+    m_Fd(-1),
+    m_Running(false),
+    m_Stop(false),
+    m_NotifyPending(false)
+{
+    //ctor
+#ifdef __linux__
+    m_Fd = inotify_init();
+    if (m_Fd != -1)
+    {
+        if (Create() == wxTHREAD_NO_ERROR && Run() == wxTHREAD_NO_ERROR)
+            m_Running = true;
+        else
+        {
+            close(m_Fd);
+            m_Fd = -1;
+        }
+    }
+#endif
+}
+
+FileWatcher::~FileWatcher()
+{
+    //dtor
+    if (m_Running)
+    {
+        {
+            wxMutexLocker lock(m_Mutex);
+            m_Stop = true;
+        }
+        Wait();
+        m_Running = false;
+    }
+#ifdef __linux__
+    if (m_Fd != -1)
+        close(m_Fd);
+#endif
+}
+
+void FileWatcher::Add(const wxString& filename)
+{
+    wxMutexLocker lock(m_Mutex);
+    FileRefs::iterator it = m_Files.find(filename);
+    if (it != m_Files.end())
+    {
+        ++it->second;
+        return;
+    }
+
+    wxString name = filename.c_str(); // the thread sees it: don't share the string's buffer
+    m_Files[name] = 1;
+    if (!WatchNatively(name))
+        m_Polled.insert(name);
+    // it may have changed before now
+    m_Changed.insert(name);
+}
+
+void FileWatcher::Remove(const wxString& filename)
+{
+    wxMutexLocker lock(m_Mutex);
+    FileRefs::iterator it = m_Files.find(filename);
+    if (it == m_Files.end() || --it->second > 0)
+        return;
+
+    m_Files.erase(it);
+    m_Changed.erase(filename);
+    if (m_Polled.erase(filename) == 0)
+        UnwatchNatively(filename);
+}
+
+void FileWatcher::GetChanges(wxArrayString& changed)
+{
+    wxMutexLocker lock(m_Mutex);
+    changed.Clear();
+    for (std::set<wxString>::iterator it = m_Changed.begin(); it != m_Changed.end(); ++it)
+        changed.Add(it->c_str());
+    for (std::set<wxString>::iterator it = m_Polled.begin(); it != m_Polled.end(); ++it)
+    {
+        if (m_Changed.find(*it) == m_Changed.end())
+            changed.Add(it->c_str());
+    }
+    m_Changed.clear();
+    m_NotifyPending = false;
+}
+
+void FileWatcher::Requeue(const wxArrayString& filenames)
+{
+    wxMutexLocker lock(m_Mutex);
+    for (size_t i = 0; i < filenames.GetCount(); ++i)
+    {
+        FileRefs::iterator it = m_Files.find(filenames[i]);
+        if (it != m_Files.end())
+            m_Changed.insert(it->first);
+    }
+}
+
+bool FileWatcher::ShouldCheckChanges()
+{
+    wxTopLevelWindow* appWindow = wxDynamicCast(Manager::Get()->GetAppWindow(), wxTopLevelWindow);
+    return appWindow && appWindow->IsActive() &&
+           Manager::Get()->GetConfigManager(_T("app"))->ReadBool(_T("/environment/check_modified_files"), true);
+}
+
+// called with m_Mutex locked
+bool FileWatcher::WatchNatively(const wxString& filename)
+{
+#ifdef __linux__
+    if (m_Fd == -1)
+        return false;
+
+    wxString dir = GetDirectory(filename);
+    WatchedDirs::iterator it = m_Dirs.find(dir);
+    if (it != m_Dirs.end())
+    {
+        ++it->second.count;
+        return true;
+    }
+
+    if (dir.IsEmpty() || IsNetworkFileSystem(dir))
+        return false;
+    int wd = inotify_add_watch(m_Fd, dir.fn_str(), watchMask);
+    // an already known watch means the same directory by another name (symlinks): poll
+    if (wd == -1 || m_DirsByWatch.find(wd) != m_DirsByWatch.end())
+        return false;
+
+    WatchedDir& watched = m_Dirs[dir];
+    watched.wd = wd;
+    watched.count = 1;
+    m_DirsByWatch[wd] = dir;
+    return true;
+#else
+    return false;
+#endif
+}
+
+// called with m_Mutex locked
+void FileWatcher::UnwatchNatively(const wxString& filename)
+{
+#ifdef __linux__
+    WatchedDirs::iterator it = m_Dirs.find(GetDirectory(filename));
+    if (it == m_Dirs.end() || --it->second.count > 0)
+        return;
+    inotify_rm_watch(m_Fd, it->second.wd);
+    m_DirsByWatch.erase(it->second.wd);
+    m_Dirs.erase(it);
+#endif
+}
+
+// called with m_Mutex locked
+void FileWatcher::DirectoryChanged(const wxString& dir)
+{
+    for (FileRefs::iterator it = m_Files.begin(); it != m_Files.end(); ++it)
+    {
+        if (dir.IsEmpty() || IsInDirectory(it->first, dir))
+            m_Changed.insert(it->first);
+    }
+}
+
+// called with m_Mutex locked
+void FileWatcher::Notify()
+{
+    if (m_Changed.empty() || m_NotifyPending)
+        return;
+    m_NotifyPending = true;
+    // one event until the owner takes the changes with GetChanges()
+    wxCommandEvent event(wxEVT_COMMAND_MENU_SELECTED, m_ID);
+    wxPostEvent(m_pOwner, event);
+}
+
+wxThread::ExitCode FileWatcher::Entry()
+{
+#ifdef __linux__
+    // large enough for many events, aligned for struct inotify_event
+    char buf[16 * 1024] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    while (true)
+    {
+        {
+            wxMutexLocker lock(m_Mutex);
+            if (m_Stop)
+                break;
+        }
+
+        struct pollfd pfd;
+        pfd.fd = m_Fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        if (poll(&pfd, 1, stopCheckInterval) <= 0)
+            continue; // timeout or EINTR
+
+        ssize_t len = read(m_Fd, buf, sizeof(buf));
+        if (len <= 0)
+        {
+            if (len == -1 && errno == EINTR)
+                continue;
+            break; // the inotify instance is broken, the files are reported by the checks on activation
+        }
+
+        wxMutexLocker lock(m_Mutex);
+        for (char* p = buf; p < buf + len; )
+        {
+            struct inotify_event* event = (struct inotify_event*)p;
+            p += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW)
+            {
+                DirectoryChanged(wxEmptyString); // events were lost: all files
+                continue;
+            }
+
+            std::map<int, wxString>::iterator dirIt = m_DirsByWatch.find(event->wd);
+            if (dirIt == m_DirsByWatch.end())
+                continue; // not watched anymore
+            const wxString dir = dirIt->second;
+
+            if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED | IN_UNMOUNT))
+            {
+                DirectoryChanged(dir);
+                if (event->mask & IN_IGNORED)
+                {
+                    // the watch is gone with the directory: poll its files from now on
+                    for (FileRefs::iterator it = m_Files.begin(); it != m_Files.end(); ++it)
+                    {
+                        if (IsInDirectory(it->first, dir))
+                            m_Polled.insert(it->first);
+                    }
+                    m_DirsByWatch.erase(dirIt);
+                    m_Dirs.erase(dir);
+                }
+                continue;
+            }
+
+            if (event->len == 0)
+                continue;
+            FileRefs::iterator it = m_Files.find(dir + wxString(event->name, *wxConvFileName));
+            if (it != m_Files.end())
+                m_Changed.insert(it->first);
+        }
+        Notify();
+    }
+#endif
+    return 0;
+}
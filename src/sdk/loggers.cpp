@@ -19,11 +19,42 @@
 
 #include <wx/clipbrd.h>
 #include <wx/dataobj.h>
+#include <wx/timer.h>
 #include <wx/wupdlock.h>
 
 #include "loggers.h"
 #include "cbcolourmanager.h"
 
+namespace
+{
+    // buffered loggers update their control at most five times per second
+    const int flushInterval = 200;
+
+    template<class T> class FlushTimer : public wxTimer
+    {
+    public:
+        FlushTimer(T* logger_in) : logger(logger_in) {}
+        virtual void Notify() { logger->Flush(); }
+    private:
+        T* logger;
+    };
+
+    class VirtualListCtrl : public wxListCtrl
+    {
+    public:
+        VirtualListCtrl(wxWindow* parent, VirtualListCtrlLogger* logger_in) :
+            wxListCtrl(parent, -1, wxDefaultPosition, wxDefaultSize, wxLC_REPORT | wxLC_SINGLE_SEL | wxLC_VIRTUAL),
+            logger(logger_in)
+        {
+        }
+
+        virtual wxString OnGetItemText(long item, long column) const { return logger->GetItemText(item, column); }
+        virtual wxListItemAttr* OnGetItemAttr(long item) const { return logger->GetItemAttr(item); }
+    private:
+        VirtualListCtrlLogger* logger;
+    };
+}
+
 // Helper function which blends a colour with the default window text colour,
 // so that text will be readable in bright and dark colour schemes
 wxColour BlendTextColour(wxColour col)
@@ -239,6 +270,76 @@ void TimestampTextCtrlLogger::Append(const wxString& msg, Logger::level lv)
     control->AppendText(::temp_string);
 }
 
+BufferedTextCtrlLogger::BufferedTextCtrlLogger(bool fixedPitchFont) :
+    TextCtrlLogger(fixedPitchFont),
+    flushTimer(new FlushTimer<BufferedTextCtrlLogger>(this))
+{
+}
+
+BufferedTextCtrlLogger::~BufferedTextCtrlLogger()
+{
+    delete flushTimer;
+}
+
+void BufferedTextCtrlLogger::AddRun(Logger::level lv, const wxString& text)
+{
+    if (pending.empty() || pending.back().lv != lv)
+    {
+        pending.push_back(Run());
+        pending.back().lv = lv;
+    }
+    pending.back().text.append(text);
+}
+
+void BufferedTextCtrlLogger::Flush()
+{
+    flushTimer->Stop();
+    if (control)
+    {
+        for (size_t i = 0; i < pending.size(); ++i)
+        {
+            control->SetDefaultStyle(style[pending[i].lv]);
+            control->AppendText(pending[i].text);
+        }
+    }
+    pending.clear();
+}
+
+void BufferedTextCtrlLogger::CopyContentsToClipboard(bool selectionOnly)
+{
+    Flush();
+    TextCtrlLogger::CopyContentsToClipboard(selectionOnly);
+}
+
+void BufferedTextCtrlLogger::Append(const wxString& msg, Logger::level lv)
+{
+    if (!control)
+        return;
+
+    if (lv == caption)
+    {
+        AddRun(info, ::newline_string);
+        AddRun(lv, msg);
+        AddRun(lv, _T("\n"));
+        AddRun(spacer, ::newline_string);
+    }
+    else
+    {
+        AddRun(lv, msg);
+        AddRun(lv, _T("\n"));
+    }
+
+    if (!flushTimer->IsRunning())
+        flushTimer->Start(flushInterval, wxTIMER_ONE_SHOT);
+}
+
+void BufferedTextCtrlLogger::Clear()
+{
+    flushTimer->Stop();
+    pending.clear();
+    TextCtrlLogger::Clear();
+}
+
 ListCtrlLogger::ListCtrlLogger(const wxArrayString& titles_in, const wxArrayInt& widths_in, bool fixedPitchFont) :
     control(nullptr),
     fixed(fixedPitchFont),
@@ -347,6 +448,8 @@ void ListCtrlLogger::UpdateSettings()
 
     // Tell control and items about the font change
     control->SetFont(default_font);
+    if (control->HasFlag(wxLC_VIRTUAL))
+        return; // items of virtual controls have no fonts of their own
     for (int i = 0; i < control->GetItemCount(); ++i)
     {
         wxFont font = control->GetItemFont(i);
@@ -428,6 +531,151 @@ void ListCtrlLogger::AutoFitColumns(int column)
         control->SetColumnWidth(column, wxLIST_AUTOSIZE);
 }
 
+VirtualListCtrlLogger::VirtualListCtrlLogger(const wxArrayString& titles_in, const wxArrayInt& widths_in, bool fixedPitchFont) :
+    ListCtrlLogger(titles_in, widths_in, fixedPitchFont),
+    columns(titles_in.GetCount()),
+    attrs(new wxListItemAttr[num_levels]),
+    flushTimer(new FlushTimer<VirtualListCtrlLogger>(this))
+{
+}
+
+VirtualListCtrlLogger::~VirtualListCtrlLogger()
+{
+    delete flushTimer;
+    delete[] attrs;
+}
+
+void VirtualListCtrlLogger::Flush()
+{
+    flushTimer->Stop();
+    if (!control)
+        return;
+
+    if ((size_t)control->GetItemCount() != levels.size())
+        control->SetItemCount(levels.size());
+    for (size_t i = 0; i < autoSizeColumns.GetCount(); ++i)
+        control->SetColumnWidth(autoSizeColumns[i], wxLIST_AUTOSIZE);
+    autoSizeColumns.Clear();
+}
+
+wxString VirtualListCtrlLogger::GetItemText(long item, long column) const
+{
+    if (item < 0 || (size_t)item >= levels.size() || column < 0 || (size_t)column >= columns.size())
+        return wxEmptyString;
+    return columns[column][item];
+}
+
+wxListItemAttr* VirtualListCtrlLogger::GetItemAttr(long item) const
+{
+    if (item < 0 || (size_t)item >= levels.size())
+        return nullptr;
+    return &attrs[levels[item]];
+}
+
+void VirtualListCtrlLogger::CopyContentsToClipboard(bool selectionOnly)
+{
+    Flush();
+    if (control && !levels.empty() && wxTheClipboard->Open())
+    {
+        long first = 0;
+        long last = levels.size() - 1;
+        if (selectionOnly)
+            first = last = control->GetNextItem(-1, wxLIST_NEXT_ALL, wxLIST_STATE_SELECTED);
+
+        wxString text;
+        for (long i = first; i >= 0 && i <= last; ++i)
+        {
+            for (size_t col = 0; col < columns.size(); ++col)
+                text << columns[col][i] << _T('|');
+            if (selectionOnly)
+                break;
+            if (platform::windows)
+                text << _T('\r'); // Add CR for Windows clipboard
+            text << _T('\n');
+        }
+        wxTheClipboard->SetData(new wxTextDataObject(text));
+        wxTheClipboard->Close();
+    }
+}
+
+void VirtualListCtrlLogger::UpdateSettings()
+{
+    ListCtrlLogger::UpdateSettings();
+    if (!control)
+        return;
+
+    for (unsigned int i = 0; i < num_levels; ++i)
+    {
+        attrs[i].SetFont(style[i].font);
+        attrs[i].SetTextColour(style[i].colour);
+    }
+    control->Refresh();
+}
+
+void VirtualListCtrlLogger::Append(const wxString& msg, Logger::level lv)
+{
+    if (!control || columns.empty())
+        return;
+
+    columns[0].Add(msg);
+    for (size_t i = 1; i < columns.size(); ++i)
+        columns[i].Add(wxEmptyString);
+    levels.push_back(lv);
+
+    if (!flushTimer->IsRunning())
+        flushTimer->Start(flushInterval, wxTIMER_ONE_SHOT);
+}
+
+void VirtualListCtrlLogger::Append(const wxArrayString& colValues, Logger::level lv, int autoSize)
+{
+    if (!control)
+        return;
+
+    if (colValues.GetCount() == 0 || colValues.GetCount() > titles.GetCount())
+        return;
+
+    Append(colValues[0], lv);
+    size_t idx = levels.size() - 1;
+    for (size_t i = 1; i < colValues.GetCount(); ++i)
+        columns[i][idx] = colValues[i];
+    AutoFitColumns(autoSize);
+}
+
+size_t VirtualListCtrlLogger::GetItemsCount() const
+{
+    return control ? levels.size() : 0;
+}
+
+void VirtualListCtrlLogger::Clear()
+{
+    flushTimer->Stop();
+    for (size_t i = 0; i < columns.size(); ++i)
+        columns[i].Clear();
+    levels.clear();
+    autoSizeColumns.Clear();
+    if (control)
+        control->DeleteAllItems();
+}
+
+wxWindow* VirtualListCtrlLogger::CreateControl(wxWindow* parent)
+{
+    if (control)
+        return control;
+
+    control = new VirtualListCtrl(parent, this);
+    for (size_t i = 0; i < titles.GetCount(); ++i)
+        control->InsertColumn(i, titles[i], wxLIST_FORMAT_LEFT, widths[i]);
+
+    return control;
+}
+
+void VirtualListCtrlLogger::AutoFitColumns(int column)
+{
+    // done when flushing, measuring the rows for every one appended is far too slow
+    if (column != -1 && autoSizeColumns.Index(column) == wxNOT_FOUND)
+        autoSizeColumns.Add(column);
+}
+
 CSS::CSS() :
     caption  (_T("font-size: 12pt;")),
     info     (wxEmptyString),
@@ -58,6 +58,10 @@ template<> bool  Mgr<MacrosManager>::isShutdown = false;
 static const wxString const_COIN(_T("COIN"));
 static const wxString const_RANDOM(_T("RANDOM"));
 
+static const size_t max_templates = 4096;
+static const size_t max_expansions = 4096;
+static const int max_depth = 16;
+
 MacrosManager::MacrosManager()
 {
     Reset();
@@ -87,26 +91,25 @@ void MacrosManager::Reset()
     m_lastProject = 0;
     m_lastTarget = 0;
     m_lastEditor = 0;
+    m_templates.clear();
+    m_expanded.clear();
 
     m_AppPath = UnixFilename(ConfigManager::GetExecutableFolder());
     m_Plugins = UnixFilename(ConfigManager::GetPluginsFolder());
     m_DataPath = UnixFilename(ConfigManager::GetDataFolder());
     ClearProjectKeys();
-    m_re_unx.Compile(_T("([^$]|^)(\\$[({]?(#?[A-Za-z_0-9.]+)[)} /\\]?)"), wxRE_EXTENDED | wxRE_NEWLINE);
-    m_re_dos.Compile(_T("([^%]|^)(%(#?[A-Za-z_0-9.]+)%)"), wxRE_EXTENDED | wxRE_NEWLINE);
     m_re_if.Compile(_T("\\$if\\((.*)\\)[ ]*\\{([^}]*)\\}{1}([ ]*else[ ]*\\{([^}]*)\\})?"), wxRE_EXTENDED | wxRE_NEWLINE);
     m_re_ifsp.Compile(_T("[^=!<>]+|(([^=!<>]+)[ ]*(=|==|!=|>|<|>=|<=)[ ]*([^=!<>]+))"), wxRE_EXTENDED | wxRE_NEWLINE);
     m_re_script.Compile(_T("(\\[\\[(.*)\\]\\])"), wxRE_EXTENDED | wxRE_NEWLINE);
     m_uVarMan = Manager::Get()->GetUserVariableManager();
     srand(time(0));
-    assert(m_re_unx.IsValid());
-    assert(m_re_dos.IsValid());
 }
 
 void MacrosManager::ClearProjectKeys()
 {
 //    Manager::Get()->GetLogManager()->DebugLog(_T("clear"));
     macros.clear();
+    m_expanded.clear(); // expansions of the cleared variables
 
     macros[_T("AMP")]   = _T("&");
     macros[_T("CODEBLOCKS")] = m_AppPath;
@@ -143,6 +146,8 @@ void MacrosManager::ClearProjectKeys()
 
 void MacrosManager::RecalcVars(cbProject* project,EditorBase* editor,ProjectBuildTarget* target)
 {
+    m_expanded.clear();
+
     if(!editor)
     {
         m_ActiveEditorFilename = wxEmptyString;
@@ -326,13 +331,19 @@ void MacrosManager::RecalcVars(cbProject* project,EditorBase* editor,ProjectBuil
 
 
 void MacrosManager::ReplaceMacros(wxString& buffer, ProjectBuildTarget* target, bool subrequest)
+{
+    DoReplaceMacros(buffer, target, subrequest);
+}
+
+// Returns false if the result depends on anything besides the macro table (see ExpandTemplate()).
+bool MacrosManager::DoReplaceMacros(wxString& buffer, ProjectBuildTarget* target, bool subrequest)
 {
     if (buffer.IsEmpty())
-        return;
+        return true;
 
     static const wxString delim(_T("$%["));
     if( buffer.find_first_of(delim) == wxString::npos )
-        return;
+        return true;
 
     cbProject* project = target
                         ? target->GetParentProject()
@@ -355,76 +366,199 @@ void MacrosManager::ReplaceMacros(wxString& buffer, ProjectBuildTarget* target,
     if(project != m_lastProject || target != m_lastTarget || editor != m_lastEditor)
         RecalcVars(project, editor, target);
 
+    // expansions depend only on the macro table, which RecalcVars() rebuilds
+    const bool cacheable = !subrequest;
+    if(cacheable)
+    {
+        MacrosMap::iterator it = m_expanded.find(buffer);
+        if(it != m_expanded.end())
+        {
+            buffer = it->second;
+            return true;
+        }
+    }
+    const wxString key(cacheable ? buffer : wxString());
+
     wxString search;
     wxString replace;
+    bool constant = true;
 
     if(buffer.find(_T("$if")) != wxString::npos)
     while(m_re_if.Matches(buffer))
     {
         search = m_re_if.GetMatch(buffer, 0);
-        replace = EvalCondition(m_re_if.GetMatch(buffer, 1), m_re_if.GetMatch(buffer, 2), m_re_if.GetMatch(buffer, 4), target);
+        replace = EvalCondition(m_re_if.GetMatch(buffer, 1), m_re_if.GetMatch(buffer, 2), m_re_if.GetMatch(buffer, 4), target, constant);
         buffer.Replace(search, replace, false);
     }
 
+    if(buffer.find(_T("[[")) != wxString::npos)
     while(m_re_script.Matches(buffer))
     {
+        constant = false;
         search = m_re_script.GetMatch(buffer, 1);
         replace = Manager::Get()->GetScriptingManager()->LoadBufferRedirectOutput(m_re_script.GetMatch(buffer, 2));
         buffer.Replace(search, replace, false);
     }
 
-    while(m_re_unx.Matches(buffer))
+    if(m_templates.size() > max_templates)
+        m_templates.clear();
+
+    wxString out;
+    out.Alloc(buffer.length());
+    if(!ExpandTemplate(GetTemplate(buffer), out, 0))
+        constant = false;
+    buffer = out;
+
+    if(!subrequest)
     {
-        replace.Empty();
+        buffer.Replace(_T("%%"), _T("%"));
+        buffer.Replace(_T("$$"), _T("$"));
+    }
 
-        wxString search = m_re_unx.GetMatch(buffer, 2);
-        wxString var = m_re_unx.GetMatch(buffer, 3).Upper();
+    if(cacheable && constant && m_expanded.size() < max_expansions)
+        m_expanded[key] = buffer;
+    return constant;
+}
 
-        if (var.GetChar(0) == _T('#'))
+static inline bool IsMacroNameChar(wxChar c)
+{
+    return (c >= _T('A') && c <= _T('Z')) || (c >= _T('a') && c <= _T('z'))
+        || (c >= _T('0') && c <= _T('9')) || c == _T('_') || c == _T('.');
+}
+
+// length of the variable name "#?[A-Za-z_0-9.]+" starting at pos, 0 if there is none
+static size_t MacroNameLength(const wxString& str, size_t pos)
+{
+    const size_t len = str.length();
+    size_t end = pos;
+    if(end < len && str[end] == _T('#'))
+        ++end;
+    const size_t first = end;
+    while(end < len && IsMacroNameChar(str[end]))
+        ++end;
+    return end == first ? 0 : end - pos;
+}
+
+// Splits str into literal text and $VAR / $(VAR) / ${VAR} / %VAR% references in one pass.
+// A reference matches what the old $VAR and %VAR% regexes matched: "$$" and "%%" never start one,
+// and the ')', '}', ' ', '/' or '\\' following a $ reference is part of it.
+static void CompileMacroTemplate(const wxString& str, MacroTemplate& tpl)
+{
+    static const wxString unx_trail(_T(")} /\\"));
+
+    const size_t len = str.length();
+    size_t textStart = 0;
+    size_t i = 0;
+
+    while(i < len)
+    {
+        const wxChar c = str[i];
+        if((c != _T('$') && c != _T('%')) || (i > textStart && str[i - 1] == c))
         {
-            replace = UnixFilename(m_uVarMan->Replace(var));
+            ++i;
+            continue;
+        }
+
+        size_t nameStart = i + 1;
+        size_t end;
+        size_t nameLen;
+        wxChar trail = 0;
+
+        if(c == _T('$'))
+        {
+            if(nameStart < len && (str[nameStart] == _T('(') || str[nameStart] == _T('{')) && MacroNameLength(str, nameStart + 1))
+                ++nameStart;
+            nameLen = MacroNameLength(str, nameStart);
+            if(!nameLen)
+            {
+                ++i;
+                continue;
+            }
+            end = nameStart + nameLen;
+            if(end < len && unx_trail.find(str[end]) != wxString::npos)
+            {
+                if(str[end] != _T(')') && str[end] != _T('}'))
+                    trail = str[end];
+                ++end;
+            }
         }
         else
         {
-            if(var.compare(const_COIN) == 0)
-                replace.assign(1u, rand() & 1 ? _T('1') : _T('0'));
-            else if(var.compare(const_RANDOM) == 0)
-                replace = wxString::Format(_T("%d"), rand() & 0xffff);
-            else
+            nameLen = MacroNameLength(str, nameStart);
+            if(!nameLen || nameStart + nameLen >= len || str[nameStart + nameLen] != _T('%'))
             {
-                MacrosMap::iterator it;
-                if((it = macros.find(var)) != macros.end())
-                    replace = it->second;
+                ++i;
+                continue;
             }
+            end = nameStart + nameLen + 1;
         }
 
-        const wxChar l = search.Last(); // make non-braced variables work
-        if(l == _T('/') || l == _T('\\') || l == _T('$') || l == _T(' '))
-            replace.append(l);
-
-        if (replace.IsEmpty())
-            wxGetEnv(var, &replace);
+        if(i > textStart)
+        {
+            MacroToken text = { false, str.Mid(textStart, i - textStart), 0 };
+            tpl.push_back(text);
+        }
+        MacroToken var = { true, str.Mid(nameStart, nameLen).Upper(), trail };
+        tpl.push_back(var);
+        textStart = i = end;
+    }
 
-        buffer.Replace(search, replace, false);
+    if(textStart < len)
+    {
+        MacroToken text = { false, str.Mid(textStart), 0 };
+        tpl.push_back(text);
     }
+}
+
+const MacroTemplate& MacrosManager::GetTemplate(const wxString& str)
+{
+    MacroTemplateMap::iterator it = m_templates.find(str);
+    if(it != m_templates.end())
+        return it->second;
+
+    MacroTemplate& tpl = m_templates[str];
+    CompileMacroTemplate(str, tpl);
+    return tpl;
+}
 
-    while(m_re_dos.Matches(buffer))
+// Appends the expansion of tpl to out. Values are expanded in turn, as the old regex loops
+// did by rescanning the buffer. Returns false if the result depends on anything besides
+// the macro table (global variables, the environment, COIN, RANDOM, scripts).
+bool MacrosManager::ExpandTemplate(const MacroTemplate& tpl, wxString& out, int depth)
+{
+    static const wxString delim(_T("$%"));
+
+    bool constant = true;
+    wxString replace;
+
+    for(MacroTemplate::const_iterator tok = tpl.begin(); tok != tpl.end(); ++tok)
     {
-        replace.Empty();
+        if(!tok->isVar)
+        {
+            out << tok->text;
+            continue;
+        }
 
-        wxString search = m_re_dos.GetMatch(buffer, 2);
-        wxString var = m_re_dos.GetMatch(buffer, 3).Upper();
+        const wxString& var = tok->text;
+        replace.Empty();
 
         if (var.GetChar(0) == _T('#'))
         {
             replace = UnixFilename(m_uVarMan->Replace(var));
+            constant = false;
         }
         else
         {
             if(var.compare(const_COIN) == 0)
+            {
                 replace.assign(1u, rand() & 1 ? _T('1') : _T('0'));
+                constant = false;
+            }
             else if(var.compare(const_RANDOM) == 0)
+            {
                 replace = wxString::Format(_T("%d"), rand() & 0xffff);
+                constant = false;
+            }
             else
             {
                 MacrosMap::iterator it;
@@ -433,28 +567,37 @@ void MacrosManager::ReplaceMacros(wxString& buffer, ProjectBuildTarget* target,
             }
         }
 
+        if(tok->trail) // make non-braced variables work
+            replace.append(tok->trail);
+
         if (replace.IsEmpty())
+        {
             wxGetEnv(var, &replace);
+            constant = false;
+        }
 
-        buffer.Replace(search, replace, false);
-    }
-
-
-    if(!subrequest)
-    {
-        buffer.Replace(_T("%%"), _T("%"));
-        buffer.Replace(_T("$$"), _T("$"));
+        // a self-referencing value used to hang the regex loops; leave it unexpanded instead
+        if(depth < max_depth && replace.find_first_of(delim) != wxString::npos)
+        {
+            if(!ExpandTemplate(GetTemplate(replace), out, depth + 1))
+                constant = false;
+        }
+        else
+            out << replace;
     }
+    return constant;
 }
 
-wxString MacrosManager::EvalCondition(const wxString& in_cond, const wxString& true_clause, const wxString& false_clause, ProjectBuildTarget* target)
+// constant is set to false if the condition depends on anything besides the macro table
+wxString MacrosManager::EvalCondition(const wxString& in_cond, const wxString& true_clause, const wxString& false_clause, ProjectBuildTarget* target, bool& constant)
 {
     enum condition_codes {EQ = 1, LT = 2, GT = 4, NE = 8};
 
     wxString cond(in_cond);
     wxString result;
 
-    ReplaceMacros(cond, target, true);
+    if(!DoReplaceMacros(cond, target, true))
+        constant = false;
 
     if(!m_re_ifsp.Matches(in_cond))
         return false_clause;
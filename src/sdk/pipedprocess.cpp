@@ -133,6 +133,7 @@ PipedProcess::PipedProcess(void** pvThis, wxEvtHandler* parent, int id, bool pip
 	m_Parent(parent),
 	m_Id(id),
 	m_Pid(0),
+	m_PollInput(true),
 	m_pvThis(pvThis)
 {
 	wxSetWorkingDirectory(UnixFilename(dir));
@@ -172,6 +173,8 @@ void PipedProcess::SendString(const wxString& text)
 void PipedProcess::ForfeitStreams()
 {
     char buf[4096];
+    if (!m_PollInput)
+        return; // the streams are drained by whoever reads them
     if (IsErrorAvailable())
     {
         wxInputStream *in = GetErrorStream();
@@ -190,6 +193,9 @@ bool PipedProcess::HasInput()
 {
     bool hasInput = false;
 
+    if (!m_PollInput)
+        return false;
+
     if (IsErrorAvailable())
     {
         cbTextInputStream serr(*GetErrorStream());
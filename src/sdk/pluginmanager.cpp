@@ -53,12 +53,20 @@
 #include <wx/filesys.h>
 #include <wx/progdlg.h>
 #include <wx/utils.h>
+#include <wx/filefn.h>
 #include <wx/filename.h>
 
 #include <wx/wfstream.h>
 #include <wx/zipstrm.h>
 #include <wx/txtstrm.h>
+#include <wx/stopwatch.h>
+#include <wx/thread.h>
+#include <wx/log.h>
 
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "cbthreadpool.h"
 #include "filefilters.h"
 #include "tinyxml/tinyxml.h"
 
@@ -173,6 +181,95 @@ namespace LibLoader
     }
 };
 
+namespace
+{
+    // bump when the format changes
+    const char manifestCacheMagic[] = "CBMANIFESTS1\n";
+
+    wxString GetManifestCacheFilename()
+    {
+        return ConfigManager::GetFolder(sdConfig) + wxFILE_SEP_PATH + _T("plugin_manifests.cache");
+    }
+
+    // reads manifest.xml from a plugin's resource (zip) file
+    bool ReadManifest(const wxString& resource, std::string& contents)
+    {
+        // open the file ourselves: wxFFileInputStream would log failures
+        FILE* fp = wxFopen(resource, _T("rb"));
+        if (!fp)
+            return false;
+
+        bool found = false;
+        {
+            wxFFileInputStream file(fp);
+            wxZipInputStream zip(file);
+            while (wxZipEntry* entry = zip.GetNextEntry())
+            {
+                found = entry->GetName(wxPATH_UNIX) == _T("manifest.xml");
+                delete entry;
+                if (found)
+                    break;
+            }
+            if (found)
+            {
+                char buf[4096];
+                while (zip.Read(buf, sizeof(buf)).LastRead() > 0)
+                    contents.append(buf, zip.LastRead());
+            }
+        }
+        fclose(fp);
+        return found;
+    }
+
+    struct ManifestJob
+    {
+        wxString resource;
+        std::string* contents;
+        bool found;
+        bool done;
+    };
+
+#if wxCHECK_VERSION(2, 9, 1)
+    // reads a manifest in a worker thread
+    class ReadManifestTask : public cbThreadedTask
+    {
+        public:
+            ReadManifestTask(ManifestJob& job, wxMutex& mutex)
+                : m_Job(job),
+                m_Mutex(mutex),
+                m_Resource(job.resource.c_str()) // deep copy, wxString isn't thread-safe
+            {
+            }
+
+            int Execute()
+            {
+                // wxZipInputStream logs corrupt archives; since wx2.9.1 this only
+                // silences the current thread (older wx reads on the main thread)
+                wxLogNull noLog;
+                std::string contents;
+                bool found = !TestDestroy() && ReadManifest(m_Resource, contents);
+
+                wxMutexLocker lock(m_Mutex);
+                m_Job.contents->swap(contents);
+                m_Job.found = found;
+                m_Job.done = true;
+                return 0;
+            }
+
+        private:
+            ManifestJob& m_Job;
+            wxMutex& m_Mutex;
+            wxString m_Resource;
+    };
+
+    bool IsDone(const ManifestJob& job, wxMutex& mutex)
+    {
+        wxMutexLocker lock(mutex);
+        return job.done;
+    }
+#endif
+}
+
 //static
 bool PluginManager::s_SafeMode = false;
 
@@ -183,7 +280,8 @@ END_EVENT_TABLE()
 // class constructor
 PluginManager::PluginManager()
     : m_pCurrentlyLoadingLib(0),
-    m_pCurrentlyLoadingManifestDoc(0)
+    m_pCurrentlyLoadingManifestDoc(0),
+    m_ManifestCacheLoaded(false)
 {
     Manager::Get()->GetAppWindow()->PushEventHandler(this);
 }
@@ -953,6 +1051,185 @@ void PluginManager::ReadExtraFilesFromManifestFile(const wxString& pluginFilenam
     }
 }
 
+void PluginManager::ReadManifests(const wxArrayString& pluginFilenames, std::vector<std::string>& manifests)
+{
+    LoadManifestCache();
+
+    manifests.assign(pluginFilenames.GetCount(), std::string());
+    std::vector<ManifestJob> jobs(pluginFilenames.GetCount());
+    std::vector<wxStructStat> stats(pluginFilenames.GetCount());
+    size_t toRead = 0;
+    for (size_t i = 0; i < pluginFilenames.GetCount(); ++i)
+    {
+        ManifestJob& job = jobs[i];
+        job.contents = &manifests[i];
+        job.found = false;
+        job.done = true;
+
+        // find plugin's resource file
+        // (pluginFilename contains no path info)
+        wxFileName fname(pluginFilenames[i]);
+        fname.SetExt(_T("zip"));
+        wxString actual = fname.GetFullName();
+
+        // remove 'lib' prefix from plugin name (if any)
+        if (!platform::windows && actual.StartsWith(_T("lib")))
+            actual.Remove(0, 3);
+
+        job.resource = ConfigManager::LocateDataFile(actual, sdPluginsUser | sdDataUser | sdPluginsGlobal | sdDataGlobal);
+        if (job.resource.IsEmpty())
+        {
+            Manager::Get()->GetLogManager()->LogError(_T("Plugin resource not found: ") + fname.GetFullName());
+            continue;
+        }
+
+        // the cached manifest is good as long as the resource has the same size and modification time
+        if (wxStat(job.resource, &stats[i]) == 0)
+        {
+            ManifestCache::iterator it = m_ManifestCache.find(job.resource);
+            if (it != m_ManifestCache.end() &&
+                it->second.modified == (long)stats[i].st_mtime &&
+                it->second.size == (long)stats[i].st_size)
+            {
+                manifests[i] = it->second.contents;
+                job.found = true;
+                continue;
+            }
+        }
+        else
+            stats[i].st_mtime = 0; // not cached
+
+        job.done = false;
+        ++toRead;
+    }
+
+    if (toRead == 0)
+        return;
+
+#if wxCHECK_VERSION(2, 9, 1)
+    wxMutex mutex;
+    cbThreadPool pool(this);
+    pool.BatchBegin();
+    for (size_t i = 0; i < jobs.size(); ++i)
+    {
+        if (!jobs[i].done)
+            pool.AddTask(new ReadManifestTask(jobs[i], mutex), true);
+    }
+    pool.BatchEnd();
+
+    for (size_t i = 0; i < jobs.size(); ++i)
+    {
+        while (!IsDone(jobs[i], mutex))
+            wxMilliSleep(1);
+    }
+    // the tasks are done, wait for the threads to let go of them too
+    while (!pool.Done())
+        wxMilliSleep(1);
+#else
+    // wxLog isn't thread-safe before wx2.9.1 and a corrupt zip logs an error
+    for (size_t i = 0; i < jobs.size(); ++i)
+    {
+        if (!jobs[i].done)
+            jobs[i].found = ReadManifest(jobs[i].resource, manifests[i]);
+    }
+#endif
+
+    for (size_t i = 0; i < jobs.size(); ++i)
+    {
+        const ManifestJob& job = jobs[i];
+        if (job.resource.IsEmpty())
+            continue;
+        if (!job.found)
+        {
+            Manager::Get()->GetLogManager()->LogError(_T("No plugin manifest file in resource: ") + job.resource);
+            manifests[i].clear();
+            continue;
+        }
+        if (stats[i].st_mtime != 0)
+        {
+            CachedManifest& cached = m_ManifestCache[job.resource];
+            cached.modified = (long)stats[i].st_mtime;
+            cached.size = (long)stats[i].st_size;
+            cached.contents = manifests[i];
+        }
+    }
+    SaveManifestCache();
+}
+
+void PluginManager::LoadManifestCache()
+{
+    if (m_ManifestCacheLoaded)
+        return;
+    m_ManifestCacheLoaded = true;
+
+    FILE* fp = wxFopen(GetManifestCacheFilename(), _T("rb"));
+    if (!fp)
+        return;
+    std::string data;
+    char buf[16384];
+    size_t len;
+    while ((len = fread(buf, 1, sizeof(buf), fp)) > 0)
+        data.append(buf, len);
+    fclose(fp);
+
+    // <magic>
+    // then for each manifest:
+    // <modified> <size> <length> <resource, UTF-8>\n<length bytes of manifest>\n
+    const size_t magicLen = sizeof(manifestCacheMagic) - 1;
+    if (data.compare(0, magicLen, manifestCacheMagic) != 0)
+        return; // unknown version, start over
+
+    size_t pos = magicLen;
+    while (pos < data.length())
+    {
+        size_t eol = data.find('\n', pos);
+        if (eol == std::string::npos)
+            break;
+        std::string line = data.substr(pos, eol - pos);
+        pos = eol + 1;
+
+        char* end;
+        long modified = strtol(line.c_str(), &end, 10);
+        long size = strtol(end, &end, 10);
+        long length = strtol(end, &end, 10);
+        if (*end != ' ' || length < 0 || (size_t)length > data.length() - pos)
+            break; // damaged, keep what's been read so far
+
+        CachedManifest& cached = m_ManifestCache[cbC2U(end + 1)];
+        cached.modified = modified;
+        cached.size = size;
+        cached.contents = data.substr(pos, length);
+        pos += length + 1;
+    }
+}
+
+void PluginManager::SaveManifestCache()
+{
+    std::string data(manifestCacheMagic);
+    char buf[64];
+    for (ManifestCache::iterator it = m_ManifestCache.begin(); it != m_ManifestCache.end(); ++it)
+    {
+        // forget about uninstalled plugins
+        if (!wxFileExists(it->first))
+            continue;
+        const CachedManifest& cached = it->second;
+        sprintf(buf, "%ld %ld %ld ", cached.modified, cached.size, (long)cached.contents.length());
+        data += buf;
+        data += (const char*)cbU2C(it->first);
+        data += '\n';
+        data += cached.contents;
+        data += '\n';
+    }
+
+    wxString filename = GetManifestCacheFilename();
+    FILE* fp = wxFopen(filename, _T("wb"));
+    if (!fp)
+        return;
+    bool ok = fwrite(data.data(), 1, data.length(), fp) == data.length();
+    if (fclose(fp) != 0 || !ok)
+        wxRemoveFile(filename); // don't leave a partial cache around
+}
+
 int PluginManager::ScanForPlugins(const wxString& path)
 {
     static const wxString PluginsMask = platform::windows ? _T("*.dll") : _T("*.so");
@@ -980,8 +1257,11 @@ int PluginManager::ScanForPlugins(const wxString& path)
         }
     }
 
+    wxStopWatch timer;
+
+    // first list the plugins...
+    wxArrayString filenames;
     wxString filename;
-    wxString failed;
     bool ok = dir.GetFirst(&filename, PluginsMask, wxDIR_FILES);
     while (ok)
     {
@@ -1004,20 +1284,39 @@ int PluginManager::ScanForPlugins(const wxString& path)
                 continue;
             }
         }
+        filenames.Add(filename);
+        ok = dir.GetNext(&filename);
+    }
+    long listTime = timer.Time();
+
+    // ...then read all their manifests...
+    std::vector<std::string> manifests;
+    ReadManifests(filenames, manifests);
+    long manifestTime = timer.Time() - listTime;
+
+    // ...and load them, one by one: registering plugins isn't thread-safe
+    wxString failed;
+    for (size_t i = 0; i < filenames.GetCount(); ++i)
+    {
+        if (manifests[i].empty())
+            continue;
 
         // load manifest
-        m_pCurrentlyLoadingManifestDoc = 0;
-        if (ReadManifestFile(filename))
+        m_pCurrentlyLoadingManifestDoc = new TiXmlDocument;
+        if (m_pCurrentlyLoadingManifestDoc->Parse(manifests[i].c_str()) && ReadManifestFile(filenames[i]))
         {
-            if (LoadPlugin(path + _T('/') + filename))
+            if (LoadPlugin(path + _T('/') + filenames[i]))
                 ++count;
             else
-                failed << _T('\n') << filename;
+                failed << _T('\n') << filenames[i];
         }
         delete m_pCurrentlyLoadingManifestDoc;
         m_pCurrentlyLoadingManifestDoc = 0;
-        ok = dir.GetNext(&filename);
     }
+    long loadTime = timer.Time() - listTime - manifestTime;
+
+    Manager::Get()->GetLogManager()->DebugLog(F(_T("Plugins in %s: listed in %ld ms, manifests read in %ld ms, libraries loaded in %ld ms"),
+                                                path.wx_str(), listTime, manifestTime, loadTime));
     Manager::Get()->GetLogManager()->Log(F(_("Loaded %d plugins"), count));
     if (!failed.IsEmpty())
     {
@@ -28,9 +28,6 @@
 
 #include "compiler.h"
 
-#include <wx/listimpl.cpp>
-WX_DEFINE_LIST(FilesList);
-
 ProjectFile::ProjectFile(cbProject* prj) :
     compile(false),
     link(false),
@@ -112,9 +109,7 @@ void ProjectFile::RemoveBuildTarget(const wxString& targetName)
         ProjectBuildTarget* target = project->GetBuildTarget(targetName);
         if (target)
         {
-            wxFilesListNode* node = target->m_Files.Find(this);
-            if (node)
-                target->m_Files.Erase(node);
+            target->m_Files.DeleteObject(this);
         }
     }
 
@@ -32,6 +32,7 @@
 #include "filefilters.h"
 #include "projectloader.h"
 #include "projectloader_hooks.h"
+#include "projectsnapshot.h"
 #include "annoyingdialog.h"
 #include "configmanager.h"
 #include "tinyxml/tinywxuni.h"
@@ -64,13 +65,23 @@ bool ProjectLoader::Open(const wxString& filename, TiXmlElement** ppExtensions)
     if (!pMsg)
         return false;
 
-    wxStopWatch sw;
     pMsg->DebugLog(_T("Loading project file..."));
     TiXmlDocument doc;
-    if (!TinyXML::LoadDocument(filename, &doc))
+    if (!ProjectSnapshot::LoadDocument(filename, ProjectSnapshot::GetSnapshotFilename(filename), &doc))
+        return false;
+
+    return Open(filename, &doc, ppExtensions);
+}
+
+bool ProjectLoader::Open(const wxString& filename, TiXmlDocument* pDoc, TiXmlElement** ppExtensions)
+{
+    LogManager* pMsg = Manager::Get()->GetLogManager();
+    if (!pMsg || !pDoc)
         return false;
 
-    pMsg->DebugLog(_T("Parsing project file..."));
+    wxStopWatch sw;
+    TiXmlDocument& doc = *pDoc;
+    pMsg->DebugLog(_T("Parsing project file ") + filename + _T("..."));
     TiXmlElement* root;
     TiXmlElement* proj;
 
@@ -853,6 +864,13 @@ void ProjectLoader::DoUnits(TiXmlElement* parentNode)
 {
     Manager::Get()->GetLogManager()->DebugLog(_T("Loading project files..."));
     m_pProject->BeginAddFiles();
+
+    // what AddFile() worked out for the units the last time
+    ProjectFileStates cachedStates;
+    ProjectSnapshot::LoadFileStates(m_pProject, cachedStates);
+    ProjectFileStates states;
+    bool statesChanged = false;
+
     int count = 0;
     TiXmlElement* unit = parentNode->FirstChildElement("Unit");
     while (unit)
@@ -860,7 +878,30 @@ void ProjectLoader::DoUnits(TiXmlElement* parentNode)
         wxString filename = cbC2U(unit->Attribute("filename"));
         if (!filename.IsEmpty())
         {
-            ProjectFile* file = m_pProject->AddFile(-1, UnixFilename(filename));
+            filename = UnixFilename(filename);
+            ProjectFile* file = 0;
+            ProjectFileStates::iterator cached = cachedStates.find(filename);
+            if (cached != cachedStates.end())
+            {
+                file = m_pProject->AddFile(cached->second);
+                states[filename] = cached->second;
+            }
+            else
+            {
+                file = m_pProject->AddFile(-1, filename);
+                statesChanged = true;
+                // files generating other files are worked out every time
+                if (file && file->generatedFiles.empty() && !file->autoGeneratedBy)
+                {
+                    ProjectFileState& state = states[filename];
+                    state.relativeFilename = file->relativeFilename;
+                    state.fullFilename = file->file.GetFullPath();
+                    state.compilerVar = file->compilerVar;
+                    state.compile = file->compile;
+                    state.link = file->link;
+                }
+            }
+
             if (!file)
                 Manager::Get()->GetLogManager()->DebugLog(_T("Can't load file ") + filename);
             else
@@ -872,6 +913,8 @@ void ProjectLoader::DoUnits(TiXmlElement* parentNode)
 
         unit = unit->NextSiblingElement("Unit");
     }
+    if (statesChanged || states.size() != cachedStates.size())
+        ProjectSnapshot::SaveFileStates(m_pProject, states);
     m_pProject->EndAddFiles();
     Manager::Get()->GetLogManager()->DebugLog(F(_T("%d files loaded"), count));
 }
@@ -65,6 +65,7 @@
 #include "projectdepsdlg.h"
 #include "multiselectdlg.h"
 #include "filefilters.h"
+#include "filewatcher.h"
 #include "confirmreplacedlg.h"
 #include "projectfileoptionsdlg.h"
 
@@ -123,6 +124,7 @@ int idMenuTreeSaveAsWorkspace = wxNewId();
 int idMenuTreeCloseWorkspace = wxNewId();
 int idMenuAddVirtualFolder = wxNewId();
 int idMenuDeleteVirtualFolder = wxNewId();
+int idProjectManagerFilesChanged = wxNewId();
 
 static const int idMenuFindFile = wxNewId();
 static const int idNB = wxNewId();
@@ -187,6 +189,7 @@ BEGIN_EVENT_TABLE(ProjectManager, wxEvtHandler)
     EVT_MENU(idMenuTreeSaveWorkspace, ProjectManager::OnSaveWorkspace)
     EVT_MENU(idMenuTreeSaveAsWorkspace, ProjectManager::OnSaveAsWorkspace)
     EVT_MENU(idMenuTreeCloseWorkspace, ProjectManager::OnCloseWorkspace)
+    EVT_MENU(idProjectManagerFilesChanged, ProjectManager::OnProjectFilesChanged)
     EVT_MENU(idMenuAddVirtualFolder, ProjectManager::OnAddVirtualFolder)
     EVT_MENU(idMenuDeleteVirtualFolder, ProjectManager::OnDeleteVirtualFolder)
     EVT_MENU(idMenuAddFile, ProjectManager::OnAddFileToProject)
@@ -229,7 +232,8 @@ ProjectManager::ProjectManager()
     m_IsClosingWorkspace(false),
     m_InitialDir(_T("")),
     m_isCheckingForExternallyModifiedProjects(false),
-    m_CanSendWorkspaceChanged(false)
+    m_CanSendWorkspaceChanged(false),
+    m_pWatcher(0)
 {
     m_pNotebook = new wxFlatNotebook(Manager::Get()->GetAppWindow(), idNB);
     m_pNotebook->SetWindowStyleFlag(Manager::Get()->GetConfigManager(_T("app"))->ReadInt(_T("/environment/project_tabs_style"), wxFNB_NO_X_BUTTON));
@@ -248,6 +252,7 @@ ProjectManager::ProjectManager()
     InitPane();
 
     m_pFileGroups = new FilesGroupsAndMasks;
+    m_pWatcher = new FileWatcher(this, idProjectManagerFilesChanged);
 
     ConfigManager *cfg = Manager::Get()->GetConfigManager(_T("project_manager"));
     m_TreeCategorize = cfg->ReadBool(_T("/categorize_tree"), true);
@@ -271,6 +276,9 @@ ProjectManager::~ProjectManager()
     // in this case, the app has already un-hooked us, so no need to do it ourselves...
 //    Manager::Get()->GetAppWindow()->RemoveEventHandler(this);
 
+    delete m_pWatcher;
+    m_pWatcher = 0;
+
     delete m_pWorkspace;
     m_pWorkspace = 0;
 
@@ -743,7 +751,7 @@ wxMenu* ProjectManager::GetProjectMenu()
     return result;
 }
 
-cbProject* ProjectManager::LoadProject(const wxString& filename, bool activateIt)
+cbProject* ProjectManager::LoadProject(const wxString& filename, bool activateIt, TiXmlDocument* doc)
 {
     cbProject* result = 0;
     if (!wxFileExists(filename) || !BeginLoadingProject())
@@ -768,7 +776,7 @@ cbProject* ProjectManager::LoadProject(const wxString& filename, bool activateIt
 
         if (FileTypeOf(filename) == ftCodeBlocksProject)
         {
-            project = new cbProject(filename);
+            project = new cbProject(filename, doc);
 
             // We need to do this because creating cbProject allows the app to be
             // closed in the middle of the operation. So the class destructor gets
@@ -932,6 +940,7 @@ bool ProjectManager::CloseProject(cbProject* project, bool dontsave, bool refres
 
     RemoveProjectFromAllDependencies(project);
     m_pProjects->Remove(project);
+    UpdateWatchedProjects();
 
     // moved here from cbProject's destructor, because by then
     // the list of project files was already emptied...
@@ -1088,6 +1097,7 @@ bool ProjectManager::LoadWorkspace(const wxString& filename)
         return false;
     m_pWorkspace = new cbWorkspace(filename);
     EndLoadingWorkspace();
+    UpdateWatchedProjects();
 
     return m_pWorkspace && m_pWorkspace->IsOK();
 }
@@ -1099,7 +1109,9 @@ bool ProjectManager::SaveWorkspace()
 
 bool ProjectManager::SaveWorkspaceAs(const wxString& filename)
 {
-    return GetWorkspace()->SaveAs(filename);
+    bool ret = GetWorkspace()->SaveAs(filename);
+    UpdateWatchedProjects();
+    return ret;
 }
 
 bool ProjectManager::QueryCloseWorkspace()
@@ -1150,6 +1162,7 @@ bool ProjectManager::CloseWorkspace()
 
         delete m_pWorkspace;
         m_pWorkspace = 0;
+        UpdateWatchedProjects();
 
         if (m_pTree)
         {
@@ -2529,6 +2542,18 @@ void ProjectManager::CheckForExternallyModifiedProjects()
         return;
     m_isCheckingForExternallyModifiedProjects = true;
 
+    // only the project files which may have changed need to be checked
+    UpdateWatchedProjects(); // projects may have been renamed
+    wxArrayString changedFiles;
+    m_pWatcher->GetChanges(changedFiles);
+
+    // a reloaded workspace reloads all its projects too
+    if (CheckForExternallyModifiedWorkspace(changedFiles))
+    {
+        m_isCheckingForExternallyModifiedProjects = false;
+        return;
+    }
+
     // check also the projects (TO DO : what if we gonna reload while compiling/debugging)
     // TODO : make sure the same project is the active one again
     ProjectManager* ProjectMgr = Manager::Get()->GetProjectManager();
@@ -2545,6 +2570,8 @@ void ProjectManager::CheckForExternallyModifiedProjects()
         for(unsigned int idxProject = 0; idxProject < ProjectPointers.size(); ++idxProject)
         {
             cbProject* pProject = ProjectPointers[idxProject];
+            if (changedFiles.Index(pProject->GetFilename()) == wxNOT_FOUND)
+                continue;
             wxFileName fname(pProject->GetFilename());
             wxDateTime last = fname.GetModificationTime();
             if(last.IsLaterThan(pProject->GetLastModificationTime()))
@@ -2572,6 +2599,7 @@ void ProjectManager::CheckForExternallyModifiedProjects()
                 }
                 else if (ret == crCancel)
                 {
+                    m_pWatcher->Requeue(changedFiles); // check again next time
                     break;
                 }
                 else if (ret == crNo)
@@ -2584,6 +2612,60 @@ void ProjectManager::CheckForExternallyModifiedProjects()
     m_isCheckingForExternallyModifiedProjects = false;
 } // end of CheckForExternallyModifiedProjects
 
+bool ProjectManager::CheckForExternallyModifiedWorkspace(const wxArrayString& changedFiles)
+{
+    if (!m_pWorkspace || m_pWorkspace->IsDefault() || IsLoadingOrClosing())
+        return false;
+    wxString filename = m_pWorkspace->GetFilename();
+    if (changedFiles.Index(filename) == wxNOT_FOUND || !wxFileExists(filename))
+        return false;
+    if (!wxFileName(filename).GetModificationTime().IsLaterThan(m_pWorkspace->GetLastModificationTime()))
+        return false;
+
+    wxString msg;
+    msg.Printf(_("Workspace %s is modified outside the IDE...\nDo you want to reload it (you will lose any unsaved work)?"),
+               filename.c_str());
+    if (cbMessageBox(msg, _("Reload Workspace?"), wxICON_QUESTION | wxYES_NO) != wxID_YES)
+    {
+        m_pWorkspace->Touch();
+        return false;
+    }
+    if (!CloseWorkspace())
+        return false;
+    LoadWorkspace(filename);
+    return true;
+}
+
+void ProjectManager::UpdateWatchedProjects()
+{
+    if (!m_pWatcher)
+        return;
+
+    wxArrayString current;
+    for (size_t i = 0; i < m_pProjects->GetCount(); ++i)
+        current.Add(m_pProjects->Item(i)->GetFilename());
+    if (m_pWorkspace && !m_pWorkspace->IsDefault() && !m_pWorkspace->GetFilename().IsEmpty())
+        current.Add(m_pWorkspace->GetFilename());
+
+    for (size_t i = 0; i < m_WatchedProjects.GetCount(); ++i)
+    {
+        if (current.Index(m_WatchedProjects[i]) == wxNOT_FOUND)
+            m_pWatcher->Remove(m_WatchedProjects[i]);
+    }
+    for (size_t i = 0; i < current.GetCount(); ++i)
+    {
+        if (m_WatchedProjects.Index(current[i]) == wxNOT_FOUND)
+            m_pWatcher->Add(current[i]);
+    }
+    m_WatchedProjects = current;
+}
+
+void ProjectManager::OnProjectFilesChanged(wxCommandEvent& event)
+{
+    if (FileWatcher::ShouldCheckChanges())
+        CheckForExternallyModifiedProjects();
+}
+
 
 void ProjectManager::RemoveFilesRecursively(wxTreeItemId& sel_id)
 {
@@ -2664,6 +2746,7 @@ void ProjectManager::EndLoadingProject(cbProject* project)
         if (newAddition)
         {
             m_pProjects->Add(project);
+            UpdateWatchedProjects();
             project->LoadLayout();
         }
 
@@ -0,0 +1,593 @@
+/*
+* This file is part of Code::Blocks Studio, an open-source cross-platform IDE
+* Copyright (C) 2003  Yiannis An. Mandravellos
+*
+* This program is distributed under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or (at your option) any later version.
+*
+* $Revision$
+* $Id$
+* $HeadURL$
+*/
+
+#include "sdk_precomp.h"
+
+#ifndef CB_PRECOMP
+    #include <wx/filename.h>
+    #include <wx/string.h>
+
+    #include "cbproject.h"
+    #include "compiler.h"
+    #include "compilerfactory.h"
+    #include "configmanager.h"
+    #include "globals.h"
+    #include "manager.h"
+    #include "projectbuildtarget.h"
+#endif
+
+#include <time.h>
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "projectsnapshot.h"
+#include "tinyxml/tinyxml.h"
+
+namespace
+{
+    // bump the last character when the format changes
+    const char g_Magic[8] = { 'C', 'B', 'S', 'N', 'A', 'P', '0', '2' };
+    const char g_UnitsMagic[8] = { 'C', 'B', 'U', 'N', 'I', 'T', '0', '1' };
+    // deeper trees can't be a project file, the snapshot must be damaged
+    const int g_MaxDepth = 256;
+
+    // node kinds in the snapshot
+    enum
+    {
+        snElement = 'E',
+        snText = 'T',
+        snCData = 'C',
+        snComment = 'M',
+        snUnknown = 'U',
+        snDeclaration = 'D'
+    };
+
+    bool ReadFile(const wxString& filename, std::vector<char>& buffer)
+    {
+        FILE* fp = wxFopen(filename, _T("rb"));
+        if (!fp)
+            return false;
+
+        bool ok = fseek(fp, 0, SEEK_END) == 0;
+        long len = ok ? ftell(fp) : -1;
+        ok = len >= 0 && fseek(fp, 0, SEEK_SET) == 0;
+        if (ok)
+        {
+            buffer.resize(len);
+            ok = len == 0 || fread(&buffer[0], 1, len, fp) == (size_t)len;
+        }
+        fclose(fp);
+        return ok;
+    }
+
+    bool WriteFile(const wxString& filename, const std::string& data)
+    {
+        FILE* fp = wxFopen(filename, _T("wb"));
+        if (!fp)
+            return false;
+        bool ok = fwrite(data.data(), 1, data.size(), fp) == data.size();
+        if (fclose(fp) != 0 || !ok)
+        {
+            wxRemove(filename); // don't leave a partial file around
+            return false;
+        }
+        return true;
+    }
+
+    wxUint64 Hash(const std::string& data)
+    {
+        // 64-bit FNV-1a
+        wxUint64 hash = wxULL(14695981039346656037);
+        for (size_t i = 0; i < data.size(); ++i)
+        {
+            hash ^= (unsigned char)data[i];
+            hash *= wxULL(1099511628211);
+        }
+        return hash;
+    }
+
+    std::string ToUTF8(const wxString& str)
+    {
+        wxCharBuffer buffer = str.mb_str(wxConvUTF8);
+        return buffer.data() ? std::string(buffer.data()) : std::string();
+    }
+
+    void PutU32(std::string& out, wxUint32 value)
+    {
+        char bytes[4] = { (char)(value & 0xff), (char)((value >> 8) & 0xff),
+                          (char)((value >> 16) & 0xff), (char)((value >> 24) & 0xff) };
+        out.append(bytes, 4);
+    }
+
+    void PutU64(std::string& out, wxUint64 value)
+    {
+        PutU32(out, (wxUint32)(value & 0xffffffff));
+        PutU32(out, (wxUint32)(value >> 32));
+    }
+
+    void PutString(std::string& out, const std::string& str)
+    {
+        PutU32(out, str.size());
+        out += str;
+    }
+
+    /** Reads what the Put*() functions wrote, checking everything it reads. */
+    class BinaryReader
+    {
+        public:
+            BinaryReader(const std::vector<char>& data)
+                : m_Ptr(data.empty() ? 0 : &data[0]),
+                m_End(m_Ptr + data.size())
+            {
+            }
+
+            bool Magic(const char* magic, size_t len)
+            {
+                if (m_End - m_Ptr < (ptrdiff_t)len || memcmp(m_Ptr, magic, len) != 0)
+                    return false;
+                m_Ptr += len;
+                return true;
+            }
+
+            bool U32(wxUint32& value)
+            {
+                if (m_End - m_Ptr < 4)
+                    return false;
+                const unsigned char* p = (const unsigned char*)m_Ptr;
+                value = p[0] | (p[1] << 8) | (p[2] << 16) | ((wxUint32)p[3] << 24);
+                m_Ptr += 4;
+                return true;
+            }
+
+            bool U64(wxUint64& value)
+            {
+                wxUint32 low, high;
+                if (!U32(low) || !U32(high))
+                    return false;
+                value = ((wxUint64)high << 32) | low;
+                return true;
+            }
+
+            bool String(std::string& str)
+            {
+                wxUint32 len;
+                if (!U32(len) || len > (wxUint32)(m_End - m_Ptr))
+                    return false;
+                str.assign(m_Ptr, len);
+                m_Ptr += len;
+                return true;
+            }
+
+            bool Byte(char& value)
+            {
+                if (m_Ptr == m_End)
+                    return false;
+                value = *m_Ptr++;
+                return true;
+            }
+
+            size_t Left() const { return m_End - m_Ptr; }
+            bool AtEnd() const { return m_Ptr == m_End; }
+
+        private:
+            const char* m_Ptr;
+            const char* m_End;
+    };
+
+    /** What the snapshot of a project file was made from. */
+    struct SnapshotKey
+    {
+        std::string path; // UTF-8
+        wxUint64 size;
+        wxUint64 mtime;
+        bool condensed;
+    };
+
+    bool GetSnapshotKey(const wxString& filename, SnapshotKey& key)
+    {
+        wxStructStat st;
+        if (wxStat(filename, &st) != 0)
+            return false;
+        key.path = ToUTF8(filename);
+        key.size = st.st_size;
+        key.mtime = st.st_mtime;
+        key.condensed = TiXmlBase::IsWhiteSpaceCondensed();
+        return true;
+    }
+
+    /** Writes the snapshot: a header, a table of unique strings and the node tree. */
+    class SnapshotWriter
+    {
+        public:
+            void Header(const SnapshotKey& key)
+            {
+                m_Header.assign(g_Magic, sizeof(g_Magic));
+                PutString(m_Header, key.path);
+                PutU64(m_Header, key.size);
+                PutU64(m_Header, key.mtime);
+                PutU32(m_Header, key.condensed ? 1 : 0);
+            }
+
+            void Children(const TiXmlNode* parent)
+            {
+                wxUint32 count = 0;
+                for (const TiXmlNode* node = parent->FirstChild(); node; node = node->NextSibling())
+                    ++count;
+                PutU32(m_Nodes, count);
+                for (const TiXmlNode* node = parent->FirstChild(); node; node = node->NextSibling())
+                    Node(node);
+            }
+
+            bool Save(const wxString& filename)
+            {
+                std::string data = m_Header;
+                PutU32(data, m_StringList.size());
+                for (size_t i = 0; i < m_StringList.size(); ++i)
+                    PutString(data, *m_StringList[i]);
+                data += m_Nodes;
+                return WriteFile(filename, data);
+            }
+
+        private:
+            void Node(const TiXmlNode* node)
+            {
+                switch (node->Type())
+                {
+                    case TiXmlNode::TINYXML_ELEMENT:
+                    {
+                        const TiXmlElement* element = node->ToElement();
+                        m_Nodes += (char)snElement;
+                        String(element->Value());
+                        wxUint32 count = 0;
+                        for (const TiXmlAttribute* attr = element->FirstAttribute(); attr; attr = attr->Next())
+                            ++count;
+                        PutU32(m_Nodes, count);
+                        for (const TiXmlAttribute* attr = element->FirstAttribute(); attr; attr = attr->Next())
+                        {
+                            String(attr->Name());
+                            String(attr->Value());
+                        }
+                        Children(element);
+                        break;
+                    }
+                    case TiXmlNode::TINYXML_TEXT:
+                        m_Nodes += (char)(node->ToText()->CDATA() ? snCData : snText);
+                        String(node->Value());
+                        break;
+                    case TiXmlNode::TINYXML_COMMENT:
+                        m_Nodes += (char)snComment;
+                        String(node->Value());
+                        break;
+                    case TiXmlNode::TINYXML_DECLARATION:
+                    {
+                        const TiXmlDeclaration* decl = node->ToDeclaration();
+                        m_Nodes += (char)snDeclaration;
+                        String(decl->Version());
+                        String(decl->Encoding());
+                        String(decl->Standalone());
+                        break;
+                    }
+                    default:
+                        m_Nodes += (char)snUnknown;
+                        String(node->Value());
+                        break;
+                }
+            }
+
+            void String(const char* str)
+            {
+                std::pair<StringMap::iterator, bool> res = m_Strings.insert(StringMap::value_type(str, m_StringList.size()));
+                if (res.second)
+                    m_StringList.push_back(&res.first->first);
+                PutU32(m_Nodes, res.first->second);
+            }
+
+            typedef std::map<std::string, wxUint32> StringMap;
+            StringMap m_Strings;
+            std::vector<const std::string*> m_StringList;
+            std::string m_Header;
+            std::string m_Nodes;
+    };
+
+    /** Rebuilds the document from a snapshot. */
+    class SnapshotReader
+    {
+        public:
+            SnapshotReader(const std::vector<char>& data)
+                : m_Reader(data)
+            {
+            }
+
+            bool Header(const SnapshotKey& key)
+            {
+                std::string path;
+                wxUint64 size, mtime;
+                wxUint32 condensed;
+                return m_Reader.Magic(g_Magic, sizeof(g_Magic)) &&
+                       m_Reader.String(path) && path == key.path &&
+                       m_Reader.U64(size) && size == key.size &&
+                       m_Reader.U64(mtime) && mtime == key.mtime &&
+                       m_Reader.U32(condensed) && condensed == (key.condensed ? 1U : 0U);
+            }
+
+            bool Strings()
+            {
+                wxUint32 count;
+                if (!m_Reader.U32(count) || count > m_Reader.Left() / 4)
+                    return false;
+                m_Strings.resize(count);
+                for (wxUint32 i = 0; i < count; ++i)
+                {
+                    if (!m_Reader.String(m_Strings[i]))
+                        return false;
+                }
+                return true;
+            }
+
+            bool Children(TiXmlNode* parent, int depth)
+            {
+                wxUint32 count;
+                if (depth > g_MaxDepth || !m_Reader.U32(count))
+                    return false;
+                for (wxUint32 i = 0; i < count; ++i)
+                {
+                    if (!Node(parent, depth))
+                        return false;
+                }
+                return true;
+            }
+
+            bool AtEnd() const { return m_Reader.AtEnd(); }
+
+        private:
+            bool Node(TiXmlNode* parent, int depth)
+            {
+                char kind;
+                const char* value;
+                if (!m_Reader.Byte(kind) || !String(value))
+                    return false;
+
+                switch (kind)
+                {
+                    case snElement:
+                    {
+                        TiXmlElement* element = new TiXmlElement(value);
+                        parent->LinkEndChild(element);
+                        wxUint32 count;
+                        if (!m_Reader.U32(count))
+                            return false;
+                        for (wxUint32 i = 0; i < count; ++i)
+                        {
+                            const char* name;
+                            const char* attrValue;
+                            if (!String(name) || !String(attrValue))
+                                return false;
+                            element->SetAttribute(name, attrValue);
+                        }
+                        return Children(element, depth + 1);
+                    }
+                    case snText:
+                    case snCData:
+                    {
+                        TiXmlText* text = new TiXmlText(value);
+                        text->SetCDATA(kind == snCData);
+                        parent->LinkEndChild(text);
+                        return true;
+                    }
+                    case snComment:
+                        parent->LinkEndChild(new TiXmlComment(value));
+                        return true;
+                    case snUnknown:
+                    {
+                        TiXmlUnknown* unknown = new TiXmlUnknown;
+                        unknown->SetValue(value);
+                        parent->LinkEndChild(unknown);
+                        return true;
+                    }
+                    case snDeclaration:
+                    {
+                        const char* encoding;
+                        const char* standalone;
+                        if (!String(encoding) || !String(standalone))
+                            return false;
+                        parent->LinkEndChild(new TiXmlDeclaration(value, encoding, standalone));
+                        return true;
+                    }
+                    default:
+                        return false;
+                }
+            }
+
+            bool String(const char*& str)
+            {
+                wxUint32 index;
+                if (!m_Reader.U32(index) || index >= m_Strings.size())
+                    return false;
+                str = m_Strings[index].c_str();
+                return true;
+            }
+
+            BinaryReader m_Reader;
+            std::vector<std::string> m_Strings;
+    };
+
+    /** The cache file for project file @c filename, with extension @c ext
+      * (or an empty string, if caching is disabled). */
+    wxString GetCacheFilename(const wxString& filename, const wxString& ext)
+    {
+        if (!Manager::Get()->GetConfigManager(_T("app"))->ReadBool(_T("/environment/project_snapshots"), true))
+            return wxEmptyString;
+
+        wxString dir = ConfigManager::GetFolder(sdConfig) + wxFILE_SEP_PATH + _T("projects");
+        if (!wxDirExists(dir) && !wxFileName::Mkdir(dir, 0755, wxPATH_MKDIR_FULL))
+            return wxEmptyString;
+
+        // the project's path would make a too long file name: use its hash
+        wxFileName fname(filename);
+        fname.Normalize();
+        wxUint64 hash = Hash(ToUTF8(fname.GetFullPath()));
+        return dir + wxFILE_SEP_PATH +
+               wxString::Format(_T("%08x%08x."), (unsigned)(hash >> 32), (unsigned)(hash & 0xffffffff)) + ext;
+    }
+
+    /** What cbProject::AddFile() depends on, besides the file name. */
+    wxUint64 GetFileStatesKey(cbProject* project)
+    {
+        std::string key = ToUTF8(project->GetFilename());
+        key += '\0';
+
+        // the compilers used by the project...
+        key += ToUTF8(project->GetCompilerID()) + '\0';
+        for (int i = 0; i < project->GetBuildTargetsCount(); ++i)
+            key += ToUTF8(project->GetBuildTarget(i)->GetCompilerID()) + '\0';
+
+        // ...and the compilers set up (their tools tell which files generate other files)
+        for (size_t i = 0; i < CompilerFactory::GetCompilersCount(); ++i)
+        {
+            Compiler* compiler = CompilerFactory::GetCompiler(i);
+            if (!compiler)
+                continue;
+            key += ToUTF8(compiler->GetID()) + '\0';
+            const CommandType types[] = { ctCompileObjectCmd, ctCompileResourceCmd };
+            for (size_t t = 0; t < sizeof(types) / sizeof(types[0]); ++t)
+            {
+                const CompilerToolsVector& tools = compiler->GetCommandToolsVector(types[t]);
+                for (size_t n = 0; n < tools.size(); ++n)
+                {
+                    key += ToUTF8(GetStringFromArray(tools[n].extensions)) + '\0';
+                    key += ToUTF8(GetStringFromArray(tools[n].generatedFiles)) + '\0';
+                }
+            }
+        }
+        return Hash(key);
+    }
+}
+
+wxString ProjectSnapshot::GetSnapshotFilename(const wxString& filename)
+{
+    return GetCacheFilename(filename, _T("snapshot"));
+}
+
+bool ProjectSnapshot::LoadDocument(const wxString& filename, const wxString& snapshotFilename, TiXmlDocument* doc)
+{
+    if (!doc)
+        return false;
+
+    SnapshotKey key;
+    bool useSnapshot = !snapshotFilename.IsEmpty() && GetSnapshotKey(filename, key);
+
+    std::vector<char> snapshot;
+    if (useSnapshot && ReadFile(snapshotFilename, snapshot))
+    {
+        SnapshotReader reader(snapshot);
+        if (reader.Header(key) &&
+            reader.Strings() &&
+            reader.Children(doc, 0) &&
+            reader.AtEnd())
+        {
+            return true;
+        }
+        // stale or damaged, parse the file instead
+        doc->Clear();
+    }
+
+    std::vector<char> contents;
+    if (!ReadFile(filename, contents))
+        return false;
+    contents.push_back('\0');
+    doc->Parse(&contents[0]);
+    if (doc->Error() || !useSnapshot)
+        return true; // let the caller report errors, there's nothing to cache
+
+    // the file may be changed again within the same second, keeping its size:
+    // the snapshot couldn't tell (it will be saved the next time)
+    if ((wxUint64)contents.size() - 1 != key.size || (time_t)key.mtime >= time(0) - 1)
+        return true;
+
+    SnapshotWriter writer;
+    writer.Header(key);
+    writer.Children(doc);
+    writer.Save(snapshotFilename);
+    return true;
+}
+
+bool ProjectSnapshot::LoadFileStates(cbProject* project, ProjectFileStates& states)
+{
+    wxString filename = GetCacheFilename(project->GetFilename(), _T("units"));
+    std::vector<char> data;
+    if (filename.IsEmpty() || !ReadFile(filename, data))
+        return false;
+
+    BinaryReader reader(data);
+    wxUint64 key;
+    wxUint32 count;
+    if (!reader.Magic(g_UnitsMagic, sizeof(g_UnitsMagic)) ||
+        !reader.U64(key) || key != GetFileStatesKey(project) ||
+        !reader.U32(count))
+    {
+        return false;
+    }
+
+    for (wxUint32 i = 0; i < count; ++i)
+    {
+        std::string unit, relativeFilename, fullFilename, compilerVar;
+        char flags;
+        if (!reader.String(unit) ||
+            !reader.String(relativeFilename) ||
+            !reader.String(fullFilename) ||
+            !reader.String(compilerVar) ||
+            !reader.Byte(flags))
+        {
+            states.clear();
+            return false;
+        }
+
+        ProjectFileState& state = states[cbC2U(unit.c_str())];
+        state.relativeFilename = cbC2U(relativeFilename.c_str());
+        state.fullFilename = cbC2U(fullFilename.c_str());
+        state.compilerVar = cbC2U(compilerVar.c_str());
+        state.compile = (flags & 1) != 0;
+        state.link = (flags & 2) != 0;
+    }
+    if (!reader.AtEnd())
+    {
+        states.clear();
+        return false;
+    }
+    return true;
+}
+
+void ProjectSnapshot::SaveFileStates(cbProject* project, const ProjectFileStates& states)
+{
+    wxString filename = GetCacheFilename(project->GetFilename(), _T("units"));
+    if (filename.IsEmpty())
+        return;
+
+    std::string data(g_UnitsMagic, sizeof(g_UnitsMagic));
+    PutU64(data, GetFileStatesKey(project));
+    PutU32(data, states.size());
+    for (ProjectFileStates::const_iterator it = states.begin(); it != states.end(); ++it)
+    {
+        const ProjectFileState& state = it->second;
+        PutString(data, ToUTF8(it->first));
+        PutString(data, ToUTF8(state.relativeFilename));
+        PutString(data, ToUTF8(state.fullFilename));
+        PutString(data, ToUTF8(state.compilerVar));
+        data += (char)((state.compile ? 1 : 0) | (state.link ? 2 : 0));
+    }
+    WriteFile(filename, data);
+}
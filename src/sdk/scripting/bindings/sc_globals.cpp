@@ -12,6 +12,7 @@
 #endif
 
 #include "sc_base_types.h"
+#include "scripting/squirrel/sqmem.h"
 
 #include <wx/colordlg.h>
 #include <wx/numdlg.h>
@@ -113,6 +114,21 @@ namespace ScriptBindings
         return wxGetTextFromUser(message, caption, default_value);
     }
 
+    wxString GetScriptMemoryStats()
+    {
+        SQMemStats stats;
+        sq_vm_getmemstats(&stats);
+        wxString msg = F(_T("Live: %lu bytes (peak: %lu bytes), pools: %lu bytes, large blocks: %lu\n"),
+                         (unsigned long)stats.live_bytes, (unsigned long)stats.peak_bytes,
+                         (unsigned long)stats.pool_bytes, (unsigned long)stats.large_allocs);
+        for (int i = 0; i < SQ_MEM_NUM_CLASSES; ++i)
+        {
+            if (stats.class_hits[i])
+                msg << F(_T("%4d bytes: %lu\n"), (i + 1) * SQ_MEM_GRANULARITY, (unsigned long)stats.class_hits[i]);
+        }
+        return msg;
+    }
+
     void Register_Globals()
     {
         // global funcs
@@ -156,6 +172,7 @@ namespace ScriptBindings
         SqPlus::RegisterGlobal(InfoWindow::Display, "InfoWindow");
 
         SquirrelVM::CreateFunctionGlobal(IsNull, "IsNull", "*");
+        SqPlus::RegisterGlobal(GetScriptMemoryStats, "GetScriptMemoryStats");
 
         // now for some wx globals (utility) functions
         SqPlus::RegisterGlobal(wxLaunchDefaultBrowser, "wxLaunchDefaultBrowser");
@@ -2,10 +2,160 @@
 	see copyright notice in squirrel.h
 */
 #include "sqpcheader.h"
-void *sq_vm_malloc(SQUnsignedInteger size){	return malloc(size); }
 
-// C::B patch: Make the compiler happy by commenting unused variables
-void *sq_vm_realloc(void *p, SQUnsignedInteger /*oldsize*/, SQUnsignedInteger size){ return realloc(p, size); }
+// C::B patch: Serve small blocks from size-classed pools
+//
+// Scripts create lots of small tables, strings and closures, and Squirrel
+// always passes the block's size when freeing or reallocating it. So small
+// blocks are rounded up to a multiple of SQ_MEM_GRANULARITY and served from
+// free lists, one per size class, carved out of larger chunks (the same way
+// as BlockAllocator in blockallocated.h). Bigger blocks go to libc.
+// Like the VM itself, this is not thread-safe.
 
-// C::B patch: Make the compiler happy by commenting unused variables
-void sq_vm_free(void *p, SQUnsignedInteger /*size*/){	free(p); }
+namespace
+{
+	const SQUnsignedInteger chunk_size = 16 * 1024;
+
+	struct FreeBlock
+	{
+		FreeBlock *next;
+	};
+
+	struct Chunk
+	{
+		Chunk *next;
+	};
+
+	// chunk data starts after the header, keeping the blocks aligned
+	const SQUnsignedInteger chunk_header = (sizeof(Chunk) + SQ_MEM_GRANULARITY - 1) & ~(SQ_MEM_GRANULARITY - 1);
+
+	FreeBlock *free_lists[SQ_MEM_NUM_CLASSES];
+	Chunk *chunks = NULL;
+	SQMemStats stats;
+
+	inline SQUnsignedInteger SizeClass(SQUnsignedInteger size)
+	{
+		return size ? (size - 1) / SQ_MEM_GRANULARITY : 0;
+	}
+
+	inline bool IsPooled(SQUnsignedInteger size)
+	{
+		return size <= SQ_MEM_NUM_CLASSES * SQ_MEM_GRANULARITY;
+	}
+
+	bool AddChunk(SQUnsignedInteger cls)
+	{
+		char *mem = (char *)malloc(chunk_size);
+		if(!mem)
+			return false;
+		Chunk *chunk = (Chunk *)mem;
+		chunk->next = chunks;
+		chunks = chunk;
+		stats.pool_bytes += chunk_size;
+
+		SQUnsignedInteger block_size = (cls + 1) * SQ_MEM_GRANULARITY;
+		SQUnsignedInteger count = (chunk_size - chunk_header) / block_size;
+		char *p = mem + chunk_header;
+		for(SQUnsignedInteger i = 0; i < count; ++i, p += block_size) {
+			FreeBlock *block = (FreeBlock *)p;
+			block->next = free_lists[cls];
+			free_lists[cls] = block;
+		}
+		return true;
+	}
+
+	inline void Allocated(SQUnsignedInteger size)
+	{
+		stats.live_bytes += size;
+		if(stats.live_bytes > stats.peak_bytes)
+			stats.peak_bytes = stats.live_bytes;
+	}
+
+	// gives the chunks back, if nothing lives in them anymore
+	struct ChunkReleaser
+	{
+		~ChunkReleaser()
+		{
+			if(stats.live_blocks != 0)
+				return;
+			while(chunks) {
+				Chunk *next = chunks->next;
+				free(chunks);
+				chunks = next;
+			}
+		}
+	} releaser;
+}
+
+void *sq_vm_malloc(SQUnsignedInteger size)
+{
+	if(!IsPooled(size)) {
+		void *p = malloc(size);
+		if(p) {
+			++stats.large_allocs;
+			Allocated(size);
+		}
+		return p;
+	}
+
+	SQUnsignedInteger cls = SizeClass(size);
+	if(!free_lists[cls] && !AddChunk(cls))
+		return NULL;
+	FreeBlock *block = free_lists[cls];
+	free_lists[cls] = block->next;
+	++stats.class_hits[cls];
+	++stats.live_blocks;
+	Allocated(size);
+	return block;
+}
+
+void *sq_vm_realloc(void *p, SQUnsignedInteger oldsize, SQUnsignedInteger size)
+{
+	if(!p)
+		return sq_vm_malloc(size);
+
+	bool oldpooled = IsPooled(oldsize);
+	bool newpooled = IsPooled(size);
+	if(!oldpooled && !newpooled) {
+		void *newp = realloc(p, size);
+		if(newp) {
+			stats.live_bytes -= oldsize;
+			Allocated(size);
+		}
+		return newp;
+	}
+	if(oldpooled && newpooled && SizeClass(oldsize) == SizeClass(size)) {
+		stats.live_bytes -= oldsize;
+		Allocated(size);
+		return p; // still fits
+	}
+
+	void *newp = sq_vm_malloc(size);
+	if(!newp)
+		return NULL;
+	memcpy(newp, p, oldsize < size ? oldsize : size);
+	sq_vm_free(p, oldsize);
+	return newp;
+}
+
+void sq_vm_free(void *p, SQUnsignedInteger size)
+{
+	if(!p)
+		return;
+	stats.live_bytes -= size;
+	if(!IsPooled(size)) {
+		free(p);
+		return;
+	}
+
+	SQUnsignedInteger cls = SizeClass(size);
+	FreeBlock *block = (FreeBlock *)p;
+	block->next = free_lists[cls];
+	free_lists[cls] = block;
+	--stats.live_blocks;
+}
+
+void sq_vm_getmemstats(SQMemStats *out)
+{
+	*out = stats;
+}
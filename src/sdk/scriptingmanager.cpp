@@ -17,6 +17,8 @@
     #include <wx/regex.h>
 #endif
 
+#include <wx/filefn.h>
+
 #include "crc32.h"
 #include "menuitemsmanager.h"
 #include "scripting/sqplus/sqplus.h"
@@ -29,6 +31,27 @@ template<> bool  Mgr<ScriptingManager>::isShutdown = false;
 static wxString s_ScriptErrors;
 static wxString capture;
 
+// Compiled scripts are kept around: build scripts run on every build, for
+// every target, and macros can contain script snippets ("[[...]]") which
+// run on every expansion. Running a compiled closure again is the same as
+// compiling its source again and running that.
+
+// script files, by filename; valid while the file's time and size don't change
+struct CompiledScript
+{
+    long modified;
+    long size;
+    SquirrelObject script;
+};
+typedef std::map<wxString, CompiledScript> CompiledScripts;
+static CompiledScripts s_CompiledScripts;
+
+// buffers, by debug name and contents
+typedef std::map<wxString, SquirrelObject> CompiledBuffers;
+static CompiledBuffers s_CompiledBuffers;
+// snippets may be generated, don't let them pile up
+static const size_t s_MaxCompiledBuffers = 256;
+
 static void ScriptsPrintFunc(HSQUIRRELVM v, const SQChar * s, ...)
 {
     static SQChar temp[2048];
@@ -93,6 +116,10 @@ ScriptingManager::~ScriptingManager()
     }
     Manager::Get()->GetConfigManager(_T("security"))->Write(_T("/trusted_scripts"), myMap);
 
+    // release the compiled scripts while the VM is still there
+    s_CompiledScripts.clear();
+    s_CompiledBuffers.clear();
+
     SquirrelVM::Shutdown();
 }
 
@@ -133,31 +160,63 @@ bool ScriptingManager::LoadScript(const wxString& filename)
 			}
 		}
     }
-    // read file
-    wxString contents = cbReadFileContents(f);
+
+    // compile it, unless it's done already
+    wxStructStat st;
+    bool hasStat = wxStat(fname, &st) == 0;
+    CompiledScripts::iterator it = s_CompiledScripts.find(fname);
+    if (it == s_CompiledScripts.end() ||
+        !hasStat ||
+        it->second.modified != (long)st.st_mtime ||
+        it->second.size != (long)st.st_size)
+    {
+        wxString contents = cbReadFileContents(f);
+        SquirrelObject script;
+        if (!CompileBuffer(contents, fname, script))
+        {
+            if (it != s_CompiledScripts.end())
+                s_CompiledScripts.erase(it);
+            return false;
+        }
+        CompiledScript& compiled = s_CompiledScripts[fname];
+        compiled.modified = hasStat ? (long)st.st_mtime : -1;
+        compiled.size = hasStat ? (long)st.st_size : -1;
+        compiled.script = script;
+        it = s_CompiledScripts.find(fname);
+    }
+
+    // run a copy: the script may load others and change the cache
+    SquirrelObject script = it->second.script;
     m_CurrentlyRunningScriptFile = fname;
-    bool ret = LoadBuffer(contents, fname);
+    bool ret = RunScript(script, fname);
     m_CurrentlyRunningScriptFile.Clear();
     return ret;
 }
 
 bool ScriptingManager::LoadBuffer(const wxString& buffer, const wxString& debugName)
 {
-    // includes guard to avoid recursion
-    wxString incName = UnixFilename(debugName);
-    if (m_IncludeSet.find(incName) != m_IncludeSet.end())
+    wxString key = debugName + _T('\n') + buffer;
+    CompiledBuffers::iterator it = s_CompiledBuffers.find(key);
+    if (it == s_CompiledBuffers.end())
     {
-        Manager::Get()->GetLogManager()->LogWarning(F(_T("Ignoring Include(\"%s\") because it would cause recursion..."), incName.wx_str()));
-        return true;
+        SquirrelObject script;
+        if (!CompileBuffer(buffer, debugName, script))
+            return false;
+        if (s_CompiledBuffers.size() >= s_MaxCompiledBuffers)
+            s_CompiledBuffers.clear();
+        it = s_CompiledBuffers.insert(CompiledBuffers::value_type(key, script)).first;
     }
-    m_IncludeSet.insert(incName);
 
+    SquirrelObject script = it->second;
+    return RunScript(script, debugName);
+}
+
+bool ScriptingManager::CompileBuffer(const wxString& buffer, const wxString& debugName, SquirrelObject& script)
+{
 //    wxCriticalSectionLocker c(cs);
 
     s_ScriptErrors.Clear();
 
-    // compile script
-    SquirrelObject script;
     try
     {
         script = SquirrelVM::CompileBuffer(cbU2C(buffer), cbU2C(debugName));
@@ -165,9 +224,25 @@ bool ScriptingManager::LoadBuffer(const wxString& buffer, const wxString& debugN
     catch (SquirrelError e)
     {
         cbMessageBox(wxString::Format(_T("Filename: %s\nError: %s\nDetails: %s"), debugName.c_str(), cbC2U(e.desc).c_str(), s_ScriptErrors.c_str()), _("Script compile error"), wxICON_ERROR);
-        m_IncludeSet.erase(incName);
         return false;
     }
+    return true;
+}
+
+bool ScriptingManager::RunScript(SquirrelObject& script, const wxString& debugName)
+{
+    // includes guard to avoid recursion
+    wxString incName = UnixFilename(debugName);
+    if (m_IncludeSet.find(incName) != m_IncludeSet.end())
+    {
+        Manager::Get()->GetLogManager()->LogWarning(F(_T("Ignoring Include(\"%s\") because it would cause recursion..."), incName.wx_str()));
+        return true;
+    }
+    m_IncludeSet.insert(incName);
+
+//    wxCriticalSectionLocker c(cs);
+
+    s_ScriptErrors.Clear();
 
     // run script
     try
@@ -0,0 +1,502 @@
+/*
+* This file is part of Code::Blocks Studio, an open-source cross-platform IDE
+* Copyright (C) 2003  Yiannis An. Mandravellos
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*
+* $Revision$
+* $Id$
+* $HeadURL$
+*/
+
+#include "sdk_precomp.h"
+
+#ifndef CB_PRECOMP
+    #include <wx/regex.h>
+    #include <wx/strconv.h>
+    #include <wx/utils.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+
+#include "cbthreadpool.h"
+#include "searchinfiles.h"
+
+namespace
+{
+    const size_t g_FilesPerTask = 16;
+
+    // Scintilla's default character classes, so "match word" finds the same
+    // matches as in the editor (all non-ASCII characters are word characters)
+    enum CharClass { ccSpace, ccNewLine, ccWord, ccPunctuation };
+
+    template<typename C> inline unsigned int CharCode(C ch) { return (unsigned int)ch; }
+    template<> inline unsigned int CharCode<char>(char ch) { return (unsigned char)ch; }
+
+    template<typename C> CharClass ClassAt(const C* text, size_t pos)
+    {
+        unsigned int ch = CharCode(text[pos]);
+        if (ch == '\r' || ch == '\n')
+            return ccNewLine;
+        if (ch < 0x20 || ch == ' ')
+            return ccSpace;
+        if (ch >= 0x80 || ch == '_' ||
+            (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9'))
+            return ccWord;
+        return ccPunctuation;
+    }
+
+    template<typename C> bool IsWordStartAt(const C* text, size_t pos)
+    {
+        if (pos == 0)
+            return true;
+        CharClass cc = ClassAt(text, pos);
+        return (cc == ccWord || cc == ccPunctuation) && cc != ClassAt(text, pos - 1);
+    }
+
+    template<typename C> bool IsWordEndAt(const C* text, size_t len, size_t pos)
+    {
+        if (pos >= len)
+            return true;
+        CharClass cc = ClassAt(text, pos - 1);
+        return (cc == ccWord || cc == ccPunctuation) && cc != ClassAt(text, pos);
+    }
+
+    bool IsMultiByte(wxFontEncoding encoding)
+    {
+        switch (encoding)
+        {
+            case wxFONTENCODING_CP932:
+            case wxFONTENCODING_CP936:
+            case wxFONTENCODING_CP949:
+            case wxFONTENCODING_CP950:
+            case wxFONTENCODING_EUC_JP:
+            case wxFONTENCODING_UTF7:
+            case wxFONTENCODING_UTF16BE:
+            case wxFONTENCODING_UTF16LE:
+            case wxFONTENCODING_UTF32BE:
+            case wxFONTENCODING_UTF32LE:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    bool ReadFile(const wxString& filename, std::vector<char>& buffer)
+    {
+        // not wxFile: it would log failures from the worker thread
+        FILE* fp = wxFopen(filename, _T("rb"));
+        if (!fp)
+            return false;
+
+        // the whole file in one read; the padding zero-terminates even UTF-32
+        buffer.clear();
+        bool ok = fseek(fp, 0, SEEK_END) == 0;
+        long size = ok ? ftell(fp) : -1;
+        if (size >= 0 && fseek(fp, 0, SEEK_SET) == 0)
+        {
+            buffer.resize(size + 4, 0);
+            size_t len = size ? fread(&buffer[0], 1, size, fp) : 0;
+            buffer.resize(len);
+            ok = !ferror(fp);
+        }
+        else
+            ok = false;
+        fclose(fp);
+        buffer.insert(buffer.end(), 4, '\0');
+        return ok;
+    }
+
+    /** Finds an ASCII needle in a byte buffer (Boyer-Moore-Horspool). */
+    class ByteFinder
+    {
+        public:
+            ByteFinder(const wxString& needle, bool matchCase)
+            {
+                for (unsigned int c = 0; c < 256; ++c)
+                    m_Fold[c] = (!matchCase && c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+                for (size_t i = 0; i < needle.Length(); ++i)
+                    m_Needle += (char)m_Fold[(unsigned char)needle[i]];
+
+                size_t len = m_Needle.length();
+                for (unsigned int c = 0; c < 256; ++c)
+                    m_Shift[c] = len;
+                for (size_t i = 0; i + 1 < len; ++i)
+                    m_Shift[(unsigned char)m_Needle[i]] = len - 1 - i;
+            }
+
+            size_t Length() const { return m_Needle.length(); }
+
+            const char* Find(const char* start, const char* end) const
+            {
+                size_t len = m_Needle.length();
+                if (!len || (size_t)(end - start) < len)
+                    return 0;
+
+                const unsigned char* needle = (const unsigned char*)m_Needle.data();
+                const unsigned char* s = (const unsigned char*)start;
+                const unsigned char* last = (const unsigned char*)end - len;
+                const unsigned char lastChar = needle[len - 1];
+                while (s <= last)
+                {
+                    unsigned char c = m_Fold[s[len - 1]];
+                    if (c == lastChar)
+                    {
+                        size_t i = 0;
+                        while (i + 1 < len && m_Fold[s[i]] == needle[i])
+                            ++i;
+                        if (i + 1 >= len)
+                            return (const char*)s;
+                    }
+                    s += m_Shift[c];
+                }
+                return 0;
+            }
+        private:
+            std::string m_Needle;
+            unsigned char m_Fold[256];
+            size_t m_Shift[256];
+    };
+}
+
+/** Searches a chunk of the files. */
+class SearchInFilesTask : public cbThreadedTask
+{
+    public:
+        SearchInFilesTask(SearchInFiles* search, size_t first, size_t last, const SearchInFilesOptions& options)
+            : m_pSearch(search),
+            m_First(first),
+            m_Last(last),
+            m_Options(options),
+            m_Conv(options.encoding)
+        {
+            // own copies, for the worker thread (wxString isn't thread-safe)
+            m_Options.text = wxString(options.text.c_str());
+            // create the converter here, as it may need the (global) font mapper
+            m_Conv.IsOk();
+        }
+
+        int Execute();
+    private:
+        void SearchBytes(const char* data, size_t len, SearchInFilesHits& hits);
+        void SearchText(const wxString& text, SearchInFilesHits& hits);
+        wxString DecodeLine(const char* data, size_t len);
+        wxString Decode(const char* data, size_t len);
+
+        SearchInFiles* m_pSearch;
+        size_t m_First;
+        size_t m_Last;
+        SearchInFilesOptions m_Options;
+        wxCSConv m_Conv;
+        ByteFinder* m_pFinder;
+        wxRegEx m_RegEx;
+};
+
+int SearchInFilesTask::Execute()
+{
+    // plain ASCII text is searched for in the raw bytes, without decoding the file
+    // (unless the text has line breaks, which the line-wise search can't match anyway)
+    m_pFinder = 0;
+    bool ascii = !m_Options.regEx && !IsMultiByte(m_Options.encoding);
+    for (size_t i = 0; ascii && i < m_Options.text.Length(); ++i)
+    {
+        unsigned int ch = m_Options.text[i];
+        ascii = ch < 0x80 && ch != '\r' && ch != '\n';
+    }
+    if (ascii)
+        m_pFinder = new ByteFinder(m_Options.text, m_Options.matchCase);
+    else if (m_Options.regEx)
+    {
+        int flags = m_Options.regExFlags | wxRE_NOSUB;
+        if (!m_Options.matchCase)
+            flags |= wxRE_ICASE;
+        // the pattern was validated on the main thread, so this won't log
+        m_RegEx.Compile(m_Options.text, flags);
+    }
+
+    std::vector<char> buffer;
+    for (size_t i = m_First; i < m_Last; ++i)
+    {
+        if (TestDestroy() || m_pSearch->IsCancelled())
+            break;
+
+        SearchInFilesHits hits;
+        const SearchInFiles::File& file = m_pSearch->m_Files[i];
+        if (file.inMemory)
+            SearchText(file.contents, hits);
+        else if (ReadFile(file.filename, buffer))
+        {
+            const char* data = &buffer[0];
+            size_t len = buffer.size() - 4;
+            bool unicode = len >= 2 && ((data[0] == '\xFF' && data[1] == '\xFE') ||
+                                        (data[0] == '\xFE' && data[1] == '\xFF') ||
+                                        (len >= 4 && !memcmp(data, "\0\0\xFE\xFF", 4)));
+            if (m_pFinder && !unicode)
+            {
+                if (len >= 3 && !memcmp(data, "\xEF\xBB\xBF", 3))
+                {
+                    data += 3;
+                    len -= 3;
+                }
+                SearchBytes(data, len, hits);
+            }
+            else
+                SearchText(Decode(data, len), hits);
+        }
+        m_pSearch->SetResults(i, hits);
+    }
+
+    delete m_pFinder;
+    m_pFinder = 0;
+    return 0;
+}
+
+void SearchInFilesTask::SearchBytes(const char* data, size_t len, SearchInFilesHits& hits)
+{
+    const char* end = data + len;
+    const char* lineStart = data;
+    const char* counted = data;
+    int line = 0;
+    const char* pos = data;
+    while (const char* match = m_pFinder->Find(pos, end))
+    {
+        // count the lines up to the match ("\r\n", "\n" and "\r" all end a line)
+        for (; counted < match; ++counted)
+        {
+            if (*counted == '\n' || (*counted == '\r' && (counted + 1 == end || counted[1] != '\n')))
+            {
+                ++line;
+                lineStart = counted + 1;
+            }
+        }
+
+        size_t start = match - data;
+        size_t stop = start + m_pFinder->Length();
+        if ((m_Options.matchWord && !(IsWordStartAt(data, start) && IsWordEndAt(data, len, stop))) ||
+            (m_Options.startWord && !IsWordStartAt(data, start)))
+        {
+            pos = match + 1;
+            continue;
+        }
+
+        const char* lineEnd = match;
+        while (lineEnd < end && *lineEnd != '\r' && *lineEnd != '\n')
+            ++lineEnd;
+
+        SearchInFilesHit hit;
+        hit.line = line + 1;
+        hit.text = DecodeLine(lineStart, lineEnd - lineStart);
+        hits.push_back(hit);
+
+        // only the first match of a line is reported
+        pos = lineEnd;
+    }
+}
+
+void SearchInFilesTask::SearchText(const wxString& text, SearchInFilesHits& hits)
+{
+    const wxChar* chars = text.c_str();
+    size_t len = text.Length();
+
+    wxString haystack;
+    wxString needle = m_Options.text;
+    size_t needleLen = needle.Length();
+    size_t match = wxString::npos;
+    if (!m_Options.regEx)
+    {
+        // Lower() maps character by character, so the positions don't change
+        haystack = m_Options.matchCase ? text : text.Lower();
+        if (!m_Options.matchCase)
+            needle.MakeLower();
+        match = haystack.find(needle);
+        if (match == wxString::npos)
+            return;
+    }
+
+    size_t lineStart = 0;
+    for (int line = 1; ; ++line)
+    {
+        size_t lineEnd = lineStart;
+        while (lineEnd < len && chars[lineEnd] != _T('\r') && chars[lineEnd] != _T('\n'))
+            ++lineEnd;
+
+        bool found = false;
+        if (m_Options.regEx)
+            found = m_RegEx.IsValid() && m_RegEx.Matches(text.Mid(lineStart, lineEnd - lineStart));
+        else
+        {
+            while (match != wxString::npos && match < lineEnd)
+            {
+                size_t stop = match + needleLen;
+                if (stop <= lineEnd &&
+                    (!m_Options.matchWord || (IsWordStartAt(chars, match) && IsWordEndAt(chars, len, stop))) &&
+                    (!m_Options.startWord || IsWordStartAt(chars, match)))
+                {
+                    found = true;
+                    break;
+                }
+                match = haystack.find(needle, match + 1);
+            }
+        }
+
+        if (found)
+        {
+            SearchInFilesHit hit;
+            hit.line = line;
+            hit.text = text.Mid(lineStart, lineEnd - lineStart);
+            hits.push_back(hit);
+            if (!m_Options.regEx)
+                match = haystack.find(needle, lineEnd);
+        }
+
+        if (lineEnd >= len || (!m_Options.regEx && match == wxString::npos))
+            break;
+        if (chars[lineEnd] == _T('\r') && lineEnd + 1 < len && chars[lineEnd + 1] == _T('\n'))
+            ++lineEnd;
+        lineStart = lineEnd + 1;
+
+        if ((line & 0xffff) == 0 && (TestDestroy() || m_pSearch->IsCancelled()))
+            break;
+    }
+}
+
+wxString SearchInFilesTask::DecodeLine(const char* data, size_t len)
+{
+    if (!len)
+        return wxEmptyString;
+    wxString text(data, wxConvUTF8, len);
+    if (text.IsEmpty())
+        text = wxString(data, m_Conv, len);
+    if (text.IsEmpty())
+        text = wxString(data, wxConvISO8859_1, len);
+    return text;
+}
+
+wxString SearchInFilesTask::Decode(const char* data, size_t len)
+{
+    if (!len)
+        return wxEmptyString;
+
+    // a BOM tells it all; otherwise UTF-8 if valid, or the default encoding
+    if (len >= 4 && !memcmp(data, "\xFF\xFE\0\0", 4))
+        return wxString(data + 4, wxMBConvUTF32LE(), len - 4);
+    if (len >= 4 && !memcmp(data, "\0\0\xFE\xFF", 4))
+        return wxString(data + 4, wxMBConvUTF32BE(), len - 4);
+    if (len >= 2 && !memcmp(data, "\xFF\xFE", 2))
+        return wxString(data + 2, wxMBConvUTF16LE(), len - 2);
+    if (len >= 2 && !memcmp(data, "\xFE\xFF", 2))
+        return wxString(data + 2, wxMBConvUTF16BE(), len - 2);
+    if (len >= 3 && !memcmp(data, "\xEF\xBB\xBF", 3))
+        return wxString(data + 3, wxConvUTF8, len - 3);
+    return DecodeLine(data, len);
+}
+
+SearchInFilesOptions::SearchInFilesOptions()
+    : matchCase(false),
+    matchWord(false),
+    startWord(false),
+    regEx(false),
+    regExFlags(wxRE_BASIC),
+    encoding(wxFONTENCODING_ISO8859_1)
+{
+}
+
+SearchInFiles::SearchInFiles(wxEvtHandler* owner, int id, const SearchInFilesOptions& options)
+    : m_Options(options),
+    m_pPool(new cbThreadPool(owner, id)),
+    m_NextResult(0),
+    m_Cancelled(false)
+{
+    //ctor
+}
+
+SearchInFiles::~SearchInFiles()
+{
+    //dtor
+    Cancel();
+    delete m_pPool;
+}
+
+void SearchInFiles::AddFile(const wxString& filename)
+{
+    File file;
+    file.filename = wxString(filename.c_str());
+    file.inMemory = false;
+    file.searched = false;
+    m_Files.push_back(file);
+}
+
+void SearchInFiles::AddBuffer(const wxString& filename, const wxString& contents)
+{
+    File file;
+    file.filename = wxString(filename.c_str());
+    file.contents = wxString(contents.c_str(), contents.Length());
+    file.inMemory = true;
+    file.searched = false;
+    m_Files.push_back(file);
+}
+
+void SearchInFiles::Start()
+{
+    m_pPool->BatchBegin();
+    for (size_t first = 0; first < m_Files.size(); first += g_FilesPerTask)
+    {
+        size_t last = std::min(first + g_FilesPerTask, m_Files.size());
+        m_pPool->AddTask(new SearchInFilesTask(this, first, last, m_Options), true);
+    }
+    m_pPool->BatchEnd();
+}
+
+void SearchInFiles::Cancel()
+{
+    if (m_Cancelled)
+        return;
+    m_Cancelled = true;
+
+    // pending tasks are just dropped; the running ones stop after their current file
+    m_pPool->AbortAllTasks();
+    while (!m_pPool->Done())
+        wxMilliSleep(1);
+}
+
+bool SearchInFiles::GetNextResults(wxString& filename, SearchInFilesHits& hits)
+{
+    wxMutexLocker lock(m_Mutex);
+    if (m_NextResult >= m_Files.size() || !m_Files[m_NextResult].searched)
+        return false;
+
+    File& file = m_Files[m_NextResult++];
+    filename = file.filename;
+    hits.swap(file.hits);
+    file.hits.clear();
+    file.contents.Clear();
+    return true;
+}
+
+bool SearchInFiles::IsDone() const
+{
+    return m_Cancelled || m_NextResult >= m_Files.size();
+}
+
+void SearchInFiles::SetResults(size_t index, SearchInFilesHits& hits)
+{
+    wxMutexLocker lock(m_Mutex);
+    File& file = m_Files[index];
+    file.hits.swap(hits);
+    file.searched = true;
+}
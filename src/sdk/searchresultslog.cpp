@@ -34,7 +34,7 @@ BEGIN_EVENT_TABLE(SearchResultsLog, wxEvtHandler)
 END_EVENT_TABLE()
 
 SearchResultsLog::SearchResultsLog(const wxArrayString& titles, wxArrayInt& widths)
-    : ListCtrlLogger(titles, widths)
+    : VirtualListCtrlLogger(titles, widths)
 {
 	//ctor
 }
@@ -46,17 +46,21 @@ SearchResultsLog::~SearchResultsLog()
 
 wxWindow* SearchResultsLog::CreateControl(wxWindow* parent)
 {
-	ListCtrlLogger::CreateControl(parent);
+	VirtualListCtrlLogger::CreateControl(parent);
     control->SetId(ID_List);
     Connect(ID_List, -1, wxEVT_COMMAND_LIST_ITEM_ACTIVATED,
             (wxObjectEventFunction) (wxEventFunction) (wxCommandEventFunction)
             &SearchResultsLog::OnDoubleClick);
+    Connect(ID_List, -1, wxEVT_COMMAND_LIST_KEY_DOWN,
+            (wxObjectEventFunction) (wxEventFunction) (wxListEventFunction)
+            &SearchResultsLog::OnKeyDown);
 	control->PushEventHandler(this);
 	return control;
 };
 
 void SearchResultsLog::FocusEntry(size_t index)
 {
+    Flush();
     if (index >= 0 && index < (size_t)control->GetItemCount())
     {
         control->SetItemState(index, wxLIST_STATE_FOCUSED | wxLIST_STATE_SELECTED, wxLIST_STATE_FOCUSED | wxLIST_STATE_SELECTED);
@@ -106,3 +110,12 @@ void SearchResultsLog::OnDoubleClick(wxCommandEvent& /*event*/)
 
     SyncEditor(index);
 } // end of OnDoubleClick
+
+void SearchResultsLog::OnKeyDown(wxListEvent& event)
+{
+    // Escape stops a running "Find in files"
+    if (event.GetKeyCode() == WXK_ESCAPE)
+        Manager::Get()->GetEditorManager()->CancelFindInFiles();
+    else
+        event.Skip();
+}
@@ -23,11 +23,19 @@
     #include "logmanager.h"
     #include "cbproject.h"
     #include "globals.h"
+    #include "sdk_events.h"
     #include "workspaceloader.h"
 #endif
 
 
 
+#include <vector>
+
+#include <wx/event.h>
+#include <wx/thread.h>
+
+#include "cbthreadpool.h"
+#include "projectsnapshot.h"
 #include "tinyxml/tinyxml.h"
 #include "tinyxml/tinywxuni.h"
 
@@ -44,6 +52,170 @@ WorkspaceLoader::~WorkspaceLoader()
 inline ProjectManager* GetpMan() { return Manager::Get()->GetProjectManager(); }
 inline LogManager* GetpMsg() { return Manager::Get()->GetLogManager(); }
 
+namespace
+{
+    /** A project listed in the workspace file */
+    struct WorkspaceProject
+    {
+        WorkspaceProject() : activate(false), doc(0), parsed(false) {}
+
+        wxString filename;  // as written in the workspace file
+        wxString fullPath;
+        wxString snapshot;  // its snapshot file, if any
+        bool activate;
+        TiXmlDocument* doc; // 0 if the file couldn't be read
+        bool parsed;        // protected by the mutex passed to ParseProjectTask
+    };
+
+    /** Reads and parses one project file in a worker thread */
+    class ParseProjectTask : public cbThreadedTask
+    {
+        public:
+            ParseProjectTask(WorkspaceProject& project, wxMutex& mutex)
+                : m_Project(project),
+                m_Mutex(mutex),
+                m_Path(project.fullPath.c_str()), // deep copies, wxString isn't thread-safe
+                m_Snapshot(project.snapshot.c_str())
+            {
+            }
+
+            int Execute()
+            {
+                TiXmlDocument* doc = TestDestroy() ? 0 : ReadDocument();
+
+                wxMutexLocker lock(m_Mutex);
+                m_Project.doc = doc;
+                m_Project.parsed = true;
+                return 0;
+            }
+
+        private:
+            TiXmlDocument* ReadDocument()
+            {
+                TiXmlDocument* doc = new TiXmlDocument();
+                if (!ProjectSnapshot::LoadDocument(m_Path, m_Snapshot, doc))
+                {
+                    delete doc;
+                    return 0;
+                }
+                return doc;
+            }
+
+            WorkspaceProject& m_Project;
+            wxMutex& m_Mutex;
+            wxString m_Path;
+            wxString m_Snapshot;
+    };
+
+    bool IsParsed(const WorkspaceProject& project, wxMutex& mutex)
+    {
+        wxMutexLocker lock(mutex);
+        return project.parsed;
+    }
+
+    const int idParseProjects = wxNewId();
+
+    /** Parses the projects in a thread pool and adds them to the workspace, in order,
+      * as the pool's tasks end. Only its own events are processed while waiting for them:
+      * yielding would let the user close the workspace (or open another one) meanwhile.
+      */
+    class WorkspaceProjectsLoader : public wxEvtHandler
+    {
+        public:
+            WorkspaceProjectsLoader(std::vector<WorkspaceProject>& projects, const wxString& workspace)
+                : m_Projects(projects),
+                m_Workspace(workspace),
+                m_Next(0),
+                m_TasksEnded(0),
+                m_Done(false),
+                m_Adding(false),
+                m_Aborted(false),
+                m_Pool(this, idParseProjects)
+            {
+                Connect(idParseProjects, -1, cbEVT_THREADTASK_ENDED,
+                        (wxObjectEventFunction) (wxEventFunction) (wxCommandEventFunction)
+                        &WorkspaceProjectsLoader::OnTaskEnded);
+                Connect(idParseProjects, -1, cbEVT_THREADTASK_ALLDONE,
+                        (wxObjectEventFunction) (wxEventFunction) (wxCommandEventFunction)
+                        &WorkspaceProjectsLoader::OnTaskEnded);
+
+                m_Pool.BatchBegin();
+                for (size_t i = 0; i < m_Projects.size(); ++i)
+                    m_Pool.AddTask(new ParseProjectTask(m_Projects[i], m_Mutex), true);
+                m_Pool.BatchEnd();
+            }
+
+            /** Wait until the pool is done, with all projects added (unless loading was aborted) */
+            bool Load()
+            {
+                while (!m_Done)
+                {
+                    m_Posted.Wait();
+#if wxCHECK_VERSION(2, 9, 0)
+                    // this processes a single event, and a modal dialog's event loop may have processed it already
+                    if (HasPendingEvents())
+#endif
+                        ProcessPendingEvents();
+                }
+                return !m_Aborted;
+            }
+
+            // the pool posts its events from the worker threads
+#if wxCHECK_VERSION(2, 9, 0)
+            virtual void AddPendingEvent(const wxEvent& event)
+#else
+            virtual void AddPendingEvent(wxEvent& event)
+#endif
+            {
+                wxEvtHandler::AddPendingEvent(event);
+                m_Posted.Post();
+            }
+
+        private:
+            void OnTaskEnded(wxCommandEvent& event)
+            {
+                // the pool also says it's done when its threads start, before they get any task
+                if (event.GetEventType() == cbEVT_THREADTASK_ENDED)
+                    ++m_TasksEnded;
+                else if (m_TasksEnded == m_Projects.size())
+                    m_Done = true;
+
+                // a project's task may end before the ones of the projects listed before it
+                if (m_Adding)
+                    return; // loading a project may process pending events; the loop below goes on anyway
+                m_Adding = true;
+                while (!m_Aborted && m_Next < m_Projects.size() && IsParsed(m_Projects[m_Next], m_Mutex))
+                {
+                    if (Manager::isappShuttingDown() || !GetpMan() || !GetpMsg())
+                    {
+                        m_Aborted = true; // the remaining tasks are just left to end
+                        break;
+                    }
+
+                    const WorkspaceProject& project = m_Projects[m_Next++];
+                    cbProject* pProject = GetpMan()->LoadProject(project.fullPath, project.activate, project.doc);
+                    if(!pProject)
+                    {
+                        cbMessageBox(_("Unable to open ") + project.filename,
+                         _("Opening WorkSpace") + m_Workspace, wxICON_WARNING);
+                    }
+                }
+                m_Adding = false;
+            }
+
+            std::vector<WorkspaceProject>& m_Projects;
+            wxString m_Workspace;
+            size_t m_Next;       // the next project to add
+            size_t m_TasksEnded;
+            bool m_Done;         // all tasks have ended and the pool is idle
+            bool m_Adding;
+            bool m_Aborted;
+            wxMutex m_Mutex;
+            wxSemaphore m_Posted; // one per event posted
+            cbThreadPool m_Pool;  // last: destroyed first
+    };
+}
+
 bool WorkspaceLoader::Open(const wxString& filename, wxString& Title)
 {
     TiXmlDocument doc;
@@ -91,11 +263,10 @@ bool WorkspaceLoader::Open(const wxString& filename, wxString& Title)
         return false;
     }
 
-    // first loop to load projects
+    // first loop to collect the projects to load
+    std::vector<WorkspaceProject> projects;
     while (proj)
     {
-        if(Manager::isappShuttingDown() || !GetpMan() || !GetpMsg())
-            return false;
         wxString projectFilename = UnixFilename(cbC2U(proj->Attribute("filename")));
         if (projectFilename.IsEmpty())
         {
@@ -106,38 +277,47 @@ bool WorkspaceLoader::Open(const wxString& filename, wxString& Title)
             wxFileName fname(projectFilename);
             wxFileName wfname(filename);
             fname.MakeAbsolute(wfname.GetPath(wxPATH_GET_VOLUME | wxPATH_GET_SEPARATOR));
+
+            WorkspaceProject project;
+            project.filename = projectFilename;
+            project.fullPath = fname.GetFullPath();
+            project.snapshot = ProjectSnapshot::GetSnapshotFilename(project.fullPath);
+
             int active = 0;
             int ret = proj->QueryIntAttribute("active", &active);
             switch (ret)
             {
                 case TIXML_SUCCESS:
                     if (active == 1)
-					{
-						cbProject* pProject = GetpMan()->LoadProject(fname.GetFullPath(), true); // activate it
-						if(!pProject)
-						{
-							cbMessageBox(_("Unable to open ") + projectFilename,
-							 _("Opening WorkSpace") + filename, wxICON_WARNING);
-						}
-					}
+                    {
+                        project.activate = true;
+                        projects.push_back(project);
+                    }
                     break;
                 case TIXML_WRONG_TYPE:
                     GetpMsg()->DebugLog(F(_T("Error %s: %s"), doc.Value(), doc.ErrorDesc()));
                     GetpMsg()->DebugLog(_T("Wrong attribute type (expected 'int')"));
                     break;
                 default:
-					cbProject* pProject = GetpMan()->LoadProject(fname.GetFullPath(), false); // don't activate it
-					if(!pProject)
-					{
-						cbMessageBox(_("Unable to open ") + projectFilename,
-						 _("Opening WorkSpace") + filename, wxICON_WARNING);
-					}
+                    projects.push_back(project);
                     break;
             }
         }
         proj = proj->NextSiblingElement("Project");
     }
 
+    // read and parse all project files in the background, and add them to the workspace
+    bool loaded = true;
+    if (!projects.empty())
+    {
+        WorkspaceProjectsLoader loader(projects, filename);
+        loaded = loader.Load();
+    }
+    for (size_t i = 0; i < projects.size(); ++i)
+        delete projects[i].doc;
+    if (!loaded)
+        return false;
+
     // second loop to setup dependencies
     proj = wksp->FirstChildElement("Project");
     while (proj)
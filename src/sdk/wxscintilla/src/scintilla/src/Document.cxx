@@ -86,7 +86,37 @@ int LexInterface::LineEndTypesSupported() {
 	return 0;
 }
 
-Document::Document() {
+/* C::B begin */
+ActionDuration::ActionDuration(double duration_, double minDuration_, double maxDuration_) :
+	duration(duration_), minDuration(minDuration_), maxDuration(maxDuration_) {
+}
+
+void ActionDuration::AddSample(size_t numberActions, double durationOfActions) {
+	// Only adjust for multiple actions to avoid instability
+	if (numberActions < 8)
+		return;
+
+	// Alpha value for exponential smoothing.
+	// Most recent value contributes 25% to smoothed value.
+	const double alpha = 0.25;
+
+	const double durationOne = durationOfActions / numberActions;
+	duration = std::max(minDuration, std::min(maxDuration,
+		alpha * durationOne + (1.0 - alpha) * duration));
+}
+
+double ActionDuration::Duration() const {
+	return duration;
+}
+
+int ActionDuration::ActionsInAllowedTime(double secondsAllowed) const {
+	return static_cast<int>(secondsAllowed / duration);
+}
+/* C::B end */
+
+/* C::B begin */
+Document::Document() : durationStyleOneLine(0.00001, 0.000001, 0.0001) {
+/* C::B end */
 	refCount = 0;
 	pcf = NULL;
 #ifdef _WIN32
@@ -1644,6 +1674,59 @@ Document::CharacterExtracted Document::ExtractCharacter(int position) const {
 	}
 }
 
+/* C::B begin */
+/**
+ * Find the first position in [pos, end) holding the byte ch, or end if there is none.
+ * The two halves of the gap buffer are scanned directly with memchr (which the C
+ * libraries vectorize), instead of going through CharAt for every byte.
+ * RangePointer only moves the gap for ranges overlapping it, which these never do.
+ */
+int Document::FindByteForward(int pos, int end, char ch) {
+	const int gap = cb.GapPosition();
+	if (pos < gap && pos < end) {
+		const int partEnd = Platform::Minimum(gap, end);
+		const char *part = cb.RangePointer(pos, partEnd - pos);
+		const char *found = static_cast<const char *>(memchr(part, static_cast<unsigned char>(ch), partEnd - pos));
+		if (found)
+			return pos + static_cast<int>(found - part);
+		pos = partEnd;
+	}
+	if (pos < end) {
+		const char *part = cb.RangePointer(pos, end - pos);
+		const char *found = static_cast<const char *>(memchr(part, static_cast<unsigned char>(ch), end - pos));
+		if (found)
+			return pos + static_cast<int>(found - part);
+	}
+	return end;
+}
+
+/**
+ * Same as FindByteForward, for any of the bytes set in the 256 entry table set.
+ */
+int Document::FindByteInSetForward(int pos, int end, const bool *set) {
+	const int gap = cb.GapPosition();
+	if (pos < gap && pos < end) {
+		const int partEnd = Platform::Minimum(gap, end);
+		const unsigned char *part = reinterpret_cast<const unsigned char *>(cb.RangePointer(pos, partEnd - pos));
+		const unsigned char *partLimit = part + (partEnd - pos);
+		for (const unsigned char *p = part; p < partLimit; p++) {
+			if (set[*p])
+				return pos + static_cast<int>(p - part);
+		}
+		pos = partEnd;
+	}
+	if (pos < end) {
+		const unsigned char *part = reinterpret_cast<const unsigned char *>(cb.RangePointer(pos, end - pos));
+		const unsigned char *partLimit = part + (end - pos);
+		for (const unsigned char *p = part; p < partLimit; p++) {
+			if (set[*p])
+				return pos + static_cast<int>(p - part);
+		}
+	}
+	return end;
+}
+/* C::B end */
+
 /**
  * Find text in document, supporting both forward and backward
  * searches (just pass minPos > maxPos to do a backward search)
@@ -1680,7 +1763,21 @@ long Document::FindText(int minPos, int maxPos, const char *search,
 		if (caseSensitive) {
 			const int endSearch = (startPos <= endPos) ? endPos - lengthFind + 1 : endPos;
 			const char charStartSearch =  search[0];
+/* C::B begin */
+			// Jumping to the next occurence of the first byte only visits the positions
+			// NextCharacter would, as long as that byte can't be inside a character:
+			// true for single byte code pages and for an UTF-8 lead (or ASCII) byte.
+			const bool skipToFirstByte = forward &&
+				(!dbcsCodePage || (SC_CP_UTF8 == dbcsCodePage && !UTF8IsTrailByte(static_cast<unsigned char>(charStartSearch))));
+/* C::B end */
 			while (forward ? (pos < endSearch) : (pos >= endSearch)) {
+/* C::B begin */
+				if (skipToFirstByte) {
+					pos = FindByteForward(pos, endSearch, charStartSearch);
+					if (pos >= endSearch)
+						break;
+				}
+/* C::B end */
 				if (CharAt(pos) == charStartSearch) {
 					bool found = (pos + lengthFind) <= limitPos;
 					for (int indexSearch = 1; (indexSearch < lengthFind) && found; indexSearch++) {
@@ -1700,7 +1797,27 @@ long Document::FindText(int minPos, int maxPos, const char *search,
 				pcf->Fold(&searchThing[0], searchThing.size(), search, lengthFind));
 			char bytes[UTF8MaxBytes + 1];
 			char folded[UTF8MaxBytes * maxFoldingExpansion + 1];
+/* C::B begin */
+			// The positions where a match may start: an ASCII character matches only
+			// if it folds to the first byte searched for, other characters are checked.
+			bool startsMatch[256];
+			for (int ch = 0; ch < 256; ch++) {
+				startsMatch[ch] = true;
+				if (UTF8IsAscii(ch) && lenSearch > 0) {
+					const char mixed = static_cast<char>(ch);
+					const size_t lenFlat = pcf->Fold(folded, sizeof(folded), &mixed, 1);
+					startsMatch[ch] = (lenFlat == 0) || (folded[0] == searchThing[0]);
+				}
+			}
+/* C::B end */
 			while (forward ? (pos < endPos) : (pos >= endPos)) {
+/* C::B begin */
+				if (forward) {
+					pos = FindByteInSetForward(pos, endPos, startsMatch);
+					if (pos >= endPos)
+						break;
+				}
+/* C::B end */
 				int widthFirstCharacter = 0;
 				int posIndexDocument = pos;
 				int indexSearch = 0;
@@ -1785,7 +1902,24 @@ long Document::FindText(int minPos, int maxPos, const char *search,
 			const int endSearch = (startPos <= endPos) ? endPos - lengthFind + 1 : endPos;
 			std::vector<char> searchThing(lengthFind + 1);
 			pcf->Fold(&searchThing[0], searchThing.size(), search, lengthFind);
+/* C::B begin */
+			// The bytes which fold to the first one searched for
+			bool startsMatch[256];
+			for (int ch = 0; ch < 256; ch++) {
+				const char mixed = static_cast<char>(ch);
+				char folded[2];
+				pcf->Fold(folded, sizeof(folded), &mixed, 1);
+				startsMatch[ch] = folded[0] == searchThing[0];
+			}
+/* C::B end */
 			while (forward ? (pos < endSearch) : (pos >= endSearch)) {
+/* C::B begin */
+				if (forward) {
+					pos = FindByteInSetForward(pos, endSearch, startsMatch);
+					if (pos >= endSearch)
+						break;
+				}
+/* C::B end */
 				bool found = (pos + lengthFind) <= limitPos;
 				for (int indexSearch = 0; (indexSearch < lengthFind) && found; indexSearch++) {
 					char ch = CharAt(pos + indexSearch);
@@ -1894,6 +2028,19 @@ void Document::EnsureStyledTo(int pos) {
 	}
 }
 
+/* C::B begin */
+// Style to pos, timing it to estimate how long styling a line takes.
+void Document::StyleToAdjustingLineDuration(int pos) {
+	const int lineFirst = LineFromPosition(GetEndStyled());
+	ElapsedTime etStyling;
+	EnsureStyledTo(pos);
+	const double durationStyling = etStyling.Duration();
+	const int lineLast = LineFromPosition(GetEndStyled());
+	if (lineLast > lineFirst)
+		durationStyleOneLine.AddSample(lineLast - lineFirst, durationStyling);
+}
+/* C::B end */
+
 void Document::LexerChanged() {
 	// Tell the watchers the lexer has changed.
 	for (std::vector<WatcherWithUserData>::iterator it = watchers.begin(); it != watchers.end(); ++it) {
@@ -195,6 +195,23 @@ public:
 	}
 };
 
+/* C::B begin */
+/**
+ * Estimates how long an action, such as styling or wrapping a line, takes, so
+ * that work done in one go can be bounded by time instead of by amount.
+ */
+class ActionDuration {
+	double duration;
+	const double minDuration;
+	const double maxDuration;
+public:
+	ActionDuration(double duration_, double minDuration_, double maxDuration_);
+	void AddSample(size_t numberActions, double durationOfActions);
+	double Duration() const;
+	int ActionsInAllowedTime(double secondsAllowed) const;
+};
+/* C::B end */
+
 struct RegexError : public std::runtime_error {
 	RegexError() : std::runtime_error("regex failure") {}
 };
@@ -256,6 +273,10 @@ public:
 
 	DecorationList decorations;
 
+/* C::B begin */
+	ActionDuration durationStyleOneLine;
+/* C::B end */
+
 	Document();
 	virtual ~Document();
 
@@ -413,6 +434,9 @@ public:
 	bool SCI_METHOD SetStyles(int length, const char *styles);
 	int GetEndStyled() const { return endStyled; }
 	void EnsureStyledTo(int pos);
+/* C::B begin */
+	void StyleToAdjustingLineDuration(int pos);
+/* C::B end */
 	void LexerChanged();
 	int GetStyleClock() const { return styleClock; }
 	void IncrementStyleClock();
@@ -457,6 +481,10 @@ private:
 	bool IsWordStartAt(int pos) const;
 	bool IsWordEndAt(int pos) const;
 	bool IsWordAt(int start, int end) const;
+/* C::B begin */
+	int FindByteForward(int pos, int end, char ch);
+	int FindByteInSetForward(int pos, int end, const bool *set);
+/* C::B end */
 
 	void NotifyModifyAttempt();
 	void NotifySavePoint(bool atSavePoint);
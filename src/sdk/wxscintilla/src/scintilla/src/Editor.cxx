@@ -99,7 +99,9 @@ static inline bool IsAllSpacesOrTabs(const char *s, unsigned int len) {
 	return true;
 }
 
-Editor::Editor() {
+/* C::B begin */
+Editor::Editor() : durationWrapOneLine(0.00001, 0.000001, 0.0001) {
+/* C::B end */
 	ctrlID = 0;
 
 	stylesValid = false;
@@ -172,6 +174,9 @@ Editor::Editor() {
 	paintAbandonedByStyling = false;
 	paintingAllText = false;
 	willRedrawAll = false;
+/* C::B begin */
+	needIdleStyling = false;
+/* C::B end */
 
 	modEventMask = SC_MODEVENTMASKALL;
 
@@ -847,7 +852,9 @@ void Editor::ScrollTo(int line, bool moveThumb) {
 		SetTopLine(topLineNew);
 		// Optimize by styling the view as this will invalidate any needed area
 		// which could abort the initial paint if discovered later.
-		StyleToPositionInView(PositionAfterArea(GetClientRectangle()));
+/* C::B begin */
+		StyleAreaBounded(GetClientRectangle(), true);
+/* C::B end */
 #ifndef UNDER_CE
 		// Perform redraw rather than scroll if many lines would be redrawn anyway.
 		if (performBlit) {
@@ -1395,7 +1402,11 @@ bool Editor::WrapOneLine(Surface *surface, int lineToWrap) {
 // Perform  wrapping for a subset of the lines needing wrapping.
 // wsAll: wrap all lines which need wrapping in this single call
 // wsVisible: wrap currently visible lines
-// wsIdle: wrap one page + 100 lines
+/* C::B begin */
+// wsIdle: wrap as many lines as fit in a short time, but at least one page + 50 lines
+// Except for wsAll, the lines to wrap are first styled for a bounded time only, so
+// wrapping stops at the first line not styled yet and goes on from there later.
+/* C::B end */
 // Return true if wrapping occurred.
 bool Editor::WrapLines(enum wrapScope ws) {
 	int goodTopLine = topLine;
@@ -1440,13 +1451,42 @@ bool Editor::WrapLines(enum wrapScope ws) {
 				return false;
 			}
 		} else if (ws == wsIdle) {
-			lineToWrapEnd = lineToWrap + LinesOnScreen() + 100;
+/* C::B begin */
+			// Try to keep time taken by wrapping reasonable so interaction remains smooth.
+			const double secondsAllowed = 0.01;
+			const int linesInAllowedTime = Platform::Clamp(
+				durationWrapOneLine.ActionsInAllowedTime(secondsAllowed),
+				LinesOnScreen() + 50, 0x10000);
+			lineToWrapEnd = lineToWrap + linesInAllowedTime;
+/* C::B end */
 		}
 		const int lineEndNeedWrap = std::min(wrapPending.end, pdoc->LinesTotal());
 		lineToWrapEnd = std::min(lineToWrapEnd, lineEndNeedWrap);
 
 		// Ensure all lines being wrapped are styled.
-		pdoc->EnsureStyledTo(pdoc->LineStart(lineToWrapEnd));
+/* C::B begin */
+		const int posWrapEnd = pdoc->LineStart(lineToWrapEnd);
+		// Lines from lineRewrap on are wrapped before they're styled
+		int lineRewrap = lineToWrapEnd;
+		if (ws == wsAll) {
+			pdoc->EnsureStyledTo(posWrapEnd);
+		} else if (pdoc->GetEndStyled() < posWrapEnd) {
+			const int endStyledBefore = pdoc->GetEndStyled();
+			pdoc->StyleToAdjustingLineDuration(PositionAfterMaxStyling(posWrapEnd, ws == wsVisible));
+			// Wrap anyway when styling can't progress, e.g. while the lexer runs
+			if ((pdoc->GetEndStyled() < posWrapEnd) && (pdoc->GetEndStyled() > endStyledBefore)) {
+				// The line holding the end of styling isn't completely styled
+				const int lineEndStyled = pdoc->LineFromPosition(pdoc->GetEndStyled());
+				if (ws == wsVisible) {
+					// Visible lines are wrapped now, and again once idle styling reaches them
+					lineRewrap = std::max(lineToWrap, lineEndStyled);
+					StartIdleStyling(true);
+				} else {
+					lineToWrapEnd = lineEndStyled;
+				}
+			}
+		}
+/* C::B end */
 
 		if (lineToWrap < lineToWrapEnd) {
 
@@ -1459,6 +1499,10 @@ bool Editor::WrapLines(enum wrapScope ws) {
 			if (surface) {
 //Platform::DebugPrintf("Wraplines: scope=%0d need=%0d..%0d perform=%0d..%0d\n", ws, wrapPending.start, wrapPending.end, lineToWrap, lineToWrapEnd);
 
+/* C::B begin */
+				const int lineToWrapStart = lineToWrap;
+				ElapsedTime etWrapping;
+/* C::B end */
 				while (lineToWrap < lineToWrapEnd) {
 					if (WrapOneLine(surface, lineToWrap)) {
 						wrapOccurred = true;
@@ -1466,6 +1510,12 @@ bool Editor::WrapLines(enum wrapScope ws) {
 					wrapPending.Wrapped(lineToWrap);
 					lineToWrap++;
 				}
+/* C::B begin */
+				durationWrapOneLine.AddSample(lineToWrap - lineToWrapStart, etWrapping.Duration());
+				// Idle wrapping only wraps styled lines, so these wait for their styles
+				if (lineRewrap < lineToWrapEnd)
+					wrapPending.AddRange(lineRewrap, lineToWrapEnd);
+/* C::B end */
 
 				goodTopLine = cs.DisplayFromDoc(lineDocTop) + std::min(subLineTop, cs.GetHeight(lineDocTop)-1);
 			}
@@ -1620,7 +1670,9 @@ void Editor::Paint(Surface *surfaceWindow, PRectangle rcArea) {
 
 	paintAbandonedByStyling = false;
 
-	StyleToPositionInView(PositionAfterArea(rcArea));
+/* C::B begin */
+	StyleAreaBounded(rcArea, true);
+/* C::B end */
 
 	PRectangle rcClient = GetClientRectangle();
 	//Platform::DebugPrintf("Client: (%3d,%3d) ... (%3d,%3d)   %d\n",
@@ -4617,12 +4669,21 @@ bool Editor::Idle() {
 			wrappingDone = true;
 	}
 
+/* C::B begin */
+	if (wrappingDone && needIdleStyling) {
+		// Wrapping styles what it wraps, so style on its own once done wrapping.
+		IdleStyling();
+	}
+/* C::B end */
+
 	// Add more idle things to do here, but make sure idleDone is
 	// set correctly before the function returns. returning
 	// false will stop calling this idle function until SetIdle() is
 	// called again.
 
-	idleDone = wrappingDone; // && thatDone && theOtherThingDone...
+/* C::B begin */
+	idleDone = wrappingDone && !needIdleStyling; // && thatDone && theOtherThingDone...
+/* C::B end */
 
 	return !idleDone;
 }
@@ -4725,6 +4786,55 @@ void Editor::StyleToPositionInView(Position pos) {
 	}
 }
 
+/* C::B begin */
+// The position up to which styling may go without taking too long. Lexing is
+// sequential, so a view far from the end of styling is styled over several
+// steps: first a part while painting, then the remainder in idle time.
+int Editor::PositionAfterMaxStyling(int posMax, bool scrolling) const {
+	// When scrolling, allow less time to ensure responsive
+	const double secondsAllowed = scrolling ? 0.005 : 0.02;
+
+	const int linesToStyle = Platform::Clamp(
+		pdoc->durationStyleOneLine.ActionsInAllowedTime(secondsAllowed), 10, 0x10000);
+	const int stylingMaxLine = std::min(
+		pdoc->LineFromPosition(pdoc->GetEndStyled()) + linesToStyle,
+		pdoc->LinesTotal());
+	return std::min(pdoc->LineStart(stylingMaxLine), posMax);
+}
+
+void Editor::StartIdleStyling(bool truncatedLastStyling) {
+	if (truncatedLastStyling) {
+		needIdleStyling = true;
+		SetIdle(true);
+	}
+}
+
+// Style the area, but only for a bounded time: what is left is styled in idle time.
+void Editor::StyleAreaBounded(PRectangle rcArea, bool scrolling) {
+	const int posAfterArea = PositionAfterArea(rcArea);
+	const int posAfterMax = PositionAfterMaxStyling(posAfterArea, scrolling);
+	if (posAfterMax < posAfterArea) {
+		// Style a bit now then style further in idle time
+		pdoc->StyleToAdjustingLineDuration(posAfterMax);
+	} else {
+		// Can style all wanted now.
+		StyleToPositionInView(posAfterArea);
+	}
+	StartIdleStyling(posAfterMax < posAfterArea);
+}
+
+void Editor::IdleStyling() {
+	const int posAfterArea = PositionAfterArea(GetClientRectangle());
+	const int posAfterMax = PositionAfterMaxStyling(posAfterArea, false);
+	const int endStyledBefore = pdoc->GetEndStyled();
+	pdoc->StyleToAdjustingLineDuration(posAfterMax);
+	// Stop as well when styling can't progress, the next paint starts again
+	if ((pdoc->GetEndStyled() >= posAfterArea) || (pdoc->GetEndStyled() == endStyledBefore)) {
+		needIdleStyling = false;
+	}
+}
+/* C::B end */
+
 void Editor::IdleWork() {
 	// Style the line after the modification as this allows modifications that change just the
 	// line of the modification to heal instead of propagating to the rest of the window.